@@ -0,0 +1,217 @@
+#include "AppConfig.h"
+
+#include <cstdlib>      // For getenv
+#include <fstream>      // For reading the config file
+#include <sstream>      // For parsing numbers
+#include "SessionBackend.h"   // For the default keepalive interval
+
+using namespace std;
+
+// Function to get the built-in settings used when nothing else is given
+AppConfig defaultAppConfig()
+{
+    AppConfig config;
+    config.connection.host = "xxx.xxx.x.x"; // hidden for security purposes
+    config.connection.port = 389;
+    config.connection.username = "cn=idamadmin,ou=sa,o=pitg";
+    config.connection.password = "xxxxxxxxxxx"; // hidden for security purposes
+    config.basePath = "o=c_plusplus_project";
+    config.keepaliveInterval = defaultKeepaliveInterval;
+    return config;
+}
+
+// Function to remove spaces and tabs from both ends of a string
+static string trim(const string& text)
+{
+    size_t first = text.find_first_not_of(" \t\r");
+    if (first == string::npos)
+    {
+        return string();
+    }
+    size_t last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+// Function to read a port number
+static bool parsePort(const string& text, int& port)
+{
+    istringstream stream(text);
+    int value = 0;
+    if (!(stream >> value) || !stream.eof() || value <= 0 || value > 65535)
+    {
+        return false;
+    }
+    port = value;
+    return true;
+}
+
+// Function to read a limit of operations per second, 0 for none
+static bool parseRate(const string& text, double& rate)
+{
+    istringstream stream(text);
+    double value = 0;
+    if (!(stream >> value) || !stream.eof() || value < 0)
+    {
+        return false;
+    }
+    rate = value;
+    return true;
+}
+
+// Function to read a number of seconds, 0 included
+static bool parseSeconds(const string& text, chrono::seconds& seconds)
+{
+    istringstream stream(text);
+    long long value = 0;
+    if (!(stream >> value) || !stream.eof() || value < 0)
+    {
+        return false;
+    }
+    seconds = chrono::seconds(value);
+    return true;
+}
+
+// Function to read settings from a config file
+bool loadConfigFile(const string& path, AppConfig& config, string& error)
+{
+    ifstream file(path);
+    if (!file.is_open())
+    {
+        error = "The config file " + path + " can't be opened";
+        return false;
+    }
+
+    string line;
+    size_t lineNumber = 0;
+    while (getline(file, line))
+    {
+        lineNumber++;
+        line = trim(line);
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        size_t equals = line.find('=');
+        if (equals == string::npos)
+        {
+            error = path + " line " + to_string(lineNumber) + ": expected key = value";
+            return false;
+        }
+        string key = trim(line.substr(0, equals));
+        string value = trim(line.substr(equals + 1));
+
+        if (key == "host")
+        {
+            config.connection.host = value;
+        }
+        else if (key == "port")
+        {
+            if (!parsePort(value, config.connection.port))
+            {
+                error = path + " line " + to_string(lineNumber) + ": invalid port '" + value + "'";
+                return false;
+            }
+        }
+        else if (key == "bind_dn")
+        {
+            config.connection.username = value;
+        }
+        else if (key == "password")
+        {
+            config.connection.password = value;
+        }
+        else if (key == "base_path")
+        {
+            config.basePath = value;
+        }
+        else if (key == "max_ops_per_second")
+        {
+            if (!parseRate(value, config.maxOpsPerSecond))
+            {
+                error = path + " line " + to_string(lineNumber) + ": invalid rate '" + value + "'";
+                return false;
+            }
+        }
+        else if (key == "keepalive_seconds")
+        {
+            if (!parseSeconds(value, config.keepaliveInterval))
+            {
+                error = path + " line " + to_string(lineNumber) + ": invalid number of seconds '" + value + "'";
+                return false;
+            }
+        }
+        else
+        {
+            error = path + " line " + to_string(lineNumber) + ": unknown key '" + key + "'";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Function to override settings from the environment
+bool applyEnvironment(AppConfig& config, string& error)
+{
+    if (const char* host = getenv("LDAP_HOST"))
+    {
+        config.connection.host = host;
+    }
+    if (const char* port = getenv("LDAP_PORT"))
+    {
+        if (!parsePort(port, config.connection.port))
+        {
+            error = string("LDAP_PORT is not a valid port: '") + port + "'";
+            return false;
+        }
+    }
+    if (const char* username = getenv("LDAP_BIND_DN"))
+    {
+        config.connection.username = username;
+    }
+    if (const char* password = getenv("LDAP_PASSWORD"))
+    {
+        config.connection.password = password;
+    }
+    if (const char* basePath = getenv("LDAP_BASE_PATH"))
+    {
+        config.basePath = basePath;
+    }
+    if (const char* rate = getenv("LDAP_MAX_OPS_PER_SECOND"))
+    {
+        if (!parseRate(rate, config.maxOpsPerSecond))
+        {
+            error = string("LDAP_MAX_OPS_PER_SECOND is not a valid rate: '") + rate + "'";
+            return false;
+        }
+    }
+    if (const char* keepalive = getenv("LDAP_KEEPALIVE_SECONDS"))
+    {
+        if (!parseSeconds(keepalive, config.keepaliveInterval))
+        {
+            error = string("LDAP_KEEPALIVE_SECONDS is not a number of seconds: '") + keepalive + "'";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Function to build the settings of a run
+bool loadAppConfig(const string& configPath, AppConfig& config, string& error)
+{
+    config = defaultAppConfig();
+
+    string path = configPath;
+    if (path.empty())
+    {
+        if (const char* environmentPath = getenv("LDAP_CONFIG"))
+        {
+            path = environmentPath;
+        }
+    }
+    if (!path.empty() && !loadConfigFile(path, config, error))
+    {
+        return false;
+    }
+    return applyEnvironment(config, error);
+}
@@ -0,0 +1,41 @@
+#ifndef APPCONFIG_H
+#define APPCONFIG_H
+
+#include <chrono>               // For the keepalive interval
+#include <string>               // For string operations
+#include "DirectoryBackend.h"   // For connection settings
+
+// Settings of the application, read from a config file and the environment
+struct AppConfig
+{
+    LDAPConnectionSettings connection;
+    std::string basePath;
+
+    // Most writes sent per second over every connection, 0 for no limit
+    double maxOpsPerSecond = 0;
+
+    // Time an idle connection waits before a keepalive request, 0 for none
+    std::chrono::seconds keepaliveInterval;
+};
+
+// Function to get the built-in settings used when nothing else is given
+AppConfig defaultAppConfig();
+
+// Function to read settings from a config file, keeping the current value of anything not in the file
+// The file has one "key = value" per line, with keys host, port, bind_dn, password, base_path,
+// max_ops_per_second and keepalive_seconds.
+// Blank lines and lines starting with # are ignored. Returns false and sets error if the file
+// can't be read or has a line that isn't understood.
+bool loadConfigFile(const std::string& path, AppConfig& config, std::string& error);
+
+// Function to override settings from the LDAP_HOST, LDAP_PORT, LDAP_BIND_DN, LDAP_PASSWORD, LDAP_BASE_PATH,
+// LDAP_MAX_OPS_PER_SECOND and LDAP_KEEPALIVE_SECONDS environment variables, returns false and sets error
+// if a number is invalid
+bool applyEnvironment(AppConfig& config, std::string& error);
+
+// Function to build the settings of a run: the built-in ones, then the config file, then the environment
+// The config file is configPath, or the file named by LDAP_CONFIG when configPath is empty; with
+// neither the built-in settings are used.
+bool loadAppConfig(const std::string& configPath, AppConfig& config, std::string& error);
+
+#endif // APPCONFIG_H
@@ -0,0 +1,260 @@
+#include "AsyncRuntime.h"
+
+#include <algorithm>            // For max
+#include <future>               // For waiting for work run on the loop
+
+using namespace std;
+
+// Coroutine that runs a spawned task to the end and then frees itself
+// It starts as soon as it is created and nothing holds its handle, so its frame is destroyed when it returns.
+struct AsyncRuntime::SpawnedTask
+{
+    struct promise_type
+    {
+        SpawnedTask get_return_object() { return {}; }
+        suspend_never initial_suspend() noexcept { return {}; }
+        suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() noexcept { terminate(); }
+    };
+};
+
+AsyncRuntime::AsyncRuntime(DirectoryBackend* connection) : ldap(connection), liveTasks(0), stopping(false)
+{
+}
+
+AsyncRuntime::~AsyncRuntime()
+{
+    stop();
+}
+
+// Function to start the event loop thread
+void AsyncRuntime::start()
+{
+    if (loopThread.joinable())
+    {
+        return;
+    }
+    stopping = false;
+    loopThread = thread(&AsyncRuntime::run, this);
+}
+
+// Function to wait for every task to finish and stop the event loop thread
+void AsyncRuntime::stop()
+{
+    if (!loopThread.joinable())
+    {
+        return;
+    }
+    {
+        lock_guard<mutex> lock(postedMutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    loopThread.join();
+}
+
+// Function to run a task on the loop until it finishes, from any thread
+void AsyncRuntime::spawn(Task<>&& task)
+{
+    liveTasks.fetch_add(1, memory_order_acq_rel);
+
+    // A task spawned by another task starts right away and runs until it first waits
+    if (onLoopThread())
+    {
+        runSpawned(move(task));
+        return;
+    }
+    {
+        lock_guard<mutex> lock(postedMutex);
+        spawned.push_back(move(task));
+    }
+    wake.notify_one();
+}
+
+// Function to run a function on the loop and wait for it, from any thread
+void AsyncRuntime::call(const function<void()>& work)
+{
+    if (!loopThread.joinable() || onLoopThread())
+    {
+        work();
+        return;
+    }
+
+    promise<void> done;
+    {
+        lock_guard<mutex> lock(postedMutex);
+        posted.push_back([&work, &done]()
+        {
+            work();
+            done.set_value();
+        });
+    }
+    wake.notify_one();
+    done.get_future().wait();
+}
+
+// Function to check if the caller is the event loop thread
+bool AsyncRuntime::onLoopThread() const
+{
+    return this_thread::get_id() == loopThread.get_id();
+}
+
+// Coroutine that runs a spawned task and counts it as finished
+AsyncRuntime::SpawnedTask AsyncRuntime::runSpawned(Task<> task)
+{
+    co_await task;
+    liveTasks.fetch_sub(1, memory_order_acq_rel);
+}
+
+// Function to run the tasks until stop() is called and none is left
+void AsyncRuntime::run()
+{
+    deque<function<void()>> work;
+    deque<Task<>> tasks;
+    while (true)
+    {
+        {
+            // Without a task ready or a request in flight there is nothing to do until work is handed over or a timer is due
+            unique_lock<mutex> lock(postedMutex);
+            if (ready.empty() && awaitedReplies.empty())
+            {
+                auto handedOver = [this]()
+                {
+                    return !posted.empty() || !spawned.empty() || (stopping && liveTasks.load(memory_order_acquire) == 0);
+                };
+                if (timers.empty())
+                {
+                    wake.wait(lock, handedOver);
+                }
+                else
+                {
+                    wake.wait_until(lock, timers.begin()->first, handedOver);
+                }
+                if (posted.empty() && spawned.empty() && stopping && liveTasks.load(memory_order_acquire) == 0)
+                {
+                    return;
+                }
+            }
+            work.swap(posted);
+            tasks.swap(spawned);
+        }
+
+        // Work from other threads runs between replies, never while a task is running
+        for (auto& job : work)
+        {
+            job();
+        }
+        work.clear();
+        for (auto& task : tasks)
+        {
+            runSpawned(move(task));
+        }
+        tasks.clear();
+
+        auto now = chrono::steady_clock::now();
+        while (!timers.empty() && timers.begin()->first <= now)
+        {
+            ready.push_back(timers.begin()->second);
+            timers.erase(timers.begin());
+        }
+        while (!ready.empty())
+        {
+            coroutine_handle<> handle = ready.front();
+            ready.pop_front();
+            handle.resume();
+        }
+
+        // Every task is now waiting, for a reply, a timer or a free place in a window
+        if (!awaitedReplies.empty())
+        {
+            int messageId = 0;
+            int resultCode = LDAP_SUCCESS;
+            int rc = ldap->waitForResult(messageId, resultCode);
+            if (connectionLost(rc))
+            {
+                // No reply can be read any more, so every task waiting for one is given the error
+                for (auto& awaited : awaitedReplies)
+                {
+                    awaited.second->resultCode = rc;
+                    ready.push_back(awaited.second->handle);
+                }
+                awaitedReplies.clear();
+            }
+            else if (rc == LDAP_SUCCESS)
+            {
+                // Replies to requests no task waits for, such as abandoned searches, are dropped
+                auto awaited = awaitedReplies.find(messageId);
+                if (awaited != awaitedReplies.end())
+                {
+                    awaited->second->resultCode = resultCode;
+                    ready.push_back(awaited->second->handle);
+                    awaitedReplies.erase(awaited);
+                }
+            }
+            // After any other error the replies may still come, and are waited for again on the next turn
+        }
+    }
+}
+
+void AsyncRuntime::ResultAwaiter::await_suspend(coroutine_handle<> awaiting)
+{
+    handle = awaiting;
+    runtime.awaitedReplies[messageId] = this;
+}
+
+void AsyncRuntime::TimerAwaiter::await_suspend(coroutine_handle<> awaiting)
+{
+    runtime.timers.emplace(due, awaiting);
+}
+
+AsyncWindow::AsyncWindow(AsyncRuntime& runtime, size_t size) : runtime(runtime), size(max<size_t>(size, 1)), used(0)
+{
+}
+
+bool AsyncWindow::Acquire::await_ready()
+{
+    // Tasks already waiting are served first, so a place given back isn't taken from them
+    if (window.waitingForPlace.empty() && window.used < window.size)
+    {
+        window.used++;
+        return true;
+    }
+    return false;
+}
+
+// Function to give back a place, handing it to the task waiting longest
+void AsyncWindow::release()
+{
+    if (used > 0)
+    {
+        used--;
+    }
+    wakeWaiting();
+}
+
+// Function to change the number of places, as a FlowController adjusts its window
+void AsyncWindow::resize(size_t newSize)
+{
+    size = max<size_t>(newSize, 1);
+    wakeWaiting();
+}
+
+// Function to hand free places to waiting tasks, and wake the tasks waiting for the window to drain
+void AsyncWindow::wakeWaiting()
+{
+    while (used < size && !waitingForPlace.empty())
+    {
+        used++;
+        runtime.schedule(waitingForPlace.front());
+        waitingForPlace.pop_front();
+    }
+    if (used == 0)
+    {
+        for (auto handle : waitingForDrain)
+        {
+            runtime.schedule(handle);
+        }
+        waitingForDrain.clear();
+    }
+}
@@ -0,0 +1,300 @@
+#ifndef ASYNCRUNTIME_H
+#define ASYNCRUNTIME_H
+
+#include <atomic>               // For the number of running tasks
+#include <chrono>               // For timers
+#include <condition_variable>   // For waking the event loop
+#include <coroutine>            // For C++20 coroutines
+#include <cstddef>              // For size_t
+#include <deque>                // For coroutines ready to run
+#include <exception>            // For terminate
+#include <functional>           // For work handed to the event loop
+#include <map>                  // For timers and awaited replies
+#include <mutex>                // For guarding work handed to the event loop
+#include <optional>             // For the result of a task
+#include <thread>               // For the event loop thread
+#include <type_traits>          // For tasks without a result
+#include <utility>              // For moving results and handles
+#include "DirectoryBackend.h"   // For directory operations
+
+template <typename T = void>
+class Task;
+
+// Resumes the task that awaited a finished task, or returns to the event loop if none did
+struct TaskFinalAwaiter
+{
+    bool await_ready() const noexcept { return false; }
+
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> finished) noexcept
+    {
+        std::coroutine_handle<> continuation = finished.promise().continuation;
+        return continuation ? continuation : std::noop_coroutine();
+    }
+
+    void await_resume() const noexcept {}
+};
+
+// Parts of the promise of a task that don't depend on its result
+struct TaskPromiseBase
+{
+    std::coroutine_handle<> continuation;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    TaskFinalAwaiter final_suspend() noexcept { return {}; }
+
+    // Nothing in this application throws on purpose, so an exception escaping a task ends the program
+    void unhandled_exception() noexcept { std::terminate(); }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase
+{
+    std::optional<T> result;
+
+    Task<T> get_return_object();
+    void return_value(T value) { result = std::move(value); }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase
+{
+    Task<void> get_return_object();
+    void return_void() {}
+};
+
+// Coroutine run by an AsyncRuntime, with a result of type T
+// A task does nothing until it is awaited by another task or given to AsyncRuntime::spawn(). Awaiting it
+// runs it until it first waits itself, and the awaiting task carries on with its result once it finishes.
+template <typename T>
+class Task
+{
+public:
+    using promise_type = TaskPromise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    Task() : handle(nullptr) {}
+    explicit Task(Handle handle) : handle(handle) {}
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    ~Task()
+    {
+        if (handle)
+        {
+            handle.destroy();
+        }
+    }
+
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (handle)
+            {
+                handle.destroy();
+            }
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    bool await_ready() const noexcept { return !handle || handle.done(); }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+
+    T await_resume()
+    {
+        if constexpr (!std::is_void_v<T>)
+        {
+            return std::move(*handle.promise().result);
+        }
+    }
+
+private:
+    Handle handle;
+};
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object()
+{
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object()
+{
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+// Event loop that runs tasks on one connection, waking each task when the reply it waits for arrives
+// Tasks send requests with a message ID and co_await result(messageId) instead of waiting for the reply,
+// so any number of them can have requests in flight on the connection at once. A single thread runs
+// every task and is the only one that reads replies, with waitForResult(), so nothing else may use the
+// connection while a task has requests in flight. Other threads use it through call(), which runs a
+// function on the loop between replies, so a short search from the menus is answered while a long
+// import carries on.
+class AsyncRuntime
+{
+public:
+    explicit AsyncRuntime(DirectoryBackend* connection);
+    ~AsyncRuntime();
+
+    AsyncRuntime(const AsyncRuntime&) = delete;
+    AsyncRuntime& operator=(const AsyncRuntime&) = delete;
+
+    // Function to start the event loop thread
+    void start();
+
+    // Function to wait for every task to finish and stop the event loop thread
+    void stop();
+
+    // Function to run a task on the loop until it finishes, from any thread
+    // A task spawned from the loop starts at once, one spawned from another thread on the next pass of the loop.
+    void spawn(Task<>&& task);
+
+    // Function to run a function on the loop and wait for it, from any thread
+    // Runs it right away if the loop isn't running or it is called from the loop itself.
+    void call(const std::function<void()>& work);
+
+    // Connection the tasks send their requests on
+    DirectoryBackend* connection() const { return ldap; }
+
+    // Number of spawned tasks that haven't finished
+    size_t runningTasks() const { return liveTasks.load(std::memory_order_acquire); }
+
+    // Awaitable reply to a request sent with a message ID, resumes the task with the request's result code
+    // If the connection fails, every task waiting for a reply is resumed with the error.
+    class ResultAwaiter
+    {
+    public:
+        ResultAwaiter(AsyncRuntime& runtime, int messageId) : runtime(runtime), messageId(messageId), resultCode(LDAP_SUCCESS) {}
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> awaiting);
+        int await_resume() const noexcept { return resultCode; }
+
+    private:
+        friend class AsyncRuntime;
+
+        AsyncRuntime& runtime;
+        int messageId;
+        int resultCode;
+        std::coroutine_handle<> handle;
+    };
+
+    // Awaitable point in time, resumes the task once it has passed
+    // The loop can't look at the clock while it waits for a reply, so a task may be resumed a little
+    // late while others have requests in flight.
+    class TimerAwaiter
+    {
+    public:
+        TimerAwaiter(AsyncRuntime& runtime, std::chrono::steady_clock::time_point due) : runtime(runtime), due(due) {}
+
+        bool await_ready() const { return due <= std::chrono::steady_clock::now(); }
+        void await_suspend(std::coroutine_handle<> awaiting);
+        void await_resume() const noexcept {}
+
+    private:
+        AsyncRuntime& runtime;
+        std::chrono::steady_clock::time_point due;
+    };
+
+    // Function to wait for the reply to a request, only from a task
+    ResultAwaiter result(int messageId) { return ResultAwaiter(*this, messageId); }
+
+    // Function to wait until a point in time or for a while, only from a task
+    TimerAwaiter sleepUntil(std::chrono::steady_clock::time_point due) { return TimerAwaiter(*this, due); }
+    TimerAwaiter sleepFor(std::chrono::steady_clock::duration delay) { return TimerAwaiter(*this, std::chrono::steady_clock::now() + delay); }
+
+    // Function to resume a suspended coroutine on the next pass of the loop, only from the loop
+    void schedule(std::coroutine_handle<> handle) { ready.push_back(handle); }
+
+private:
+    struct SpawnedTask;
+    SpawnedTask runSpawned(Task<> task);
+
+    void run();
+    bool onLoopThread() const;
+
+    DirectoryBackend* ldap;
+    std::thread loopThread;
+    std::atomic<size_t> liveTasks;
+
+    // Used by the loop thread only
+    std::deque<std::coroutine_handle<>> ready;
+    std::map<int, ResultAwaiter*> awaitedReplies;
+    std::multimap<std::chrono::steady_clock::time_point, std::coroutine_handle<>> timers;
+
+    // Work and tasks handed to the loop by other threads
+    std::mutex postedMutex;
+    std::condition_variable wake;
+    std::deque<std::function<void()>> posted;
+    std::deque<Task<>> spawned;
+    bool stopping;
+};
+
+// Limit on the requests a task keeps in flight, which it waits for when they are all in use
+// Used from the loop of one AsyncRuntime only.
+class AsyncWindow
+{
+public:
+    AsyncWindow(AsyncRuntime& runtime, size_t size);
+
+    // Awaitable free place in the window, taken when the task is resumed
+    class Acquire
+    {
+    public:
+        explicit Acquire(AsyncWindow& window) : window(window) {}
+
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> awaiting) { window.waitingForPlace.push_back(awaiting); }
+        void await_resume() const noexcept {}
+
+    private:
+        AsyncWindow& window;
+    };
+
+    // Awaitable moment every place in the window is free again
+    class Drain
+    {
+    public:
+        explicit Drain(AsyncWindow& window) : window(window) {}
+
+        bool await_ready() const noexcept { return window.used == 0; }
+        void await_suspend(std::coroutine_handle<> awaiting) { window.waitingForDrain.push_back(awaiting); }
+        void await_resume() const noexcept {}
+
+    private:
+        AsyncWindow& window;
+    };
+
+    // Function to wait for a free place and take it
+    Acquire acquire() { return Acquire(*this); }
+
+    // Function to give back a place, handing it to the task waiting longest
+    void release();
+
+    // Function to wait until every place is free
+    Drain drained() { return Drain(*this); }
+
+    // Function to change the number of places, as a FlowController adjusts its window
+    void resize(size_t newSize);
+
+    size_t inUse() const { return used; }
+
+private:
+    void wakeWaiting();
+
+    AsyncRuntime& runtime;
+    size_t size;
+    size_t used;
+    std::deque<std::coroutine_handle<>> waitingForPlace;
+    std::deque<std::coroutine_handle<>> waitingForDrain;
+};
+
+#endif // ASYNCRUNTIME_H
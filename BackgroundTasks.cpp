@@ -0,0 +1,272 @@
+#include "BackgroundTasks.h"
+
+#include <algorithm>            // For comparing the header
+#include <iomanip>              // For formatting the progress
+#include <sstream>              // For building the progress line
+#include <vector>               // For pages of users
+#include "CsvImport.h"          // For describing rows that can't be read
+#include "CsvParser.h"          // For reading the import file
+#include "DirectorySearch.h"    // For counting and listing users
+#include "EntryEncoder.h"       // For building the entries of users
+#include "FlowControl.h"        // For adapting to server load
+#include "Metrics.h"            // For counting bytes read
+#include "UserSchema.h"         // For the columns of an import file
+
+using namespace std;
+
+// Function to mark a task as finished, after which the menus may read everything in it
+static void finishBackgroundTask(BackgroundTask& task)
+{
+    task.finishTime = chrono::steady_clock::now();
+    task.finished.store(true, memory_order_release);
+}
+
+// Function to add one user, sending it again while the server answers busy, and give back its place in the window
+static Task<> addUserInBackground(AsyncRuntime& runtime, UserEntryEncoder& encoder, ImportRow row, FlowController& flow, AsyncWindow& inFlight, BackgroundTask& task)
+{
+    DirectoryBackend* ldap = runtime.connection();
+    int rc = LDAP_SUCCESS;
+    for (unsigned int attempt = 0; ; attempt++)
+    {
+        // The rate limit is waited for on the loop, so other tasks carry on meanwhile
+        co_await runtime.sleepUntil(writeRateLimiter().reserve());
+
+        // The entry is only read while the request is sent, so the encoder is reset straight away
+        int messageId = 0;
+        auto sentAt = chrono::steady_clock::now();
+        rc = ldap->addEntry(encoder.encode(row), &messageId);
+        encoder.reset();
+        if (rc == LDAP_SUCCESS)
+        {
+            rc = co_await runtime.result(messageId);
+            if (!isTransientResult(rc))
+            {
+                flow.recordReply(chrono::steady_clock::now() - sentAt);
+            }
+        }
+        if (!isTransientResult(rc) || attempt >= maxWriteRetries)
+        {
+            break;
+        }
+        flow.recordBusy();
+        co_await runtime.sleepFor(flow.retryDelay(attempt + 1));
+    }
+
+    // An existing entry is reported by the server instead of a separate existence search
+    if (rc == LDAP_SUCCESS)
+    {
+        task.report.recordAdded();
+        task.succeeded.fetch_add(1, memory_order_relaxed);
+    }
+    else if (rc == LDAP_ALREADY_EXISTS)
+    {
+        task.report.recordFailure(row.id, "User already exists");
+    }
+    else
+    {
+        task.report.recordFailure(row.id, ldap->errorString(rc));
+    }
+    inFlight.resize(flow.window());
+    inFlight.release();
+}
+
+// Function to add the users of a CSV file under ou=users of basePath, keeping up to window adds in flight
+Task<> importCsvInBackground(AsyncRuntime& runtime, string basePath, string filePath, size_t window, BackgroundTask& task)
+{
+    CsvReader file;
+    CsvRecord record;
+    CsvStatus status = CsvStatus::EndOfFile;
+    CsvImportResult importResult;
+    task.total.store(task.validation.rowCount, memory_order_relaxed);
+
+    if (!file.open(filePath))
+    {
+        task.error = "the file " + filePath + " can't be opened";
+        finishBackgroundTask(task);
+        co_return;
+    }
+    file.setExpectedColumns(csvColumnCount);
+    status = file.next(record);
+    if (status != CsvStatus::Ok || !equal(record.fields.begin(), record.fields.end(), csvColumns))
+    {
+        importResult.status = status == CsvStatus::EndOfFile ? CsvImportStatus::Empty : CsvImportStatus::BadHeader;
+        importResult.rowError = status;
+        importResult.errorRecord = file.recordNumber();
+        task.error = describeCsvImport(importResult);
+        finishBackgroundTask(task);
+        co_return;
+    }
+
+    // Children of this task use these until the window has drained, which is waited for before returning
+    UserEntryEncoder encoder(basePath);
+    FlowController flow(window);
+    AsyncWindow inFlight(runtime, window);
+
+    while (!task.cancelRequested.load(memory_order_relaxed) && (status = file.next(record)) != CsvStatus::EndOfFile)
+    {
+        ImportRow row;
+        row.recordNumber = file.recordNumber();
+
+        // Rows rejected by validation were recorded before the task started
+        if (task.validation.rejects(row.recordNumber))
+        {
+            continue;
+        }
+        if (status != CsvStatus::Ok)
+        {
+            importResult.status = CsvImportStatus::Malformed;
+            importResult.rowError = status;
+            importResult.errorRecord = row.recordNumber;
+            task.error = describeCsvImport(importResult);
+            break;
+        }
+
+        // Extract user details from the record
+        row.id.assign(record.fields[0]);
+        row.fullName.assign(record.fields[1]);
+        row.phoneNumber.assign(record.fields[2]);
+        row.email.assign(record.fields[3]);
+        row.department.assign(record.fields[4]);
+        row.jobDescription.assign(record.fields[5]);
+
+        // The record points into the reader, so the row is copied out before waiting for a place
+        co_await inFlight.acquire();
+        runtime.spawn(addUserInBackground(runtime, encoder, move(row), flow, inFlight, task));
+    }
+
+    co_await inFlight.drained();
+    metrics().csvBytesRead.fetch_add(file.byteOffset(), memory_order_relaxed);
+    file.close();
+    finishBackgroundTask(task);
+}
+
+// Function to delete one user, with its children when the server refuses to delete a non-leaf entry, and give back its place in the window
+static Task<> deleteUserInBackground(AsyncRuntime& runtime, string dn, bool treeDeleteSupported, FlowController& flow, AsyncWindow& inFlight, BackgroundTask& task)
+{
+    DirectoryBackend* ldap = runtime.connection();
+    int rc = LDAP_SUCCESS;
+    bool treeDelete = false;
+    unsigned int attempt = 0;
+    while (true)
+    {
+        co_await runtime.sleepUntil(writeRateLimiter().reserve());
+
+        int messageId = 0;
+        auto sentAt = chrono::steady_clock::now();
+        rc = ldap->deleteEntry(dn, treeDelete, &messageId);
+        if (rc == LDAP_SUCCESS)
+        {
+            rc = co_await runtime.result(messageId);
+            if (!isTransientResult(rc))
+            {
+                flow.recordReply(chrono::steady_clock::now() - sentAt);
+            }
+        }
+        if (rc == LDAP_NOT_ALLOWED_ON_NONLEAF && treeDeleteSupported && !treeDelete)
+        {
+            treeDelete = true;
+            continue;
+        }
+        if (!isTransientResult(rc) || attempt >= maxWriteRetries)
+        {
+            break;
+        }
+        attempt++;
+        flow.recordBusy();
+        co_await runtime.sleepFor(flow.retryDelay(attempt));
+    }
+
+    if (rc == LDAP_SUCCESS)
+    {
+        task.succeeded.fetch_add(1, memory_order_relaxed);
+    }
+    else
+    {
+        task.report.recordFailure(dn, ldap->errorString(rc));
+    }
+    inFlight.resize(flow.window());
+    inFlight.release();
+}
+
+// Function to delete every user under ou=users of basePath, keeping up to window deletes in flight
+Task<> deleteAllUsersInBackground(AsyncRuntime& runtime, string basePath, size_t window, BackgroundTask& task)
+{
+    DirectoryBackend* ldap = runtime.connection();
+    string filter = "(objectClass=inetOrgPerson)";
+    string searchBase = "ou=users," + basePath;
+
+    // The count only feeds the progress, so the deletes go ahead without it
+    size_t userCount = 0;
+    if (countEntries(ldap, searchBase, LDAP_SCOPE_ONELEVEL, filter, userCount) == LDAP_SUCCESS)
+    {
+        task.total.store(userCount, memory_order_relaxed);
+    }
+
+    bool treeDeleteSupported = serverSupportsControl(ldap, treeDeleteControlOid);
+    FlowController flow(window);
+    AsyncWindow inFlight(runtime, window);
+    string cookie;
+    vector<DirectoryEntry> entries;
+
+    // Each page is deleted while the next is read, a page is small enough that reading it doesn't hold up the replies for long
+    do
+    {
+        int rc = ldap->searchPage(searchBase, LDAP_SCOPE_ONELEVEL, filter, noAttributes, "", defaultSearchPageSize, cookie, entries);
+        if (rc != LDAP_SUCCESS)
+        {
+            if (rc != LDAP_NO_SUCH_OBJECT)
+            {
+                task.error = "the users can't be listed: " + ldap->errorString(rc);
+            }
+            cookie.clear();
+            break;
+        }
+        for (auto& entry : entries)
+        {
+            if (task.cancelRequested.load(memory_order_relaxed))
+            {
+                break;
+            }
+            co_await inFlight.acquire();
+            runtime.spawn(deleteUserInBackground(runtime, move(entry.dn), treeDeleteSupported, flow, inFlight, task));
+        }
+    } while (!cookie.empty() && !task.cancelRequested.load(memory_order_relaxed));
+
+    // A search left part way is abandoned so the server can free it
+    if (!cookie.empty())
+    {
+        ldap->searchPage(searchBase, LDAP_SCOPE_ONELEVEL, filter, noAttributes, "", 0, cookie, entries);
+    }
+
+    co_await inFlight.drained();
+    finishBackgroundTask(task);
+}
+
+// Function to describe the progress of a task in one line, for the menus
+string describeBackgroundTask(const BackgroundTask& task)
+{
+    size_t total = task.total.load(memory_order_relaxed);
+    size_t succeeded = task.succeeded.load(memory_order_relaxed);
+    size_t failed = task.report.failedCount();
+    size_t done = succeeded + failed;
+    bool finished = task.finished.load(memory_order_acquire);
+    auto endTime = finished ? task.finishTime : chrono::steady_clock::now();
+    double seconds = chrono::duration<double>(endTime - task.startTime).count();
+
+    ostringstream line;
+    line << task.description << ": " << done;
+    if (total > 0)
+    {
+        line << " of " << total << " (" << fixed << setprecision(1) << 100.0 * min(done, total) / total << "%)";
+    }
+    line << " done, " << failed << " failed";
+    if (seconds > 0)
+    {
+        line << ", " << static_cast<size_t>(succeeded / seconds) << " users/sec";
+    }
+    if (task.cancelRequested.load(memory_order_relaxed) && !finished)
+    {
+        line << ", cancelling";
+    }
+    return line.str();
+}
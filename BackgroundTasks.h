@@ -0,0 +1,52 @@
+#ifndef BACKGROUNDTASKS_H
+#define BACKGROUNDTASKS_H
+
+#include <atomic>               // For progress read by the menus while the task runs
+#include <chrono>               // For the time the task started
+#include <cstddef>              // For size_t
+#include <string>               // For string operations
+#include "AsyncRuntime.h"       // For running the task on the event loop
+#include "CsvValidation.h"      // For rows rejected before the import
+#include "ImportReport.h"       // For recording the outcome of each user
+
+// Import or delete run by an AsyncRuntime while the menus stay in use
+// The task updates the counters as replies arrive and sets finished last, so the menus may read the
+// counters at any time and everything else once finished is set. Setting cancelRequested stops the task
+// sending new requests, and it finishes once the ones in flight are answered.
+struct BackgroundTask
+{
+    std::string description;
+
+    // Users to add or delete, 0 while not known, and users added or deleted so far
+    std::atomic<size_t> total{0};
+    std::atomic<size_t> succeeded{0};
+
+    std::atomic<bool> cancelRequested{false};
+    std::atomic<bool> finished{false};
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point finishTime;
+
+    // Failures, written to the report file when one was opened
+    ImportReport report;
+
+    // Rows of an import file rejected before anything was sent, already recorded in the report
+    CsvValidationResult validation;
+
+    // Why the task stopped before the end, empty if it didn't
+    std::string error;
+};
+
+// Function to add the users of a CSV file under ou=users of basePath, keeping up to window adds in flight
+// The file is expected to have been checked into task.validation, and its rejected rows are skipped. Users
+// are added with asynchronous requests on the runtime's connection, fewer in flight while the server shows
+// signs of load, and writes answered busy or unavailable are sent again after a jittered delay.
+Task<> importCsvInBackground(AsyncRuntime& runtime, std::string basePath, std::string filePath, size_t window, BackgroundTask& task);
+
+// Function to delete every user under ou=users of basePath, keeping up to window deletes in flight
+// Users are listed a page at a time, and a cancelled task abandons the rest of the search.
+Task<> deleteAllUsersInBackground(AsyncRuntime& runtime, std::string basePath, size_t window, BackgroundTask& task);
+
+// Function to describe the progress of a task in one line, for the menus
+std::string describeBackgroundTask(const BackgroundTask& task);
+
+#endif // BACKGROUNDTASKS_H
@@ -0,0 +1,945 @@
+#include "BatchMode.h"
+
+#include <iostream>             // For input and output operations
+#include <fstream>              // For file handling
+#include <sstream>              // For parsing arguments
+#include <string>               // For string operations
+#include <vector>               // For storing rows and results
+#include <chrono>               // For timing bulk operations
+#include "AppConfig.h"          // For the server and credentials
+#include "CsvImport.h"          // For reading CSV input with checkpoints
+#include "CsvValidation.h"      // For checking CSV files before anything is sent
+#include "DirectorySearch.h"    // For counting users
+#include "ImportEngine.h"       // For importing over several connections
+#include "Ldif.h"               // For LDIF export and import
+#include "TenantImport.h"       // For importing several base paths at once
+#include "UserOperations.h"     // For listing and deleting users
+#include "UserWriter.h"         // For the formats of user listings
+#include "UserQuery.h"          // For filtered queries and counts
+#include "UserSnapshot.h"       // For looking users up without connecting
+#include "Metrics.h"            // For latency histograms and counters
+#include "FlowControl.h"        // For the write rate limit
+
+using namespace std;
+
+// Options of a batch command, taken from the command line
+struct BatchOptions
+{
+    string command;
+    vector<string> arguments;
+    string configPath;
+    string basePath;
+    string format;
+    string sortAttribute = defaultSortAttribute;
+    OutputFormat outputFormat = OutputFormat::Table;
+    UserQuery query;
+    vector<string> attributes;
+    string countAttribute;
+    bool countOnly = false;
+    string reportPath = defaultReportPath;
+    size_t connections = defaultImportConnections;
+    size_t window = defaultImportWindow;
+    bool confirmed = false;
+    bool resume = false;
+    bool skipInvalid = false;
+
+    // Snapshot get looks users up in, and the age in seconds past which it is not used, 0 for any age
+    string snapshotPath;
+    size_t maxSnapshotAge = 0;
+    bool verify = false;
+
+    // Most writes per second, negative to keep the one from the config
+    double maxOpsPerSecond = -1;
+};
+
+// Function to print how batch commands are used
+static void printBatchUsage(const char* program)
+{
+    cerr << "Usage:\n"
+         << "  " << program << "                          start the interactive menus\n"
+         << "  " << program << " import [FILE|-]          add users from CSV or LDIF, stdin when FILE is - or missing\n"
+         << "  " << program << " import-manifest FILE     add users from every CSV file a manifest lists, each under its own base path\n"
+         << "  " << program << " export [FILE|-]          write every user as LDIF, stdout when FILE is - or missing\n"
+         << "  " << program << " list [FILE|-]            write every user sorted, stdout when FILE is - or missing\n"
+         << "  " << program << " query [FILE|-]           write the users matching the query options, stdout when FILE is - or missing\n"
+         << "  " << program << " snapshot [FILE]          write every user to a snapshot file (default " << defaultSnapshotPath << ")\n"
+         << "  " << program << " verify-snapshot [FILE]   count the users added, deleted and modified since a snapshot\n"
+         << "  " << program << " get <cn>                 show one user\n"
+         << "  " << program << " delete <cn>              delete one user\n"
+         << "  " << program << " delete-all --yes         delete every user\n"
+         << "  " << program << " count                    print the number of users\n"
+         << "\n"
+         << "Options:\n"
+         << "  --config FILE        read host, port, bind_dn, password, base_path, max_ops_per_second\n"
+         << "                       and keepalive_seconds from FILE\n"
+         << "  --base-path DN       add and look up users under ou=users of DN\n"
+         << "  --format csv|ldif    format of the import input, by default ldif for .ldif files and csv otherwise\n"
+         << "  --output-format F    format of list: table (default), csv with the columns of an import file, or jsonl\n"
+         << "  --sort ATTRIBUTE     attribute list sorts users by (default " << defaultSortAttribute << ", numeric IDs in numeric order)\n"
+         << "  --department OU      query users in this department\n"
+         << "  --email-domain D     query users whose email address is in domain D\n"
+         << "  --job-prefix TEXT    query users whose job description starts with TEXT\n"
+         << "  --id-range A-B       query users whose numeric ID is from A to B, either may be left out\n"
+         << "  --attributes A,B     attributes query writes (default every attribute of a user)\n"
+         << "  --count-by ATTRIBUTE count the users query matches per value of ATTRIBUTE instead of writing them\n"
+         << "  --count              count the users query matches instead of writing them\n"
+         << "  --connections N      connections to import with (default " << defaultImportConnections << ")\n"
+         << "  --window N           add requests in flight per connection (default " << defaultImportWindow << ")\n"
+         << "  --report FILE        write the users that failed to import to FILE (default " << defaultReportPath << ")\n"
+         << "  --resume             carry on with an import of a CSV file that stopped before it finished\n"
+         << "  --max-rate N         send at most N writes per second over all connections, 0 for no limit\n"
+         << "  --skip-invalid       add the valid rows of a CSV file that has rows which can't be added\n"
+         << "  --snapshot FILE      get looks the user up in FILE without connecting, or on the server if it can't\n"
+         << "  --max-age SECONDS    get uses the snapshot only if it was taken at most SECONDS ago\n"
+         << "  --verify             get checks the user in the snapshot against the server, showing the server's\n"
+         << "                       copy if the snapshot is out of date\n"
+         << "\n"
+         << "Settings are taken from the config file (--config, or LDAP_CONFIG), then from LDAP_HOST, LDAP_PORT,\n"
+         << "LDAP_BIND_DN, LDAP_PASSWORD, LDAP_BASE_PATH, LDAP_MAX_OPS_PER_SECOND and LDAP_KEEPALIVE_SECONDS, then from\n"
+         << "--base-path and --max-rate.\n"
+         << "\n"
+         << "Every row of a CSV file is checked before anything is sent. Rows with the wrong number of columns, an\n"
+         << "empty or DN-unsafe id, an invalid email or phone number, or the id of an earlier row are listed in the\n"
+         << "report, and nothing is imported unless --skip-invalid is given. Rows from stdin are not checked.\n"
+         << "\n"
+         << "A manifest is a CSV file with the header file,base_path and one line per CSV file. The files are imported\n"
+         << "at the same time over the same connections, taking turns so a small file isn't held up by a large one,\n"
+         << "and the failures of each are written to its own report, numbered after its line, such as ExitFile-1.csv.\n"
+         << "\n"
+         << "verify-snapshot exits with 1 when users changed since the snapshot was taken.\n"
+         << "\n"
+         << "Exit codes: 0 success, 1 some users failed, 2 invalid usage or config, 3 connection or bind failed,\n"
+         << "4 invalid or unreadable input, 5 nothing applied or user not found." << endl;
+}
+
+// Function to read a positive number from a command line argument
+static bool parseCount(const string& text, size_t& value)
+{
+    istringstream stream(text);
+    return stream >> value && stream.eof() && value > 0;
+}
+
+// Function to read the command, its arguments and options
+static bool parseBatchOptions(int argc, char* argv[], BatchOptions& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--config" && hasValue)
+        {
+            options.configPath = argv[++i];
+        }
+        else if (argument == "--base-path" && hasValue)
+        {
+            options.basePath = argv[++i];
+        }
+        else if (argument == "--format" && hasValue)
+        {
+            options.format = argv[++i];
+            if (options.format != "csv" && options.format != "ldif")
+            {
+                cerr << "Error: Invalid format '" << options.format << "'." << endl;
+                return false;
+            }
+        }
+        else if (argument == "--output-format" && hasValue)
+        {
+            if (!parseOutputFormat(argv[++i], options.outputFormat))
+            {
+                cerr << "Error: Invalid output format '" << argv[i] << "'." << endl;
+                return false;
+            }
+        }
+        else if (argument == "--sort" && hasValue)
+        {
+            options.sortAttribute = argv[++i];
+        }
+        else if (argument == "--department" && hasValue)
+        {
+            options.query.department = argv[++i];
+        }
+        else if (argument == "--email-domain" && hasValue)
+        {
+            options.query.emailDomain = argv[++i];
+        }
+        else if (argument == "--job-prefix" && hasValue)
+        {
+            options.query.jobDescriptionPrefix = argv[++i];
+        }
+        else if (argument == "--id-range" && hasValue)
+        {
+            if (!parseIdRange(argv[++i], options.query.idFrom, options.query.idTo))
+            {
+                cerr << "Error: Invalid ID range '" << argv[i] << "'." << endl;
+                return false;
+            }
+        }
+        else if (argument == "--attributes" && hasValue)
+        {
+            options.attributes = parseAttributeList(argv[++i]);
+        }
+        else if (argument == "--count-by" && hasValue)
+        {
+            options.countAttribute = argv[++i];
+        }
+        else if (argument == "--count")
+        {
+            options.countOnly = true;
+        }
+        else if (argument == "--connections" && hasValue)
+        {
+            if (!parseCount(argv[++i], options.connections))
+            {
+                cerr << "Error: Invalid number of connections '" << argv[i] << "'." << endl;
+                return false;
+            }
+        }
+        else if (argument == "--window" && hasValue)
+        {
+            if (!parseCount(argv[++i], options.window))
+            {
+                cerr << "Error: Invalid number of requests '" << argv[i] << "'." << endl;
+                return false;
+            }
+        }
+        else if (argument == "--report" && hasValue)
+        {
+            options.reportPath = argv[++i];
+        }
+        else if (argument == "--yes")
+        {
+            options.confirmed = true;
+        }
+        else if (argument == "--max-rate" && hasValue)
+        {
+            istringstream stream(argv[++i]);
+            if (!(stream >> options.maxOpsPerSecond) || !stream.eof() || options.maxOpsPerSecond < 0)
+            {
+                cerr << "Error: Invalid rate '" << argv[i] << "'." << endl;
+                return false;
+            }
+        }
+        else if (argument == "--resume")
+        {
+            options.resume = true;
+        }
+        else if (argument == "--skip-invalid")
+        {
+            options.skipInvalid = true;
+        }
+        else if (argument == "--snapshot" && hasValue)
+        {
+            options.snapshotPath = argv[++i];
+        }
+        else if (argument == "--max-age" && hasValue)
+        {
+            if (!parseCount(argv[++i], options.maxSnapshotAge))
+            {
+                cerr << "Error: Invalid age '" << argv[i] << "'." << endl;
+                return false;
+            }
+        }
+        else if (argument == "--verify")
+        {
+            options.verify = true;
+        }
+        else if (argument.size() > 1 && argument[0] == '-' && argument != "-")
+        {
+            cerr << "Error: Invalid option '" << argument << "'." << endl;
+            return false;
+        }
+        else if (options.command.empty())
+        {
+            options.command = argument;
+        }
+        else
+        {
+            options.arguments.push_back(argument);
+        }
+    }
+    return true;
+}
+
+// Function to pick the exit code of a command that applied some users and failed on others
+static int exitCodeFor(size_t appliedCount, size_t failedCount)
+{
+    if (failedCount == 0)
+    {
+        return exitSuccess;
+    }
+    return appliedCount > 0 ? exitPartialFailure : exitFailed;
+}
+
+// Function to queue every entry of an LDIF input, entries that can't be read are recorded as failed
+static void submitLdifEntries(LdifReader& reader, ImportEngine& engine, ImportReport& report)
+{
+    vector<ImportRow> batch;
+    batch.reserve(importBatchSize);
+    ImportRow row;
+    LdifStatus status;
+    while ((status = reader.next(row)) != LdifStatus::EndOfFile)
+    {
+        if (status != LdifStatus::Ok)
+        {
+            report.recordFailure("line " + to_string(reader.entryLine()), LdifReader::describe(status));
+            continue;
+        }
+        batch.push_back(move(row));
+
+        if (batch.size() == importBatchSize)
+        {
+            engine.submit(move(batch));
+            batch = vector<ImportRow>();
+            batch.reserve(importBatchSize);
+        }
+    }
+    engine.submit(move(batch));
+}
+
+// Function to add users from a CSV or LDIF file or stdin
+static int importUsers(DirectoryBackend* ldap, const AppConfig& config, const BatchOptions& options)
+{
+    string path = options.arguments.empty() ? "-" : options.arguments[0];
+    string format = options.format;
+    if (format.empty())
+    {
+        format = path.size() > 5 && path.compare(path.size() - 5, 5, ".ldif") == 0 ? "ldif" : "csv";
+    }
+
+    CsvReader csvFile;
+    LdifReader ldifFile;
+    if (path == "-")
+    {
+        if (format == "csv")
+        {
+            csvFile.open(cin);
+        }
+        else
+        {
+            ldifFile.open(cin);
+        }
+    }
+    else if (format == "csv" ? !csvFile.open(path) : !ldifFile.open(path))
+    {
+        cerr << "Error: The file " << path << " can't be opened." << endl;
+        return exitInputError;
+    }
+
+    // Imports of CSV files keep a journal next to the file so they can be resumed, stdin can't be read again
+    CsvImportOptions importOptions;
+    ImportCheckpoint checkpoint;
+    bool journaled = format == "csv" && path != "-";
+    if (options.resume)
+    {
+        if (!journaled)
+        {
+            cerr << "Error: Only imports of CSV files can be resumed." << endl;
+            return exitUsage;
+        }
+        if (!loadImportCheckpoint(journalPathFor(path), checkpoint) || checkpoint.fileSize != csvFile.fileSize())
+        {
+            cerr << "Error: There is no import of " << path << " to resume, or the file has changed since it stopped." << endl;
+            return exitInputError;
+        }
+        importOptions.resumeFrom = &checkpoint;
+    }
+
+    // Failures are written to the report file as they happen, so memory doesn't grow with the input
+    ImportReport report;
+    if (!report.open(options.reportPath, options.resume))
+    {
+        cerr << "Error: The report file " << options.reportPath << " can't be created." << endl;
+        return exitUsage;
+    }
+
+    // Every row of a CSV file is checked on all cores before anything is sent, stdin can't be read twice
+    CsvValidationResult validation;
+    if (journaled && validateCsvFile(path, 0, validation) && validation.headerValid)
+    {
+        // A resumed import appends to the report of the run it carries on, which already lists the rejected rows
+        size_t rejectedRows = options.resume ? 0 : recordCsvIssues(validation, report);
+        if (rejectedRows > 0 && !options.skipInvalid)
+        {
+            report.close();
+            cerr << "Error: " << rejectedRows << " of " << validation.rowCount << " rows can't be added, so no users were added. "
+                 << "Run again with --skip-invalid to add the others." << endl;
+            report.printSummary(cerr);
+            return exitInputError;
+        }
+        importOptions.validation = &validation;
+    }
+
+    ImportEngine engine(ldap, config.connection, config.basePath, options.connections, options.window, report);
+    ImportProgress progress(csvFile.fileSize());
+    if (journaled)
+    {
+        engine.setAnsweredListener([&progress](const ImportRow& row) { progress.finished(row); });
+        importOptions.progress = &progress;
+        importOptions.journalPath = journalPathFor(path);
+    }
+    engine.start();
+
+    auto startTime = chrono::steady_clock::now();
+    bool inputValid = true;
+    CsvImportResult importResult;
+    if (format == "csv")
+    {
+        importResult = submitCsvRows(csvFile, engine, importOptions);
+        csvFile.close();
+        if (importResult.status != CsvImportStatus::Complete)
+        {
+            cerr << "Error: " << describeCsvImport(importResult) << "." << endl;
+            inputValid = false;
+        }
+    }
+    else
+    {
+        submitLdifEntries(ldifFile, engine, report);
+        ldifFile.close();
+    }
+
+    // Wait for every connection to finish its rows
+    engine.finish();
+    report.close();
+    bool journalRemoved = finishCsvImportJournal(importOptions, importResult);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    cerr << "Imported " << report.addedCount() << " users in " << seconds << " seconds";
+    if (seconds > 0)
+    {
+        cerr << " (" << static_cast<size_t>(report.addedCount() / seconds) << " users/sec)";
+    }
+    cerr << ", " << report.failedCount() << " failed." << endl;
+    report.printSummary(cerr);
+    if (importResult.resumedRows > 0)
+    {
+        cerr << importResult.resumedRows << " users imported before the import was resumed were skipped." << endl;
+    }
+    if (!journalRemoved)
+    {
+        cerr << progress.unfinishedCount() << " users were not answered, run the import again with --resume to carry on." << endl;
+    }
+
+    if (!inputValid)
+    {
+        return exitInputError;
+    }
+    return exitCodeFor(report.addedCount(), report.failedCount());
+}
+
+// Function to add users from every CSV file a manifest lists, each under its own base path
+static int importManifest(DirectoryBackend* ldap, const AppConfig& config, const BatchOptions& options)
+{
+    vector<TenantFeed> feeds;
+    string error;
+    if (!loadImportManifest(options.arguments[0], feeds, error))
+    {
+        cerr << "Error: " << error << "." << endl;
+        return exitInputError;
+    }
+
+    TenantImportOptions importOptions;
+    importOptions.connections = options.connections;
+    importOptions.window = options.window;
+    importOptions.reportPath = options.reportPath;
+    importOptions.skipInvalid = options.skipInvalid;
+
+    auto startTime = chrono::steady_clock::now();
+    vector<TenantImportResult> results;
+    importTenants(ldap, config.connection, feeds, importOptions, results);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    printTenantResults(cerr, feeds, results);
+
+    size_t addedCount = 0;
+    size_t failedCount = 0;
+    bool inputValid = true;
+    for (const auto& result : results)
+    {
+        addedCount += result.report->addedCount();
+        failedCount += result.report->failedCount();
+        inputValid = inputValid && result.error.empty();
+    }
+    cerr << "Imported " << addedCount << " users for " << feeds.size() << " tenants in " << seconds << " seconds";
+    if (seconds > 0)
+    {
+        cerr << " (" << static_cast<size_t>(addedCount / seconds) << " users/sec)";
+    }
+    cerr << ", " << failedCount << " failed." << endl;
+
+    if (!inputValid)
+    {
+        return exitInputError;
+    }
+    return exitCodeFor(addedCount, failedCount);
+}
+
+// Function to write every user as LDIF to a file or stdout
+static int exportUsers(DirectoryBackend* ldap, const AppConfig& config, const BatchOptions& options)
+{
+    string path = options.arguments.empty() ? "-" : options.arguments[0];
+    size_t entryCount = 0;
+    int rc = LDAP_SUCCESS;
+    auto startTime = chrono::steady_clock::now();
+
+    if (path == "-")
+    {
+        rc = exportLdif(ldap, config.basePath, cout, entryCount);
+        cout.flush();
+    }
+    else
+    {
+        // The buffer has to be in place before the file is opened to take effect
+        vector<char> outputBuffer(ldifBufferSize);
+        ofstream out;
+        out.rdbuf()->pubsetbuf(outputBuffer.data(), outputBuffer.size());
+        out.open(path, ios::binary);
+        if (!out.is_open())
+        {
+            cerr << "Error: The file " << path << " can't be created." << endl;
+            return exitInputError;
+        }
+        rc = exportLdif(ldap, config.basePath, out, entryCount);
+        out.close();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    if (rc != LDAP_SUCCESS)
+    {
+        cerr << "Export stopped after " << entryCount << " entries: " << ldap->errorString(rc) << endl;
+        return exitFailed;
+    }
+    cerr << "Exported " << entryCount << " entries in " << seconds << " seconds." << endl;
+    return exitSuccess;
+}
+
+// Function to write every user, sorted, to a file or stdout
+static int listUsers(DirectoryBackend* ldap, const AppConfig& config, const BatchOptions& options)
+{
+    string path = options.arguments.empty() ? "-" : options.arguments[0];
+    int rc = LDAP_SUCCESS;
+    size_t userCount = 0;
+    bool written = false;
+    auto startTime = chrono::steady_clock::now();
+
+    // The writer buffers whole megabytes, so the stream needs no buffer of its own
+    if (path == "-")
+    {
+        UserWriter writer(cout, options.outputFormat, displayedAttributes);
+        rc = displayAllLDAPUsers(ldap, config.basePath, options.sortAttribute, writer);
+        userCount = writer.userCount();
+        written = static_cast<bool>(cout);
+    }
+    else
+    {
+        ofstream out(path, ios::binary);
+        if (!out.is_open())
+        {
+            cerr << "Error: The file " << path << " can't be created." << endl;
+            return exitInputError;
+        }
+        UserWriter writer(out, options.outputFormat, displayedAttributes);
+        rc = displayAllLDAPUsers(ldap, config.basePath, options.sortAttribute, writer);
+        userCount = writer.userCount();
+        out.close();
+        written = static_cast<bool>(out);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    if (!written)
+    {
+        cerr << "Error: The users could not be written to " << (path == "-" ? "stdout" : path) << "." << endl;
+        return exitInputError;
+    }
+    if (rc != LDAP_SUCCESS && rc != LDAP_NO_SUCH_OBJECT)
+    {
+        cerr << "Listing stopped after " << userCount << " users." << endl;
+        return exitFailed;
+    }
+    cerr << "Listed " << userCount << " users in " << seconds << " seconds." << endl;
+    return exitSuccess;
+}
+
+// Function to write the users a query matches, or how many there are, to a file or stdout
+static int findUsers(DirectoryBackend* ldap, const AppConfig& config, const BatchOptions& options)
+{
+    string path = options.arguments.empty() ? "-" : options.arguments[0];
+    ofstream file;
+    if (path != "-")
+    {
+        file.open(path, ios::binary);
+        if (!file.is_open())
+        {
+            cerr << "Error: The file " << path << " can't be created." << endl;
+            return exitInputError;
+        }
+    }
+    ostream& out = path == "-" ? cout : file;
+
+    int rc = LDAP_SUCCESS;
+    size_t userCount = 0;
+    auto startTime = chrono::steady_clock::now();
+    if (options.countOnly || !options.countAttribute.empty())
+    {
+        // Only the counts are kept, whatever the number of users
+        vector<UserGroupCount> counts;
+        size_t missingCount = 0;
+        rc = countUsersBy(ldap, config.basePath, options.query, options.countAttribute, counts, missingCount);
+        if (rc == LDAP_SUCCESS || rc == LDAP_NO_SUCH_OBJECT)
+        {
+            writeUserCounts(out, options.outputFormat, options.countAttribute, counts, missingCount);
+        }
+        userCount = missingCount;
+        for (const auto& group : counts)
+        {
+            userCount += group.count;
+        }
+    }
+    else
+    {
+        UserWriter writer(out, options.outputFormat, options.attributes.empty() ? displayedAttributes : options.attributes);
+        rc = queryUsers(ldap, config.basePath, options.query, writer);
+        userCount = writer.userCount();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    if (file.is_open())
+    {
+        file.close();
+    }
+    if (!out)
+    {
+        cerr << "Error: The users could not be written to " << (path == "-" ? "stdout" : path) << "." << endl;
+        return exitInputError;
+    }
+    if (rc != LDAP_SUCCESS && rc != LDAP_NO_SUCH_OBJECT)
+    {
+        return exitFailed;
+    }
+    cerr << userCount << " users matched in " << seconds << " seconds." << endl;
+    return exitSuccess;
+}
+
+// Function to print the attributes of one user
+static int getUser(DirectoryBackend* ldap, const AppConfig& config, const string& userId)
+{
+    string userDN = "cn=" + userId + ",ou=users," + config.basePath;
+    vector<DirectoryEntry> entries;
+    int rc = ldap->search(userDN, LDAP_SCOPE_BASE, "(objectClass=inetOrgPerson)", displayedAttributes, 0, entries);
+    if (rc == LDAP_NO_SUCH_OBJECT || (rc == LDAP_SUCCESS && entries.empty()))
+    {
+        cerr << "No user found with DN: " << userDN << endl;
+        return exitFailed;
+    }
+    if (rc != LDAP_SUCCESS)
+    {
+        cerr << "LDAP search failed: " << ldap->errorString(rc) << endl;
+        return exitFailed;
+    }
+
+    cout << "dn: " << userDN << "\n";
+    for (const auto& attr : displayedAttributes)
+    {
+        const string* value = entries[0].firstValue(attr);
+        if (value)
+        {
+            cout << attr << ": " << *value << "\n";
+        }
+    }
+    cout.flush();
+    return exitSuccess;
+}
+
+// Function to write every user to a snapshot file
+static int takeSnapshot(DirectoryBackend* ldap, const AppConfig& config, const BatchOptions& options)
+{
+    string path = options.arguments.empty() ? defaultSnapshotPath : options.arguments[0];
+    auto startTime = chrono::steady_clock::now();
+    size_t userCount = 0;
+    if (writeUserSnapshot(ldap, config.basePath, path, userCount) != LDAP_SUCCESS)
+    {
+        return exitFailed;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    cerr << "Wrote a snapshot of " << userCount << " users to " << path << " in " << seconds << " seconds." << endl;
+    return exitSuccess;
+}
+
+// Function to get the age of a snapshot in whole seconds
+static long long snapshotAge(const UserSnapshot& snapshot)
+{
+    return chrono::duration_cast<chrono::seconds>(chrono::system_clock::now() - snapshot.takenAt()).count();
+}
+
+// Function to count the users added, deleted and modified on the server since a snapshot was taken
+static int verifySnapshot(DirectoryBackend* ldap, const BatchOptions& options)
+{
+    string path = options.arguments.empty() ? defaultSnapshotPath : options.arguments[0];
+    UserSnapshot snapshot;
+    string error;
+    if (!snapshot.open(path, error))
+    {
+        cerr << "Error: " << error << "." << endl;
+        return exitInputError;
+    }
+
+    SnapshotDrift drift;
+    if (verifyUserSnapshot(ldap, snapshot, drift) != LDAP_SUCCESS)
+    {
+        return exitFailed;
+    }
+    if (drift.isCurrent())
+    {
+        cout << "The snapshot of " << snapshot.size() << " users taken " << snapshotAge(snapshot) << " seconds ago is up to date." << endl;
+        return exitSuccess;
+    }
+    cout << "Since the snapshot was taken " << snapshotAge(snapshot) << " seconds ago, " << drift.added << " users were added, "
+         << drift.deleted << " deleted and " << drift.modified << " modified." << endl;
+    return exitPartialFailure;
+}
+
+// Function to map the snapshot get was given, returns false with a warning if it can't be used
+static bool openSnapshotFor(const BatchOptions& options, const AppConfig& config, UserSnapshot& snapshot)
+{
+    string error;
+    if (!snapshot.open(options.snapshotPath, error))
+    {
+        cerr << "Warning: " << error << ", looking the user up on the server." << endl;
+        return false;
+    }
+    if (snapshot.basePath() != config.basePath)
+    {
+        cerr << "Warning: The snapshot is of users under " << snapshot.basePath() << ", looking the user up on the server." << endl;
+        return false;
+    }
+    long long age = snapshotAge(snapshot);
+    if (options.maxSnapshotAge > 0 && age > static_cast<long long>(options.maxSnapshotAge))
+    {
+        cerr << "Warning: The snapshot was taken " << age << " seconds ago, looking the user up on the server." << endl;
+        return false;
+    }
+    return true;
+}
+
+// Function to print the attributes of one user from a snapshot
+static int getSnapshotUser(const UserSnapshot& snapshot, const string& userId)
+{
+    size_t user = snapshot.find(userId);
+    if (user == UserSnapshot::npos)
+    {
+        cerr << "No user found with ID " << userId << " in the snapshot taken " << snapshotAge(snapshot) << " seconds ago." << endl;
+        return exitFailed;
+    }
+
+    cout << "dn: " << snapshot.dn(user) << "\n";
+    string_view value;
+    for (const auto& attr : displayedAttributes)
+    {
+        if (snapshot.value(user, attr, value))
+        {
+            cout << attr << ": " << value << "\n";
+        }
+    }
+    cout.flush();
+    return exitSuccess;
+}
+
+// Function to print one user from a snapshot after checking with the server that it hasn't changed
+static int getVerifiedSnapshotUser(DirectoryBackend* ldap, const AppConfig& config, const UserSnapshot& snapshot, const string& userId)
+{
+    string userDN = "cn=" + userId + ",ou=users," + config.basePath;
+    vector<DirectoryEntry> entries;
+    int rc = ldap->search(userDN, LDAP_SCOPE_BASE, "(objectClass=inetOrgPerson)", { "modifyTimestamp" }, 0, entries);
+    if (rc != LDAP_SUCCESS && rc != LDAP_NO_SUCH_OBJECT)
+    {
+        cerr << "LDAP search failed: " << ldap->errorString(rc) << endl;
+        return exitFailed;
+    }
+
+    // The snapshot is current for this user if both agree it is missing, or it has the server's modifyTimestamp
+    bool onServer = rc == LDAP_SUCCESS && !entries.empty();
+    size_t user = snapshot.find(userId);
+    bool current = onServer == (user != UserSnapshot::npos);
+    if (current && onServer)
+    {
+        const string* timestamp = entries[0].firstValue("modifyTimestamp");
+        string_view snapshotTimestamp;
+        bool hasTimestamp = snapshot.value(user, "modifyTimestamp", snapshotTimestamp);
+        current = (timestamp != nullptr) == hasTimestamp && (timestamp == nullptr || *timestamp == snapshotTimestamp);
+    }
+    if (!current)
+    {
+        cerr << "The snapshot is out of date for this user, showing the server's copy." << endl;
+        return getUser(ldap, config, userId);
+    }
+    return getSnapshotUser(snapshot, userId);
+}
+
+// Function to run a command on a bound connection
+static int runOnConnection(DirectoryBackend* ldap, const AppConfig& config, const BatchOptions& options)
+{
+    if (options.command == "import")
+    {
+        return importUsers(ldap, config, options);
+    }
+    if (options.command == "import-manifest")
+    {
+        return importManifest(ldap, config, options);
+    }
+    if (options.command == "export")
+    {
+        return exportUsers(ldap, config, options);
+    }
+    if (options.command == "list")
+    {
+        return listUsers(ldap, config, options);
+    }
+    if (options.command == "query")
+    {
+        return findUsers(ldap, config, options);
+    }
+    if (options.command == "snapshot")
+    {
+        return takeSnapshot(ldap, config, options);
+    }
+    if (options.command == "verify-snapshot")
+    {
+        return verifySnapshot(ldap, options);
+    }
+    if (options.command == "get")
+    {
+        return getUser(ldap, config, options.arguments[0]);
+    }
+    if (options.command == "delete")
+    {
+        string userDN = "cn=" + options.arguments[0] + ",ou=users," + config.basePath;
+        return deleteSingleLDAPUser(ldap, userDN) == LDAP_SUCCESS ? exitSuccess : exitFailed;
+    }
+    string searchBase = "ou=users," + config.basePath;
+    if (options.command == "delete-all")
+    {
+        // The users left afterwards tell whether some, all or none were deleted
+        size_t before = 0;
+        size_t after = 0;
+        int rc = countEntries(ldap, searchBase, LDAP_SCOPE_ONELEVEL, "(objectClass=inetOrgPerson)", before);
+        if (rc == LDAP_NO_SUCH_OBJECT || (rc == LDAP_SUCCESS && before == 0))
+        {
+            cerr << "There are no users to delete." << endl;
+            return exitSuccess;
+        }
+        rc = deleteAllLDAPUsers(ldap, config.basePath);
+        if (countEntries(ldap, searchBase, LDAP_SCOPE_ONELEVEL, "(objectClass=inetOrgPerson)", after) != LDAP_SUCCESS)
+        {
+            return rc == LDAP_SUCCESS ? exitSuccess : exitFailed;
+        }
+        return exitCodeFor(before - min(before, after), after);
+    }
+
+    size_t userCount = 0;
+    int rc = countEntries(ldap, searchBase, LDAP_SCOPE_ONELEVEL, "(objectClass=inetOrgPerson)", userCount);
+    if (rc != LDAP_SUCCESS && rc != LDAP_NO_SUCH_OBJECT)
+    {
+        cerr << "LDAP search failed: " << ldap->errorString(rc) << endl;
+        return exitFailed;
+    }
+    cout << userCount << endl;
+    return exitSuccess;
+}
+
+// Function to run one command given on the command line instead of the menus
+int runBatchCommand(int argc, char* argv[])
+{
+    // Nothing here reads stdin with C stdio, so the streams can buffer on their own
+    ios::sync_with_stdio(false);
+
+    BatchOptions options;
+    if (!parseBatchOptions(argc, argv, options))
+    {
+        printBatchUsage(argv[0]);
+        return exitUsage;
+    }
+
+    // Check the command and the number of arguments it takes
+    size_t minArguments = 0;
+    size_t maxArguments = 0;
+    if (options.command == "import" || options.command == "export" || options.command == "list" || options.command == "query"
+        || options.command == "snapshot" || options.command == "verify-snapshot")
+    {
+        maxArguments = 1;
+    }
+    else if (options.command == "get" || options.command == "delete" || options.command == "import-manifest")
+    {
+        minArguments = 1;
+        maxArguments = 1;
+    }
+    else if (options.command != "delete-all" && options.command != "count")
+    {
+        if (options.command != "help")
+        {
+            cerr << "Error: Unknown command '" << options.command << "'." << endl;
+        }
+        printBatchUsage(argv[0]);
+        return options.command == "help" ? exitSuccess : exitUsage;
+    }
+    if (options.arguments.size() < minArguments || options.arguments.size() > maxArguments)
+    {
+        printBatchUsage(argv[0]);
+        return exitUsage;
+    }
+    if (options.command == "delete-all" && !options.confirmed)
+    {
+        cerr << "Error: delete-all deletes every user, add --yes to confirm." << endl;
+        return exitUsage;
+    }
+
+    AppConfig config;
+    string error;
+    if (!loadAppConfig(options.configPath, config, error))
+    {
+        cerr << "Error: " << error << "." << endl;
+        return exitUsage;
+    }
+    if (!options.basePath.empty())
+    {
+        config.basePath = options.basePath;
+    }
+    if (options.maxOpsPerSecond >= 0)
+    {
+        config.maxOpsPerSecond = options.maxOpsPerSecond;
+    }
+    writeRateLimiter().setRate(config.maxOpsPerSecond);
+
+    // A user found in a snapshot is shown without connecting, unless it is to be checked with the server
+    UserSnapshot snapshot;
+    bool useSnapshot = options.command == "get" && !options.snapshotPath.empty() && openSnapshotFor(options, config, snapshot);
+    if (useSnapshot && !options.verify)
+    {
+        return getSnapshotUser(snapshot, options.arguments[0]);
+    }
+
+    // Connect and bind, then run the command
+    unique_ptr<DirectoryBackend> backend = createDirectoryBackend(config.keepaliveInterval);
+    DirectoryBackend* ldap = backend.get();
+    int rc = ldap->open(config.connection.host, config.connection.port);
+    if (rc != LDAP_SUCCESS)
+    {
+        cerr << "Failed to initialize LDAP connection: " << ldap->errorString(rc) << endl;
+        return exitConnectionFailed;
+    }
+    rc = ldap->bind(config.connection.username, config.connection.password);
+    if (rc != LDAP_SUCCESS)
+    {
+        cerr << "LDAP bind failed: " << ldap->errorString(rc) << endl;
+        ldap->close();
+        return exitConnectionFailed;
+    }
+
+    int exitCode = useSnapshot ? getVerifiedSnapshotUser(ldap, config, snapshot, options.arguments[0]) : runOnConnection(ldap, config, options);
+    ldap->close();
+
+    if (!writeMetricsSnapshot())
+    {
+        cerr << "Warning: Failed to write the metrics snapshot." << endl;
+    }
+    return exitCode;
+}
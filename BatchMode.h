@@ -0,0 +1,22 @@
+#ifndef BATCHMODE_H
+#define BATCHMODE_H
+
+// Exit codes of a batch command, for schedulers and scripts
+enum BatchExitCode
+{
+    exitSuccess = 0,            // Everything was applied
+    exitPartialFailure = 1,     // Some users or entries failed, the rest were applied
+    exitUsage = 2,              // The command line or the config is invalid
+    exitConnectionFailed = 3,   // The server can't be reached or the bind was refused
+    exitInputError = 4,         // The input can't be opened or isn't valid CSV or LDIF
+    exitFailed = 5              // Nothing was applied, or the user asked for doesn't exist
+};
+
+// Function to run one command given on the command line instead of the menus
+// Commands are import, import-manifest, export, list, query, snapshot, verify-snapshot, get, delete, delete-all
+// and count; "-" as a file reads stdin or writes stdout, so a generator can be piped straight into an import.
+// get --snapshot answers from a snapshot file without connecting. Results go to stdout and everything else
+// to stderr. Returns one of the exit codes above.
+int runBatchCommand(int argc, char* argv[]);
+
+#endif // BATCHMODE_H
@@ -0,0 +1,858 @@
+#include <iostream>     // For input and output operations
+#include <fstream>      // For file handling
+#include <sstream>      // For parsing arguments
+#include <string>       // For string operations
+#include <vector>       // For storing results
+#include <chrono>       // For timing each phase
+#include <atomic>       // For counting allocations
+#include <cstdlib>      // For the replaced allocation functions
+#include <new>          // For the replaced allocation functions
+#include "CsvParser.h"  // For reading CSV files
+#include "CsvGenerator.h" // For generating benchmark data
+#include "CsvVerify.h"  // For checking the CSV reader
+#include "FakeDirectoryBackend.h" // For the local directory stand-in
+#include "InstrumentedBackend.h" // For per-operation latencies
+#include "SessionBackend.h" // For timing adds through the wrapped connection
+#include "ImportEngine.h" // For importing over several connections
+#include "CsvImport.h"  // For reading import files
+#include "DirectorySearch.h" // For counting entries
+#include "UserOperations.h" // For viewing and deleting users
+#include "UserWriter.h" // For writing user listings
+#include "EntryEncoder.h" // For building the entries of users
+
+using namespace std;
+
+// Base path the benchmark users are added under
+static const string basePath = "o=c_plusplus_project";
+
+// Number of heap allocations made by the whole program, counted by the operator new below
+static atomic<size_t> allocationCount(0);
+
+// GCC can't tell that these replace the default functions, and warns that free() is given memory from new
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size)
+{
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    void* memory = malloc(size == 0 ? 1 : size);
+    if (memory == nullptr)
+    {
+        throw bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+    free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+    free(memory);
+}
+
+// Settings of a benchmark run, taken from the command line
+struct BenchmarkSettings
+{
+    vector<size_t> rowCounts = { 1000, 100000 };
+    long long latencyUs = 100;
+    size_t connections = 4;
+    size_t window = defaultImportWindow;
+    size_t capacity = 0;
+    unsigned int seed = 1;
+    string dataDirectory = ".";
+    string outputPath = "benchmark.json";
+    string label;
+};
+
+// Timing of one phase of a run
+struct PhaseResult
+{
+    double seconds = 0;
+    size_t rows = 0;
+
+    double rowsPerSecond() const { return seconds > 0 ? rows / seconds : 0; }
+};
+
+// Results of one row count
+struct RunResult
+{
+    size_t rowCount = 0;
+    size_t fileBytes = 0;
+    PhaseResult parse;
+    PhaseResult import;
+    size_t importFailed = 0;
+    PhaseResult viewAll;
+    PhaseResult deleteAll;
+    size_t remainingAfterDelete = 0;
+
+    // Metrics of the whole run as a JSON object
+    string metricsJson;
+};
+
+// Stream buffer that throws its output away, so console output is formatted but not written while timed
+class NullBuffer : public streambuf
+{
+protected:
+    int overflow(int c) override { return c; }
+    streamsize xsputn(const char*, streamsize count) override { return count; }
+};
+
+// Function to write a string as a JSON string literal
+static void writeJsonString(ostream& out, const string& value)
+{
+    out << '"';
+    for (char c : value)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out << '\\' << c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            static const char hex[] = "0123456789abcdef";
+            out << "\\u00" << hex[(c >> 4) & 0xF] << hex[c & 0xF];
+        }
+        else
+        {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+// Function to write one phase as a JSON object
+static void writeJsonPhase(ostream& out, const char* name, const PhaseResult& phase)
+{
+    out << "      \"" << name << "\": { \"seconds\": " << phase.seconds << ", \"rows\": " << phase.rows << ", \"rowsPerSec\": " << phase.rowsPerSecond() << " }";
+}
+
+// Function to write the results of every run as JSON
+static bool writeJsonResults(const string& path, const BenchmarkSettings& settings, const vector<RunResult>& runs)
+{
+    ofstream out(path);
+    if (!out)
+    {
+        return false;
+    }
+
+    out.precision(6);
+    out << "{\n";
+    out << "  \"label\": ";
+    writeJsonString(out, settings.label);
+    out << ",\n";
+    out << "  \"settings\": { \"latencyUs\": " << settings.latencyUs << ", \"connections\": " << settings.connections
+        << ", \"window\": " << settings.window << ", \"capacity\": " << settings.capacity << ", \"seed\": " << settings.seed << " },\n";
+    out << "  \"runs\": [\n";
+    for (size_t i = 0; i < runs.size(); i++)
+    {
+        const RunResult& run = runs[i];
+        double megabytes = run.fileBytes / (1024.0 * 1024.0);
+        out << "    {\n";
+        out << "      \"rows\": " << run.rowCount << ",\n";
+        out << "      \"fileBytes\": " << run.fileBytes << ",\n";
+        writeJsonPhase(out, "parse", run.parse);
+        out << ",\n";
+        out << "      \"parseMegabytesPerSec\": " << (run.parse.seconds > 0 ? megabytes / run.parse.seconds : 0) << ",\n";
+        writeJsonPhase(out, "import", run.import);
+        out << ",\n";
+        out << "      \"importFailed\": " << run.importFailed << ",\n";
+        writeJsonPhase(out, "viewAll", run.viewAll);
+        out << ",\n";
+        writeJsonPhase(out, "deleteAll", run.deleteAll);
+        out << ",\n";
+        out << "      \"remainingAfterDelete\": " << run.remainingAfterDelete << ",\n";
+        out << "      \"metrics\": " << run.metricsJson << "\n";
+        out << "    }" << (i + 1 < runs.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n";
+    out << "}\n";
+
+    return static_cast<bool>(out);
+}
+
+// Function to generate a benchmark file, returns false if it can't be written
+static bool generateFile(const string& path, size_t rowCount, unsigned int seed)
+{
+    vector<char> buffer(1 << 20);
+    ofstream out;
+    out.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    out.open(path, ios::binary);
+    if (!out)
+    {
+        return false;
+    }
+
+    bool written = writeSyntheticUsers(out, rowCount, seed);
+    out.close();
+    return written && !out.fail();
+}
+
+// Function to check if a file exists
+static bool fileExists(const string& path)
+{
+    ifstream file(path);
+    return file.good();
+}
+
+// Function to read a file without doing anything with its rows, to measure the parser alone
+static bool measureParse(const string& path, RunResult& run)
+{
+    CsvReader file;
+    if (!file.open(path))
+    {
+        return false;
+    }
+
+    CsvRecord record;
+    CsvStatus status;
+    size_t rows = 0;
+    size_t fieldBytes = 0;
+    auto startTime = chrono::steady_clock::now();
+    file.setExpectedColumns(csvColumnCount);
+    while ((status = file.next(record)) != CsvStatus::EndOfFile)
+    {
+        if (status != CsvStatus::Ok)
+        {
+            cerr << "Error: line " << file.recordNumber() << " of " << path << ": " << CsvReader::describe(status) << endl;
+            return false;
+        }
+        rows++;
+
+        // Touch the fields so the loop can't be optimized away
+        fieldBytes += record.fields[0].size();
+    }
+    run.parse.seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    run.parse.rows = rows > 0 ? rows - 1 : 0;
+    run.fileBytes = file.byteOffset();
+    file.close();
+
+    return fieldBytes > 0;
+}
+
+// Function to import a file the way the menu does, timing from opening the file to the last reply
+static bool measureImport(DirectoryBackend* ldap, const BenchmarkSettings& settings, const string& path, RunResult& run)
+{
+    auto startTime = chrono::steady_clock::now();
+
+    CsvReader file;
+    if (!file.open(path))
+    {
+        return false;
+    }
+
+    // Failures are only counted, the benchmark writes no report file
+    LDAPConnectionSettings connectionSettings = { "localhost", 389, "", "" };
+    ImportReport report;
+    ImportEngine engine(ldap, connectionSettings, basePath, settings.connections, settings.window, report);
+    engine.start();
+
+    // No journal is kept, a benchmark is never resumed
+    CsvImportResult result = submitCsvRows(file, engine, CsvImportOptions());
+    file.close();
+    if (result.status != CsvImportStatus::Complete)
+    {
+        cerr << "Error: " << path << " is not a valid import file (" << describeCsvImport(result) << ")." << endl;
+    }
+    engine.finish();
+
+    run.import.seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    run.import.rows = report.addedCount();
+    run.importFailed = report.failedCount();
+    return result.status == CsvImportStatus::Complete;
+}
+
+// Function to run every phase against a fresh directory for one row count
+static bool runBenchmark(const BenchmarkSettings& settings, size_t rowCount, RunResult& run)
+{
+    run.rowCount = rowCount;
+
+    string path = settings.dataDirectory + "/benchmark_" + to_string(rowCount) + ".csv";
+    if (!fileExists(path))
+    {
+        cout << "Generating " << path << "..." << endl;
+        if (!generateFile(path, rowCount, settings.seed))
+        {
+            cerr << "Error: Failed to write " << path << "." << endl;
+            return false;
+        }
+    }
+
+    if (!measureParse(path, run))
+    {
+        return false;
+    }
+
+    FakeDirectorySettings directorySettings;
+    directorySettings.latency = chrono::microseconds(settings.latencyUs);
+    directorySettings.capacity = settings.capacity;
+    directorySettings.seed = settings.seed;
+    InstrumentedBackend backend(unique_ptr<DirectoryBackend>(new FakeDirectoryBackend(directorySettings)));
+    DirectoryBackend* ldap = &backend;
+    metrics().reset();
+    int rc = ldap->open("localhost", 389);
+    if (rc == LDAP_SUCCESS)
+    {
+        rc = ldap->bind("", "");
+    }
+    if (rc != LDAP_SUCCESS)
+    {
+        cerr << "Error: Failed to open the directory stand-in: " << ldap->errorString(rc) << endl;
+        return false;
+    }
+
+    if (!measureImport(ldap, settings, path, run))
+    {
+        return false;
+    }
+
+    // The view and delete output is formatted as usual but not written, so the console doesn't dominate
+    NullBuffer nullBuffer;
+    streambuf* consoleBuffer = cout.rdbuf(&nullBuffer);
+
+    auto startTime = chrono::steady_clock::now();
+    {
+        UserWriter writer(cout, OutputFormat::Table, displayedAttributes);
+        displayAllLDAPUsers(ldap, basePath, defaultSortAttribute, writer);
+    }
+    run.viewAll.seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    run.viewAll.rows = run.import.rows;
+
+    startTime = chrono::steady_clock::now();
+    rc = deleteAllLDAPUsers(ldap, basePath);
+    run.deleteAll.seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    run.deleteAll.rows = run.import.rows;
+
+    cout.rdbuf(consoleBuffer);
+
+    countEntries(ldap, "ou=users," + basePath, LDAP_SCOPE_ONELEVEL, "(objectClass=inetOrgPerson)", run.remainingAfterDelete);
+    ldap->close();
+
+    ostringstream metricsJson;
+    metrics().writeJson(metricsJson);
+    run.metricsJson = metricsJson.str();
+    return rc == LDAP_SUCCESS;
+}
+
+// Function to build the entry of a user the way it was built before the encoder, for comparison
+static void encodeWithVectors(const ImportRow& row, string& dn, vector<EntryAttribute>& attributes)
+{
+    istringstream iss(row.fullName);
+    string firstName, lastName;
+    iss >> firstName;
+    getline(iss, lastName);
+
+    dn = "cn=" + row.id + ",ou=users," + basePath;
+    attributes = {
+        { "cn", { row.id } },
+        { "sn", { lastName } },
+        { "givenName", { firstName } },
+        { "mail", { row.email } },
+        { "objectClass", { "inetOrgPerson", "organizationalPerson", "person", "top" } },
+        { "ou", { row.department } },
+        { "telephoneNumber", { row.phoneNumber } },
+        { "description", { row.jobDescription } }
+    };
+}
+
+// Function to measure the heap allocations and speed of building entries from rows
+// Rows are encoded a batch at a time like the import engine does, the first batch warms the arena up
+static void measureEncode(size_t rowCount)
+{
+    vector<ImportRow> rows(importBatchSize);
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        string number = to_string(i + 1);
+        rows[i].id = "user" + number;
+        rows[i].fullName = "Firstname" + number + " Lastname" + number;
+        rows[i].phoneNumber = "555-01" + number;
+        rows[i].email = "user" + number + "@example.com";
+        rows[i].department = "Engineering";
+        rows[i].jobDescription = "Builds and maintains the directory tooling";
+    }
+
+    size_t batches = (rowCount + rows.size() - 1) / rows.size();
+    size_t encodedRows = batches * rows.size();
+    size_t checksum = 0;
+
+    // Entries built as vectors of strings
+    string dn;
+    vector<EntryAttribute> attributes;
+    size_t allocationsBefore = allocationCount.load(memory_order_relaxed);
+    auto startTime = chrono::steady_clock::now();
+    for (size_t batch = 0; batch < batches; batch++)
+    {
+        for (const auto& row : rows)
+        {
+            encodeWithVectors(row, dn, attributes);
+            checksum += dn.size() + attributes.size();
+        }
+    }
+    double vectorSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    size_t vectorAllocations = allocationCount.load(memory_order_relaxed) - allocationsBefore;
+
+    // Entries built by the encoder
+    UserEntryEncoder encoder(basePath);
+    for (const auto& row : rows)
+    {
+        checksum += encoder.encode(row).attributeCount;
+    }
+    encoder.reset();
+    allocationsBefore = allocationCount.load(memory_order_relaxed);
+    startTime = chrono::steady_clock::now();
+    for (size_t batch = 0; batch < batches; batch++)
+    {
+        for (const auto& row : rows)
+        {
+            EntryView entry = encoder.encode(row);
+            checksum += entry.attributeCount + entry.dn[0];
+        }
+        encoder.reset();
+    }
+    double encoderSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    size_t encoderAllocations = allocationCount.load(memory_order_relaxed) - allocationsBefore;
+
+    cout << "Encoded " << encodedRows << " users (checksum " << checksum << ")" << endl;
+    cout << "  vectors: " << static_cast<double>(vectorAllocations) / encodedRows << " allocations/row, "
+         << static_cast<size_t>(vectorSeconds > 0 ? encodedRows / vectorSeconds : 0) << " rows/sec" << endl;
+    cout << "  encoder: " << static_cast<double>(encoderAllocations) / encodedRows << " allocations/row, "
+         << static_cast<size_t>(encoderSeconds > 0 ? encodedRows / encoderSeconds : 0) << " rows/sec" << endl;
+}
+
+// Function to add users with up to window adds in flight, the way the import engine sends them, returns the number that failed
+// Each entry is only read while its request is sent, so the encoder is reset straight after.
+static size_t addUsers(DirectoryBackend* ldap, UserEntryEncoder& encoder, const vector<ImportRow>& rows, size_t first, size_t last, size_t window)
+{
+    size_t next = first;
+    size_t inFlight = 0;
+    size_t failed = 0;
+    while (next < last || inFlight > 0)
+    {
+        int messageId = 0;
+        if (next < last && inFlight < window)
+        {
+            int rc = ldap->addEntry(encoder.encode(rows[next++]), &messageId);
+            encoder.reset();
+            if (rc == LDAP_SUCCESS)
+            {
+                inFlight++;
+            }
+            else
+            {
+                failed++;
+            }
+            continue;
+        }
+
+        int resultCode = LDAP_SUCCESS;
+        if (ldap->waitForResult(messageId, resultCode) != LDAP_SUCCESS)
+        {
+            return failed + inFlight + (last - next);
+        }
+        inFlight--;
+        if (resultCode != LDAP_SUCCESS)
+        {
+            failed++;
+        }
+    }
+    return failed;
+}
+
+// Function to time adding users to a fresh directory stand-in and count the heap allocations made per user
+// The first batch, or window if larger, warms up the encoder and the tables of outstanding requests, and isn't counted.
+static bool timeAdds(DirectoryBackend* ldap, const vector<ImportRow>& rows, size_t window, double& allocationsPerRow, double& rowsPerSecond)
+{
+    int rc = ldap->open("localhost", 389);
+    if (rc == LDAP_SUCCESS)
+    {
+        rc = ldap->bind("", "");
+    }
+    if (rc != LDAP_SUCCESS)
+    {
+        cerr << "Error: Failed to open the directory stand-in: " << ldap->errorString(rc) << endl;
+        return false;
+    }
+
+    UserEntryEncoder encoder(basePath);
+    size_t warmUpRows = min(max(importBatchSize, window), rows.size());
+    size_t failed = addUsers(ldap, encoder, rows, 0, warmUpRows, window);
+
+    size_t allocationsBefore = allocationCount.load(memory_order_relaxed);
+    auto startTime = chrono::steady_clock::now();
+    failed += addUsers(ldap, encoder, rows, warmUpRows, rows.size(), window);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    size_t allocations = allocationCount.load(memory_order_relaxed) - allocationsBefore;
+    ldap->close();
+
+    if (failed > 0)
+    {
+        cerr << "Error: " << failed << " of " << rows.size() << " adds failed." << endl;
+        return false;
+    }
+    size_t timedRows = rows.size() - warmUpRows;
+    allocationsPerRow = timedRows > 0 ? static_cast<double>(allocations) / timedRows : 0;
+    rowsPerSecond = seconds > 0 ? timedRows / seconds : 0;
+    return true;
+}
+
+// Function to measure the heap allocations and speed of adding users through the connection the menus use
+// The directory stand-in answers at once, so the time and allocations left are those of sending the adds
+// and reading their replies. The stand-in stores every user, which costs the same with or without the
+// session and instrumentation layers wrapped around it, so the difference between the two is theirs.
+static bool measureAdd(size_t rowCount, size_t window)
+{
+    vector<ImportRow> rows(rowCount);
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        string number = to_string(i + 1);
+        rows[i].id = "user" + number;
+        rows[i].fullName = "Firstname" + number + " Lastname" + number;
+        rows[i].phoneNumber = "555-01" + number;
+        rows[i].email = "user" + number + "@example.com";
+        rows[i].department = "Engineering";
+        rows[i].jobDescription = "Builds and maintains the directory tooling";
+    }
+
+    FakeDirectorySettings directorySettings;
+    directorySettings.latency = chrono::microseconds(0);
+
+    double bareAllocations = 0;
+    double bareRowsPerSecond = 0;
+    {
+        FakeDirectoryBackend backend(directorySettings);
+        if (!timeAdds(&backend, rows, window, bareAllocations, bareRowsPerSecond))
+        {
+            return false;
+        }
+    }
+
+    // Wrapped like createDirectoryBackend() does, without the keepalive thread
+    double wrappedAllocations = 0;
+    double wrappedRowsPerSecond = 0;
+    {
+        unique_ptr<DirectoryBackend> instrumented(new InstrumentedBackend(unique_ptr<DirectoryBackend>(new FakeDirectoryBackend(directorySettings))));
+        SessionBackend backend(move(instrumented), chrono::seconds(0));
+        if (!timeAdds(&backend, rows, window, wrappedAllocations, wrappedRowsPerSecond))
+        {
+            return false;
+        }
+    }
+
+    cout << "Added " << rowCount << " users with " << window << " in flight" << endl;
+    cout << "  stand-in alone: " << bareAllocations << " allocations/row, " << static_cast<size_t>(bareRowsPerSecond) << " rows/sec" << endl;
+    cout << "  wrapped:        " << wrappedAllocations << " allocations/row, " << static_cast<size_t>(wrappedRowsPerSecond) << " rows/sec" << endl;
+    cout << "  the wrapping makes " << wrappedAllocations - bareAllocations << " allocations/row" << endl;
+    return true;
+}
+
+// Function to measure how fast listings are written to a file, in each format and the way they were written before
+// The users are made up here rather than searched for, so only formatting and writing are timed.
+static bool measureWrite(size_t rowCount, const string& dataDirectory)
+{
+    const size_t targetPerSecond = 1000000;
+
+    // A batch of distinct users is written over and over, like the pages of a search
+    vector<DirectoryEntry> entries(1000);
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        string number = to_string(i + 1);
+        entries[i].dn = "cn=" + number + ",ou=users," + basePath;
+        entries[i].attributes = {
+            { "cn", { number } },
+            { "sn", { "Lastname" + number } },
+            { "givenName", { "Firstname" + number } },
+            { "mail", { "user" + number + "@example.com" } },
+            { "ou", { "Engineering" } },
+            { "telephoneNumber", { "555-01" + number } },
+            { "description", { i % 10 == 0 ? "Builds, tests and ships \"the\" directory tooling" : "Builds and maintains the directory tooling" } }
+        };
+    }
+
+    const struct { const char* name; OutputFormat format; } formats[] = {
+        { "table", OutputFormat::Table }, { "csv", OutputFormat::Csv }, { "jsonl", OutputFormat::JsonLines }
+    };
+    bool allMetTarget = true;
+    cout << "Wrote " << rowCount << " users to " << dataDirectory << "/listing.*" << endl;
+    for (const auto& format : formats)
+    {
+        string path = dataDirectory + "/listing." + format.name;
+        ofstream out(path, ios::binary);
+        if (!out)
+        {
+            cerr << "Error: Failed to write " << path << "." << endl;
+            return false;
+        }
+
+        auto startTime = chrono::steady_clock::now();
+        {
+            UserWriter writer(out, format.format, displayedAttributes);
+            for (size_t i = 0; i < rowCount; i++)
+            {
+                writer.writeUser(entries[i % entries.size()]);
+            }
+            writer.finish();
+        }
+        out.close();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+        if (!out)
+        {
+            cerr << "Error: Failed to write " << path << "." << endl;
+            return false;
+        }
+
+        size_t perSecond = static_cast<size_t>(seconds > 0 ? rowCount / seconds : 0);
+        allMetTarget = allMetTarget && perSecond >= targetPerSecond;
+        cout << "  " << format.name << ": " << seconds << " s (" << perSecond << " users/sec)" << endl;
+    }
+
+    // Every attribute line ended with endl, flushing the stream each time
+    string path = dataDirectory + "/listing.txt";
+    ofstream out(path, ios::binary);
+    auto startTime = chrono::steady_clock::now();
+    for (size_t i = 0; i < rowCount; i++)
+    {
+        const DirectoryEntry& entry = entries[i % entries.size()];
+        out << "\nUser Details (DN: " << entry.dn << "):\n";
+        for (const auto& attr : displayedAttributes)
+        {
+            const string* value = entry.firstValue(attr);
+            if (value)
+            {
+                out << attr << ": " << *value << endl;
+            }
+        }
+    }
+    out.close();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    cout << "  lines flushed one at a time: " << seconds << " s (" << static_cast<size_t>(seconds > 0 ? rowCount / seconds : 0) << " users/sec)" << endl;
+
+    cout << (allMetTarget ? "Every format" : "Not every format") << " reached the target of " << targetPerSecond << " users/sec." << endl;
+    return allMetTarget;
+}
+
+// Function to read a positive number from a command line argument
+static bool parseCount(const string& text, size_t& value)
+{
+    istringstream stream(text);
+    return stream >> value && stream.eof() && value > 0;
+}
+
+// Function to read a comma-separated list of row counts
+static bool parseRowCounts(const string& text, vector<size_t>& rowCounts)
+{
+    rowCounts.clear();
+    istringstream stream(text);
+    string item;
+    while (getline(stream, item, ','))
+    {
+        size_t rowCount = 0;
+        if (!parseCount(item, rowCount))
+        {
+            return false;
+        }
+        rowCounts.push_back(rowCount);
+    }
+    return !rowCounts.empty();
+}
+
+// Function to print how the benchmark is used
+static void printUsage(const char* program)
+{
+    cerr << "Usage:\n"
+         << "  " << program << " generate <rows> <file> [--seed N]\n"
+         << "  " << program << " run [--rows 1000,100000] [--latency-us 100] [--connections 4] [--window 64]\n"
+         << "      [--capacity N] [--seed N] [--data-dir DIR] [--output benchmark.json] [--label TEXT]\n"
+         << "  " << program << " encode [--rows 100000]\n"
+         << "  " << program << " add [--rows 100000] [--window 64]\n"
+         << "  " << program << " write [--rows 100000] [--data-dir DIR]\n"
+         << "  " << program << " verify-csv [SAMPLE_DIR] [--data-dir DIR]\n"
+         << "\n"
+         << "'run' generates benchmark_<rows>.csv in the data directory when it is missing, then measures\n"
+         << "parsing, importing, viewing all and deleting all users against an in-process directory with\n"
+         << "the given latency per request, and writes the results as JSON. With --capacity the directory\n"
+         << "answers busy once it is working on that many writes. Large runs such as\n"
+         << "--rows 10000000 keep every user in memory and need several gigabytes.\n"
+         << "\n"
+         << "'encode' counts the heap allocations made while building the entries of the largest number\n"
+         << "of users given, with the encoder used by imports and with the vectors of strings it replaced.\n"
+         << "\n"
+         << "'add' adds the largest number of users given to an in-process directory that answers at once,\n"
+         << "through the directory alone and then wrapped in the session and instrumentation layers the menus\n"
+         << "use, and counts the heap allocations and rows/sec of the adds and their replies.\n"
+         << "\n"
+         << "'write' writes the largest number of users given to listing.table, .csv and .jsonl in the data\n"
+         << "directory the way listings do, then the way they were written with a flush after every line, and\n"
+         << "fails unless every format reaches 1000000 users/sec.\n"
+         << "\n"
+         << "'verify-csv' reads the Company sample files in SAMPLE_DIR (the current directory by default),\n"
+         << "a generated file and hand-written inputs both from a mapped file and from a stream, and fails\n"
+         << "unless every record and field is the expected one. Inputs are written to the data directory." << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    string command = argv[1];
+    BenchmarkSettings settings;
+    vector<string> positional;
+
+    // Read the options shared by both commands
+    for (int i = 2; i < argc; i++)
+    {
+        string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        size_t number = 0;
+        if (argument == "--rows" && hasValue && parseRowCounts(argv[i + 1], settings.rowCounts))
+        {
+            i++;
+        }
+        else if (argument == "--latency-us" && hasValue)
+        {
+            istringstream stream(argv[++i]);
+            if (!(stream >> settings.latencyUs) || settings.latencyUs < 0)
+            {
+                cerr << "Error: Invalid latency '" << argv[i] << "'." << endl;
+                return 2;
+            }
+        }
+        else if (argument == "--connections" && hasValue && parseCount(argv[i + 1], number))
+        {
+            settings.connections = number;
+            i++;
+        }
+        else if (argument == "--window" && hasValue && parseCount(argv[i + 1], number))
+        {
+            settings.window = number;
+            i++;
+        }
+        else if (argument == "--capacity" && hasValue && parseCount(argv[i + 1], number))
+        {
+            settings.capacity = number;
+            i++;
+        }
+        else if (argument == "--seed" && hasValue && parseCount(argv[i + 1], number))
+        {
+            settings.seed = static_cast<unsigned int>(number);
+            i++;
+        }
+        else if (argument == "--data-dir" && hasValue)
+        {
+            settings.dataDirectory = argv[++i];
+        }
+        else if (argument == "--output" && hasValue)
+        {
+            settings.outputPath = argv[++i];
+        }
+        else if (argument == "--label" && hasValue)
+        {
+            settings.label = argv[++i];
+        }
+        else if (argument.compare(0, 2, "--") != 0)
+        {
+            positional.push_back(argument);
+        }
+        else
+        {
+            cerr << "Error: Invalid option '" << argument << "'." << endl;
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (command == "generate")
+    {
+        size_t rowCount = 0;
+        if (positional.size() != 2 || !parseCount(positional[0], rowCount))
+        {
+            printUsage(argv[0]);
+            return 2;
+        }
+
+        auto startTime = chrono::steady_clock::now();
+        if (!generateFile(positional[1], rowCount, settings.seed))
+        {
+            cerr << "Error: Failed to write " << positional[1] << "." << endl;
+            return 1;
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+        cout << "Wrote " << rowCount << " users to " << positional[1] << " in " << seconds << " seconds." << endl;
+        return 0;
+    }
+
+    if (command == "encode" && positional.empty())
+    {
+        measureEncode(*max_element(settings.rowCounts.begin(), settings.rowCounts.end()));
+        return 0;
+    }
+
+    if (command == "add" && positional.empty())
+    {
+        return measureAdd(*max_element(settings.rowCounts.begin(), settings.rowCounts.end()), settings.window) ? 0 : 1;
+    }
+
+    if (command == "write" && positional.empty())
+    {
+        return measureWrite(*max_element(settings.rowCounts.begin(), settings.rowCounts.end()), settings.dataDirectory) ? 0 : 1;
+    }
+
+    if (command == "verify-csv" && positional.size() <= 1)
+    {
+        return verifyCsvReader(positional.empty() ? "." : positional[0], settings.dataDirectory, cout) == 0 ? 0 : 1;
+    }
+
+    if (command != "run" || !positional.empty())
+    {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    vector<RunResult> runs;
+    for (size_t rowCount : settings.rowCounts)
+    {
+        RunResult run;
+        cout << "Running with " << rowCount << " users..." << endl;
+        if (!runBenchmark(settings, rowCount, run))
+        {
+            cerr << "Error: The run with " << rowCount << " users failed." << endl;
+            return 1;
+        }
+
+        cout << "  parse:      " << run.parse.seconds << " s (" << static_cast<size_t>(run.parse.rowsPerSecond()) << " rows/sec)" << endl;
+        cout << "  import:     " << run.import.seconds << " s (" << static_cast<size_t>(run.import.rowsPerSecond()) << " rows/sec, " << run.importFailed << " failed)" << endl;
+        cout << "  view all:   " << run.viewAll.seconds << " s" << endl;
+        cout << "  delete all: " << run.deleteAll.seconds << " s (" << static_cast<size_t>(run.deleteAll.rowsPerSecond()) << " rows/sec)" << endl;
+        runs.push_back(run);
+    }
+
+    if (!writeJsonResults(settings.outputPath, settings, runs))
+    {
+        cerr << "Error: Failed to write " << settings.outputPath << "." << endl;
+        return 1;
+    }
+    cout << "Results written to " << settings.outputPath << "." << endl;
+
+    return 0;
+}
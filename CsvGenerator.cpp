@@ -0,0 +1,90 @@
+#include "CsvGenerator.h"
+
+#include <cstdint>      // For 64-bit mixing
+#include <string>       // For building rows
+
+using namespace std;
+
+static const char* const firstNames[] = { "John", "Jane", "Bob", "Emily", "Michael", "Jessica", "David", "Laura", "Robert", "Susan",
+                                          "Avery", "Pat", "Riley", "Taylor", "Casey", "Chris", "Alex", "Jordan", "Morgan", "Sam" };
+static const char* const lastNames[] = { "Doe", "Smith", "Johnson", "Davis", "Brown", "Wilson", "Martinez", "Garcia", "Lee", "Miller",
+                                         "Adams", "Baker", "Walker", "Lewis", "Wright", "Allen", "Young", "King", "Scott", "Green" };
+static const char* const departments[] = { "Engineering", "Marketing", "Sales", "Human Resources", "Finance", "IT", "Customer Support", "Product" };
+static const char* const jobDescriptions[] = { "Software Engineer", "Marketing Manager", "Sales Representative", "HR Specialist", "Senior Developer",
+                                               "Accountant", "System Administrator", "Support Specialist", "DevOps Engineer", "Product Manager" };
+
+template <typename T, size_t N>
+static size_t countOf(T (&)[N])
+{
+    return N;
+}
+
+// Function to mix a row ID and seed into well-spread bits (splitmix64)
+static uint64_t mix(uint64_t value)
+{
+    value += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
+}
+
+// Function to append a name in lower case, for the e-mail address
+static void appendLower(string& out, const char* name)
+{
+    for (const char* c = name; *c; c++)
+    {
+        out += static_cast<char>(*c >= 'A' && *c <= 'Z' ? *c - 'A' + 'a' : *c);
+    }
+}
+
+// Function to write a synthetic import file with the id,full_name,...,job_description header and rowCount users
+bool writeSyntheticUsers(ostream& out, size_t rowCount, unsigned int seed)
+{
+    out << "id,full_name,phone_number,email,department,job_description\n";
+
+    string row;
+    for (size_t id = 1; id <= rowCount && out; id++)
+    {
+        uint64_t bits = mix((static_cast<uint64_t>(seed) << 40) ^ id);
+        const char* firstName = firstNames[bits % countOf(firstNames)];
+        const char* lastName = lastNames[(bits >> 8) % countOf(lastNames)];
+        const char* department = departments[(bits >> 16) % countOf(departments)];
+        const char* jobDescription = jobDescriptions[(bits >> 24) % countOf(jobDescriptions)];
+        unsigned int phoneSuffix = static_cast<unsigned int>((bits >> 32) % 10000);
+
+        row.clear();
+        row += to_string(id);
+        row += ',';
+        row += firstName;
+        row += ' ';
+        row += lastName;
+        row += ",123-456-";
+        string phone = to_string(phoneSuffix);
+        row.append(4 - phone.size(), '0');
+        row += phone;
+        row += ',';
+        appendLower(row, firstName);
+        row += '.';
+        appendLower(row, lastName);
+        row += to_string(id);
+        row += "@example.com,";
+        row += department;
+        row += ',';
+        if ((bits >> 48) % 10 == 0)
+        {
+            row += '"';
+            row += jobDescription;
+            row += ", ";
+            row += department;
+            row += '"';
+        }
+        else
+        {
+            row += jobDescription;
+        }
+        row += '\n';
+        out.write(row.data(), row.size());
+    }
+
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,13 @@
+#ifndef CSVGENERATOR_H
+#define CSVGENERATOR_H
+
+#include <cstddef>      // For size_t
+#include <ostream>      // For streaming output
+
+// Function to write a synthetic import file with the id,full_name,...,job_description header and rowCount users
+// Every row is derived from its ID and the seed alone, so the same arguments always give the same file.
+// About one row in ten has a quoted job description containing a comma, so the escaped-field path of the
+// parser is measured too. Returns false if the stream fails.
+bool writeSyntheticUsers(std::ostream& out, size_t rowCount, unsigned int seed = 1);
+
+#endif // CSVGENERATOR_H
@@ -0,0 +1,169 @@
+#include "CsvImport.h"
+
+#include <algorithm>            // For comparing the header
+#include <chrono>               // For timing checkpoints
+#include <cstdio>               // For removing the journal
+#include <iostream>             // For error output
+#include <vector>               // For batches of rows
+#include "Metrics.h"            // For counting bytes read
+#include "UserSchema.h"         // For the columns of an import file
+
+using namespace std;
+
+// Function to hand a batch to the engine, tracking its rows first so none is answered before it is tracked
+static void submitBatch(ImportEngine& engine, const CsvImportOptions& options, vector<ImportRow>& batch)
+{
+    if (batch.empty())
+    {
+        return;
+    }
+    if (options.progress != nullptr)
+    {
+        options.progress->submitted(batch);
+    }
+    engine.submit(options.tenant, move(batch));
+    batch = vector<ImportRow>();
+    batch.reserve(importBatchSize);
+}
+
+// Function to check the header of a CSV import file and hand its rows to the import engine in batches
+CsvImportResult submitCsvRows(CsvReader& file, ImportEngine& engine, const CsvImportOptions& options)
+{
+    CsvImportResult result;
+    CsvRecord record;
+    CsvStatus status;
+    vector<ImportRow> batch;
+    batch.reserve(importBatchSize);
+
+    // Check the header
+    file.setExpectedColumns(csvColumnCount);
+    status = file.next(record);
+    if (status == CsvStatus::EndOfFile)
+    {
+        result.status = CsvImportStatus::Empty;
+        return result;
+    }
+    if (status != CsvStatus::Ok || !equal(record.fields.begin(), record.fields.end(), csvColumns))
+    {
+        result.status = CsvImportStatus::BadHeader;
+        result.rowError = status;
+        result.errorRecord = file.recordNumber();
+        return result;
+    }
+
+    // Rows before the checkpoint were answered by the server, so reading carries on from there
+    size_t skippedBytes = 0;
+    if (options.resumeFrom != nullptr && options.resumeFrom->committedOffset > file.byteOffset())
+    {
+        skippedBytes = options.resumeFrom->committedOffset - file.byteOffset();
+        file.seek(options.resumeFrom->committedOffset, options.resumeFrom->committedRecords);
+    }
+    size_t recordStart = file.byteOffset();
+    auto lastCheckpoint = chrono::steady_clock::now();
+
+    while ((status = file.next(record)) != CsvStatus::EndOfFile)
+    {
+        ImportRow row;
+        row.recordNumber = file.recordNumber();
+        row.byteOffset = recordStart;
+
+        // Rows rejected by validation were recorded before the import started
+        if (options.validation != nullptr && options.validation->rejects(row.recordNumber))
+        {
+            recordStart = file.byteOffset();
+            continue;
+        }
+        if (status != CsvStatus::Ok)
+        {
+            result.status = CsvImportStatus::Malformed;
+            result.rowError = status;
+            result.errorRecord = row.recordNumber;
+            break;
+        }
+        recordStart = file.byteOffset();
+
+        // Extract user details from the record
+        row.id.assign(record.fields[0]);
+        row.fullName.assign(record.fields[1]);
+        row.phoneNumber.assign(record.fields[2]);
+        row.email.assign(record.fields[3]);
+        row.department.assign(record.fields[4]);
+        row.jobDescription.assign(record.fields[5]);
+
+        if (options.resumeFrom != nullptr)
+        {
+            if (!options.resumeFrom->needsReplay(row))
+            {
+                result.resumedRows++;
+                continue;
+            }
+            row.replayed = row.byteOffset < options.resumeFrom->readOffset;
+        }
+        if (options.skip && options.skip(row))
+        {
+            continue;
+        }
+        batch.push_back(move(row));
+
+        if (batch.size() == importBatchSize)
+        {
+            submitBatch(engine, options, batch);
+
+            // Write a checkpoint now and then, a lost one only means more rows are sent again
+            auto now = chrono::steady_clock::now();
+            if (options.progress != nullptr && now - lastCheckpoint >= checkpointInterval)
+            {
+                if (!saveImportCheckpoint(options.journalPath, options.progress->checkpoint(file.byteOffset(), file.recordNumber())))
+                {
+                    cerr << "Warning: Failed to write the checkpoint " << options.journalPath << "." << endl;
+                }
+                lastCheckpoint = now;
+            }
+        }
+    }
+    submitBatch(engine, options, batch);
+
+    result.stopOffset = recordStart;
+    result.stopRecords = result.status == CsvImportStatus::Malformed ? result.errorRecord - 1 : file.recordNumber();
+    metrics().csvBytesRead.fetch_add(file.byteOffset() - skippedBytes, memory_order_relaxed);
+    return result;
+}
+
+// Function to end the journal of an import once the engine has finished
+bool finishCsvImportJournal(const CsvImportOptions& options, const CsvImportResult& result)
+{
+    if (options.progress == nullptr)
+    {
+        return true;
+    }
+
+    // Nothing is left to resume once every row sent was answered
+    if (options.progress->unfinishedCount() == 0)
+    {
+        remove(options.journalPath.c_str());
+        return true;
+    }
+
+    if (!saveImportCheckpoint(options.journalPath, options.progress->checkpoint(result.stopOffset, result.stopRecords)))
+    {
+        cerr << "Warning: Failed to write the checkpoint " << options.journalPath << "." << endl;
+    }
+    return false;
+}
+
+// Function to describe why reading an import file stopped, for error messages
+string describeCsvImport(const CsvImportResult& result)
+{
+    switch (result.status)
+    {
+    case CsvImportStatus::Complete:
+        return "Every row was read";
+    case CsvImportStatus::Empty:
+        return "The input is empty";
+    case CsvImportStatus::BadHeader:
+        return "CSV header is incorrect";
+    case CsvImportStatus::Malformed:
+        return "File is not properly comma-delimited (line " + to_string(result.errorRecord) + ": " + CsvReader::describe(result.rowError) + ")";
+    }
+    return "Unknown error";
+}
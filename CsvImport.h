@@ -0,0 +1,72 @@
+#ifndef CSVIMPORT_H
+#define CSVIMPORT_H
+
+#include <cstddef>              // For size_t
+#include <functional>           // For the skip test
+#include <string>               // For the journal path
+#include "CsvParser.h"          // For reading the import file
+#include "CsvValidation.h"      // For rows rejected before the import
+#include "ImportEngine.h"       // For importing the rows
+#include "ImportJournal.h"      // For checkpoints
+
+// Outcome of reading an import file
+enum class CsvImportStatus
+{
+    Complete,       // Every row was read
+    Empty,          // The input has no header
+    BadHeader,      // The header doesn't name the expected columns
+    Malformed       // A row can't be read, the rows after it were not read either
+};
+
+// Options of reading an import file
+struct CsvImportOptions
+{
+    // Tenant of the engine the rows are queued for
+    size_t tenant = 0;
+
+    // Rows for which skip returns true are not sent, for example users already in the local cache
+    std::function<bool(const ImportRow&)> skip;
+
+    // When set, rows are tracked and a checkpoint is written to journalPath every checkpointInterval
+    // The engine's answered listener must report to the same progress.
+    ImportProgress* progress = nullptr;
+    std::string journalPath;
+
+    // When set, reading starts at the checkpoint and only rows that may not have been applied are sent
+    const ImportCheckpoint* resumeFrom = nullptr;
+
+    // When set, the rows it rejects are not sent and a row that can't be read doesn't stop reading
+    // The rejected rows are expected to be recorded in the report already.
+    const CsvValidationResult* validation = nullptr;
+};
+
+// Structure to store where and why reading an import file stopped
+struct CsvImportResult
+{
+    CsvImportStatus status = CsvImportStatus::Complete;
+
+    // Why the row couldn't be read, and its record number, when the status is Malformed or BadHeader
+    CsvStatus rowError = CsvStatus::Ok;
+    size_t errorRecord = 0;
+
+    // Position reading stopped at, the start of the row that couldn't be read
+    size_t stopOffset = 0;
+    size_t stopRecords = 0;
+
+    // Rows not sent because they were applied before the checkpoint that was resumed from
+    size_t resumedRows = 0;
+};
+
+// Function to check the header of a CSV import file and hand its rows to the import engine in batches
+// Reading stops at the first row that can't be read, the engine still finishes the rows before it.
+CsvImportResult submitCsvRows(CsvReader& file, ImportEngine& engine, const CsvImportOptions& options);
+
+// Function to end the journal of an import once the engine has finished
+// The journal is removed when every row sent was answered. Otherwise the rows lost with a connection
+// are written as in flight so a resume sends them again, and false is returned.
+bool finishCsvImportJournal(const CsvImportOptions& options, const CsvImportResult& result);
+
+// Function to describe why reading an import file stopped, for error messages
+std::string describeCsvImport(const CsvImportResult& result);
+
+#endif // CSVIMPORT_H
@@ -0,0 +1,471 @@
+#include "CsvParser.h"
+
+#include <cstring>      // For memchr and memmove
+
+#ifdef _WIN32
+#include <Windows.h>    // For memory-mapped files
+#else
+#include <fcntl.h>      // For open
+#include <sys/mman.h>   // For mmap
+#include <sys/stat.h>   // For fstat
+#include <unistd.h>     // For close
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>  // For SSE2 byte comparisons
+#define CSV_USE_SSE2
+#endif
+
+using namespace std;
+
+// Function to check if a character ends an unquoted field
+static inline bool isSpecial(char c)
+{
+    return c == ',' || c == '"' || c == '\n' || c == '\r';
+}
+
+// Function to find the next comma, quote or line break, 16 bytes at a time where SSE2 is available
+static const char* findSpecial(const char* p, const char* end)
+{
+#ifdef CSV_USE_SSE2
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i lineFeed = _mm_set1_epi8('\n');
+    const __m128i carriageReturn = _mm_set1_epi8('\r');
+
+    while (end - p >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, comma), _mm_cmpeq_epi8(chunk, quote)),
+                                    _mm_or_si128(_mm_cmpeq_epi8(chunk, lineFeed), _mm_cmpeq_epi8(chunk, carriageReturn)));
+        unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(hits));
+        if (mask != 0)
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return p + index;
+#else
+            return p + __builtin_ctz(mask);
+#endif
+        }
+        p += 16;
+    }
+#endif
+
+    while (p < end && !isSpecial(*p))
+    {
+        p++;
+    }
+    return p;
+}
+
+// Function to find the next quote character
+static const char* findQuote(const char* p, const char* end)
+{
+    const void* quote = memchr(p, '"', static_cast<size_t>(end - p));
+    return quote != nullptr ? static_cast<const char*>(quote) : end;
+}
+
+CsvReader::CsvReader()
+    : mappedData(nullptr), mappedSize(0),
+#ifdef _WIN32
+      fileHandle(nullptr), mappingHandle(nullptr),
+#endif
+      stream(nullptr), bufferStart(0), bufferEnd(0), streamEnded(false),
+      expectedColumns(0), records(0), consumedBytes(0)
+{
+}
+
+CsvReader::~CsvReader()
+{
+    close();
+}
+
+// Function to open a file for reading, returns false if it can't be opened
+bool CsvReader::open(const string& filePath)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappedSize = static_cast<size_t>(size.QuadPart);
+    if (mappedSize == 0)
+    {
+        // Empty files can't be mapped
+        mappedData = "";
+        return true;
+    }
+
+    mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle != nullptr)
+    {
+        mappedData = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (mappedData == nullptr)
+    {
+        close();
+        return false;
+    }
+#else
+    int fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    mappedSize = static_cast<size_t>(info.st_size);
+    if (mappedSize == 0)
+    {
+        // Empty files can't be mapped
+        ::close(fd);
+        mappedData = "";
+        return true;
+    }
+
+    void* data = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        mappedSize = 0;
+        return false;
+    }
+    madvise(data, mappedSize, MADV_SEQUENTIAL);
+    mappedData = static_cast<const char*>(data);
+#endif
+
+    return true;
+}
+
+// Function to read from a stream such as stdin instead of a file
+void CsvReader::open(istream& input)
+{
+    close();
+    stream = &input;
+    buffer.resize(csvStreamBufferSize);
+}
+
+// Function to close the input and release the mapping or buffer
+void CsvReader::close()
+{
+#ifdef _WIN32
+    if (mappedData != nullptr && mappedSize != 0)
+    {
+        UnmapViewOfFile(mappedData);
+    }
+    if (mappingHandle != nullptr)
+    {
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle != nullptr)
+    {
+        CloseHandle(fileHandle);
+    }
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    if (mappedData != nullptr && mappedSize != 0)
+    {
+        munmap(const_cast<char*>(mappedData), mappedSize);
+    }
+#endif
+    mappedData = nullptr;
+    mappedSize = 0;
+
+    stream = nullptr;
+    buffer.clear();
+    bufferStart = 0;
+    bufferEnd = 0;
+    streamEnded = false;
+
+    records = 0;
+    consumedBytes = 0;
+}
+
+// Function to carry on reading a file from the start of a record found by an earlier read
+bool CsvReader::seek(size_t offset, size_t recordNumber)
+{
+    if (mappedData == nullptr || offset > mappedSize)
+    {
+        return false;
+    }
+    consumedBytes = offset;
+    records = recordNumber;
+    return true;
+}
+
+// Function to find the first line of a file that starts at or after offset
+size_t CsvReader::nextLineStart(size_t offset) const
+{
+    if (mappedData == nullptr || offset >= mappedSize)
+    {
+        return mappedSize;
+    }
+    if (offset == 0 || mappedData[offset - 1] == '\n')
+    {
+        return offset;
+    }
+    const void* lineEnd = memchr(mappedData + offset, '\n', mappedSize - offset);
+    return lineEnd != nullptr ? static_cast<size_t>(static_cast<const char*>(lineEnd) - mappedData) + 1 : mappedSize;
+}
+
+// Function to read more streamed input, keeping the unconsumed part of the buffer
+bool CsvReader::refill()
+{
+    if (stream == nullptr || streamEnded)
+    {
+        return false;
+    }
+
+    // Move the partial record to the front, and grow the buffer if it alone fills it
+    if (bufferStart > 0)
+    {
+        memmove(buffer.data(), buffer.data() + bufferStart, bufferEnd - bufferStart);
+        bufferEnd -= bufferStart;
+        bufferStart = 0;
+    }
+    if (bufferEnd == buffer.size())
+    {
+        buffer.resize(buffer.size() * 2);
+    }
+
+    stream->read(buffer.data() + bufferEnd, static_cast<streamsize>(buffer.size() - bufferEnd));
+    streamsize count = stream->gcount();
+    bufferEnd += static_cast<size_t>(count);
+    if (count == 0 || !*stream)
+    {
+        streamEnded = true;
+    }
+    return true;
+}
+
+// Function to split one record out of [begin, end)
+// Returns NeedMoreInput when the record runs past end and more input may follow
+CsvReader::ParseStep CsvReader::parseRecord(const char* begin, const char* end, bool atEnd, CsvRecord& record, const char*& recordEnd, CsvStatus& error)
+{
+    record.fields.clear();
+    unescaped.clear();
+    escapedFields.clear();
+
+    const char* p = begin;
+    while (true)
+    {
+        if (p < end && *p == '"')
+        {
+            // Quoted field: find the closing quote, skipping escaped quotes
+            const char* q = p + 1;
+            bool hasEscapes = false;
+            while (true)
+            {
+                q = findQuote(q, end);
+                if (q == end || (q + 1 == end && !atEnd))
+                {
+                    if (!atEnd)
+                    {
+                        return ParseStep::NeedMoreInput;
+                    }
+                    error = CsvStatus::MalformedQuote;
+                    recordEnd = end;
+                    return ParseStep::Failed;
+                }
+                if (q + 1 < end && q[1] == '"')
+                {
+                    hasEscapes = true;
+                    q += 2;
+                    continue;
+                }
+                break;
+            }
+
+            if (hasEscapes)
+            {
+                // Escaped fields are unescaped into scratch space, their views are set once the record is complete
+                size_t offset = unescaped.size();
+                for (const char* c = p + 1; c < q; c++)
+                {
+                    unescaped.push_back(*c);
+                    if (*c == '"')
+                    {
+                        c++;
+                    }
+                }
+                escapedFields.push_back({ record.fields.size(), offset, unescaped.size() - offset });
+                record.fields.emplace_back();
+            }
+            else
+            {
+                // Without escapes the field is used in place
+                record.fields.emplace_back(p + 1, static_cast<size_t>(q - p - 1));
+            }
+
+            // The closing quote must be followed by a delimiter or a line break
+            p = q + 1;
+            if (p == end)
+            {
+                break;
+            }
+            if (*p == ',')
+            {
+                p++;
+                continue;
+            }
+            if (*p != '\n' && *p != '\r')
+            {
+                error = CsvStatus::MalformedQuote;
+                const void* lineEnd = memchr(p, '\n', static_cast<size_t>(end - p));
+                recordEnd = lineEnd != nullptr ? static_cast<const char*>(lineEnd) + 1 : end;
+                return ParseStep::Failed;
+            }
+            break;
+        }
+
+        // Unquoted field: runs up to the next delimiter or line break
+        const char* q = findSpecial(p, end);
+        if (q == end && !atEnd)
+        {
+            return ParseStep::NeedMoreInput;
+        }
+        if (q < end && *q == '"')
+        {
+            error = CsvStatus::MalformedQuote;
+            const void* lineEnd = memchr(q, '\n', static_cast<size_t>(end - q));
+            recordEnd = lineEnd != nullptr ? static_cast<const char*>(lineEnd) + 1 : end;
+            return ParseStep::Failed;
+        }
+        record.fields.emplace_back(p, static_cast<size_t>(q - p));
+        p = q;
+        if (p < end && *p == ',')
+        {
+            p++;
+            continue;
+        }
+        break;
+    }
+
+    // Consume the line break, accepting both LF and CRLF
+    if (p < end && *p == '\r')
+    {
+        if (p + 1 == end && !atEnd)
+        {
+            return ParseStep::NeedMoreInput;
+        }
+        p++;
+        if (p < end && *p == '\n')
+        {
+            p++;
+        }
+    }
+    else if (p < end && *p == '\n')
+    {
+        p++;
+    }
+
+    for (const auto& field : escapedFields)
+    {
+        record.fields[field.index] = string_view(unescaped.data() + field.offset, field.length);
+    }
+
+    recordEnd = p;
+    return ParseStep::Done;
+}
+
+// Function to read the next record
+CsvStatus CsvReader::next(CsvRecord& record)
+{
+    while (true)
+    {
+        const char* begin = nullptr;
+        const char* end = nullptr;
+        bool atEnd = true;
+
+        if (mappedData != nullptr)
+        {
+            begin = mappedData + consumedBytes;
+            end = mappedData + mappedSize;
+        }
+        else if (stream != nullptr)
+        {
+            begin = buffer.data() + bufferStart;
+            end = buffer.data() + bufferEnd;
+            atEnd = streamEnded;
+        }
+        else
+        {
+            return CsvStatus::EndOfFile;
+        }
+
+        if (begin == end)
+        {
+            if (atEnd || !refill())
+            {
+                return CsvStatus::EndOfFile;
+            }
+            continue;
+        }
+
+        const char* recordEnd = nullptr;
+        CsvStatus error = CsvStatus::Ok;
+        ParseStep step = parseRecord(begin, end, atEnd, record, recordEnd, error);
+        if (step == ParseStep::NeedMoreInput)
+        {
+            refill();
+            continue;
+        }
+
+        // Failed records are skipped up to the next line so the caller may carry on
+        size_t used = static_cast<size_t>(recordEnd - begin);
+        consumedBytes += used;
+        if (stream != nullptr)
+        {
+            bufferStart += used;
+        }
+        records++;
+
+        if (step == ParseStep::Failed)
+        {
+            return error;
+        }
+        if (expectedColumns != 0 && record.fields.size() != expectedColumns)
+        {
+            return CsvStatus::ColumnCountMismatch;
+        }
+        return CsvStatus::Ok;
+    }
+}
+
+// Function to describe a status for error messages
+const char* CsvReader::describe(CsvStatus status)
+{
+    switch (status)
+    {
+    case CsvStatus::Ok:
+        return "OK";
+    case CsvStatus::EndOfFile:
+        return "End of file";
+    case CsvStatus::ColumnCountMismatch:
+        return "Wrong number of columns";
+    case CsvStatus::MalformedQuote:
+        return "Malformed quoted field";
+    }
+    return "Unknown error";
+}
@@ -0,0 +1,117 @@
+#ifndef CSVPARSER_H
+#define CSVPARSER_H
+
+#include <cstddef>      // For size_t
+#include <istream>      // For streaming input
+#include <string>       // For string operations
+#include <string_view>  // For zero-copy fields
+#include <vector>       // For storing record fields
+
+// Size of the buffer used when streaming input that can't be memory-mapped
+const size_t csvStreamBufferSize = 1 << 20;
+
+// Outcome of reading a single CSV record
+enum class CsvStatus
+{
+    Ok,                 // A record was read
+    EndOfFile,          // No more records
+    ColumnCountMismatch,// The record does not have the expected number of columns
+    MalformedQuote      // A quoted field is not closed or is followed by stray characters
+};
+
+// A single CSV record
+// Fields point into the reader's buffer and stay valid until the next call to CsvReader::next()
+struct CsvRecord
+{
+    std::vector<std::string_view> fields;
+};
+
+// Single-pass RFC 4180 CSV reader
+// Files are memory-mapped when possible, other input is streamed through a reusable buffer.
+// Column count and quoting are validated while the fields are split, so each byte is scanned once.
+class CsvReader
+{
+public:
+    CsvReader();
+    ~CsvReader();
+
+    CsvReader(const CsvReader&) = delete;
+    CsvReader& operator=(const CsvReader&) = delete;
+
+    // Function to open a file for reading, returns false if it can't be opened
+    bool open(const std::string& filePath);
+
+    // Function to read from a stream such as stdin instead of a file
+    void open(std::istream& input);
+
+    // Function to close the input and release the mapping or buffer
+    void close();
+
+    // Function to carry on reading a file from the start of a record found by an earlier read
+    // recordNumber is the number of records before that point. Streams can't seek, so returns false for them.
+    bool seek(size_t offset, size_t recordNumber);
+
+    // Function to find the first line of a file that starts at or after offset, the file size if there is none
+    // The line may still be in the middle of a record when a quoted field holds a line break.
+    size_t nextLineStart(size_t offset) const;
+
+    // Size of the open file, 0 for streams
+    size_t fileSize() const { return mappedData != nullptr ? mappedSize : 0; }
+
+    // Function to set the number of columns every record must have (0 accepts any number)
+    void setExpectedColumns(size_t columns) { expectedColumns = columns; }
+
+    // Function to read the next record
+    CsvStatus next(CsvRecord& record);
+
+    // Number of records read so far (the header counts as the first)
+    size_t recordNumber() const { return records; }
+
+    // Byte offset of the first byte after the last record read
+    size_t byteOffset() const { return consumedBytes; }
+
+    // Function to describe a status for error messages
+    static const char* describe(CsvStatus status);
+
+private:
+    enum class ParseStep
+    {
+        Done,
+        NeedMoreInput,
+        Failed
+    };
+
+    ParseStep parseRecord(const char* begin, const char* end, bool atEnd, CsvRecord& record, const char*& recordEnd, CsvStatus& error);
+    bool refill();
+
+    // Memory-mapped input
+    const char* mappedData;
+    size_t mappedSize;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+
+    // Streamed input
+    std::istream* stream;
+    std::vector<char> buffer;
+    size_t bufferStart;
+    size_t bufferEnd;
+    bool streamEnded;
+
+    // Scratch space for quoted fields that contain escaped quotes
+    struct EscapedField
+    {
+        size_t index;
+        size_t offset;
+        size_t length;
+    };
+    std::string unescaped;
+    std::vector<EscapedField> escapedFields;
+
+    size_t expectedColumns;
+    size_t records;
+    size_t consumedBytes;
+};
+
+#endif // CSVPARSER_H
@@ -0,0 +1,405 @@
+#include "CsvValidation.h"
+
+#include <algorithm>            // For comparing the header and sorting rejected rows
+#include <atomic>               // For handing out chunks to threads
+#include <functional>           // For hashing IDs
+#include <memory>               // For owning readers
+#include <mutex>                // For the shards of the ID set
+#include <string_view>          // For IDs read in place
+#include <thread>               // For checking chunks at the same time
+#include <unordered_map>        // For the IDs seen so far
+#include <utility>              // For pairs of positions and IDs
+#include "CsvParser.h"          // For reading the import file
+#include "UserSchema.h"         // For the columns of an import file
+
+using namespace std;
+
+// Number of separately locked parts of the set of IDs seen so far
+static const size_t idSetShardCount = 64;
+
+// Fewest and most digits a phone number may have, the most is the limit of international numbers
+static const size_t minPhoneDigits = 7;
+static const size_t maxPhoneDigits = 15;
+
+// Position of a row by the chunk it is in and its number within that chunk, which orders rows as in the file
+struct RowPosition
+{
+    size_t chunk;
+    size_t row;
+
+    bool operator<(const RowPosition& other) const
+    {
+        return chunk != other.chunk ? chunk < other.chunk : row < other.row;
+    }
+};
+
+// Set of the IDs of the valid rows seen so far, with the position of the first row of each
+// The set is split into shards with their own locks so threads rarely wait for each other. IDs are
+// kept as views into the file, which stays mapped until checking is over.
+class IdSet
+{
+public:
+    // Function to add the ID of a row, returns false and sets duplicate to the later of the two rows if it was there
+    bool insert(string_view id, RowPosition position, RowPosition& duplicate)
+    {
+        Shard& shard = shards[hash<string_view>()(id) % idSetShardCount];
+        lock_guard<mutex> lock(shard.shardMutex);
+        auto inserted = shard.firstRows.try_emplace(id, position);
+        if (inserted.second)
+        {
+            return true;
+        }
+
+        // The row that comes first in the file is kept, so the same rows are duplicates however threads are timed
+        RowPosition& first = inserted.first->second;
+        if (position < first)
+        {
+            duplicate = first;
+            first = position;
+        }
+        else
+        {
+            duplicate = position;
+        }
+        return false;
+    }
+
+private:
+    struct Shard
+    {
+        mutex shardMutex;
+        unordered_map<string_view, RowPosition> firstRows;
+    };
+
+    Shard shards[idSetShardCount];
+};
+
+// Structure to store a part of the file and what was found in it
+struct ValidationChunk
+{
+    // Rows starting from start up to limit belong to the chunk, end is the offset after the last one read
+    size_t start = 0;
+    size_t limit = 0;
+    size_t end = 0;
+    size_t rows = 0;
+
+    // Rejected rows with record numbers counted from the start of the chunk
+    vector<CsvRowIssue> issues;
+
+    // Duplicates found while checking the chunk, which may be rows of any chunk
+    vector<pair<RowPosition, string_view>> duplicates;
+};
+
+// Function to check if a character is a control character
+static inline bool isControl(char c)
+{
+    unsigned char byte = static_cast<unsigned char>(c);
+    return byte < 0x20 || byte == 0x7f;
+}
+
+// Function to check if an ID can be the value of a DN without escaping
+static bool isDnSafe(string_view id)
+{
+    if (id.front() == ' ' || id.front() == '#' || id.back() == ' ')
+    {
+        return false;
+    }
+    for (char c : id)
+    {
+        if (isControl(c) || string_view(",+\"\\<>;=").find(c) != string_view::npos)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Function to check if a value looks like an email address, one @ with a dotted domain after it
+static bool isValidEmail(string_view email)
+{
+    size_t at = email.find('@');
+    if (at == 0 || at == string_view::npos || email.find('@', at + 1) != string_view::npos)
+    {
+        return false;
+    }
+
+    string_view domain = email.substr(at + 1);
+    if (domain.empty() || domain.front() == '.' || domain.back() == '.' || domain.find('.') == string_view::npos || domain.find("..") != string_view::npos)
+    {
+        return false;
+    }
+    for (char c : email)
+    {
+        if (c == ' ' || isControl(c) || string_view("()<>,;:\\\"[]").find(c) != string_view::npos)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Function to check if a value looks like a phone number, digits with an optional leading + and separators
+static bool isValidPhoneNumber(string_view phoneNumber)
+{
+    size_t digits = 0;
+    for (size_t i = 0; i < phoneNumber.size(); i++)
+    {
+        char c = phoneNumber[i];
+        if (c >= '0' && c <= '9')
+        {
+            digits++;
+        }
+        else if (c == '+' ? i != 0 : string_view(" -().").find(c) == string_view::npos)
+        {
+            return false;
+        }
+    }
+    return digits >= minPhoneDigits && digits <= maxPhoneDigits;
+}
+
+// Function to find why a row can't be added, returns false if it can
+static bool findRowProblem(CsvStatus status, const CsvRecord& record, CsvRowProblem& problem)
+{
+    if (status == CsvStatus::MalformedQuote)
+    {
+        problem = CsvRowProblem::MalformedQuote;
+        return true;
+    }
+    if (status != CsvStatus::Ok)
+    {
+        problem = CsvRowProblem::ColumnCount;
+        return true;
+    }
+
+    string_view id = record.fields[idColumn];
+    if (id.empty())
+    {
+        problem = CsvRowProblem::EmptyId;
+    }
+    else if (!isDnSafe(id))
+    {
+        problem = CsvRowProblem::UnsafeId;
+    }
+    else if (!isValidEmail(record.fields[emailColumn]))
+    {
+        problem = CsvRowProblem::InvalidEmail;
+    }
+    else if (!isValidPhoneNumber(record.fields[phoneNumberColumn]))
+    {
+        problem = CsvRowProblem::InvalidPhoneNumber;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+// Function to check the rows of one chunk
+static void checkChunk(CsvReader& reader, size_t index, ValidationChunk& chunk, IdSet& ids)
+{
+    CsvRecord record;
+    CsvRowProblem problem;
+    RowPosition duplicate;
+
+    reader.seek(chunk.start, 0);
+    while (reader.byteOffset() < chunk.limit)
+    {
+        CsvStatus status = reader.next(record);
+        if (status == CsvStatus::EndOfFile)
+        {
+            break;
+        }
+
+        size_t row = reader.recordNumber();
+        if (findRowProblem(status, record, problem))
+        {
+            CsvRowIssue issue;
+            issue.recordNumber = row;
+            if (!record.fields.empty())
+            {
+                issue.id.assign(record.fields[idColumn]);
+            }
+            issue.problem = problem;
+            chunk.issues.push_back(move(issue));
+        }
+        else if (!ids.insert(record.fields[idColumn], { index, row }, duplicate))
+        {
+            // A valid ID holds no quote, so it was read in place and its view stays valid with the mapping
+            chunk.duplicates.emplace_back(duplicate, record.fields[idColumn]);
+        }
+    }
+    chunk.end = reader.byteOffset();
+    chunk.rows = reader.recordNumber();
+}
+
+// Function to check the chunks of a file with one thread per reader, returns false if a chunk didn't start at a row
+static bool checkChunks(vector<unique_ptr<CsvReader>>& readers, vector<ValidationChunk>& chunks, size_t headerRecords, CsvValidationResult& result)
+{
+    IdSet ids;
+    atomic<size_t> nextChunk(0);
+    auto checkNextChunks = [&](CsvReader& reader)
+    {
+        size_t index;
+        while ((index = nextChunk.fetch_add(1)) < chunks.size())
+        {
+            checkChunk(reader, index, chunks[index], ids);
+        }
+    };
+
+    size_t threadCount = min(readers.size(), chunks.size());
+    vector<thread> threads;
+    for (size_t i = 1; i < threadCount; i++)
+    {
+        threads.emplace_back(checkNextChunks, ref(*readers[i]));
+    }
+    checkNextChunks(*readers[0]);
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+
+    // Each chunk has to start where the rows of the one before it ended, or it started inside a quoted line break
+    for (size_t i = 1; i < chunks.size(); i++)
+    {
+        if (chunks[i].start != chunks[i - 1].end)
+        {
+            return false;
+        }
+    }
+
+    // Record numbers within a chunk become record numbers within the file
+    vector<size_t> firstRecords(chunks.size());
+    size_t records = headerRecords;
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        firstRecords[i] = records;
+        records += chunks[i].rows;
+    }
+    result.rowCount = records - headerRecords;
+    result.issues.clear();
+    for (auto& chunk : chunks)
+    {
+        for (auto& issue : chunk.issues)
+        {
+            issue.recordNumber += firstRecords[&chunk - chunks.data()];
+            result.issues.push_back(move(issue));
+        }
+        for (const auto& duplicate : chunk.duplicates)
+        {
+            CsvRowIssue issue;
+            issue.recordNumber = firstRecords[duplicate.first.chunk] + duplicate.first.row;
+            issue.id.assign(duplicate.second);
+            issue.problem = CsvRowProblem::DuplicateId;
+            result.issues.push_back(move(issue));
+        }
+    }
+    sort(result.issues.begin(), result.issues.end(), [](const CsvRowIssue& a, const CsvRowIssue& b) { return a.recordNumber < b.recordNumber; });
+    return true;
+}
+
+// Function to check if the row with the given record number was rejected
+bool CsvValidationResult::rejects(size_t recordNumber) const
+{
+    auto issue = lower_bound(issues.begin(), issues.end(), recordNumber, [](const CsvRowIssue& a, size_t number) { return a.recordNumber < number; });
+    return issue != issues.end() && issue->recordNumber == recordNumber;
+}
+
+// Function to check every row of an import file without sending anything
+bool validateCsvFile(const string& filePath, size_t threadCount, CsvValidationResult& result)
+{
+    result = CsvValidationResult();
+    if (threadCount == 0)
+    {
+        threadCount = max<size_t>(thread::hardware_concurrency(), 1);
+    }
+
+    // Every thread reads through a reader of its own, only files that can be read in place can be split
+    vector<unique_ptr<CsvReader>> readers;
+    for (size_t i = 0; i < threadCount; i++)
+    {
+        readers.emplace_back(new CsvReader());
+        if (!readers.back()->open(filePath))
+        {
+            return false;
+        }
+        readers.back()->setExpectedColumns(csvColumnCount);
+    }
+
+    // Check the header
+    CsvReader& header = *readers[0];
+    CsvRecord record;
+    CsvStatus status = header.next(record);
+    if (status != CsvStatus::Ok || !equal(record.fields.begin(), record.fields.end(), csvColumns))
+    {
+        return true;
+    }
+    result.headerValid = true;
+
+    // Split the rows into chunks at line breaks, several per thread so a chunk of long rows doesn't hold up the rest
+    size_t headerRecords = header.recordNumber();
+    size_t dataStart = header.byteOffset();
+    size_t dataSize = header.fileSize() - dataStart;
+    size_t chunkCount = max<size_t>(min(dataSize / validationChunkSize, threadCount * 4), 1);
+    vector<ValidationChunk> chunks;
+    for (size_t i = 0; i < chunkCount; i++)
+    {
+        size_t start = i == 0 ? dataStart : header.nextLineStart(dataStart + dataSize / chunkCount * i);
+        if (!chunks.empty() && start <= chunks.back().start)
+        {
+            continue;
+        }
+        if (!chunks.empty())
+        {
+            chunks.back().limit = start;
+        }
+        ValidationChunk chunk;
+        chunk.start = start;
+        chunks.push_back(move(chunk));
+    }
+    chunks.back().limit = header.fileSize();
+
+    if (!checkChunks(readers, chunks, headerRecords, result))
+    {
+        // Quoted line breaks make where rows start unknowable without reading from the top
+        vector<ValidationChunk> wholeFile(1);
+        wholeFile[0].start = dataStart;
+        wholeFile[0].limit = header.fileSize();
+        readers.resize(1);
+        checkChunks(readers, wholeFile, headerRecords, result);
+    }
+    return true;
+}
+
+// Function to record the rejected rows as failures in a report
+size_t recordCsvIssues(const CsvValidationResult& result, ImportReport& report)
+{
+    for (const auto& issue : result.issues)
+    {
+        report.recordFailure(issue.id.empty() ? "line " + to_string(issue.recordNumber) : issue.id, describeCsvRowProblem(issue.problem));
+    }
+    return result.issues.size();
+}
+
+// Function to describe why a row was rejected, for reports and error messages
+const char* describeCsvRowProblem(CsvRowProblem problem)
+{
+    switch (problem)
+    {
+    case CsvRowProblem::ColumnCount:
+        return CsvReader::describe(CsvStatus::ColumnCountMismatch);
+    case CsvRowProblem::MalformedQuote:
+        return CsvReader::describe(CsvStatus::MalformedQuote);
+    case CsvRowProblem::EmptyId:
+        return "Empty id";
+    case CsvRowProblem::UnsafeId:
+        return "Id has characters not allowed in a DN";
+    case CsvRowProblem::InvalidEmail:
+        return "Invalid email address";
+    case CsvRowProblem::InvalidPhoneNumber:
+        return "Invalid phone number";
+    case CsvRowProblem::DuplicateId:
+        return "Duplicate id in the file";
+    }
+    return "Unknown error";
+}
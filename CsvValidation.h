@@ -0,0 +1,60 @@
+#ifndef CSVVALIDATION_H
+#define CSVVALIDATION_H
+
+#include <cstddef>              // For size_t
+#include <string>               // For string operations
+#include <vector>               // For the rejected rows
+#include "ImportReport.h"       // For recording rejected rows
+
+// Smallest part of an import file checked by one thread at a time
+const size_t validationChunkSize = 1 << 20;
+
+// Why a row of an import file is rejected before anything is sent
+enum class CsvRowProblem
+{
+    ColumnCount,        // The row doesn't have one value per column
+    MalformedQuote,     // A quoted value is not closed or is followed by stray characters
+    EmptyId,            // The id column is empty
+    UnsafeId,           // The id holds characters that would change the meaning of the user's DN
+    InvalidEmail,       // The email column is not an address
+    InvalidPhoneNumber, // The phone_number column is not a phone number
+    DuplicateId         // An earlier row of the file has the same id
+};
+
+// Structure to store a rejected row of an import file
+struct CsvRowIssue
+{
+    size_t recordNumber = 0;
+    std::string id;
+    CsvRowProblem problem = CsvRowProblem::ColumnCount;
+};
+
+// Structure to store the outcome of checking an import file
+struct CsvValidationResult
+{
+    // False when the file is empty or its header doesn't name the expected columns, no row is checked then
+    bool headerValid = false;
+
+    // Rows after the header, and the ones rejected in order of their record number, one issue per row
+    size_t rowCount = 0;
+    std::vector<CsvRowIssue> issues;
+
+    // Function to check if the row with the given record number was rejected
+    bool rejects(size_t recordNumber) const;
+};
+
+// Function to check every row of an import file without sending anything, using threadCount threads (0 for one per core)
+// The file is split into chunks at line breaks that are checked at the same time. Rows are checked for
+// their number of columns and quoting, an empty or DN-unsafe id, and the syntax of the email and phone
+// number, and every row that repeats the id of an earlier valid row is rejected as a duplicate. If a chunk
+// turns out to start inside a quoted line break, the file is checked again on one thread. Returns false
+// if the file can't be opened or read in place, as when it is a pipe.
+bool validateCsvFile(const std::string& filePath, size_t threadCount, CsvValidationResult& result);
+
+// Function to record the rejected rows as failures in a report, returns how many were recorded
+size_t recordCsvIssues(const CsvValidationResult& result, ImportReport& report);
+
+// Function to describe why a row was rejected, for reports and error messages
+const char* describeCsvRowProblem(CsvRowProblem problem);
+
+#endif // CSVVALIDATION_H
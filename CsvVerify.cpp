@@ -0,0 +1,416 @@
+#include "CsvVerify.h"
+
+#include <cstdio>               // For removing the scratch file
+#include <fstream>              // For reading samples and writing the scratch file
+#include <iterator>             // For reading a whole sample
+#include <sstream>              // For streamed input
+#include <vector>               // For records and fields
+#include "CsvGenerator.h"       // For the generated file
+#include "CsvParser.h"          // For the reader being checked
+#include "UserSchema.h"         // For the columns of an import file
+
+using namespace std;
+
+// Sample files shipped with the project, each checked with the columns of an import file
+static const char* const sampleFiles[] = {
+    "CompanyAptDataSample.csv",
+    "CompanyErrorDataSample.csv",
+    "CompanyLargeDataSample.csv",
+    "CompanyRepetitiveDataSample.csv",
+    "CompanyNonCSVFile.txt"
+};
+
+// Number of users in the generated file, enough for it to span several stream buffers
+static const size_t generatedUsers = 50000;
+
+// Record expected from CsvReader::next(), the fields of a record with a malformed quote are not compared
+struct ExpectedRecord
+{
+    CsvStatus status;
+    vector<string> fields;
+};
+
+// Input with the records it should be read as
+struct CsvCase
+{
+    string name;
+    string input;
+    size_t expectedColumns = 0;
+    vector<ExpectedRecord> records;
+
+    // Whether the records were written by hand, in which case the byte-by-byte reader is checked against them too
+    bool handWritten = true;
+};
+
+// Function to find where reading carries on after a malformed record, the start of the next line
+static size_t nextLine(const string& text, size_t position)
+{
+    size_t lineFeed = text.find('\n', position);
+    return lineFeed == string::npos ? text.size() : lineFeed + 1;
+}
+
+// Function to split text into records one byte at a time, following the same rules as CsvReader
+// It has no blocks, no buffers and no lookahead, so it gives the expected records of inputs too large to write by hand.
+static vector<ExpectedRecord> readByteByByte(const string& text, size_t expectedColumns)
+{
+    vector<ExpectedRecord> records;
+    size_t position = 0;
+    while (position < text.size())
+    {
+        ExpectedRecord record = { CsvStatus::Ok, {} };
+        bool malformed = false;
+        while (true)
+        {
+            string field;
+            if (position < text.size() && text[position] == '"')
+            {
+                // Quoted field, a doubled quote stands for one quote
+                size_t i = position + 1;
+                while (i < text.size() && (text[i] != '"' || (i + 1 < text.size() && text[i + 1] == '"')))
+                {
+                    field += text[i];
+                    i += text[i] == '"' ? 2 : 1;
+                }
+                if (i >= text.size())
+                {
+                    malformed = true;
+                    position = text.size();
+                    break;
+                }
+                record.fields.push_back(field);
+                position = i + 1;
+                if (position < text.size() && text[position] == ',')
+                {
+                    position++;
+                    continue;
+                }
+                if (position < text.size() && text[position] != '\n' && text[position] != '\r')
+                {
+                    malformed = true;
+                    position = nextLine(text, position);
+                }
+                break;
+            }
+
+            // Unquoted field, a quote in it is malformed
+            while (position < text.size() && text[position] != ',' && text[position] != '"' && text[position] != '\n' && text[position] != '\r')
+            {
+                field += text[position++];
+            }
+            if (position < text.size() && text[position] == '"')
+            {
+                malformed = true;
+                position = nextLine(text, position);
+                break;
+            }
+            record.fields.push_back(field);
+            if (position < text.size() && text[position] == ',')
+            {
+                position++;
+                continue;
+            }
+            break;
+        }
+
+        if (malformed)
+        {
+            record.status = CsvStatus::MalformedQuote;
+            record.fields.clear();
+        }
+        else
+        {
+            // LF, CRLF and a lone CR all end a record
+            if (position < text.size() && text[position] == '\r')
+            {
+                position++;
+                if (position < text.size() && text[position] == '\n')
+                {
+                    position++;
+                }
+            }
+            else if (position < text.size() && text[position] == '\n')
+            {
+                position++;
+            }
+            if (expectedColumns != 0 && record.fields.size() != expectedColumns)
+            {
+                record.status = CsvStatus::ColumnCountMismatch;
+            }
+        }
+        records.push_back(move(record));
+    }
+    return records;
+}
+
+// Function to read every record, stopping one record after the expected ones in case the reader never reaches the end
+static vector<ExpectedRecord> readAll(CsvReader& reader, size_t expectedColumns, size_t expectedCount)
+{
+    vector<ExpectedRecord> records;
+    CsvRecord record;
+    CsvStatus status;
+    reader.setExpectedColumns(expectedColumns);
+    while (records.size() <= expectedCount && (status = reader.next(record)) != CsvStatus::EndOfFile)
+    {
+        ExpectedRecord read = { status, {} };
+        if (status != CsvStatus::MalformedQuote)
+        {
+            read.fields.assign(record.fields.begin(), record.fields.end());
+        }
+        records.push_back(move(read));
+    }
+    return records;
+}
+
+// Function to show a field in a message, with line breaks made visible and shortened when it is long
+static string quoteField(const string& field)
+{
+    string shown;
+    for (size_t i = 0; i < field.size() && i < 40; i++)
+    {
+        shown += field[i] == '\r' ? "\\r" : field[i] == '\n' ? "\\n" : string(1, field[i]);
+    }
+    return "\"" + shown + (field.size() > 40 ? "...\" (" + to_string(field.size()) + " bytes)" : "\"");
+}
+
+// Function to describe the first difference between the records read and the expected ones, empty if there is none
+static string firstDifference(const vector<ExpectedRecord>& read, const vector<ExpectedRecord>& expected)
+{
+    for (size_t i = 0; i < read.size() || i < expected.size(); i++)
+    {
+        string where = "record " + to_string(i + 1);
+        if (i >= read.size())
+        {
+            return where + " is missing";
+        }
+        if (i >= expected.size())
+        {
+            return where + " was read after the last one";
+        }
+        if (read[i].status != expected[i].status)
+        {
+            return where + " is " + CsvReader::describe(read[i].status) + " instead of " + CsvReader::describe(expected[i].status);
+        }
+        if (read[i].fields.size() != expected[i].fields.size())
+        {
+            return where + " has " + to_string(read[i].fields.size()) + " fields instead of " + to_string(expected[i].fields.size());
+        }
+        for (size_t j = 0; j < read[i].fields.size(); j++)
+        {
+            if (read[i].fields[j] != expected[i].fields[j])
+            {
+                return where + " field " + to_string(j + 1) + " is " + quoteField(read[i].fields[j]) + " instead of " + quoteField(expected[i].fields[j]);
+            }
+        }
+    }
+    return string();
+}
+
+// Function to check the records of an open reader and its position at the end, returns an empty string if they are right
+static string checkReader(CsvReader& reader, const CsvCase& test)
+{
+    vector<ExpectedRecord> read = readAll(reader, test.expectedColumns, test.records.size());
+    string difference = firstDifference(read, test.records);
+    if (difference.empty() && reader.byteOffset() != test.input.size())
+    {
+        difference = "stopped at byte " + to_string(reader.byteOffset()) + " of " + to_string(test.input.size());
+    }
+    if (difference.empty() && reader.recordNumber() != test.records.size())
+    {
+        difference = "counted " + to_string(reader.recordNumber()) + " records instead of " + to_string(test.records.size());
+    }
+    return difference;
+}
+
+// Function to run a case from a mapped file and from a stream, returns false if either is wrong
+// filePath is a file that already holds the input, or empty to write it to scratchPath first.
+static bool runCase(const CsvCase& test, const string& filePath, const string& scratchPath, ostream& out)
+{
+    vector<string> failures;
+    if (test.handWritten)
+    {
+        string difference = firstDifference(readByteByByte(test.input, test.expectedColumns), test.records);
+        if (!difference.empty())
+        {
+            failures.push_back("byte-by-byte reader: " + difference);
+        }
+    }
+
+    // Memory-mapped file
+    string mappedPath = filePath;
+    if (mappedPath.empty())
+    {
+        mappedPath = scratchPath;
+        ofstream scratch(scratchPath, ios::binary);
+        scratch.write(test.input.data(), static_cast<streamsize>(test.input.size()));
+        scratch.close();
+        if (!scratch)
+        {
+            failures.push_back("the scratch file " + scratchPath + " can't be written");
+        }
+    }
+    CsvReader mapped;
+    if (!mapped.open(mappedPath))
+    {
+        failures.push_back("mapped file: " + mappedPath + " can't be opened");
+    }
+    else
+    {
+        string difference = checkReader(mapped, test);
+        mapped.close();
+        if (!difference.empty())
+        {
+            failures.push_back("mapped file: " + difference);
+        }
+    }
+    if (filePath.empty())
+    {
+        remove(scratchPath.c_str());
+    }
+
+    // Stream, read through the buffer instead of in place
+    istringstream input(test.input);
+    CsvReader streamed;
+    streamed.open(input);
+    string difference = checkReader(streamed, test);
+    if (!difference.empty())
+    {
+        failures.push_back("stream: " + difference);
+    }
+
+    out << (failures.empty() ? "  ok      " : "  FAILED  ") << test.name << " (" << test.records.size() << " records)" << endl;
+    for (const auto& failure : failures)
+    {
+        out << "          " << failure << endl;
+    }
+    return failures.empty();
+}
+
+// Function to build the cases with hand-written expected records
+static vector<CsvCase> handWrittenCases()
+{
+    const CsvStatus ok = CsvStatus::Ok;
+    const CsvStatus malformed = CsvStatus::MalformedQuote;
+    const CsvStatus wrongColumns = CsvStatus::ColumnCountMismatch;
+    const size_t bufferSize = csvStreamBufferSize;
+    vector<CsvCase> cases;
+
+    cases.push_back({ "quoted comma", "1,\"Doe, John\",x\n2,\",\",\",,\"\n",
+                      0, { { ok, { "1", "Doe, John", "x" } }, { ok, { "2", ",", ",," } } } });
+
+    cases.push_back({ "doubled quotes", "1,\"say \"\"hi\"\"\",\"\"\"\"\n\"\"\"a,b\"\"\",\"\"\n",
+                      0, { { ok, { "1", "say \"hi\"", "\"" } }, { ok, { "\"a,b\"", "" } } } });
+
+    cases.push_back({ "CRLF line endings", "a,b\r\nc,\"d\"\r\n\r\ne,\"f\r\ng\"\r\nh,i",
+                      0, { { ok, { "a", "b" } }, { ok, { "c", "d" } }, { ok, { "" } }, { ok, { "e", "f\r\ng" } }, { ok, { "h", "i" } } } });
+
+    cases.push_back({ "empty fields", ",,\n,\n\"\",x,",
+                      0, { { ok, { "", "", "" } }, { ok, { "", "" } }, { ok, { "", "x", "" } } } });
+
+    cases.push_back({ "unterminated quote", "a,b\nc,\"never closed\nd,e\n",
+                      0, { { ok, { "a", "b" } }, { malformed, {} } } });
+
+    cases.push_back({ "stray quotes", "a,\"b\"x,c\nd,e\na,b\"c\nf,g\n",
+                      0, { { malformed, {} }, { ok, { "d", "e" } }, { malformed, {} }, { ok, { "f", "g" } } } });
+
+    cases.push_back({ "short and long rows", "a,b,c\nd,e\nf,g,h\ni,j,k,l\n",
+                      3, { { ok, { "a", "b", "c" } }, { wrongColumns, { "d", "e" } }, { ok, { "f", "g", "h" } }, { wrongColumns, { "i", "j", "k", "l" } } } });
+
+    cases.push_back({ "empty input", "", 0, {} });
+
+    // Every delimiter position within a 16-byte block, with records starting at every alignment
+    CsvCase blocks = { "unquoted fields across 16-byte blocks", "", 0, {} };
+    CsvCase quotedBlocks = { "quoted fields across 16-byte blocks", "", 0, {} };
+    for (size_t length = 0; length <= 48; length++)
+    {
+        string field(length, static_cast<char>('a' + length % 26));
+        blocks.input += field + ",y\n";
+        blocks.records.push_back({ ok, { field, "y" } });
+
+        string quoted = field + "," + field + "\"";
+        quotedBlocks.input += "\"" + field + "," + field + "\"\"\",z\n";
+        quotedBlocks.records.push_back({ ok, { quoted, "z" } });
+    }
+    // The last field ends with the input, so it is found by the byte loop after the blocks
+    blocks.input += string(33, 'e');
+    blocks.records.push_back({ ok, { string(33, 'e') } });
+    cases.push_back(blocks);
+    cases.push_back(quotedBlocks);
+
+    // A field that starts in the first stream buffer and ends in the second
+    string pad = "p," + string(bufferSize - 20, 'p');
+    CsvCase crossing = { "field across the stream buffer", pad + "\nleft," + string(30, 'm') + ",right\n", 0, {} };
+    crossing.records = { { ok, { "p", pad.substr(2) } }, { ok, { "left", string(30, 'm'), "right" } } };
+    cases.push_back(crossing);
+
+    // A doubled quote split between the two buffers, the first quote is the last byte of the first buffer
+    string head = "x,\"" + string(10, 'q');
+    string quotePad(bufferSize - 1 - head.size() - 1, 'p');
+    CsvCase splitQuote = { "doubled quote across the stream buffer", quotePad + "\n" + head + "\"\"tail\",end\n", 0, {} };
+    splitQuote.records = { { ok, { quotePad } }, { ok, { "x", string(10, 'q') + "\"tail", "end" } } };
+    cases.push_back(splitQuote);
+
+    // A CRLF split between the two buffers
+    string crPad = "a," + string(bufferSize - 3, 'p');
+    CsvCase splitLineBreak = { "CRLF across the stream buffer", crPad + "\r\nc,d\r\n", 0, {} };
+    splitLineBreak.records = { { ok, { "a", crPad.substr(2) } }, { ok, { "c", "d" } } };
+    cases.push_back(splitLineBreak);
+
+    // A record larger than the stream buffer, which has to grow to hold it
+    string big(3 * bufferSize, 'b');
+    CsvCase bigRecord = { "record larger than the stream buffer", "big," + big + "\n\"" + big + "\",f\n", 0, {} };
+    bigRecord.records = { { ok, { "big", big } }, { ok, { big, "f" } } };
+    cases.push_back(bigRecord);
+
+    return cases;
+}
+
+// Function to check the records and fields CsvReader returns against the expected ones, returns the number of cases that failed
+size_t verifyCsvReader(const string& sampleDirectory, const string& scratchDirectory, ostream& out)
+{
+    string scratchPath = scratchDirectory + "/verify-csv.tmp";
+    size_t failed = 0;
+    size_t total = 0;
+
+    // Sample files, read in place
+    for (const char* sample : sampleFiles)
+    {
+        string samplePath = sampleDirectory + "/" + sample;
+        ifstream file(samplePath, ios::binary);
+        if (!file)
+        {
+            out << "  FAILED  " << sample << endl << "          " << samplePath << " can't be opened" << endl;
+            failed++;
+            total++;
+            continue;
+        }
+        CsvCase test;
+        test.name = sample;
+        test.input.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        test.expectedColumns = csvColumnCount;
+        test.records = readByteByByte(test.input, csvColumnCount);
+        test.handWritten = false;
+        failed += runCase(test, samplePath, scratchPath, out) ? 0 : 1;
+        total++;
+    }
+
+    // Generated users, about one in ten with a quoted comma, spanning several stream buffers
+    ostringstream generated;
+    writeSyntheticUsers(generated, generatedUsers);
+    CsvCase generatedCase;
+    generatedCase.name = "generated file with " + to_string(generatedUsers) + " users";
+    generatedCase.input = generated.str();
+    generatedCase.expectedColumns = csvColumnCount;
+    generatedCase.records = readByteByByte(generatedCase.input, csvColumnCount);
+    generatedCase.handWritten = false;
+    failed += runCase(generatedCase, "", scratchPath, out) ? 0 : 1;
+    total++;
+
+    for (const auto& test : handWrittenCases())
+    {
+        failed += runCase(test, "", scratchPath, out) ? 0 : 1;
+        total++;
+    }
+
+    out << total - failed << " of " << total << " cases passed." << endl;
+    return failed;
+}
@@ -0,0 +1,16 @@
+#ifndef CSVVERIFY_H
+#define CSVVERIFY_H
+
+#include <cstddef>      // For size_t
+#include <ostream>      // For printing the outcome of each case
+#include <string>       // For the directories
+
+// Function to check the records and fields CsvReader returns against the expected ones, returns the number of cases that failed
+// Every case is read twice, from a memory-mapped file and from a stream, since the two use different buffers.
+// The cases are the Company*DataSample files in sampleDirectory and a generated file, whose expected records
+// come from a plain byte-by-byte reader, and hand-written inputs with their expected records: quoted commas,
+// doubled quotes, CRLF, fields that cross the 16-byte blocks of the scanner and the 1 MB stream buffer,
+// an unterminated quote and a short row. Inputs are written to files in scratchDirectory while they are read.
+size_t verifyCsvReader(const std::string& sampleDirectory, const std::string& scratchDirectory, std::ostream& out);
+
+#endif // CSVVERIFY_H
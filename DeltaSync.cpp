@@ -0,0 +1,325 @@
+#include "DeltaSync.h"
+
+#include <chrono>               // For the time each request was sent
+#include <cstdint>              // For 64-bit hashes
+#include <iostream>             // For error output
+#include <map>                  // For outstanding requests
+#include <unordered_map>        // For the current directory state
+#include "DirectorySearch.h"    // For paged searches
+#include "EntryEncoder.h"       // For building the entries of new users
+#include "FlowControl.h"        // For adapting to server load
+
+using namespace std;
+
+// Attributes compared between the file and the directory, cn is the key and is never changed
+static const size_t syncedAttributeCount = 6;
+static const char* const syncedAttributes[syncedAttributeCount] = { "sn", "givenName", "mail", "ou", "telephoneNumber", "description" };
+
+// Structure to store the state of one existing user, one hash per synced attribute
+struct EntryDigest
+{
+    uint64_t attributeHashes[syncedAttributeCount];
+    bool inFile;
+};
+
+// Structure to store a request that was sent and not yet answered, or is waiting to be sent again
+// An add keeps its row and a modify its changes, so either can be sent again.
+struct PendingChange
+{
+    enum Kind { Add, Modify, Delete } kind = Add;
+    string id;
+    ImportRow row;
+    vector<AttributeChange> changes;
+    unsigned int attempts = 0;
+    chrono::steady_clock::time_point sentAt;
+};
+
+// Function to hash an attribute value with 64-bit FNV-1a
+static uint64_t hashValue(const char* value, size_t length)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= static_cast<unsigned char>(value[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Function to read the current users into digests keyed by ID
+static int readCurrentUsers(DirectoryBackend* ldap, const string& searchBase, unordered_map<string, EntryDigest>& current)
+{
+    vector<string> attrs = { "cn" };
+    attrs.insert(attrs.end(), syncedAttributes, syncedAttributes + syncedAttributeCount);
+
+    int rc = pagedSearch(ldap, searchBase, LDAP_SCOPE_ONELEVEL, "(objectClass=inetOrgPerson)", attrs, defaultSearchPageSize, [&](const DirectoryEntry& entry)
+    {
+        const string* id = entry.firstValue("cn");
+        if (!id)
+        {
+            return true;
+        }
+
+        // A missing attribute hashes the same as an empty value, which is what the file would give
+        EntryDigest& digest = current[*id];
+        digest.inFile = false;
+        for (size_t i = 0; i < syncedAttributeCount; i++)
+        {
+            const string* value = entry.firstValue(syncedAttributes[i]);
+            digest.attributeHashes[i] = value ? hashValue(value->data(), value->size()) : hashValue("", 0);
+        }
+        return true;
+    });
+
+    // A missing ou=users simply means there are no users yet
+    return rc == LDAP_NO_SUCH_OBJECT ? LDAP_SUCCESS : rc;
+}
+
+// Function to send one request, waiting for a slot when writes are rate limited
+// Requests the server can't take now are scheduled to be sent again, other failures are recorded
+static void sendChange(DirectoryBackend* ldap, UserEntryEncoder& encoder, const string& searchBase, PendingChange&& change, map<int, PendingChange>& pendingChanges, FlowController& flow, RetryQueue<PendingChange>& retries, DeltaSyncSummary& summary)
+{
+    writeRateLimiter().acquire();
+
+    int messageId = 0;
+    int rc = LDAP_SUCCESS;
+    if (change.kind == PendingChange::Add)
+    {
+        rc = ldap->addEntry(encoder.encode(change.row), &messageId);
+        encoder.reset();
+    }
+    else if (change.kind == PendingChange::Modify)
+    {
+        rc = ldap->modifyEntry("cn=" + change.id + "," + searchBase, change.changes, &messageId);
+    }
+    else
+    {
+        rc = ldap->deleteEntry("cn=" + change.id + "," + searchBase, false, &messageId);
+    }
+
+    if (rc == LDAP_SUCCESS)
+    {
+        change.sentAt = chrono::steady_clock::now();
+        pendingChanges[messageId] = move(change);
+        return;
+    }
+    if (isTransientResult(rc))
+    {
+        flow.recordBusy();
+        if (retries.retry(change, flow))
+        {
+            return;
+        }
+    }
+    summary.failures.recordFailure(change.id, ldap->errorString(rc));
+}
+
+// Function to wait for the reply to one outstanding request and record its outcome
+static void collectChangeResult(DirectoryBackend* ldap, map<int, PendingChange>& pendingChanges, FlowController& flow, RetryQueue<PendingChange>& retries, DeltaSyncSummary& summary)
+{
+    int messageId = 0;
+    int rc = LDAP_SUCCESS;
+    int waitRc = ldap->waitForResult(messageId, rc);
+
+    // Only a lost connection takes the pending requests with it, after any other error their replies may still come
+    if (waitRc != LDAP_SUCCESS)
+    {
+        if (!connectionLost(waitRc))
+        {
+            return;
+        }
+        string error = ldap->errorString(waitRc);
+        for (const auto& pending : pendingChanges)
+        {
+            summary.failures.recordFailure(pending.second.id, error);
+        }
+        pendingChanges.clear();
+        return;
+    }
+
+    auto pending = pendingChanges.find(messageId);
+    if (pending == pendingChanges.end())
+    {
+        return;
+    }
+
+    // A busy server gets fewer requests in flight and the request again later
+    if (isTransientResult(rc))
+    {
+        flow.recordBusy();
+        if (retries.retry(pending->second, flow))
+        {
+            pendingChanges.erase(pending);
+            return;
+        }
+    }
+    else
+    {
+        flow.recordReply(chrono::steady_clock::now() - pending->second.sentAt);
+    }
+
+    if (rc != LDAP_SUCCESS)
+    {
+        summary.failures.recordFailure(pending->second.id, ldap->errorString(rc));
+    }
+    else if (pending->second.kind == PendingChange::Add)
+    {
+        summary.added++;
+    }
+    else if (pending->second.kind == PendingChange::Modify)
+    {
+        summary.modified++;
+    }
+    else
+    {
+        summary.deleted++;
+    }
+    pendingChanges.erase(pending);
+}
+
+// Function to bring the users under basePath in line with a CSV file
+int deltaSyncUsers(DirectoryBackend* ldap, const string& basePath, CsvReader& file, bool deleteMissing, size_t window, DeltaSyncSummary& summary)
+{
+    string searchBase = "ou=users," + basePath;
+    unordered_map<string, EntryDigest> current;
+
+    int rc = readCurrentUsers(ldap, searchBase, current);
+    if (rc != LDAP_SUCCESS)
+    {
+        return rc;
+    }
+
+    map<int, PendingChange> pendingChanges;
+    RetryQueue<PendingChange> retries;
+    FlowController flow(window);
+    CsvRecord record;
+    CsvStatus status;
+    ImportRow row;
+    string firstName, lastName;
+    UserEntryEncoder encoder(basePath);
+
+    // Function to send a request once the window of outstanding requests has room, after any retries that are due
+    auto send = [&](PendingChange&& change)
+    {
+        PendingChange retry;
+        while (retries.takeDue(retry))
+        {
+            while (pendingChanges.size() >= flow.window())
+            {
+                collectChangeResult(ldap, pendingChanges, flow, retries, summary);
+            }
+            sendChange(ldap, encoder, searchBase, move(retry), pendingChanges, flow, retries, summary);
+        }
+        while (pendingChanges.size() >= flow.window())
+        {
+            collectChangeResult(ldap, pendingChanges, flow, retries, summary);
+        }
+        sendChange(ldap, encoder, searchBase, move(change), pendingChanges, flow, retries, summary);
+    };
+
+    while ((status = file.next(record)) != CsvStatus::EndOfFile)
+    {
+        if (status != CsvStatus::Ok)
+        {
+            cerr << "Error: File is not properly comma-delimited (line " << file.recordNumber() << ": " << CsvReader::describe(status) << ")." << endl;
+            summary.properFormat = false;
+            break;
+        }
+
+        row.id.assign(record.fields[0]);
+        row.fullName.assign(record.fields[1]);
+        row.phoneNumber.assign(record.fields[2]);
+        row.email.assign(record.fields[3]);
+        row.department.assign(record.fields[4]);
+        row.jobDescription.assign(record.fields[5]);
+
+        auto existing = current.find(row.id);
+        if (existing == current.end())
+        {
+            // New users are added, and remembered so a repeated ID later in the file isn't added twice
+            current[row.id].inFile = true;
+            PendingChange change;
+            change.kind = PendingChange::Add;
+            change.id = row.id;
+            change.row = move(row);
+            send(move(change));
+            continue;
+        }
+
+        if (existing->second.inFile)
+        {
+            summary.duplicates++;
+            continue;
+        }
+        existing->second.inFile = true;
+
+        // Compare attribute by attribute and replace only the ones that changed
+        splitFullName(row.fullName, firstName, lastName);
+        const string* values[syncedAttributeCount] = { &lastName, &firstName, &row.email, &row.department, &row.phoneNumber, &row.jobDescription };
+
+        PendingChange change;
+        change.kind = PendingChange::Modify;
+        for (size_t i = 0; i < syncedAttributeCount; i++)
+        {
+            if (hashValue(values[i]->data(), values[i]->size()) == existing->second.attributeHashes[i])
+            {
+                continue;
+            }
+
+            // Replacing with no values removes an attribute that the file leaves empty
+            AttributeChange attributeChange;
+            attributeChange.operation = LDAP_MOD_REPLACE;
+            attributeChange.name = syncedAttributes[i];
+            if (!values[i]->empty())
+            {
+                attributeChange.values.push_back(*values[i]);
+            }
+            change.changes.push_back(move(attributeChange));
+        }
+
+        if (change.changes.empty())
+        {
+            summary.unchanged++;
+            continue;
+        }
+        change.id = row.id;
+        send(move(change));
+    }
+
+    // Deleting is only safe when every row of the file has been seen
+    if (deleteMissing && summary.properFormat)
+    {
+        for (const auto& user : current)
+        {
+            if (user.second.inFile)
+            {
+                continue;
+            }
+
+            PendingChange change;
+            change.kind = PendingChange::Delete;
+            change.id = user.first;
+            send(move(change));
+        }
+    }
+
+    // Collect the replies to the requests that are still outstanding, and send the ones still to be retried
+    while (!pendingChanges.empty() || !retries.empty())
+    {
+        PendingChange retry;
+        if (pendingChanges.empty())
+        {
+            retries.waitForNext();
+        }
+        while (pendingChanges.size() < flow.window() && retries.takeDue(retry))
+        {
+            sendChange(ldap, encoder, searchBase, move(retry), pendingChanges, flow, retries, summary);
+        }
+        if (!pendingChanges.empty())
+        {
+            collectChangeResult(ldap, pendingChanges, flow, retries, summary);
+        }
+    }
+
+    return LDAP_SUCCESS;
+}
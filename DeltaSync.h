@@ -0,0 +1,30 @@
+#ifndef DELTASYNC_H
+#define DELTASYNC_H
+
+#include <string>           // For string operations
+#include "CsvParser.h"      // For reading the import file
+#include "ImportEngine.h"   // For the directory backend
+#include "ImportReport.h"   // For recording failures
+
+// Structure to store the outcome of a delta sync
+struct DeltaSyncSummary
+{
+    size_t added = 0;
+    size_t modified = 0;
+    size_t deleted = 0;
+    size_t unchanged = 0;
+    size_t duplicates = 0;
+    bool properFormat = true;
+
+    // Users that could not be added, modified or deleted, open it to have them written to a file
+    ImportReport failures;
+};
+
+// Function to bring the users under basePath in line with a CSV file
+// The current users are read once and reduced to a hash per attribute, then each row is compared
+// against them so only new users are added and only changed attributes are replaced. Users missing
+// from the file are deleted when deleteMissing is set and the whole file was read without errors.
+// The file must be positioned just after its header.
+int deltaSyncUsers(DirectoryBackend* ldap, const std::string& basePath, CsvReader& file, bool deleteMissing, size_t window, DeltaSyncSummary& summary);
+
+#endif // DELTASYNC_H
@@ -0,0 +1,127 @@
+#include "DirectoryBackend.h"
+
+#include <cctype>                   // For tolower
+#include <cstdlib>                  // For getenv
+#include "FakeDirectoryBackend.h"   // For the in-process fake directory
+#include "InstrumentedBackend.h"    // For measuring every request
+#include "SessionBackend.h"         // For restoring lost connections
+#ifdef _WIN32
+#include "WinldapBackend.h"         // For Wldap32
+#else
+#include "OpenLdapBackend.h"        // For OpenLDAP
+#endif
+
+using namespace std;
+
+// Function to compare attribute names, which are case-insensitive
+bool sameAttributeName(const string& a, const string& b)
+{
+    if (a.size() != b.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i])))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Function to get the first value of an attribute, returns nullptr if the entry doesn't have it
+const string* DirectoryEntry::firstValue(const string& name) const
+{
+    for (const auto& attribute : attributes)
+    {
+        if (sameAttributeName(attribute.name, name))
+        {
+            return attribute.values.empty() ? nullptr : &attribute.values[0];
+        }
+    }
+    return nullptr;
+}
+
+// Function to check if a result code means the connection is gone, and with it every request still waiting for a reply
+bool connectionLost(int rc)
+{
+    return rc == LDAP_SERVER_DOWN || rc == LDAP_CONNECT_ERROR;
+}
+
+// Function to add an entry
+int DirectoryBackend::addEntry(const string& dn, const vector<EntryAttribute>& attributes, int* messageId)
+{
+    vector<AttributeView> attributeViews;
+    vector<string_view> values;
+    attributeViews.reserve(attributes.size());
+    for (const auto& attribute : attributes)
+    {
+        values.insert(values.end(), attribute.values.begin(), attribute.values.end());
+    }
+
+    size_t firstValue = 0;
+    for (const auto& attribute : attributes)
+    {
+        attributeViews.push_back({ attribute.name.c_str(), values.data() + firstValue, attribute.values.size() });
+        firstValue += attribute.values.size();
+    }
+
+    return addEntry(EntryView{ dn.c_str(), attributeViews.data(), attributeViews.size() }, messageId);
+}
+
+// Function to wrap a backend so its requests are measured and its connection is kept alive
+static unique_ptr<DirectoryBackend> wrapBackend(unique_ptr<DirectoryBackend> backend, chrono::seconds keepaliveInterval)
+{
+    unique_ptr<DirectoryBackend> instrumented(new InstrumentedBackend(move(backend)));
+    return unique_ptr<DirectoryBackend>(new SessionBackend(move(instrumented), keepaliveInterval));
+}
+
+// Function to create the backend named by the LDAP_BACKEND environment variable
+unique_ptr<DirectoryBackend> createDirectoryBackend(chrono::seconds keepaliveInterval)
+{
+    const char* backend = getenv("LDAP_BACKEND");
+    if (backend != nullptr && string(backend) == "fake")
+    {
+        FakeDirectorySettings settings;
+        if (const char* latency = getenv("LDAP_FAKE_LATENCY_US"))
+        {
+            settings.latency = chrono::microseconds(strtol(latency, nullptr, 10));
+        }
+        if (const char* errorRate = getenv("LDAP_FAKE_ERROR_RATE"))
+        {
+            settings.errorRate = strtod(errorRate, nullptr);
+        }
+        if (const char* spikeRate = getenv("LDAP_FAKE_SPIKE_RATE"))
+        {
+            settings.spikeRate = strtod(spikeRate, nullptr);
+        }
+        if (const char* spikeLatency = getenv("LDAP_FAKE_SPIKE_US"))
+        {
+            settings.spikeLatency = chrono::microseconds(strtol(spikeLatency, nullptr, 10));
+        }
+        if (const char* capacity = getenv("LDAP_FAKE_CAPACITY"))
+        {
+            settings.capacity = strtoul(capacity, nullptr, 10);
+        }
+        if (const char* dropEvery = getenv("LDAP_FAKE_DROP_EVERY"))
+        {
+            settings.dropEvery = strtoul(dropEvery, nullptr, 10);
+        }
+        if (const char* idleTimeout = getenv("LDAP_FAKE_IDLE_TIMEOUT_MS"))
+        {
+            settings.idleTimeout = chrono::milliseconds(strtol(idleTimeout, nullptr, 10));
+        }
+        if (const char* seed = getenv("LDAP_FAKE_SEED"))
+        {
+            settings.seed = static_cast<unsigned int>(strtoul(seed, nullptr, 10));
+        }
+        return wrapBackend(unique_ptr<DirectoryBackend>(new FakeDirectoryBackend(settings)), keepaliveInterval);
+    }
+
+#ifdef _WIN32
+    return wrapBackend(unique_ptr<DirectoryBackend>(new WinldapBackend()), keepaliveInterval);
+#else
+    return wrapBackend(unique_ptr<DirectoryBackend>(new OpenLdapBackend()), keepaliveInterval);
+#endif
+}
@@ -0,0 +1,146 @@
+#ifndef DIRECTORYBACKEND_H
+#define DIRECTORYBACKEND_H
+
+#ifdef _WIN32
+#include <Windows.h>        // For Windows-specific types
+#include <Winldap.h>        // For LDAP result codes and scopes
+#else
+#include <ldap.h>           // For LDAP result codes and scopes
+#endif
+#include <chrono>           // For the keepalive interval
+#include <cstddef>          // For size_t
+#include <memory>           // For owning backends
+#include <string>           // For string operations
+#include <string_view>      // For values held by the caller
+#include <vector>           // For attributes and entries
+
+// Control used to delete an entry together with its children
+const char* const treeDeleteControlOid = "1.2.840.113556.1.4.805";
+
+// Control used to read search results a page at a time (RFC 2696)
+const char* const pagedResultsControlOid = "1.2.840.113556.1.4.319";
+
+// Control used to have the server sort search results (RFC 2891)
+const char* const serverSortControlOid = "1.2.840.113556.1.4.473";
+
+// Server details used to open and bind a connection
+struct LDAPConnectionSettings
+{
+    std::string host;
+    int port;
+    std::string username;
+    std::string password;
+};
+
+// Structure to store one attribute of an entry with all of its values
+struct EntryAttribute
+{
+    std::string name;
+    std::vector<std::string> values;
+};
+
+// Attribute whose name and values are held by the caller, for adding entries without copying them
+struct AttributeView
+{
+    const char* name;
+    const std::string_view* values;
+    size_t valueCount;
+};
+
+// Entry whose DN and attributes are held by the caller, the DN must be null-terminated
+struct EntryView
+{
+    const char* dn;
+    const AttributeView* attributes;
+    size_t attributeCount;
+};
+
+// Structure to store one change of a modify request
+// operation is LDAP_MOD_ADD, LDAP_MOD_DELETE or LDAP_MOD_REPLACE, and no values with a replace removes the attribute
+struct AttributeChange
+{
+    int operation;
+    std::string name;
+    std::vector<std::string> values;
+};
+
+// Structure to store an entry returned by a search
+struct DirectoryEntry
+{
+    std::string dn;
+    std::vector<EntryAttribute> attributes;
+
+    // Function to get the first value of an attribute, returns nullptr if the entry doesn't have it
+    const std::string* firstValue(const std::string& name) const;
+};
+
+// Function to compare attribute names, which are case-insensitive
+bool sameAttributeName(const std::string& a, const std::string& b);
+
+// Function to check if a result code means the connection is gone, and with it every request still waiting for a reply
+bool connectionLost(int rc);
+
+// Operations the application needs from a directory server
+// Each backend object is one connection and is used by one thread at a time. Requests that are given
+// a messageId are only sent, and their replies are read with waitForResult(), so callers can keep a
+// window of requests in flight; without a messageId they wait for the reply and return its result code.
+class DirectoryBackend
+{
+public:
+    virtual ~DirectoryBackend() {}
+
+    // Function to open a connection using LDAP version 3
+    virtual int open(const std::string& host, int port) = 0;
+
+    // Function to bind with a simple username and password
+    virtual int bind(const std::string& username, const std::string& password) = 0;
+
+    // Function to unbind and close the connection
+    virtual void close() = 0;
+
+    // Function to create another, unopened backend of the same kind that talks to the same directory
+    virtual std::unique_ptr<DirectoryBackend> createConnection() const = 0;
+
+    // Function to add an entry
+    int addEntry(const std::string& dn, const std::vector<EntryAttribute>& attributes, int* messageId = nullptr);
+
+    // Function to add an entry without copying it, the caller's memory is only read while the request is sent
+    virtual int addEntry(const EntryView& entry, int* messageId = nullptr) = 0;
+
+    // Function to modify an entry
+    virtual int modifyEntry(const std::string& dn, const std::vector<AttributeChange>& changes, int* messageId = nullptr) = 0;
+
+    // Function to delete an entry, together with its children when treeDelete is set
+    virtual int deleteEntry(const std::string& dn, bool treeDelete = false, int* messageId = nullptr) = 0;
+
+    // Function to wait for the reply to any outstanding request
+    // Returns an error if no reply could be read, otherwise sets the reply's message ID and result code.
+    // After an error for which connectionLost() is true no outstanding request will be answered; after any
+    // other error they may still be, and the caller waits again.
+    virtual int waitForResult(int& messageId, int& resultCode) = 0;
+
+    // Function to search for matching entries, at most sizeLimit of them unless it is 0
+    // No attributes asks for every user attribute, and the single attribute "1.1" asks for none
+    virtual int search(const std::string& base, int scope, const std::string& filter, const std::vector<std::string>& attributes, size_t sizeLimit, std::vector<DirectoryEntry>& entries) = 0;
+
+    // Function to read one page of a search with the Simple Paged Results control
+    // cookie is empty for the first page and is replaced by the server's cookie, which is empty after the last page.
+    // A page size of 0 with a cookie abandons the rest of the search. Unless sortAttribute is empty, the server is
+    // asked to sort the entries by it with the critical Server Side Sorting control, so a server that can't fails.
+    virtual int searchPage(const std::string& base, int scope, const std::string& filter, const std::vector<std::string>& attributes, const std::string& sortAttribute, size_t pageSize, std::string& cookie, std::vector<DirectoryEntry>& entries) = 0;
+
+    // Function to describe a result code for error messages
+    virtual std::string errorString(int rc) const = 0;
+};
+
+// Function to create the backend named by the LDAP_BACKEND environment variable
+// "fake" selects the in-process fake directory, configured by LDAP_FAKE_LATENCY_US, LDAP_FAKE_ERROR_RATE,
+// LDAP_FAKE_SPIKE_RATE, LDAP_FAKE_SPIKE_US, LDAP_FAKE_CAPACITY, LDAP_FAKE_DROP_EVERY,
+// LDAP_FAKE_IDLE_TIMEOUT_MS and LDAP_FAKE_SEED. Anything else selects the platform's LDAP library:
+// Wldap32 on Windows, OpenLDAP elsewhere.
+// Either way the backend is wrapped in an InstrumentedBackend, so every request is recorded in metrics(),
+// and that in a SessionBackend, so lost connections are restored and idle ones kept alive with a
+// request every keepaliveInterval (zero for none).
+std::unique_ptr<DirectoryBackend> createDirectoryBackend(std::chrono::seconds keepaliveInterval);
+
+#endif // DIRECTORYBACKEND_H
@@ -0,0 +1,158 @@
+#include "DirectorySearch.h"
+
+using namespace std;
+
+// Number of entries requested per page when only counting, entries without attributes are small
+static const size_t countPageSize = 1000;
+
+// Filter matching the users managed by this application
+static const char* const userFilter = "(objectClass=inetOrgPerson)";
+
+// Function to search one page at a time with the Simple Paged Results control (RFC 2696)
+int pagedSearch(DirectoryBackend* ldap, const string& base, int scope, const string& filter, const vector<string>& attrs, size_t pageSize, const function<bool(const DirectoryEntry&)>& onEntry)
+{
+    return sortedPagedSearch(ldap, base, scope, filter, attrs, string(), pageSize, onEntry);
+}
+
+// Function to search one page at a time with the entries sorted by the server
+int sortedPagedSearch(DirectoryBackend* ldap, const string& base, int scope, const string& filter, const vector<string>& attrs, const string& sortAttribute, size_t pageSize, const function<bool(const DirectoryEntry&)>& onEntry)
+{
+    int rc = LDAP_SUCCESS;
+    string cookie;
+    vector<DirectoryEntry> page;
+
+    do
+    {
+        rc = ldap->searchPage(base, scope, filter, attrs, sortAttribute, pageSize, cookie, page);
+        if (rc != LDAP_SUCCESS)
+        {
+            return rc;
+        }
+
+        for (const auto& entry : page)
+        {
+            if (!onEntry(entry))
+            {
+                // A page size of zero tells the server to release the rest of the result set
+                if (!cookie.empty())
+                {
+                    ldap->searchPage(base, scope, filter, attrs, sortAttribute, 0, cookie, page);
+                }
+                return LDAP_SUCCESS;
+            }
+        }
+
+        // Servers without paging support simply don't return a cookie
+    } while (!cookie.empty());
+
+    return rc;
+}
+
+// Function to check if any entry matches, asking for no attributes and at most one entry
+int probeForEntries(DirectoryBackend* ldap, const string& base, int scope, const string& filter, bool& found)
+{
+    vector<DirectoryEntry> entries;
+    int rc = ldap->search(base, scope, filter, noAttributes, 1, entries);
+    found = !entries.empty();
+
+    // More than one match is reported as exceeding the size limit, which still answers the question
+    if (rc == LDAP_SIZELIMIT_EXCEEDED)
+    {
+        rc = LDAP_SUCCESS;
+    }
+    return rc;
+}
+
+// Function to count matching entries with a paged search that transfers no attributes
+int countEntries(DirectoryBackend* ldap, const string& base, int scope, const string& filter, size_t& count)
+{
+    count = 0;
+    return pagedSearch(ldap, base, scope, filter, noAttributes, countPageSize, [&count](const DirectoryEntry&)
+    {
+        count++;
+        return true;
+    });
+}
+
+// Function to check if the server lists a control in the supportedControl attribute of its root DSE
+bool serverSupportsControl(DirectoryBackend* ldap, const char* controlOid)
+{
+    vector<DirectoryEntry> entries;
+    int rc = ldap->search("", LDAP_SCOPE_BASE, "(objectClass=*)", { "supportedControl" }, 0, entries);
+    if (rc != LDAP_SUCCESS || entries.empty())
+    {
+        return false;
+    }
+
+    for (const auto& attribute : entries[0].attributes)
+    {
+        for (const auto& value : attribute.values)
+        {
+            if (value == controlOid)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+UserCountProbe::UserCountProbe(DirectoryBackend* ldap, const string& basePath)
+    : ldap(ldap), searchBase("ou=users," + basePath), countKnown(false), cachedCount(0), emptinessKnown(false), cachedEmpty(true)
+{
+}
+
+// Function to check if there are no users, using a single-entry probe unless the count is already known
+bool UserCountProbe::isEmpty()
+{
+    if (countKnown)
+    {
+        return cachedCount == 0;
+    }
+    if (!emptinessKnown)
+    {
+        // A failed probe is treated as an empty directory, just like a failed listing
+        bool found = false;
+        int rc = probeForEntries(ldap, searchBase, LDAP_SCOPE_ONELEVEL, userFilter, found);
+        cachedEmpty = rc != LDAP_SUCCESS || !found;
+        emptinessKnown = rc == LDAP_SUCCESS;
+    }
+    return cachedEmpty;
+}
+
+// Function to count the users, using a paged count unless the count is already known
+int UserCountProbe::count(size_t& userCount)
+{
+    if (!countKnown)
+    {
+        // A missing ou=users holds no users, any other failure leaves the count unknown
+        int rc = countEntries(ldap, searchBase, LDAP_SCOPE_ONELEVEL, userFilter, userCount);
+        if (rc == LDAP_NO_SUCH_OBJECT)
+        {
+            userCount = 0;
+        }
+        else if (rc != LDAP_SUCCESS)
+        {
+            return rc;
+        }
+        setCount(userCount);
+    }
+    userCount = cachedCount;
+    return LDAP_SUCCESS;
+}
+
+// Function to record a count learned elsewhere, for example after deleting every user
+void UserCountProbe::setCount(size_t userCount)
+{
+    countKnown = true;
+    cachedCount = userCount;
+    emptinessKnown = true;
+    cachedEmpty = userCount == 0;
+}
+
+// Function to forget the cached answers after users have been added or deleted
+void UserCountProbe::invalidate()
+{
+    countKnown = false;
+    emptinessKnown = false;
+}
@@ -0,0 +1,62 @@
+#ifndef DIRECTORYSEARCH_H
+#define DIRECTORYSEARCH_H
+
+#include <functional>           // For entry callbacks
+#include <string>               // For string operations
+#include <vector>               // For attribute lists
+#include "DirectoryBackend.h"   // For directory operations
+
+// Default number of entries requested per page of a paged search
+const size_t defaultSearchPageSize = 500;
+
+// Attribute list that asks for no attributes, only DNs
+const std::vector<std::string> noAttributes = { "1.1" };
+
+// Function to search one page at a time with the Simple Paged Results control (RFC 2696)
+// onEntry is called for every entry and may stop the search early by returning false.
+// Only one page is held in memory at a time, whatever the size of the directory.
+int pagedSearch(DirectoryBackend* ldap, const std::string& base, int scope, const std::string& filter, const std::vector<std::string>& attrs, size_t pageSize, const std::function<bool(const DirectoryEntry&)>& onEntry);
+
+// Function to search one page at a time with the entries sorted by the server (RFC 2891)
+// A server that can't sort by sortAttribute fails the first page before onEntry is called, so the caller can sort instead.
+int sortedPagedSearch(DirectoryBackend* ldap, const std::string& base, int scope, const std::string& filter, const std::vector<std::string>& attrs, const std::string& sortAttribute, size_t pageSize, const std::function<bool(const DirectoryEntry&)>& onEntry);
+
+// Function to check if any entry matches, asking for no attributes and at most one entry
+int probeForEntries(DirectoryBackend* ldap, const std::string& base, int scope, const std::string& filter, bool& found);
+
+// Function to count matching entries with a paged search that transfers no attributes
+int countEntries(DirectoryBackend* ldap, const std::string& base, int scope, const std::string& filter, size_t& count);
+
+// Function to check if the server lists a control in the supportedControl attribute of its root DSE
+bool serverSupportsControl(DirectoryBackend* ldap, const char* controlOid);
+
+// Answers "are there any users" and "how many users" for the menus
+// Answers are cached for the session and must be invalidated after users are added or deleted.
+class UserCountProbe
+{
+public:
+    UserCountProbe(DirectoryBackend* ldap, const std::string& basePath);
+
+    // Function to check if there are no users, using a single-entry probe unless the count is already known
+    bool isEmpty();
+
+    // Function to count the users, using a paged count unless the count is already known
+    // Returns the result of the count, and userCount is only valid when it is LDAP_SUCCESS.
+    int count(size_t& userCount);
+
+    // Function to record a count learned elsewhere, for example after deleting every user
+    void setCount(size_t userCount);
+
+    // Function to forget the cached answers after users have been added or deleted
+    void invalidate();
+
+private:
+    DirectoryBackend* ldap;
+    std::string searchBase;
+    bool countKnown;
+    size_t cachedCount;
+    bool emptinessKnown;
+    bool cachedEmpty;
+};
+
+#endif // DIRECTORYSEARCH_H
@@ -0,0 +1,165 @@
+#include "EntryEncoder.h"
+
+#include <cstring>      // For copying the DN
+
+using namespace std;
+
+Arena::Arena(size_t blockSize)
+    : blockSize(blockSize), currentBlock(0), used(0)
+{
+}
+
+// Function to get uninitialised memory with the given alignment
+void* Arena::allocate(size_t size, size_t alignment)
+{
+    while (currentBlock < blocks.size())
+    {
+        Block& block = blocks[currentBlock];
+        size_t start = (used + alignment - 1) & ~(alignment - 1);
+        if (start + size <= block.size)
+        {
+            used = start + size;
+            return block.data.get() + start;
+        }
+        currentBlock++;
+        used = 0;
+    }
+
+    // Requests larger than a block get a block of their own
+    Block block;
+    block.size = size > blockSize ? size : blockSize;
+    block.data.reset(new char[block.size]);
+    blocks.push_back(move(block));
+    currentBlock = blocks.size() - 1;
+
+    // new[] of char is aligned for any fundamental type, so the start of a block needs no padding
+    used = size;
+    return blocks.back().data.get();
+}
+
+// Function to give back everything handed out, keeping the blocks for reuse
+void Arena::reset()
+{
+    currentBlock = 0;
+    used = 0;
+}
+
+// Total size of the blocks held
+size_t Arena::capacity() const
+{
+    size_t total = 0;
+    for (const auto& block : blocks)
+    {
+        total += block.size;
+    }
+    return total;
+}
+
+// Function to split a full name into first name and last name without copying
+void splitFullName(string_view fullName, string_view& firstName, string_view& lastName)
+{
+    const char* whitespace = " \t";
+    size_t firstStart = fullName.find_first_not_of(whitespace);
+    if (firstStart == string_view::npos)
+    {
+        firstName = string_view();
+        lastName = string_view();
+        return;
+    }
+
+    size_t firstEnd = fullName.find_first_of(whitespace, firstStart);
+    firstName = fullName.substr(firstStart, firstEnd == string_view::npos ? string_view::npos : firstEnd - firstStart);
+
+    size_t lastStart = firstEnd == string_view::npos ? string_view::npos : fullName.find_first_not_of(whitespace, firstEnd);
+    lastName = lastStart == string_view::npos ? string_view() : fullName.substr(lastStart);
+}
+
+// Function to get a column of a row by its position in the import file
+static const string& rowColumn(const ImportRow& row, size_t column)
+{
+    switch (column)
+    {
+    case idColumn:
+        return row.id;
+    case fullNameColumn:
+        return row.fullName;
+    case phoneNumberColumn:
+        return row.phoneNumber;
+    case emailColumn:
+        return row.email;
+    case departmentColumn:
+        return row.department;
+    default:
+        return row.jobDescription;
+    }
+}
+
+UserEntryEncoder::UserEntryEncoder(const string& basePath)
+    : dnSuffix(",ou=users," + basePath)
+{
+}
+
+// Function to build the entry of one row
+EntryView UserEntryEncoder::encode(const ImportRow& row)
+{
+    // The DN is the only value not found in the row, it is copied into the arena with its terminator
+    size_t rdnLength = strlen(userRdnAttribute);
+    size_t dnLength = rdnLength + 1 + row.id.size() + dnSuffix.size();
+    char* dn = arena.allocateArray<char>(dnLength + 1);
+    char* end = dn;
+    memcpy(end, userRdnAttribute, rdnLength);
+    end += rdnLength;
+    *end++ = '=';
+    memcpy(end, row.id.data(), row.id.size());
+    end += row.id.size();
+    memcpy(end, dnSuffix.data(), dnSuffix.size());
+    end += dnSuffix.size();
+    *end = '\0';
+
+    string_view firstName, lastName;
+    splitFullName(row.fullName, firstName, lastName);
+
+    AttributeView* attributes = arena.allocateArray<AttributeView>(userSchemaSize);
+    string_view* values = arena.allocateArray<string_view>(userSchemaValueCount());
+    for (size_t i = 0; i < userSchemaSize; i++)
+    {
+        const AttributeMapping& mapping = userSchema[i];
+        attributes[i].name = mapping.attribute;
+        attributes[i].values = values;
+
+        switch (mapping.source)
+        {
+        case ValueSource::Column:
+            *values++ = rowColumn(row, mapping.column);
+            attributes[i].valueCount = 1;
+            break;
+        case ValueSource::FirstName:
+            *values++ = firstName;
+            attributes[i].valueCount = 1;
+            break;
+        case ValueSource::LastName:
+            *values++ = lastName;
+            attributes[i].valueCount = 1;
+            break;
+        case ValueSource::Constant:
+            for (size_t j = 0; j < mapping.constantCount; j++)
+            {
+                *values++ = mapping.constants[j];
+            }
+            attributes[i].valueCount = mapping.constantCount;
+            break;
+        }
+    }
+
+    EntryView entry;
+    entry.dn = dn;
+    entry.attributes = attributes;
+    entry.attributeCount = userSchemaSize;
+    return entry;
+}
+
+// Function to forget every entry built so far, called between batches
+void UserEntryEncoder::reset()
+{
+    arena.reset();
+}
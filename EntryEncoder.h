@@ -0,0 +1,75 @@
+#ifndef ENTRYENCODER_H
+#define ENTRYENCODER_H
+
+#include <cstddef>              // For size_t
+#include <memory>               // For owning arena blocks
+#include <string>               // For the base path
+#include <string_view>          // For names split without copying
+#include <vector>               // For arena blocks
+#include "DirectoryBackend.h"   // For entry views
+#include "ImportEngine.h"       // For import rows
+#include "UserSchema.h"         // For the attributes of a user
+
+// Memory handed out in pieces and given back all at once
+// Blocks are kept when the arena is reset, so after the first batch no more memory is allocated.
+class Arena
+{
+public:
+    explicit Arena(size_t blockSize = 64 * 1024);
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Function to get uninitialised memory with the given alignment
+    void* allocate(size_t size, size_t alignment);
+
+    // Function to get room for count objects of a trivial type
+    template <typename T>
+    T* allocateArray(size_t count)
+    {
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    // Function to give back everything handed out, keeping the blocks for reuse
+    void reset();
+
+    // Total size of the blocks held
+    size_t capacity() const;
+
+private:
+    struct Block
+    {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    size_t blockSize;
+    std::vector<Block> blocks;
+    size_t currentBlock;
+    size_t used;
+};
+
+// Function to split a full name into first name and last name without copying
+// The first name is the first word, the last name is the rest with the spaces before it removed
+void splitFullName(std::string_view fullName, std::string_view& firstName, std::string_view& lastName);
+
+// Turns import rows into entries of users under a base path, following userSchema
+// Entries are built in an arena and point into the rows for their values, so an entry stays valid until
+// its row is changed or the encoder is reset. Encoding a row allocates nothing once the arena has grown.
+class UserEntryEncoder
+{
+public:
+    explicit UserEntryEncoder(const std::string& basePath);
+
+    // Function to build the entry of one row
+    EntryView encode(const ImportRow& row);
+
+    // Function to forget every entry built so far, called between batches
+    void reset();
+
+private:
+    std::string dnSuffix;
+    Arena arena;
+};
+
+#endif // ENTRYENCODER_H
@@ -0,0 +1,144 @@
+#include "ExternalSort.h"
+
+#include <algorithm>    // For sorting runs and the merge heap
+#include <cstdint>      // For fixed-size lengths in run files
+
+using namespace std;
+
+// Size of the buffer each run file is written and read through
+static const size_t runBufferSize = 64 * 1024;
+
+// Function to write one string to a run file, preceded by its length
+static bool writeString(FILE* file, const string& value)
+{
+    uint32_t length = static_cast<uint32_t>(value.size());
+    return fwrite(&length, sizeof(length), 1, file) == 1 && fwrite(value.data(), 1, value.size(), file) == value.size();
+}
+
+// Function to read one string written by writeString, returns false at the end of the file
+static bool readString(FILE* file, string& value)
+{
+    uint32_t length = 0;
+    if (fread(&length, sizeof(length), 1, file) != 1)
+    {
+        return false;
+    }
+    value.resize(length);
+    return fread(&value[0], 1, length, file) == length;
+}
+
+ExternalSorter::ExternalSorter(size_t memoryBudget)
+    : memoryBudget(memoryBudget), memoryUsed(0)
+{
+}
+
+ExternalSorter::~ExternalSorter()
+{
+    for (FILE* run : runs)
+    {
+        fclose(run);
+    }
+}
+
+// Function to add a record with its sort key
+bool ExternalSorter::add(string&& key, string&& record)
+{
+    memoryUsed += sizeof(SortRecord) + key.capacity() + record.capacity();
+    records.push_back({ move(key), move(record) });
+    if (memoryUsed >= memoryBudget)
+    {
+        return writeRun();
+    }
+    return true;
+}
+
+// Function to sort the records in memory and write them to a new temporary file
+bool ExternalSorter::writeRun()
+{
+    FILE* run = tmpfile();
+    if (run == nullptr)
+    {
+        return false;
+    }
+    runs.push_back(run);
+    setvbuf(run, nullptr, _IOFBF, runBufferSize);
+
+    stable_sort(records.begin(), records.end(), [](const SortRecord& a, const SortRecord& b) { return a.key < b.key; });
+    for (const auto& record : records)
+    {
+        if (!writeString(run, record.key) || !writeString(run, record.record))
+        {
+            return false;
+        }
+    }
+    records.clear();
+    records.shrink_to_fit();
+    memoryUsed = 0;
+    return fflush(run) == 0;
+}
+
+// Function to hand every record to onRecord in key order
+bool ExternalSorter::finish(const function<void(const string& record)>& onRecord)
+{
+    auto less = [](const SortRecord& a, const SortRecord& b) { return a.key < b.key; };
+
+    // Everything fit in memory, nothing has to be merged
+    if (runs.empty())
+    {
+        stable_sort(records.begin(), records.end(), less);
+        for (const auto& record : records)
+        {
+            onRecord(record.record);
+        }
+        records.clear();
+        return true;
+    }
+
+    // The last records become a run of their own, so every run is merged the same way
+    if (!records.empty() && !writeRun())
+    {
+        return false;
+    }
+
+    // Each run contributes its smallest record, ties go to the earlier run so equal keys keep their order
+    vector<SortRecord> heads(runs.size());
+    vector<size_t> heap;
+    for (size_t i = 0; i < runs.size(); i++)
+    {
+        rewind(runs[i]);
+        if (readString(runs[i], heads[i].key) && readString(runs[i], heads[i].record))
+        {
+            heap.push_back(i);
+        }
+    }
+    auto later = [&](size_t a, size_t b)
+    {
+        int order = heads[a].key.compare(heads[b].key);
+        return order > 0 || (order == 0 && a > b);
+    };
+    make_heap(heap.begin(), heap.end(), later);
+
+    while (!heap.empty())
+    {
+        pop_heap(heap.begin(), heap.end(), later);
+        size_t run = heap.back();
+        onRecord(heads[run].record);
+        if (readString(runs[run], heads[run].key) && readString(runs[run], heads[run].record))
+        {
+            push_heap(heap.begin(), heap.end(), later);
+        }
+        else
+        {
+            heap.pop_back();
+        }
+    }
+
+    bool readFailed = false;
+    for (FILE* run : runs)
+    {
+        readFailed = readFailed || ferror(run) != 0;
+        fclose(run);
+    }
+    runs.clear();
+    return !readFailed;
+}
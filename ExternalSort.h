@@ -0,0 +1,53 @@
+#ifndef EXTERNALSORT_H
+#define EXTERNALSORT_H
+
+#include <cstddef>      // For size_t
+#include <cstdio>       // For the temporary run files
+#include <functional>   // For record callbacks
+#include <string>       // For keys and records
+#include <vector>       // For the records in memory and the runs
+
+// Memory a sort may use for records before it writes them to a temporary file
+const size_t defaultSortMemoryBudget = 64 << 20;
+
+// Sorts records by key when there may be too many to hold in memory
+// Keys are compared as bytes, so any other order is had by encoding the keys to match it. Records are
+// kept in memory until they take up the memory budget, then sorted and written to a temporary file as
+// a run. finish() merges the runs, reading each through a small buffer and picking the smallest key
+// with a heap, so memory stays within the budget however many records are added. Records with equal
+// keys come out in the order they were added. Run files are deleted when closed, even if the process
+// ends first.
+class ExternalSorter
+{
+public:
+    explicit ExternalSorter(size_t memoryBudget = defaultSortMemoryBudget);
+    ~ExternalSorter();
+
+    ExternalSorter(const ExternalSorter&) = delete;
+    ExternalSorter& operator=(const ExternalSorter&) = delete;
+
+    // Function to add a record with its sort key, returns false if a run couldn't be written
+    bool add(std::string&& key, std::string&& record);
+
+    // Function to hand every record to onRecord in key order, returns false if a run couldn't be written or read back
+    bool finish(const std::function<void(const std::string& record)>& onRecord);
+
+    // Number of runs written to temporary files so far
+    size_t runCount() const { return runs.size(); }
+
+private:
+    struct SortRecord
+    {
+        std::string key;
+        std::string record;
+    };
+
+    bool writeRun();
+
+    size_t memoryBudget;
+    size_t memoryUsed;
+    std::vector<SortRecord> records;
+    std::vector<FILE*> runs;
+};
+
+#endif // EXTERNALSORT_H
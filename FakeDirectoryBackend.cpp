@@ -0,0 +1,997 @@
+#include "FakeDirectoryBackend.h"
+
+#include <algorithm>    // For min and sorting
+#include <atomic>       // For counting writes in flight over every connection
+#include <cctype>       // For tolower
+#include <cstdlib>      // For reading sort cookies
+#include <ctime>        // For timestamps
+#include <map>          // For the entries, ordered by DN key
+#include <mutex>        // For sharing the directory between connections
+#include <thread>       // For waiting out the latency
+
+using namespace std;
+
+// Separator between the RDNs of a DN key, sorts before any character of an RDN
+static const char keySeparator = '\x01';
+
+// Structure to store an entry of the fake directory
+struct StoredEntry
+{
+    string dn;
+    vector<EntryAttribute> attributes;
+    vector<EntryAttribute> operationalAttributes;
+};
+
+// Entries and bookkeeping shared by every connection to one fake directory
+// Entries are keyed by their RDNs from the root down, so a subtree is one contiguous range of keys
+// and parents sort before their children.
+class FakeDirectory
+{
+public:
+    mutex lock;
+    map<string, StoredEntry> entries;
+    unsigned int connections = 0;
+
+    // Replies to asynchronous writes not yet read, over every connection
+    atomic<size_t> writesInFlight{ 0 };
+};
+
+// Structure to store one node of a parsed search filter (RFC 4515)
+struct FilterNode
+{
+    enum Type { And, Or, Not, Equal, Present, Substring, GreaterOrEqual, LessOrEqual } type = Present;
+    string attribute;
+    string value;
+    vector<string> parts;       // Substring pieces: initial, any..., final
+    bool hasInitial = false;
+    bool hasFinal = false;
+    vector<FilterNode> children;
+};
+
+// Function to lower-case a string
+static string lowerCase(const string& text)
+{
+    string lowered(text);
+    for (char& c : lowered)
+    {
+        c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+    return lowered;
+}
+
+// Function to turn a DN into its key, the lower-cased RDNs from the root down
+static string dnKey(const string& dn)
+{
+    vector<string> rdns;
+    string rdn;
+    for (size_t i = 0; i < dn.size(); i++)
+    {
+        if (dn[i] == '\\' && i + 1 < dn.size())
+        {
+            rdn += dn[i];
+            rdn += dn[++i];
+        }
+        else if (dn[i] == ',')
+        {
+            rdns.push_back(rdn);
+            rdn.clear();
+        }
+        else if (dn[i] != ' ' || (!rdn.empty() && rdn.back() != '='))
+        {
+            rdn += dn[i];
+        }
+    }
+    rdns.push_back(rdn);
+
+    string key;
+    for (auto it = rdns.rbegin(); it != rdns.rend(); ++it)
+    {
+        size_t end = it->find_last_not_of(' ');
+        if (!key.empty())
+        {
+            key += keySeparator;
+        }
+        key += lowerCase(it->substr(0, end == string::npos ? 0 : end + 1));
+    }
+    return key;
+}
+
+// Function to format the current time as an LDAP generalized time
+static string generalizedTime()
+{
+    time_t now = time(nullptr);
+    tm utc = *gmtime(&now);
+    char text[16];
+    strftime(text, sizeof(text), "%Y%m%d%H%M%SZ", &utc);
+    return text;
+}
+
+// Function to decode the \XX escapes of a filter value
+static string unescapeFilterValue(const string& value)
+{
+    string decoded;
+    for (size_t i = 0; i < value.size(); i++)
+    {
+        if (value[i] == '\\' && i + 2 < value.size() && isxdigit(static_cast<unsigned char>(value[i + 1])) && isxdigit(static_cast<unsigned char>(value[i + 2])))
+        {
+            decoded += static_cast<char>(stoi(value.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        }
+        else
+        {
+            decoded += value[i];
+        }
+    }
+    return decoded;
+}
+
+// Function to parse one parenthesised filter starting at position, returns false if it is malformed
+static bool parseFilter(const string& text, size_t& position, FilterNode& node)
+{
+    if (position >= text.size() || text[position] != '(')
+    {
+        return false;
+    }
+    position++;
+    if (position >= text.size())
+    {
+        return false;
+    }
+
+    char first = text[position];
+    if (first == '&' || first == '|' || first == '!')
+    {
+        node.type = first == '&' ? FilterNode::And : first == '|' ? FilterNode::Or : FilterNode::Not;
+        position++;
+        while (position < text.size() && text[position] == '(')
+        {
+            node.children.emplace_back();
+            if (!parseFilter(text, position, node.children.back()))
+            {
+                return false;
+            }
+        }
+        if (node.type == FilterNode::Not && node.children.size() != 1)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        size_t close = text.find(')', position);
+        size_t equals = text.find('=', position);
+        if (close == string::npos || equals == string::npos || equals > close || equals == position)
+        {
+            return false;
+        }
+
+        size_t attributeEnd = equals;
+        char modifier = text[equals - 1];
+        if (modifier == '>' || modifier == '<' || modifier == '~')
+        {
+            attributeEnd--;
+        }
+        node.attribute = text.substr(position, attributeEnd - position);
+        string value = text.substr(equals + 1, close - equals - 1);
+
+        if (modifier == '>')
+        {
+            node.type = FilterNode::GreaterOrEqual;
+            node.value = unescapeFilterValue(value);
+        }
+        else if (modifier == '<')
+        {
+            node.type = FilterNode::LessOrEqual;
+            node.value = unescapeFilterValue(value);
+        }
+        else if (value == "*")
+        {
+            node.type = FilterNode::Present;
+        }
+        else if (value.find('*') != string::npos)
+        {
+            node.type = FilterNode::Substring;
+            size_t start = 0;
+            size_t star;
+            node.hasInitial = value[0] != '*';
+            node.hasFinal = value.back() != '*';
+            while ((star = value.find('*', start)) != string::npos)
+            {
+                if (star > start)
+                {
+                    node.parts.push_back(lowerCase(unescapeFilterValue(value.substr(start, star - start))));
+                }
+                start = star + 1;
+            }
+            if (start < value.size())
+            {
+                node.parts.push_back(lowerCase(unescapeFilterValue(value.substr(start))));
+            }
+        }
+        else
+        {
+            // Approximate matches are treated as equality
+            node.type = FilterNode::Equal;
+            node.value = unescapeFilterValue(value);
+        }
+        position = close;
+    }
+
+    if (position >= text.size() || text[position] != ')')
+    {
+        return false;
+    }
+    position++;
+    return true;
+}
+
+// Function to find an attribute of a stored entry, including its operational attributes
+static const EntryAttribute* findAttribute(const StoredEntry& entry, const string& name)
+{
+    for (const auto* attributes : { &entry.attributes, &entry.operationalAttributes })
+    {
+        for (const auto& attribute : *attributes)
+        {
+            if (sameAttributeName(attribute.name, name))
+            {
+                return &attribute;
+            }
+        }
+    }
+    return nullptr;
+}
+
+// Function to check if a string is made of digits only
+static bool isNumber(const string& text)
+{
+    if (text.empty())
+    {
+        return false;
+    }
+    for (char c : text)
+    {
+        if (c < '0' || c > '9')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Function to order two values, numerically when both are numbers and ignoring case otherwise
+static int compareValues(const string& a, const string& b)
+{
+    if (isNumber(a) && isNumber(b))
+    {
+        size_t aStart = min(a.find_first_not_of('0'), a.size());
+        size_t bStart = min(b.find_first_not_of('0'), b.size());
+        if (a.size() - aStart != b.size() - bStart)
+        {
+            return a.size() - aStart < b.size() - bStart ? -1 : 1;
+        }
+        return a.compare(aStart, string::npos, b, bStart, string::npos);
+    }
+    return lowerCase(a).compare(lowerCase(b));
+}
+
+// Function to check if a value contains the pieces of a substring filter in order
+static bool matchesSubstring(const FilterNode& node, const string& value)
+{
+    string lowered = lowerCase(value);
+    size_t position = 0;
+    for (size_t i = 0; i < node.parts.size(); i++)
+    {
+        const string& part = node.parts[i];
+        if (i == 0 && node.hasInitial)
+        {
+            if (lowered.compare(0, part.size(), part) != 0)
+            {
+                return false;
+            }
+            position = part.size();
+        }
+        else if (i + 1 == node.parts.size() && node.hasFinal)
+        {
+            return lowered.size() >= position + part.size() && lowered.compare(lowered.size() - part.size(), part.size(), part) == 0;
+        }
+        else
+        {
+            size_t found = lowered.find(part, position);
+            if (found == string::npos)
+            {
+                return false;
+            }
+            position = found + part.size();
+        }
+    }
+    return true;
+}
+
+// Function to evaluate a parsed filter against an entry
+static bool matchesFilter(const FilterNode& node, const StoredEntry& entry)
+{
+    switch (node.type)
+    {
+    case FilterNode::And:
+        for (const auto& child : node.children)
+        {
+            if (!matchesFilter(child, entry))
+            {
+                return false;
+            }
+        }
+        return true;
+    case FilterNode::Or:
+        for (const auto& child : node.children)
+        {
+            if (matchesFilter(child, entry))
+            {
+                return true;
+            }
+        }
+        return false;
+    case FilterNode::Not:
+        return !matchesFilter(node.children[0], entry);
+    default:
+        break;
+    }
+
+    const EntryAttribute* attribute = findAttribute(entry, node.attribute);
+    if (attribute == nullptr)
+    {
+        return false;
+    }
+    if (node.type == FilterNode::Present)
+    {
+        return true;
+    }
+    for (const auto& value : attribute->values)
+    {
+        bool matched = false;
+        switch (node.type)
+        {
+        case FilterNode::Equal:
+            matched = compareValues(value, node.value) == 0;
+            break;
+        case FilterNode::GreaterOrEqual:
+            matched = compareValues(value, node.value) >= 0;
+            break;
+        case FilterNode::LessOrEqual:
+            matched = compareValues(value, node.value) <= 0;
+            break;
+        case FilterNode::Substring:
+            matched = matchesSubstring(node, value);
+            break;
+        default:
+            break;
+        }
+        if (matched)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Function to copy the requested attributes of a stored entry into a search result
+static DirectoryEntry selectAttributes(const StoredEntry& entry, const vector<string>& attributes)
+{
+    DirectoryEntry result;
+    result.dn = entry.dn;
+
+    bool allUser = attributes.empty();
+    bool allOperational = false;
+    for (const auto& name : attributes)
+    {
+        allUser = allUser || name == "*";
+        allOperational = allOperational || name == "+";
+    }
+
+    auto wanted = [&attributes](const string& name)
+    {
+        for (const auto& requested : attributes)
+        {
+            if (sameAttributeName(requested, name))
+            {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    for (const auto& attribute : entry.attributes)
+    {
+        if (allUser || wanted(attribute.name))
+        {
+            result.attributes.push_back(attribute);
+        }
+    }
+    for (const auto& attribute : entry.operationalAttributes)
+    {
+        if (allOperational || wanted(attribute.name))
+        {
+            result.attributes.push_back(attribute);
+        }
+    }
+    return result;
+}
+
+// Function to check if a key is the base key or lies below it
+static bool inSubtree(const string& key, const string& baseKey)
+{
+    if (baseKey.empty())
+    {
+        return true;
+    }
+    return key.compare(0, baseKey.size(), baseKey) == 0 && (key.size() == baseKey.size() || key[baseKey.size()] == keySeparator);
+}
+
+// Function to check if a key is in the search scope of the base key
+static bool inScope(const string& key, const string& baseKey, int scope)
+{
+    if (scope == LDAP_SCOPE_BASE)
+    {
+        return key == baseKey;
+    }
+    if (scope == LDAP_SCOPE_ONELEVEL)
+    {
+        if (baseKey.empty())
+        {
+            return key.find(keySeparator) == string::npos;
+        }
+        return key.size() > baseKey.size() && key.find(keySeparator, baseKey.size() + 1) == string::npos;
+    }
+    return true;
+}
+
+// Function to set or update the timestamps of an entry
+static void touch(StoredEntry& entry, bool created)
+{
+    string now = generalizedTime();
+    if (created)
+    {
+        entry.operationalAttributes = { { "createTimestamp", { now } }, { "modifyTimestamp", { now } } };
+        return;
+    }
+    for (auto& attribute : entry.operationalAttributes)
+    {
+        if (attribute.name == "modifyTimestamp")
+        {
+            attribute.values = { now };
+        }
+    }
+}
+
+FakeDirectoryBackend::FakeDirectoryBackend(const FakeDirectorySettings& settings)
+    : FakeDirectoryBackend(make_shared<FakeDirectory>(), settings, settings.seed)
+{
+}
+
+FakeDirectoryBackend::FakeDirectoryBackend(const shared_ptr<FakeDirectory>& directory, const FakeDirectorySettings& settings, unsigned int seed)
+    : directory(directory), settings(settings), random(seed), nextMessageId(1), opened(false),
+      requestsSinceOpen(0), lastRequest(chrono::steady_clock::now())
+{
+}
+
+FakeDirectoryBackend::~FakeDirectoryBackend()
+{
+}
+
+// Function to open a connection using LDAP version 3
+int FakeDirectoryBackend::open(const string&, int)
+{
+    opened = true;
+    directory->writesInFlight -= replies.size();
+    replies.clear();
+    requestsSinceOpen = 0;
+    lastRequest = chrono::steady_clock::now();
+    return LDAP_SUCCESS;
+}
+
+// Function to bind with a simple username and password, any credentials are accepted
+int FakeDirectoryBackend::bind(const string&, const string&)
+{
+    if (!opened)
+    {
+        return LDAP_SERVER_DOWN;
+    }
+    this_thread::sleep_for(settings.latency);
+    return LDAP_SUCCESS;
+}
+
+// Function to unbind and close the connection
+void FakeDirectoryBackend::close()
+{
+    cutConnection();
+}
+
+// Function to drop the connection and the replies still to be read
+void FakeDirectoryBackend::cutConnection()
+{
+    opened = false;
+    directory->writesInFlight -= replies.size();
+    replies.clear();
+    sortedKeys.clear();
+}
+
+// Function to check if the connection is up for another request, cutting it the way the settings ask
+bool FakeDirectoryBackend::connectionAlive()
+{
+    if (!opened)
+    {
+        return false;
+    }
+
+    auto now = chrono::steady_clock::now();
+    if ((settings.idleTimeout.count() > 0 && now - lastRequest > settings.idleTimeout) ||
+        (settings.dropEvery > 0 && ++requestsSinceOpen > settings.dropEvery))
+    {
+        cutConnection();
+        return false;
+    }
+    lastRequest = now;
+    return true;
+}
+
+// Function to create another, unopened backend of the same kind that talks to the same directory
+unique_ptr<DirectoryBackend> FakeDirectoryBackend::createConnection() const
+{
+    // Each connection gets its own seed so connections don't fail in lockstep
+    unsigned int connection;
+    {
+        lock_guard<mutex> guard(directory->lock);
+        connection = ++directory->connections;
+    }
+    return unique_ptr<DirectoryBackend>(new FakeDirectoryBackend(directory, settings, settings.seed + connection));
+}
+
+// Function to decide if the next request is answered with an injected error
+bool FakeDirectoryBackend::injectError()
+{
+    if (settings.errorRate <= 0)
+    {
+        return false;
+    }
+    return uniform_real_distribution<double>(0.0, 1.0)(random) < settings.errorRate;
+}
+
+// Function to check if the directory is already working on as many writes as it can
+bool FakeDirectoryBackend::overloaded() const
+{
+    return settings.capacity > 0 && directory->writesInFlight.load() >= settings.capacity;
+}
+
+// Function to answer a request, queueing the reply when it was sent asynchronously
+int FakeDirectoryBackend::reply(int resultCode, int* messageId)
+{
+    if (messageId == nullptr)
+    {
+        this_thread::sleep_for(settings.latency);
+        return resultCode;
+    }
+
+    // Now and then a reply stalls, holding up the replies behind it as a busy server would
+    chrono::microseconds latency = settings.latency;
+    if (settings.spikeRate > 0 && uniform_real_distribution<double>(0.0, 1.0)(random) < settings.spikeRate)
+    {
+        latency += settings.spikeLatency;
+    }
+
+    *messageId = nextMessageId++;
+    replies.push_back({ *messageId, resultCode, chrono::steady_clock::now() + latency });
+    directory->writesInFlight++;
+    return LDAP_SUCCESS;
+}
+
+// Function to add an entry
+int FakeDirectoryBackend::addEntry(const EntryView& view, int* messageId)
+{
+    if (!connectionAlive())
+    {
+        return LDAP_SERVER_DOWN;
+    }
+    if (injectError() || overloaded())
+    {
+        return reply(LDAP_BUSY, messageId);
+    }
+    if (view.attributeCount == 0)
+    {
+        return reply(LDAP_PROTOCOL_ERROR, messageId);
+    }
+
+    // Repeated attributes are merged, as the server would store them
+    StoredEntry entry;
+    entry.dn = view.dn;
+    for (size_t i = 0; i < view.attributeCount; i++)
+    {
+        const AttributeView& attribute = view.attributes[i];
+        EntryAttribute* existing = nullptr;
+        for (auto& stored : entry.attributes)
+        {
+            if (sameAttributeName(stored.name, attribute.name))
+            {
+                existing = &stored;
+            }
+        }
+        if (existing == nullptr)
+        {
+            entry.attributes.push_back({ attribute.name, {} });
+            existing = &entry.attributes.back();
+        }
+        existing->values.insert(existing->values.end(), attribute.values, attribute.values + attribute.valueCount);
+    }
+    touch(entry, true);
+
+    int rc = LDAP_SUCCESS;
+    {
+        lock_guard<mutex> guard(directory->lock);
+        if (!directory->entries.emplace(dnKey(view.dn), move(entry)).second)
+        {
+            rc = LDAP_ALREADY_EXISTS;
+        }
+    }
+    return reply(rc, messageId);
+}
+
+// Function to modify an entry
+int FakeDirectoryBackend::modifyEntry(const string& dn, const vector<AttributeChange>& changes, int* messageId)
+{
+    if (!connectionAlive())
+    {
+        return LDAP_SERVER_DOWN;
+    }
+    if (injectError() || overloaded())
+    {
+        return reply(LDAP_BUSY, messageId);
+    }
+
+    lock_guard<mutex> guard(directory->lock);
+    auto stored = directory->entries.find(dnKey(dn));
+    if (stored == directory->entries.end())
+    {
+        return reply(LDAP_NO_SUCH_OBJECT, messageId);
+    }
+
+    // Changes are applied to a copy so a failing change leaves the entry as it was
+    StoredEntry entry = stored->second;
+    for (const auto& change : changes)
+    {
+        auto attribute = entry.attributes.begin();
+        while (attribute != entry.attributes.end() && !sameAttributeName(attribute->name, change.name))
+        {
+            ++attribute;
+        }
+
+        int operation = change.operation & ~LDAP_MOD_BVALUES;
+        if (operation == LDAP_MOD_ADD)
+        {
+            if (attribute == entry.attributes.end())
+            {
+                entry.attributes.push_back({ change.name, change.values });
+                continue;
+            }
+            for (const auto& value : change.values)
+            {
+                for (const auto& existing : attribute->values)
+                {
+                    if (compareValues(existing, value) == 0)
+                    {
+                        return reply(LDAP_TYPE_OR_VALUE_EXISTS, messageId);
+                    }
+                }
+                attribute->values.push_back(value);
+            }
+        }
+        else if (operation == LDAP_MOD_DELETE)
+        {
+            if (attribute == entry.attributes.end())
+            {
+                return reply(LDAP_NO_SUCH_ATTRIBUTE, messageId);
+            }
+            for (const auto& value : change.values)
+            {
+                auto existing = attribute->values.begin();
+                while (existing != attribute->values.end() && compareValues(*existing, value) != 0)
+                {
+                    ++existing;
+                }
+                if (existing == attribute->values.end())
+                {
+                    return reply(LDAP_NO_SUCH_ATTRIBUTE, messageId);
+                }
+                attribute->values.erase(existing);
+            }
+            if (change.values.empty() || attribute->values.empty())
+            {
+                entry.attributes.erase(attribute);
+            }
+        }
+        else if (operation == LDAP_MOD_REPLACE)
+        {
+            if (attribute != entry.attributes.end())
+            {
+                entry.attributes.erase(attribute);
+            }
+            if (!change.values.empty())
+            {
+                entry.attributes.push_back({ change.name, change.values });
+            }
+        }
+        else
+        {
+            return reply(LDAP_PROTOCOL_ERROR, messageId);
+        }
+    }
+
+    touch(entry, false);
+    stored->second = move(entry);
+    return reply(LDAP_SUCCESS, messageId);
+}
+
+// Function to delete an entry, together with its children when treeDelete is set
+int FakeDirectoryBackend::deleteEntry(const string& dn, bool treeDelete, int* messageId)
+{
+    if (!connectionAlive())
+    {
+        return LDAP_SERVER_DOWN;
+    }
+    if (injectError() || overloaded())
+    {
+        return reply(LDAP_BUSY, messageId);
+    }
+
+    lock_guard<mutex> guard(directory->lock);
+    string key = dnKey(dn);
+    auto entry = directory->entries.find(key);
+    if (entry == directory->entries.end())
+    {
+        return reply(LDAP_NO_SUCH_OBJECT, messageId);
+    }
+
+    // Children are the keys right after the entry that continue its key
+    auto end = next(entry);
+    while (end != directory->entries.end() && inSubtree(end->first, key))
+    {
+        ++end;
+    }
+    if (end != next(entry) && !treeDelete)
+    {
+        return reply(LDAP_NOT_ALLOWED_ON_NONLEAF, messageId);
+    }
+    directory->entries.erase(entry, end);
+    return reply(LDAP_SUCCESS, messageId);
+}
+
+// Function to wait for the reply to any outstanding request
+int FakeDirectoryBackend::waitForResult(int& messageId, int& resultCode)
+{
+    if (!opened)
+    {
+        return LDAP_SERVER_DOWN;
+    }
+    if (replies.empty())
+    {
+        return LDAP_TIMEOUT;
+    }
+
+    PendingReply pending = replies.front();
+    replies.pop_front();
+    directory->writesInFlight--;
+    this_thread::sleep_until(pending.readyAt);
+    messageId = pending.messageId;
+    resultCode = pending.resultCode;
+    return LDAP_SUCCESS;
+}
+
+// Function to search for matching entries, at most sizeLimit of them unless it is 0
+int FakeDirectoryBackend::search(const string& base, int scope, const string& filter, const vector<string>& attributes, size_t sizeLimit, vector<DirectoryEntry>& entries)
+{
+    entries.clear();
+    if (!connectionAlive())
+    {
+        return LDAP_SERVER_DOWN;
+    }
+    this_thread::sleep_for(settings.latency);
+    if (injectError())
+    {
+        return LDAP_BUSY;
+    }
+
+    // Entries left over after the size limit leave a cookie behind
+    string cookie;
+    int rc = findEntries(base, scope, filter, attributes, sizeLimit, cookie, entries);
+    if (rc == LDAP_SUCCESS && !cookie.empty())
+    {
+        rc = LDAP_SIZELIMIT_EXCEEDED;
+    }
+    return rc;
+}
+
+// Function to read one page of a search with the Simple Paged Results control
+int FakeDirectoryBackend::searchPage(const string& base, int scope, const string& filter, const vector<string>& attributes, const string& sortAttribute, size_t pageSize, string& cookie, vector<DirectoryEntry>& entries)
+{
+    entries.clear();
+    if (!connectionAlive())
+    {
+        return LDAP_SERVER_DOWN;
+    }
+    this_thread::sleep_for(settings.latency);
+    if (injectError())
+    {
+        return LDAP_BUSY;
+    }
+
+    // A page size of zero abandons the search
+    if (pageSize == 0)
+    {
+        cookie.clear();
+        sortedKeys.clear();
+        return LDAP_SUCCESS;
+    }
+    if (!sortAttribute.empty())
+    {
+        return findSortedEntries(base, scope, filter, attributes, sortAttribute, pageSize, cookie, entries);
+    }
+    return findEntries(base, scope, filter, attributes, pageSize, cookie, entries);
+}
+
+// Function to collect up to limit matching entries (0 for no limit) starting after the cookie
+// The cookie is replaced by the key of the last entry returned when more entries match, and cleared otherwise.
+int FakeDirectoryBackend::findEntries(const string& base, int scope, const string& filter, const vector<string>& attributes, size_t limit, string& cookie, vector<DirectoryEntry>& entries)
+{
+    FilterNode filterTree;
+    size_t position = 0;
+    if (!parseFilter(filter, position, filterTree) || position != filter.size())
+    {
+        return LDAP_FILTER_ERROR;
+    }
+
+    // The root DSE lists the controls the fake understands
+    if (base.empty() && scope == LDAP_SCOPE_BASE)
+    {
+        StoredEntry rootDse;
+        rootDse.attributes = { { "objectClass", { "top" } }, { "supportedControl", { pagedResultsControlOid, serverSortControlOid, treeDeleteControlOid } }, { "supportedLDAPVersion", { "3" } } };
+        if (matchesFilter(filterTree, rootDse))
+        {
+            entries.push_back(selectAttributes(rootDse, attributes));
+        }
+        cookie.clear();
+        return LDAP_SUCCESS;
+    }
+
+    lock_guard<mutex> guard(directory->lock);
+    string baseKey = dnKey(base);
+    auto entry = cookie.empty() ? directory->entries.lower_bound(baseKey) : directory->entries.upper_bound(cookie);
+    if (cookie.empty())
+    {
+        // The base has to exist, or at least have entries below it
+        if (entry == directory->entries.end() || !inSubtree(entry->first, baseKey) || (scope == LDAP_SCOPE_BASE && entry->first != baseKey))
+        {
+            return LDAP_NO_SUCH_OBJECT;
+        }
+    }
+
+    cookie.clear();
+    auto lastReturned = directory->entries.end();
+    for (; entry != directory->entries.end() && inSubtree(entry->first, baseKey); ++entry)
+    {
+        if (!inScope(entry->first, baseKey, scope) || !matchesFilter(filterTree, entry->second))
+        {
+            continue;
+        }
+        if (limit != 0 && entries.size() == limit)
+        {
+            cookie = lastReturned->first;
+            break;
+        }
+        entries.push_back(selectAttributes(entry->second, attributes));
+        lastReturned = entry;
+    }
+    return LDAP_SUCCESS;
+}
+
+// Function to collect up to limit matching entries sorted by an attribute, starting at the position in the cookie
+// The first page sorts every match the way caseIgnoreOrderingMatch does, ignoring case but not numbers,
+// with entries that lack the attribute last. Later pages read on from that order, skipping deleted entries.
+int FakeDirectoryBackend::findSortedEntries(const string& base, int scope, const string& filter, const vector<string>& attributes, const string& sortAttribute, size_t limit, string& cookie, vector<DirectoryEntry>& entries)
+{
+    size_t position = 0;
+    if (cookie.empty())
+    {
+        FilterNode filterTree;
+        if (!parseFilter(filter, position, filterTree) || position != filter.size())
+        {
+            return LDAP_FILTER_ERROR;
+        }
+
+        lock_guard<mutex> guard(directory->lock);
+        string baseKey = dnKey(base);
+        auto entry = directory->entries.lower_bound(baseKey);
+        if (entry == directory->entries.end() || !inSubtree(entry->first, baseKey) || (scope == LDAP_SCOPE_BASE && entry->first != baseKey))
+        {
+            return LDAP_NO_SUCH_OBJECT;
+        }
+
+        // Sort values are paired with their keys, an entry without the attribute gets no value
+        vector<pair<pair<bool, string>, string>> matches;
+        for (; entry != directory->entries.end() && inSubtree(entry->first, baseKey); ++entry)
+        {
+            if (inScope(entry->first, baseKey, scope) && matchesFilter(filterTree, entry->second))
+            {
+                const EntryAttribute* attribute = findAttribute(entry->second, sortAttribute);
+                bool missing = attribute == nullptr || attribute->values.empty();
+                matches.push_back({ { missing, missing ? string() : lowerCase(attribute->values[0]) }, entry->first });
+            }
+        }
+        sort(matches.begin(), matches.end());
+        sortedKeys.clear();
+        sortedKeys.reserve(matches.size());
+        for (auto& match : matches)
+        {
+            sortedKeys.push_back(move(match.second));
+        }
+        position = 0;
+    }
+    else
+    {
+        // The cookie is the position in the sorted entries of this connection
+        position = static_cast<size_t>(strtoull(cookie.c_str(), nullptr, 10));
+        if (position == 0 || position > sortedKeys.size())
+        {
+            return LDAP_PROTOCOL_ERROR;
+        }
+    }
+
+    lock_guard<mutex> guard(directory->lock);
+    cookie.clear();
+    for (; position < sortedKeys.size(); position++)
+    {
+        if (limit != 0 && entries.size() == limit)
+        {
+            cookie = to_string(position);
+            return LDAP_SUCCESS;
+        }
+        auto entry = directory->entries.find(sortedKeys[position]);
+        if (entry != directory->entries.end())
+        {
+            entries.push_back(selectAttributes(entry->second, attributes));
+        }
+    }
+    sortedKeys.clear();
+    return LDAP_SUCCESS;
+}
+
+// Function to describe a result code for error messages
+string FakeDirectoryBackend::errorString(int rc) const
+{
+    switch (rc)
+    {
+    case LDAP_SUCCESS:
+        return "Success";
+    case LDAP_OPERATIONS_ERROR:
+        return "Operations error";
+    case LDAP_PROTOCOL_ERROR:
+        return "Protocol error";
+    case LDAP_SIZELIMIT_EXCEEDED:
+        return "Size limit exceeded";
+    case LDAP_NO_SUCH_ATTRIBUTE:
+        return "No such attribute";
+    case LDAP_TYPE_OR_VALUE_EXISTS:
+        return "Type or value exists";
+    case LDAP_NO_SUCH_OBJECT:
+        return "No such object";
+    case LDAP_BUSY:
+        return "Server is busy";
+    case LDAP_NOT_ALLOWED_ON_NONLEAF:
+        return "Operation not allowed on non-leaf";
+    case LDAP_ALREADY_EXISTS:
+        return "Already exists";
+    case LDAP_SERVER_DOWN:
+        return "Can't contact LDAP server";
+    case LDAP_TIMEOUT:
+        return "Timed out";
+    case LDAP_FILTER_ERROR:
+        return "Bad search filter";
+    }
+    return "Unknown error " + to_string(rc);
+}
@@ -0,0 +1,103 @@
+#ifndef FAKEDIRECTORYBACKEND_H
+#define FAKEDIRECTORYBACKEND_H
+
+#include <chrono>               // For the injected latency
+#include <deque>                // For replies waiting to be read
+#include <random>               // For the injected errors
+#include "DirectoryBackend.h"   // For the backend interface
+
+// Settings of the in-process fake directory
+struct FakeDirectorySettings
+{
+    // Time between sending a request and its reply being ready
+    std::chrono::microseconds latency = std::chrono::microseconds(0);
+
+    // Share of requests, between 0 and 1, that are answered with LDAP_BUSY instead of being applied
+    double errorRate = 0;
+
+    // Share of requests, between 0 and 1, whose reply takes spikeLatency longer, like a server stalling
+    double spikeRate = 0;
+    std::chrono::microseconds spikeLatency = std::chrono::microseconds(0);
+
+    // Writes the directory works on at once over every connection, more are answered with LDAP_BUSY
+    // 0 for no limit
+    size_t capacity = 0;
+
+    // Requests a connection takes before it is cut, as a failing server or network would, 0 for never
+    // The request that finds the connection cut is not applied, the replies still to be read are lost.
+    size_t dropEvery = 0;
+
+    // Time a connection may go without a request before it is cut, as a load balancer would, 0 for never
+    std::chrono::milliseconds idleTimeout = std::chrono::milliseconds(0);
+
+    // Seed for the injected errors and spikes, so a run can be repeated exactly
+    unsigned int seed = 1;
+};
+
+// Entries and bookkeeping shared by every connection to one fake directory
+class FakeDirectory;
+
+// Directory backend that keeps its entries in memory, for measuring the client without a server
+// Connections created from the same backend share one directory. Replies become ready a fixed latency
+// after their request is sent, so pipelined requests overlap the way they do on a network. Parent
+// entries don't have to exist, and the root DSE lists the paged results, server side sorting and
+// tree-delete controls.
+// Busy errors, latency spikes and a limited capacity can be injected to exercise flow control, and
+// connections can be cut to exercise reconnecting.
+class FakeDirectoryBackend : public DirectoryBackend
+{
+public:
+    explicit FakeDirectoryBackend(const FakeDirectorySettings& settings = FakeDirectorySettings());
+    ~FakeDirectoryBackend();
+
+    FakeDirectoryBackend(const FakeDirectoryBackend&) = delete;
+    FakeDirectoryBackend& operator=(const FakeDirectoryBackend&) = delete;
+
+    int open(const std::string& host, int port) override;
+    int bind(const std::string& username, const std::string& password) override;
+    void close() override;
+    std::unique_ptr<DirectoryBackend> createConnection() const override;
+
+    using DirectoryBackend::addEntry;
+    int addEntry(const EntryView& entry, int* messageId = nullptr) override;
+    int modifyEntry(const std::string& dn, const std::vector<AttributeChange>& changes, int* messageId = nullptr) override;
+    int deleteEntry(const std::string& dn, bool treeDelete = false, int* messageId = nullptr) override;
+    int waitForResult(int& messageId, int& resultCode) override;
+
+    int search(const std::string& base, int scope, const std::string& filter, const std::vector<std::string>& attributes, size_t sizeLimit, std::vector<DirectoryEntry>& entries) override;
+    int searchPage(const std::string& base, int scope, const std::string& filter, const std::vector<std::string>& attributes, const std::string& sortAttribute, size_t pageSize, std::string& cookie, std::vector<DirectoryEntry>& entries) override;
+
+    std::string errorString(int rc) const override;
+
+private:
+    FakeDirectoryBackend(const std::shared_ptr<FakeDirectory>& directory, const FakeDirectorySettings& settings, unsigned int seed);
+
+    bool injectError();
+    bool overloaded() const;
+    bool connectionAlive();
+    void cutConnection();
+    int findEntries(const std::string& base, int scope, const std::string& filter, const std::vector<std::string>& attributes, size_t limit, std::string& cookie, std::vector<DirectoryEntry>& entries);
+    int findSortedEntries(const std::string& base, int scope, const std::string& filter, const std::vector<std::string>& attributes, const std::string& sortAttribute, size_t limit, std::string& cookie, std::vector<DirectoryEntry>& entries);
+    int reply(int resultCode, int* messageId);
+
+    struct PendingReply
+    {
+        int messageId;
+        int resultCode;
+        std::chrono::steady_clock::time_point readyAt;
+    };
+
+    std::shared_ptr<FakeDirectory> directory;
+    FakeDirectorySettings settings;
+    std::mt19937 random;
+    std::deque<PendingReply> replies;
+    int nextMessageId;
+    bool opened;
+    size_t requestsSinceOpen;
+    std::chrono::steady_clock::time_point lastRequest;
+
+    // Keys of the entries of the sorted search being paged through, kept for the connection like a server does
+    std::vector<std::string> sortedKeys;
+};
+
+#endif // FAKEDIRECTORYBACKEND_H
@@ -0,0 +1,130 @@
+#include "FlowControl.h"
+
+#include "DirectoryBackend.h"   // For LDAP result codes
+#include "Metrics.h"            // For counting retries and window decreases
+
+using namespace std;
+
+// Function to check if a result code means the server couldn't take a request now but may later
+bool isTransientResult(int rc)
+{
+    return rc == LDAP_BUSY || rc == LDAP_UNAVAILABLE || rc == LDAP_TIMELIMIT_EXCEEDED;
+}
+
+FlowController::FlowController(size_t maxWindow)
+    : maxWindow(maxWindow == 0 ? 1 : maxWindow), currentWindow(maxWindow == 0 ? 1 : maxWindow),
+      repliesSinceIncrease(0), repliesSinceDecrease(0), fastestReply(chrono::steady_clock::duration::zero()),
+      random(random_device()())
+{
+}
+
+// Function to record a reply that was not busy or unavailable, and the time from sending it
+void FlowController::recordReply(chrono::steady_clock::duration latency)
+{
+    repliesSinceDecrease++;
+
+    // The fastest reply creeps up a little with every reply, so a lasting change of network latency is
+    // taken as the new normal instead of as load
+    fastestReply += fastestReply / 64;
+    if (fastestReply == chrono::steady_clock::duration::zero() || latency < fastestReply)
+    {
+        fastestReply = latency;
+    }
+
+    // A reply far slower than the fastest one means requests are queueing up at the server
+    if (latency > latencyFloor && latency > fastestReply * latencyTolerance)
+    {
+        decrease();
+        return;
+    }
+
+    // One more request in flight for every window's worth of timely replies
+    if (currentWindow < maxWindow && ++repliesSinceIncrease >= currentWindow)
+    {
+        currentWindow++;
+        repliesSinceIncrease = 0;
+    }
+}
+
+// Function to record a reply saying the server is busy or unavailable
+void FlowController::recordBusy()
+{
+    repliesSinceDecrease++;
+    decrease();
+}
+
+// Function to halve the window, unless it was already halved for a request sent before that
+void FlowController::decrease()
+{
+    // Replies to requests sent before the last decrease say nothing about the smaller window
+    if (repliesSinceDecrease < currentWindow)
+    {
+        return;
+    }
+    repliesSinceDecrease = 0;
+    repliesSinceIncrease = 0;
+    if (currentWindow > 1)
+    {
+        currentWindow /= 2;
+        metrics().windowDecreases.fetch_add(1, memory_order_relaxed);
+    }
+}
+
+// Function to pick the delay before the given retry of a write, with full jitter
+chrono::steady_clock::duration FlowController::retryDelay(unsigned int attempt)
+{
+    chrono::steady_clock::duration cap = maxRetryDelay;
+    if (attempt < 16)
+    {
+        chrono::steady_clock::duration doubled = chrono::steady_clock::duration(baseRetryDelay) * (1 << (attempt == 0 ? 0 : attempt - 1));
+        cap = doubled < cap ? doubled : cap;
+    }
+    metrics().writeRetries.fetch_add(1, memory_order_relaxed);
+    uniform_int_distribution<chrono::steady_clock::rep> delay(0, cap.count());
+    return chrono::steady_clock::duration(delay(random));
+}
+
+RateLimiter::RateLimiter()
+    : operationsPerSecond(0), nextSlot(chrono::steady_clock::now())
+{
+}
+
+// Function to set the limit in writes per second, 0 for none
+void RateLimiter::setRate(double rate)
+{
+    operationsPerSecond.store(rate > 0 ? rate : 0, memory_order_relaxed);
+}
+
+// Function to wait until another write may be sent
+void RateLimiter::acquire()
+{
+    if (operationsPerSecond.load(memory_order_relaxed) <= 0)
+    {
+        return;
+    }
+    this_thread::sleep_until(reserve());
+}
+
+// Function to take the next slot without waiting for it
+chrono::steady_clock::time_point RateLimiter::reserve()
+{
+    double rate = operationsPerSecond.load(memory_order_relaxed);
+    auto now = chrono::steady_clock::now();
+    if (rate <= 0)
+    {
+        return now;
+    }
+
+    // Writes take slots one interval apart, an idle spell doesn't save up slots for a burst
+    lock_guard<mutex> lock(limiterMutex);
+    chrono::steady_clock::time_point slot = nextSlot > now ? nextSlot : now;
+    nextSlot = slot + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(1.0 / rate));
+    return slot;
+}
+
+// Function to get the rate limiter of every write made by this process
+RateLimiter& writeRateLimiter()
+{
+    static RateLimiter processLimiter;
+    return processLimiter;
+}
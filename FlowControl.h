@@ -0,0 +1,147 @@
+#ifndef FLOWCONTROL_H
+#define FLOWCONTROL_H
+
+#include <atomic>       // For reading the rate limit without a lock
+#include <chrono>       // For latencies and retry delays
+#include <cstddef>      // For size_t
+#include <map>          // For retries ordered by time
+#include <mutex>        // For sharing the rate limit between connections
+#include <random>       // For jittering retry delays
+#include <thread>       // For waiting for retries
+#include <utility>      // For moving retried requests
+
+// Number of times a write answered busy or unavailable is sent again before it is recorded as failed
+const unsigned int maxWriteRetries = 5;
+
+// Delay before the first retry of a write, doubled for each further retry up to maxRetryDelay
+const std::chrono::milliseconds baseRetryDelay(50);
+const std::chrono::milliseconds maxRetryDelay(5000);
+
+// Replies slower than this multiple of the fastest reply seen are taken as a sign the server is loaded
+const double latencyTolerance = 4.0;
+
+// Replies faster than this are never taken as a sign of load, so jitter on a fast network is ignored
+const std::chrono::milliseconds latencyFloor(5);
+
+// Function to check if a result code means the server couldn't take a request now but may later
+bool isTransientResult(int rc);
+
+// Adjusts the number of writes kept in flight on one connection, additive increase, multiplicative decrease
+// The window starts at its maximum and grows by one for every window's worth of timely replies. It is
+// halved when the server answers busy or unavailable, or replies much slower than the fastest reply seen,
+// but at most once per window of replies so a single overload doesn't collapse it. Used by one thread only.
+class FlowController
+{
+public:
+    explicit FlowController(size_t maxWindow);
+
+    size_t window() const { return currentWindow; }
+
+    // Function to record a reply that was not busy or unavailable, and the time from sending it
+    void recordReply(std::chrono::steady_clock::duration latency);
+
+    // Function to record a reply saying the server is busy or unavailable
+    void recordBusy();
+
+    // Function to pick the delay before the given retry (1 for the first) of a write, with full jitter, and count the retry
+    // The delay is random between zero and an exponentially growing cap, so connections that were
+    // turned away together don't all come back at the same moment.
+    std::chrono::steady_clock::duration retryDelay(unsigned int attempt);
+
+private:
+    void decrease();
+
+    size_t maxWindow;
+    size_t currentWindow;
+    size_t repliesSinceIncrease;
+    size_t repliesSinceDecrease;
+    std::chrono::steady_clock::duration fastestReply;
+    std::mt19937 random;
+};
+
+// Limits the writes of the whole process to a number per second, shared by every connection
+// Each write is given the next free slot, so writes are spread evenly instead of sent in bursts.
+class RateLimiter
+{
+public:
+    RateLimiter();
+
+    RateLimiter(const RateLimiter&) = delete;
+    RateLimiter& operator=(const RateLimiter&) = delete;
+
+    // Function to set the limit in writes per second, 0 for none
+    void setRate(double operationsPerSecond);
+
+    double rate() const { return operationsPerSecond.load(std::memory_order_relaxed); }
+
+    // Function to wait until another write may be sent
+    void acquire();
+
+    // Function to take the next slot without waiting for it, returns the time the write may be sent
+    // For callers that can't block, such as coroutines that sleep on their event loop instead.
+    std::chrono::steady_clock::time_point reserve();
+
+private:
+    std::atomic<double> operationsPerSecond;
+    std::mutex limiterMutex;
+    std::chrono::steady_clock::time_point nextSlot;
+};
+
+// Function to get the rate limiter of every write made by this process
+RateLimiter& writeRateLimiter();
+
+// Requests waiting to be sent again, ordered by the time they are due
+// A request counts the times it was sent again in a member named attempts.
+template <typename Request>
+class RetryQueue
+{
+public:
+    // Function to schedule a request the server couldn't take now after a delay picked by flow
+    // Returns false, leaving the request as it is, once it has been sent again maxWriteRetries times.
+    bool retry(Request& request, FlowController& flow)
+    {
+        if (request.attempts >= maxWriteRetries)
+        {
+            return false;
+        }
+        request.attempts++;
+        std::chrono::steady_clock::duration delay = flow.retryDelay(request.attempts);
+        schedule(std::move(request), delay);
+        return true;
+    }
+
+    // Function to schedule a request to be sent again after a delay
+    void schedule(Request&& request, std::chrono::steady_clock::duration delay)
+    {
+        requests.emplace(std::chrono::steady_clock::now() + delay, std::move(request));
+    }
+
+    // Function to take the request due soonest, returns false if none is due yet
+    bool takeDue(Request& request)
+    {
+        if (requests.empty() || requests.begin()->first > std::chrono::steady_clock::now())
+        {
+            return false;
+        }
+        request = std::move(requests.begin()->second);
+        requests.erase(requests.begin());
+        return true;
+    }
+
+    // Function to wait until the request due soonest may be sent
+    void waitForNext() const
+    {
+        if (!requests.empty())
+        {
+            std::this_thread::sleep_until(requests.begin()->first);
+        }
+    }
+
+    bool empty() const { return requests.empty(); }
+    size_t size() const { return requests.size(); }
+
+private:
+    std::multimap<std::chrono::steady_clock::time_point, Request> requests;
+};
+
+#endif // FLOWCONTROL_H
@@ -0,0 +1,407 @@
+#include "ImportEngine.h"
+
+#include <algorithm>        // For max
+#include <iostream>         // For error output
+#include "EntryEncoder.h"   // For building the entries of users
+
+using namespace std;
+
+// Number of batches each connection may have queued before submit() waits
+static const size_t queuedBatchesPerConnection = 4;
+
+// Fewest batches a tenant may have queued, however many tenants share the connections
+static const size_t minQueuedBatchesPerTenant = 2;
+
+// Function to split a full name into first name and last name
+void splitFullName(const string& fullName, string& firstName, string& lastName)
+{
+    string_view first, last;
+    splitFullName(string_view(fullName), first, last);
+    firstName.assign(first);
+    lastName.assign(last);
+}
+
+// Function to wait for the reply to one outstanding add request and record its outcome
+bool collectLDAPAddResult(DirectoryBackend* ldap, map<int, PendingAdd>& pendingAdds, FlowController& flow, RetryQueue<PendingAdd>& retries, const vector<ImportReport*>& reports, const function<void(const ImportRow&)>& onAdded, const function<void(const ImportRow&)>& onAnswered)
+{
+    int messageId = 0;
+    int rc = LDAP_SUCCESS;
+    int waitRc = ldap->waitForResult(messageId, rc);
+
+    // Only a lost connection takes the pending adds with it, after any other error their replies may still come
+    if (waitRc != LDAP_SUCCESS)
+    {
+        if (!connectionLost(waitRc))
+        {
+            return false;
+        }
+        string error = ldap->errorString(waitRc);
+        for (const auto& pending : pendingAdds)
+        {
+            reports[pending.second.tenant]->recordFailure(pending.second.row.id, error);
+        }
+        pendingAdds.clear();
+        return false;
+    }
+
+    auto pending = pendingAdds.find(messageId);
+    if (pending == pendingAdds.end())
+    {
+        return true;
+    }
+
+    // A busy server gets fewer requests in flight and the row again later
+    if (isTransientResult(rc))
+    {
+        flow.recordBusy();
+        if (retries.retry(pending->second, flow))
+        {
+            pendingAdds.erase(pending);
+            return true;
+        }
+    }
+    else
+    {
+        flow.recordReply(chrono::steady_clock::now() - pending->second.sentAt);
+    }
+
+    // An existing entry is reported by the server instead of a separate existence search, unless the
+    // row is sent again by a resumed import, whose first attempt was most likely applied before it stopped
+    const ImportRow& row = pending->second.row;
+    ImportReport& report = *reports[pending->second.tenant];
+    if (rc == LDAP_SUCCESS || (rc == LDAP_ALREADY_EXISTS && row.replayed))
+    {
+        report.recordAdded();
+        if (onAdded)
+        {
+            onAdded(row);
+        }
+    }
+    else if (rc == LDAP_ALREADY_EXISTS)
+    {
+        report.recordFailure(row.id, "User already exists");
+    }
+    else
+    {
+        report.recordFailure(row.id, ldap->errorString(rc));
+    }
+    if (onAnswered)
+    {
+        onAnswered(row);
+    }
+    pendingAdds.erase(pending);
+
+    return true;
+}
+
+// Function to send one add request, waiting for a slot when writes are rate limited
+static void sendLDAPAdd(DirectoryBackend* ldap, UserEntryEncoder& encoder, PendingAdd&& add, map<int, PendingAdd>& pendingAdds, FlowController& flow, RetryQueue<PendingAdd>& retries, const vector<ImportReport*>& reports)
+{
+    writeRateLimiter().acquire();
+
+    int messageId = 0;
+    int rc = add.row.dn.empty()
+        ? ldap->addEntry(encoder.encode(add.row), &messageId)
+        : ldap->addEntry(add.row.dn, add.row.attributes, &messageId);
+    if (rc == LDAP_SUCCESS)
+    {
+        add.sentAt = chrono::steady_clock::now();
+        pendingAdds[messageId] = move(add);
+        return;
+    }
+
+    if (isTransientResult(rc))
+    {
+        flow.recordBusy();
+        if (retries.retry(add, flow))
+        {
+            return;
+        }
+    }
+    reports[add.tenant]->recordFailure(add.row.id, ldap->errorString(rc));
+}
+
+// Function to open and bind another connection like the given one, returns nullptr and sets rc on failure
+unique_ptr<DirectoryBackend> openLDAPConnection(const DirectoryBackend* like, const LDAPConnectionSettings& settings, int& rc)
+{
+    unique_ptr<DirectoryBackend> ldap = like->createConnection();
+    rc = ldap->open(settings.host, settings.port);
+    if (rc == LDAP_SUCCESS)
+    {
+        rc = ldap->bind(settings.username, settings.password);
+    }
+    if (rc != LDAP_SUCCESS)
+    {
+        ldap->close();
+        return nullptr;
+    }
+
+    return ldap;
+}
+
+ImportEngine::ImportEngine(DirectoryBackend* primaryConnection, const LDAPConnectionSettings& settings, size_t connectionCount, size_t windowPerConnection)
+    : primaryConnection(primaryConnection), settings(settings),
+      connectionCount(connectionCount == 0 ? 1 : connectionCount),
+      windowPerConnection(windowPerConnection == 0 ? 1 : windowPerConnection),
+      readyBatches(0), nextTenant(0), finished(false)
+{
+}
+
+ImportEngine::ImportEngine(DirectoryBackend* primaryConnection, const LDAPConnectionSettings& settings, const string& basePath, size_t connectionCount, size_t windowPerConnection, ImportReport& report)
+    : ImportEngine(primaryConnection, settings, connectionCount, windowPerConnection)
+{
+    addTenant(basePath, report);
+}
+
+ImportEngine::~ImportEngine()
+{
+    finish();
+}
+
+// Function to add a tenant whose users are added under ou=users of basePath
+size_t ImportEngine::addTenant(const string& basePath, ImportReport& report)
+{
+    tenants.push_back(Tenant());
+    tenants.back().basePath = basePath;
+    reports.push_back(&report);
+    return tenants.size() - 1;
+}
+
+// Function to open the additional connections and start the workers, returns the number of connections in use
+size_t ImportEngine::start()
+{
+    // The connection bound by the menu is always the first worker
+    workers.emplace_back(new Worker());
+    workers.back()->ldap = primaryConnection;
+
+    for (size_t i = 1; i < connectionCount; i++)
+    {
+        int rc = LDAP_SUCCESS;
+        unique_ptr<DirectoryBackend> ldap = openLDAPConnection(primaryConnection, settings, rc);
+        if (ldap == nullptr)
+        {
+            cerr << "Failed to open import connection " << i + 1 << ": " << primaryConnection->errorString(rc) << endl;
+            cerr << "Continuing with " << workers.size() << " connection(s)." << endl;
+            break;
+        }
+        workers.emplace_back(new Worker());
+        workers.back()->ldap = ldap.get();
+        workers.back()->ownedConnection = move(ldap);
+    }
+
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i]->thread = thread(&ImportEngine::run, this, i);
+    }
+
+    return workers.size();
+}
+
+// Function to set a function called with every row that was added
+void ImportEngine::setAddedListener(function<void(const ImportRow&)> listener)
+{
+    addedListener = move(listener);
+}
+
+// Function to set a function called with every row the server answered, added or not
+void ImportEngine::setAnsweredListener(function<void(const ImportRow&)> listener)
+{
+    answeredListener = move(listener);
+}
+
+// Function to get the number of batches a tenant may have queued before submit() waits
+// Each connection has a few batches ready, shared between the tenants, but every tenant can have some
+// queued so it is never left out of its turn for lack of rows.
+size_t ImportEngine::queueLimit() const
+{
+    return max(minQueuedBatchesPerTenant, workers.size() * queuedBatchesPerConnection / max<size_t>(tenants.size(), 1));
+}
+
+// Function to queue a batch of rows for a tenant, waits while its queue is full
+void ImportEngine::submit(size_t tenant, vector<ImportRow>&& batch)
+{
+    if (batch.empty() || workers.empty() || tenant >= tenants.size())
+    {
+        return;
+    }
+
+    {
+        unique_lock<mutex> lock(stateMutex);
+        Tenant& queue = tenants[tenant];
+        spaceAvailable.wait(lock, [&] { return queue.batches.size() < queueLimit(); });
+        queue.batches.push_back(move(batch));
+        readyBatches++;
+    }
+    batchReady.notify_one();
+}
+
+// Function to take the next batch, from the tenants in turn, returns false if none is queued
+bool ImportEngine::tryTakeBatch(size_t& tenant, vector<ImportRow>& batch)
+{
+    {
+        lock_guard<mutex> lock(stateMutex);
+        if (readyBatches == 0)
+        {
+            return false;
+        }
+
+        // The tenant after the one served last goes first, tenants with nothing queued are passed over
+        for (size_t i = 0; i < tenants.size(); i++)
+        {
+            size_t candidate = (nextTenant + i) % tenants.size();
+            if (!tenants[candidate].batches.empty())
+            {
+                tenant = candidate;
+                break;
+            }
+        }
+        batch = move(tenants[tenant].batches.front());
+        tenants[tenant].batches.pop_front();
+        readyBatches--;
+        nextTenant = (tenant + 1) % tenants.size();
+    }
+
+    // Producers of several tenants may be waiting, and only the one whose queue shrank can go on
+    spaceAvailable.notify_all();
+    return true;
+}
+
+// Function to wait until a batch is ready, returns false once the import is finished and every queue is empty
+bool ImportEngine::waitForBatch()
+{
+    unique_lock<mutex> lock(stateMutex);
+    batchReady.wait(lock, [this] { return readyBatches > 0 || finished; });
+    return readyBatches > 0;
+}
+
+// Function run by each worker thread
+void ImportEngine::run(size_t index)
+{
+    Worker& worker = *workers[index];
+
+    // Add requests sent on this connection but not yet answered, keyed by message ID, and rows
+    // waiting to be sent again
+    map<int, PendingAdd> pendingAdds;
+    RetryQueue<PendingAdd> retries;
+    FlowController flow(windowPerConnection);
+    vector<ImportRow> batch;
+    size_t tenant = 0;
+
+    // Entries are built in the arena of their tenant's encoder, which is reused once they have been sent
+    vector<unique_ptr<UserEntryEncoder>> encoders(tenants.size());
+    auto encoderFor = [&](size_t index) -> UserEntryEncoder&
+    {
+        if (!encoders[index])
+        {
+            encoders[index].reset(new UserEntryEncoder(tenants[index].basePath));
+        }
+        return *encoders[index];
+    };
+    auto resetEncoders = [&]()
+    {
+        for (auto& encoder : encoders)
+        {
+            if (encoder)
+            {
+                encoder->reset();
+            }
+        }
+    };
+
+    // Rows are reported to the listener one at a time
+    function<void(const ImportRow&)> onAdded;
+    if (addedListener)
+    {
+        onAdded = [this](const ImportRow& row)
+        {
+            lock_guard<mutex> lock(listenerMutex);
+            addedListener(row);
+        };
+    }
+
+    // Function to wait for a reply once the window of outstanding adds is full
+    auto waitForWindow = [&]()
+    {
+        while (pendingAdds.size() >= flow.window())
+        {
+            collectLDAPAddResult(worker.ldap, pendingAdds, flow, retries, reports, onAdded, answeredListener);
+        }
+    };
+
+    // Function to send the rows whose retry is due, ahead of new rows
+    auto sendDueRetries = [&]()
+    {
+        PendingAdd retry;
+        bool sent = false;
+        while (retries.takeDue(retry))
+        {
+            waitForWindow();
+            size_t retryTenant = retry.tenant;
+            sendLDAPAdd(worker.ldap, encoderFor(retryTenant), move(retry), pendingAdds, flow, retries, reports);
+            sent = true;
+        }
+        if (sent)
+        {
+            resetEncoders();
+        }
+    };
+
+    while (true)
+    {
+        sendDueRetries();
+        if (!tryTakeBatch(tenant, batch))
+        {
+            // Collect the outstanding replies and send every retry before going idle
+            if (!pendingAdds.empty())
+            {
+                collectLDAPAddResult(worker.ldap, pendingAdds, flow, retries, reports, onAdded, answeredListener);
+                continue;
+            }
+            if (!retries.empty())
+            {
+                retries.waitForNext();
+                continue;
+            }
+            if (!waitForBatch())
+            {
+                break;
+            }
+            continue;
+        }
+
+        UserEntryEncoder& encoder = encoderFor(tenant);
+        for (auto& row : batch)
+        {
+            waitForWindow();
+            PendingAdd add;
+            add.row = move(row);
+            add.tenant = tenant;
+            sendLDAPAdd(worker.ldap, encoder, move(add), pendingAdds, flow, retries, reports);
+        }
+        batch.clear();
+        encoder.reset();
+    }
+}
+
+// Function to wait for every queued row to be added or recorded as failed
+void ImportEngine::finish()
+{
+    {
+        lock_guard<mutex> lock(stateMutex);
+        finished = true;
+    }
+    batchReady.notify_all();
+
+    for (auto& worker : workers)
+    {
+        if (worker->thread.joinable())
+        {
+            worker->thread.join();
+        }
+        if (worker->ownedConnection)
+        {
+            worker->ownedConnection->close();
+        }
+    }
+    workers.clear();
+}
@@ -0,0 +1,157 @@
+#ifndef IMPORTENGINE_H
+#define IMPORTENGINE_H
+
+#include <chrono>               // For the time each add request was sent
+#include <condition_variable>   // For waiting on queued rows
+#include <deque>                // For the per-tenant work queues
+#include <functional>           // For the added-row listener
+#include <map>                  // For outstanding add requests
+#include <memory>               // For owning workers
+#include <mutex>                // For guarding the queues
+#include <string>               // For string operations
+#include <thread>               // For one worker per connection
+#include <vector>               // For storing rows
+#include "DirectoryBackend.h"   // For directory operations
+#include "FlowControl.h"        // For adapting to server load
+#include "ImportReport.h"       // For recording the outcome of each row
+
+// Default number of add requests kept in flight on each connection while importing a CSV file
+const size_t defaultImportWindow = 64;
+
+// Default number of connections used to import a CSV file
+const size_t defaultImportConnections = 1;
+
+// Number of rows handed to a connection at a time
+const size_t importBatchSize = 256;
+
+// Structure to store a single row of an import file
+struct ImportRow
+{
+    std::string id;
+    std::string fullName;
+    std::string phoneNumber;
+    std::string email;
+    std::string department;
+    std::string jobDescription;
+
+    // Position of the row in its file, used to checkpoint imports
+    size_t recordNumber = 0;
+    size_t byteOffset = 0;
+
+    // Set when the row was in flight as the import being resumed stopped, so it may already have been added
+    bool replayed = false;
+
+    // Entry read from an LDIF file, added as it is instead of the columns above when dn is set
+    std::string dn;
+    std::vector<EntryAttribute> attributes;
+};
+
+// Function to split a full name into first name and last name
+void splitFullName(const std::string& fullName, std::string& firstName, std::string& lastName);
+
+// Structure to store an add request that was sent and not yet answered, or is waiting to be sent again
+struct PendingAdd
+{
+    ImportRow row;
+    size_t tenant = 0;
+    unsigned int attempts = 0;
+    std::chrono::steady_clock::time_point sentAt;
+};
+
+// Function to wait for the reply to one outstanding add request and record its outcome in the report of its tenant
+// Returns false if no reply could be read, and if that is because the connection was lost every pending add is recorded as failed
+// Rows answered busy or unavailable are scheduled in retries until they have been tried maxWriteRetries
+// times, and every reply is reported to flow. onAdded, if set, is called with every row the server
+// accepted, and onAnswered with every row it answered for the last time.
+bool collectLDAPAddResult(DirectoryBackend* ldap, std::map<int, PendingAdd>& pendingAdds, FlowController& flow, RetryQueue<PendingAdd>& retries, const std::vector<ImportReport*>& reports, const std::function<void(const ImportRow&)>& onAdded, const std::function<void(const ImportRow&)>& onAnswered = nullptr);
+
+// Function to open and bind another connection like the given one, returns nullptr and sets rc on failure
+std::unique_ptr<DirectoryBackend> openLDAPConnection(const DirectoryBackend* like, const LDAPConnectionSettings& settings, int& rc);
+
+// Imports rows over several bound connections at once, for one or more tenants
+// A tenant is a base path with its own report and queue of row batches. Each connection has a worker
+// thread that takes the next batch from the tenants in turn, skipping tenants with nothing queued, so
+// every tenant with rows gets an equal share of the connections and a large tenant doesn't hold up
+// small ones. Each worker keeps at most windowPerConnection adds in flight, fewer while the server
+// shows signs of load, and sends rows answered busy or unavailable again after a jittered delay.
+class ImportEngine
+{
+public:
+    // The primary connection is used as the first worker, the others are opened by start()
+    // Tenants are added with addTenant() before start().
+    ImportEngine(DirectoryBackend* primaryConnection, const LDAPConnectionSettings& settings, size_t connectionCount, size_t windowPerConnection);
+
+    // Users are added under ou=users of basePath, and the outcome of every row is recorded in report
+    // The engine has a single tenant, which submit(batch) queues to.
+    ImportEngine(DirectoryBackend* primaryConnection, const LDAPConnectionSettings& settings, const std::string& basePath, size_t connectionCount, size_t windowPerConnection, ImportReport& report);
+    ~ImportEngine();
+
+    ImportEngine(const ImportEngine&) = delete;
+    ImportEngine& operator=(const ImportEngine&) = delete;
+
+    // Function to add a tenant whose users are added under ou=users of basePath, returns its number for submit()
+    // Must be called before start(). The outcome of every row of the tenant is recorded in report.
+    size_t addTenant(const std::string& basePath, ImportReport& report);
+
+    // Function to open the additional connections and start the workers, returns the number of connections in use
+    size_t start();
+
+    // Function to set a function called with every row that was added, must be called before start()
+    // The listener is called from the worker threads, but never by two of them at once.
+    void setAddedListener(std::function<void(const ImportRow&)> listener);
+
+    // Function to set a function called with every row the server answered, added or not, must be called before start()
+    // Rows that could not be sent or whose connection failed are never answered. The listener may be
+    // called from several worker threads at once.
+    void setAnsweredListener(std::function<void(const ImportRow&)> listener);
+
+    // Function to queue a batch of rows for the first tenant, waits while its queue is full
+    void submit(std::vector<ImportRow>&& batch) { submit(0, std::move(batch)); }
+
+    // Function to queue a batch of rows for a tenant, waits while its queue is full
+    // Batches of different tenants may be submitted from different threads at once.
+    void submit(size_t tenant, std::vector<ImportRow>&& batch);
+
+    // Function to wait for every queued row to be added or recorded as failed
+    void finish();
+
+private:
+    struct Worker
+    {
+        DirectoryBackend* ldap;
+        std::unique_ptr<DirectoryBackend> ownedConnection;
+        std::thread thread;
+    };
+
+    struct Tenant
+    {
+        std::string basePath;
+        std::deque<std::vector<ImportRow>> batches;
+    };
+
+    void run(size_t index);
+    bool tryTakeBatch(size_t& tenant, std::vector<ImportRow>& batch);
+    bool waitForBatch();
+    size_t queueLimit() const;
+
+    DirectoryBackend* primaryConnection;
+    LDAPConnectionSettings settings;
+    size_t connectionCount;
+    size_t windowPerConnection;
+    std::vector<Tenant> tenants;
+    std::vector<ImportReport*> reports;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::function<void(const ImportRow&)> addedListener;
+    std::function<void(const ImportRow&)> answeredListener;
+    std::mutex listenerMutex;
+
+    // Queued batches of every tenant, and the tenant whose turn it is to have a batch taken
+    std::mutex stateMutex;
+    std::condition_variable batchReady;
+    std::condition_variable spaceAvailable;
+    size_t readyBatches;
+    size_t nextTenant;
+    bool finished;
+};
+
+#endif // IMPORTENGINE_H
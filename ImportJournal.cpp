@@ -0,0 +1,188 @@
+#include "ImportJournal.h"
+
+#include <algorithm>    // For finding finished rows
+#include <cstdio>       // For renaming the journal into place
+#include <fstream>      // For reading and writing the journal
+#include <sstream>      // For parsing journal lines
+
+using namespace std;
+
+// First line of every journal, followed by the format version
+static const char* const journalMagic = "ldap-import-journal";
+static const int journalVersion = 1;
+
+// Function to get the path of the journal kept next to an import file
+string journalPathFor(const string& filePath)
+{
+    return filePath + ".journal";
+}
+
+// Function to read a checkpoint from a journal file
+bool loadImportCheckpoint(const string& journalPath, ImportCheckpoint& checkpoint)
+{
+    ifstream in(journalPath, ios::binary);
+    if (!in.is_open())
+    {
+        return false;
+    }
+
+    string magic;
+    int version = 0;
+    if (!(in >> magic >> version) || magic != journalMagic || version != journalVersion)
+    {
+        return false;
+    }
+
+    checkpoint = ImportCheckpoint();
+    bool complete = false;
+    string line;
+    getline(in, line);
+    while (getline(in, line))
+    {
+        // IDs may hold spaces, so everything after the key is the value
+        size_t space = line.find(' ');
+        string key = line.substr(0, space);
+        string value = space == string::npos ? string() : line.substr(space + 1);
+        istringstream number(value);
+
+        if (key == "file_size")
+        {
+            number >> checkpoint.fileSize;
+        }
+        else if (key == "committed_offset")
+        {
+            number >> checkpoint.committedOffset;
+        }
+        else if (key == "committed_records")
+        {
+            number >> checkpoint.committedRecords;
+        }
+        else if (key == "read_offset")
+        {
+            number >> checkpoint.readOffset;
+        }
+        else if (key == "in_flight")
+        {
+            checkpoint.inFlightIds.insert(value);
+        }
+        else if (key == "end")
+        {
+            complete = true;
+            break;
+        }
+        if (!number && key != "in_flight")
+        {
+            return false;
+        }
+    }
+
+    // A journal without its end line was cut short
+    return complete && checkpoint.committedOffset <= checkpoint.readOffset && checkpoint.readOffset <= checkpoint.fileSize;
+}
+
+// Function to write a checkpoint to a journal file
+bool saveImportCheckpoint(const string& journalPath, const ImportCheckpoint& checkpoint)
+{
+    string temporary = journalPath + ".tmp";
+    {
+        ofstream out(temporary, ios::binary | ios::trunc);
+        if (!out.is_open())
+        {
+            return false;
+        }
+        out << journalMagic << " " << journalVersion << "\n"
+            << "file_size " << checkpoint.fileSize << "\n"
+            << "committed_offset " << checkpoint.committedOffset << "\n"
+            << "committed_records " << checkpoint.committedRecords << "\n"
+            << "read_offset " << checkpoint.readOffset << "\n";
+        for (const auto& id : checkpoint.inFlightIds)
+        {
+            out << "in_flight " << id << "\n";
+        }
+        out << "end\n";
+        if (!out)
+        {
+            return false;
+        }
+    }
+
+#ifdef _WIN32
+    // Windows won't rename over an existing file
+    remove(journalPath.c_str());
+#endif
+    return rename(temporary.c_str(), journalPath.c_str()) == 0;
+}
+
+ImportProgress::ImportProgress(size_t fileSize)
+    : fileSize(fileSize), unfinished(0)
+{
+}
+
+// Function to record a batch of rows about to be sent
+void ImportProgress::submitted(const vector<ImportRow>& batch)
+{
+    lock_guard<mutex> lock(progressMutex);
+    for (const auto& row : batch)
+    {
+        rows.push_back({ row.recordNumber, row.byteOffset, row.id, false });
+    }
+    unfinished += batch.size();
+}
+
+// Function to record that the server answered a row
+void ImportProgress::finished(const ImportRow& row)
+{
+    lock_guard<mutex> lock(progressMutex);
+
+    // Rows are tracked in file order, so the row is found by its record number
+    auto tracked = lower_bound(rows.begin(), rows.end(), row.recordNumber, [](const TrackedRow& candidate, size_t recordNumber)
+    {
+        return candidate.recordNumber < recordNumber;
+    });
+    if (tracked == rows.end() || tracked->recordNumber != row.recordNumber || tracked->finished)
+    {
+        return;
+    }
+    tracked->finished = true;
+    unfinished--;
+
+    // Everything up to the first unanswered row is committed
+    while (!rows.empty() && rows.front().finished)
+    {
+        rows.pop_front();
+    }
+}
+
+// Function to build a checkpoint, given where the file has been read up to
+ImportCheckpoint ImportProgress::checkpoint(size_t readOffset, size_t readRecords) const
+{
+    lock_guard<mutex> lock(progressMutex);
+
+    ImportCheckpoint checkpoint;
+    checkpoint.fileSize = fileSize;
+    checkpoint.readOffset = readOffset;
+    if (rows.empty())
+    {
+        checkpoint.committedOffset = readOffset;
+        checkpoint.committedRecords = readRecords;
+        return checkpoint;
+    }
+
+    checkpoint.committedOffset = rows.front().byteOffset;
+    checkpoint.committedRecords = rows.front().recordNumber - 1;
+    for (const auto& row : rows)
+    {
+        if (!row.finished)
+        {
+            checkpoint.inFlightIds.insert(row.id);
+        }
+    }
+    return checkpoint;
+}
+
+// Number of rows sent and not yet answered
+size_t ImportProgress::unfinishedCount() const
+{
+    lock_guard<mutex> lock(progressMutex);
+    return unfinished;
+}
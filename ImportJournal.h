@@ -0,0 +1,83 @@
+#ifndef IMPORTJOURNAL_H
+#define IMPORTJOURNAL_H
+
+#include <chrono>               // For the checkpoint interval
+#include <cstddef>              // For size_t
+#include <deque>                // For rows in flight
+#include <mutex>                // For rows finished by several workers
+#include <string>               // For string operations
+#include <unordered_set>        // For the IDs to replay
+#include <vector>               // For batches of rows
+#include "ImportEngine.h"       // For import rows
+
+// Time between checkpoints of an import
+const std::chrono::seconds checkpointInterval(1);
+
+// Position an import can be resumed from
+// Every row before committedOffset was answered by the server. Rows from there up to readOffset were
+// sent, and the ones in inFlightIds may not have been applied; rows from readOffset on were never sent.
+struct ImportCheckpoint
+{
+    size_t fileSize = 0;
+    size_t committedOffset = 0;
+    size_t committedRecords = 0;
+    size_t readOffset = 0;
+    std::unordered_set<std::string> inFlightIds;
+
+    // Function to check if a row read while resuming has to be sent again
+    bool needsReplay(const ImportRow& row) const
+    {
+        return row.byteOffset >= readOffset || inFlightIds.count(row.id) != 0;
+    }
+};
+
+// Function to get the path of the journal kept next to an import file
+std::string journalPathFor(const std::string& filePath);
+
+// Function to read a checkpoint from a journal file, returns false if there is none or it can't be read
+bool loadImportCheckpoint(const std::string& journalPath, ImportCheckpoint& checkpoint);
+
+// Function to write a checkpoint to a journal file
+// The journal is written next to its destination and renamed into place, so a crash while writing
+// leaves the previous checkpoint intact.
+bool saveImportCheckpoint(const std::string& journalPath, const ImportCheckpoint& checkpoint);
+
+// Tracks the rows of an import that were sent but not yet answered
+// Rows must be reported in file order by submitted() before they are handed to the import engine,
+// and finished() is called by the engine's workers as the server answers them.
+class ImportProgress
+{
+public:
+    explicit ImportProgress(size_t fileSize);
+
+    ImportProgress(const ImportProgress&) = delete;
+    ImportProgress& operator=(const ImportProgress&) = delete;
+
+    // Function to record a batch of rows about to be sent
+    void submitted(const std::vector<ImportRow>& batch);
+
+    // Function to record that the server answered a row
+    void finished(const ImportRow& row);
+
+    // Function to build a checkpoint, given where the file has been read up to
+    ImportCheckpoint checkpoint(size_t readOffset, size_t readRecords) const;
+
+    // Number of rows sent and not yet answered
+    size_t unfinishedCount() const;
+
+private:
+    struct TrackedRow
+    {
+        size_t recordNumber;
+        size_t byteOffset;
+        std::string id;
+        bool finished;
+    };
+
+    size_t fileSize;
+    mutable std::mutex progressMutex;
+    std::deque<TrackedRow> rows;
+    size_t unfinished;
+};
+
+#endif // IMPORTJOURNAL_H
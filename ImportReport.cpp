@@ -0,0 +1,168 @@
+#include "ImportReport.h"
+
+#include <iostream>     // For error output
+
+using namespace std;
+
+// Size of the buffer the report file is written through
+static const size_t reportBufferSize = 64 * 1024;
+
+// Function to write one CSV field, quoted when it holds a comma, quote or line break
+static void writeCsvField(ostream& out, const string& value)
+{
+    if (value.find_first_of(",\"\r\n") == string::npos)
+    {
+        out << value;
+        return;
+    }
+
+    out << '"';
+    for (char c : value)
+    {
+        if (c == '"')
+        {
+            out << '"';
+        }
+        out << c;
+    }
+    out << '"';
+}
+
+ImportReport::ImportReport()
+    : writeFailed(false), failed(0), added(0), lastOutcome(chrono::steady_clock::now().time_since_epoch().count())
+{
+}
+
+ImportReport::~ImportReport()
+{
+    close();
+}
+
+// Function to start writing failures to a CSV file
+bool ImportReport::open(const string& path, bool append)
+{
+    close();
+
+    // Each open starts a new report, so nothing of an earlier one is counted or named in the summary
+    {
+        lock_guard<mutex> lock(reportMutex);
+        filePath.clear();
+        writeFailed = false;
+        reasons.clear();
+        failed = 0;
+    }
+    added.store(0, memory_order_relaxed);
+    lastOutcome.store(chrono::steady_clock::now().time_since_epoch().count(), memory_order_relaxed);
+
+    // The buffer has to be in place before the file is opened to take effect
+    buffer.resize(reportBufferSize);
+    file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    file.open(path, ios::binary | (append ? ios::app : ios::trunc));
+    if (!file.is_open())
+    {
+        return false;
+    }
+    filePath = path;
+
+    // A file being appended to already has its header unless it is empty
+    file.seekp(0, ios::end);
+    if (file.tellp() == streampos(0))
+    {
+        file << "id,error\r\n";
+    }
+    return true;
+}
+
+// Function to finish writing the report file
+void ImportReport::close()
+{
+    lock_guard<mutex> lock(reportMutex);
+    if (file.is_open())
+    {
+        file.close();
+        if (file.fail() && !writeFailed)
+        {
+            cerr << "Warning: Failed to write the report file " << filePath << "." << endl;
+        }
+    }
+}
+
+// Function to record a user that could not be added, modified or deleted
+void ImportReport::recordFailure(const string& id, const string& error)
+{
+    noteOutcome();
+    lock_guard<mutex> lock(reportMutex);
+    failed++;
+
+    ReasonSummary& reason = reasons[error];
+    reason.count++;
+    if (reason.sampleIds.size() < reportSampleCount)
+    {
+        reason.sampleIds.push_back(id);
+    }
+
+    if (file.is_open() && !writeFailed)
+    {
+        writeCsvField(file, id);
+        file << ',';
+        writeCsvField(file, error);
+        file << "\r\n";
+        if (!file)
+        {
+            // Warn once, the counts in the summary are still right
+            cerr << "Warning: Failed to write the report file " << filePath << ", further failures are only counted." << endl;
+            writeFailed = true;
+        }
+    }
+}
+
+// Function to note the time of an outcome, keeping the latest when several threads record at once
+void ImportReport::noteOutcome()
+{
+    chrono::steady_clock::rep now = chrono::steady_clock::now().time_since_epoch().count();
+    chrono::steady_clock::rep last = lastOutcome.load(memory_order_relaxed);
+    while (last < now && !lastOutcome.compare_exchange_weak(last, now, memory_order_relaxed))
+    {
+    }
+}
+
+// Time the last user was recorded as added or failed
+chrono::steady_clock::time_point ImportReport::lastOutcomeTime() const
+{
+    return chrono::steady_clock::time_point(chrono::steady_clock::duration(lastOutcome.load(memory_order_relaxed)));
+}
+
+size_t ImportReport::failedCount() const
+{
+    lock_guard<mutex> lock(reportMutex);
+    return failed;
+}
+
+// Function to print the number of failures per reason with a few of the IDs for each
+void ImportReport::printSummary(ostream& out, const char* what) const
+{
+    lock_guard<mutex> lock(reportMutex);
+    if (failed == 0)
+    {
+        return;
+    }
+
+    out << failed << " " << what << " couldn't be processed due to the following reasons:" << endl;
+    for (const auto& reason : reasons)
+    {
+        out << "Reason: " << reason.first << " - " << reason.second.count << " " << what << ": ";
+        for (const auto& id : reason.second.sampleIds)
+        {
+            out << id << " ";
+        }
+        if (reason.second.count > reason.second.sampleIds.size())
+        {
+            out << "and " << reason.second.count - reason.second.sampleIds.size() << " more";
+        }
+        out << endl;
+    }
+    if (!filePath.empty() && !writeFailed)
+    {
+        out << "Every failure is listed in " << filePath << "." << endl;
+    }
+}
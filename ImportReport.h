@@ -0,0 +1,80 @@
+#ifndef IMPORTREPORT_H
+#define IMPORTREPORT_H
+
+#include <atomic>       // For counting added users from several threads
+#include <chrono>       // For the time of the last outcome
+#include <cstddef>      // For size_t
+#include <fstream>      // For the report file
+#include <map>          // For the failures per reason
+#include <mutex>        // For recording failures from several threads
+#include <ostream>      // For printing the summary
+#include <string>       // For string operations
+#include <vector>       // For the sample IDs and the write buffer
+
+// File the failures of an import or sync are written to unless another one is given
+const char* const defaultReportPath = "ExitFile.csv";
+
+// Number of user IDs shown for each failure reason in the console summary
+const size_t reportSampleCount = 10;
+
+// Outcome of an import or sync
+// Failures are written to a CSV report file as they happen, and only counts and a few sample IDs
+// per reason are kept, so memory stays the same however many rows fail. Safe to use from several
+// threads at once.
+class ImportReport
+{
+public:
+    ImportReport();
+    ~ImportReport();
+
+    ImportReport(const ImportReport&) = delete;
+    ImportReport& operator=(const ImportReport&) = delete;
+
+    // Function to start writing failures to a CSV file, returns false if it can't be created
+    // The file is replaced unless append is set, as it is when an import is resumed. Without a file
+    // failures are only counted. Counts recorded before, and the path of an earlier file, are dropped.
+    bool open(const std::string& filePath, bool append = false);
+
+    // Function to finish writing the report file
+    void close();
+
+    // Function to record a user that was added
+    void recordAdded() { added.fetch_add(1, std::memory_order_relaxed); noteOutcome(); }
+
+    // Function to record a user that could not be added, modified or deleted
+    void recordFailure(const std::string& id, const std::string& error);
+
+    size_t addedCount() const { return added.load(std::memory_order_relaxed); }
+    size_t failedCount() const;
+
+    // Time the last user was recorded as added or failed, or the report was made if none has been
+    std::chrono::steady_clock::time_point lastOutcomeTime() const;
+
+    // Path of the report file, empty when failures are only counted
+    const std::string& path() const { return filePath; }
+
+    // Function to print the number of failures per reason with a few of the IDs for each
+    void printSummary(std::ostream& out, const char* what = "users") const;
+
+private:
+    void noteOutcome();
+
+    struct ReasonSummary
+    {
+        size_t count = 0;
+        std::vector<std::string> sampleIds;
+    };
+
+    std::vector<char> buffer;
+    std::ofstream file;
+    std::string filePath;
+    bool writeFailed;
+
+    mutable std::mutex reportMutex;
+    std::map<std::string, ReasonSummary> reasons;
+    size_t failed;
+    std::atomic<size_t> added;
+    std::atomic<std::chrono::steady_clock::rep> lastOutcome;
+};
+
+#endif // IMPORTREPORT_H
@@ -0,0 +1,124 @@
+#include "InstrumentedBackend.h"
+
+using namespace std;
+
+InstrumentedBackend::InstrumentedBackend(unique_ptr<DirectoryBackend> backend)
+    : backend(move(backend)), pendingRequests(&pendingPool)
+{
+}
+
+int InstrumentedBackend::open(const string& host, int port)
+{
+    pendingRequests.clear();
+    return backend->open(host, port);
+}
+
+int InstrumentedBackend::bind(const string& username, const string& password)
+{
+    auto sentAt = chrono::steady_clock::now();
+    int rc = backend->bind(username, password);
+    return finishRequest(Operation::Bind, sentAt, rc, nullptr);
+}
+
+void InstrumentedBackend::close()
+{
+    pendingRequests.clear();
+    backend->close();
+}
+
+unique_ptr<DirectoryBackend> InstrumentedBackend::createConnection() const
+{
+    return unique_ptr<DirectoryBackend>(new InstrumentedBackend(backend->createConnection()));
+}
+
+// Function to record a request that has been answered, or remember one that was only sent
+int InstrumentedBackend::finishRequest(Operation operation, chrono::steady_clock::time_point sentAt, int rc, int* messageId)
+{
+    metrics().roundTrips.fetch_add(1, memory_order_relaxed);
+    if (messageId != nullptr && rc == LDAP_SUCCESS)
+    {
+        pendingRequests[*messageId] = { operation, sentAt };
+        return rc;
+    }
+
+    metrics().recordOperation(operation, chrono::steady_clock::now() - sentAt, rc != LDAP_SUCCESS);
+    return rc;
+}
+
+int InstrumentedBackend::addEntry(const EntryView& entry, int* messageId)
+{
+    auto sentAt = chrono::steady_clock::now();
+    int rc = backend->addEntry(entry, messageId);
+    return finishRequest(Operation::Add, sentAt, rc, messageId);
+}
+
+int InstrumentedBackend::modifyEntry(const string& dn, const vector<AttributeChange>& changes, int* messageId)
+{
+    auto sentAt = chrono::steady_clock::now();
+    int rc = backend->modifyEntry(dn, changes, messageId);
+    return finishRequest(Operation::Modify, sentAt, rc, messageId);
+}
+
+int InstrumentedBackend::deleteEntry(const string& dn, bool treeDelete, int* messageId)
+{
+    auto sentAt = chrono::steady_clock::now();
+    int rc = backend->deleteEntry(dn, treeDelete, messageId);
+    return finishRequest(Operation::Delete, sentAt, rc, messageId);
+}
+
+int InstrumentedBackend::waitForResult(int& messageId, int& resultCode)
+{
+    int rc = backend->waitForResult(messageId, resultCode);
+    auto now = chrono::steady_clock::now();
+
+    // A lost connection fails every outstanding request at once, after any other error they may still be answered
+    if (connectionLost(rc))
+    {
+        for (const auto& pending : pendingRequests)
+        {
+            metrics().recordOperation(pending.second.operation, now - pending.second.sentAt, true);
+        }
+        pendingRequests.clear();
+        return rc;
+    }
+    if (rc != LDAP_SUCCESS)
+    {
+        return rc;
+    }
+
+    auto pending = pendingRequests.find(messageId);
+    if (pending != pendingRequests.end())
+    {
+        metrics().recordOperation(pending->second.operation, now - pending->second.sentAt, resultCode != LDAP_SUCCESS);
+        pendingRequests.erase(pending);
+    }
+    return rc;
+}
+
+int InstrumentedBackend::search(const string& base, int scope, const string& filter, const vector<string>& attributes, size_t sizeLimit, vector<DirectoryEntry>& entries)
+{
+    auto sentAt = chrono::steady_clock::now();
+    int rc = backend->search(base, scope, filter, attributes, sizeLimit, entries);
+    metrics().entriesReturned.fetch_add(entries.size(), memory_order_relaxed);
+
+    // Running out of room is how a size-limited probe is expected to end
+    bool failed = rc != LDAP_SUCCESS && rc != LDAP_SIZELIMIT_EXCEEDED && rc != LDAP_NO_SUCH_OBJECT;
+    finishRequest(Operation::Search, sentAt, failed ? rc : LDAP_SUCCESS, nullptr);
+    return rc;
+}
+
+int InstrumentedBackend::searchPage(const string& base, int scope, const string& filter, const vector<string>& attributes, const string& sortAttribute, size_t pageSize, string& cookie, vector<DirectoryEntry>& entries)
+{
+    auto sentAt = chrono::steady_clock::now();
+    int rc = backend->searchPage(base, scope, filter, attributes, sortAttribute, pageSize, cookie, entries);
+    metrics().entriesReturned.fetch_add(entries.size(), memory_order_relaxed);
+
+    bool failed = rc != LDAP_SUCCESS && rc != LDAP_NO_SUCH_OBJECT;
+    finishRequest(Operation::Search, sentAt, failed ? rc : LDAP_SUCCESS, nullptr);
+    return rc;
+}
+
+string InstrumentedBackend::errorString(int rc) const
+{
+    return backend->errorString(rc);
+}
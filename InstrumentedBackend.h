@@ -0,0 +1,52 @@
+#ifndef INSTRUMENTEDBACKEND_H
+#define INSTRUMENTEDBACKEND_H
+
+#include <chrono>               // For request start times
+#include <memory_resource>      // For recycling the nodes of the request table
+#include <unordered_map>        // For outstanding requests
+#include "DirectoryBackend.h"   // For the backend interface
+#include "Metrics.h"            // For recording latencies
+
+// Directory backend that measures every request of the backend it wraps
+// Synchronous requests are timed around the call. Asynchronous ones are timed from sending to the
+// matching waitForResult(), so pipelined requests report their real round trip and not the time spent
+// waiting behind others. Each connection keeps its own table of outstanding requests, so the only
+// shared state is the relaxed atomics in metrics().
+class InstrumentedBackend : public DirectoryBackend
+{
+public:
+    explicit InstrumentedBackend(std::unique_ptr<DirectoryBackend> backend);
+
+    int open(const std::string& host, int port) override;
+    int bind(const std::string& username, const std::string& password) override;
+    void close() override;
+    std::unique_ptr<DirectoryBackend> createConnection() const override;
+
+    using DirectoryBackend::addEntry;
+    int addEntry(const EntryView& entry, int* messageId = nullptr) override;
+    int modifyEntry(const std::string& dn, const std::vector<AttributeChange>& changes, int* messageId = nullptr) override;
+    int deleteEntry(const std::string& dn, bool treeDelete = false, int* messageId = nullptr) override;
+    int waitForResult(int& messageId, int& resultCode) override;
+
+    int search(const std::string& base, int scope, const std::string& filter, const std::vector<std::string>& attributes, size_t sizeLimit, std::vector<DirectoryEntry>& entries) override;
+    int searchPage(const std::string& base, int scope, const std::string& filter, const std::vector<std::string>& attributes, const std::string& sortAttribute, size_t pageSize, std::string& cookie, std::vector<DirectoryEntry>& entries) override;
+
+    std::string errorString(int rc) const override;
+
+private:
+    struct PendingRequest
+    {
+        Operation operation;
+        std::chrono::steady_clock::time_point sentAt;
+    };
+
+    int finishRequest(Operation operation, std::chrono::steady_clock::time_point sentAt, int rc, int* messageId);
+
+    std::unique_ptr<DirectoryBackend> backend;
+
+    // The table's nodes come from a pool that keeps them once freed, so timing a request allocates nothing once the window has filled
+    std::pmr::unsynchronized_pool_resource pendingPool;
+    std::pmr::unordered_map<int, PendingRequest> pendingRequests;
+};
+
+#endif // INSTRUMENTEDBACKEND_H
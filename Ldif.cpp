@@ -0,0 +1,428 @@
+#include "Ldif.h"
+
+#include <algorithm>            // For min
+#include "DirectorySearch.h"    // For paged searches
+
+using namespace std;
+
+// Longest line written before it is folded onto a continuation line
+static const size_t foldColumn = 76;
+
+static const char base64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Function to encode bytes as base64, appending to output
+static void encodeBase64(const char* data, size_t length, string& output)
+{
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    size_t i = 0;
+    for (; i + 2 < length; i += 3)
+    {
+        output += base64Alphabet[bytes[i] >> 2];
+        output += base64Alphabet[((bytes[i] & 0x03) << 4) | (bytes[i + 1] >> 4)];
+        output += base64Alphabet[((bytes[i + 1] & 0x0f) << 2) | (bytes[i + 2] >> 6)];
+        output += base64Alphabet[bytes[i + 2] & 0x3f];
+    }
+    if (i + 1 == length)
+    {
+        output += base64Alphabet[bytes[i] >> 2];
+        output += base64Alphabet[(bytes[i] & 0x03) << 4];
+        output += "==";
+    }
+    else if (i + 2 == length)
+    {
+        output += base64Alphabet[bytes[i] >> 2];
+        output += base64Alphabet[((bytes[i] & 0x03) << 4) | (bytes[i + 1] >> 4)];
+        output += base64Alphabet[(bytes[i + 1] & 0x0f) << 2];
+        output += '=';
+    }
+}
+
+// Function to decode base64 text, returns false if it is not valid base64
+static bool decodeBase64(const string& text, size_t start, string& output)
+{
+    output.clear();
+    unsigned int bits = 0;
+    int bitCount = 0;
+    size_t padding = 0;
+    for (size_t i = start; i < text.size(); i++)
+    {
+        char c = text[i];
+        int value;
+        if (c >= 'A' && c <= 'Z')
+        {
+            value = c - 'A';
+        }
+        else if (c >= 'a' && c <= 'z')
+        {
+            value = c - 'a' + 26;
+        }
+        else if (c >= '0' && c <= '9')
+        {
+            value = c - '0' + 52;
+        }
+        else if (c == '+')
+        {
+            value = 62;
+        }
+        else if (c == '/')
+        {
+            value = 63;
+        }
+        else if (c == '=')
+        {
+            padding++;
+            continue;
+        }
+        else if (c == ' ')
+        {
+            continue;
+        }
+        else
+        {
+            return false;
+        }
+
+        // Nothing but padding may follow padding
+        if (padding > 0)
+        {
+            return false;
+        }
+        bits = (bits << 6) | static_cast<unsigned int>(value);
+        bitCount += 6;
+        if (bitCount >= 8)
+        {
+            bitCount -= 8;
+            output += static_cast<char>((bits >> bitCount) & 0xff);
+        }
+    }
+    return padding <= 2;
+}
+
+// Function to check if a value has to be written in base64 (SAFE-STRING in RFC 2849)
+static bool needsBase64(const char* data, size_t length)
+{
+    if (length == 0)
+    {
+        return false;
+    }
+    if (data[0] == ' ' || data[0] == ':' || data[0] == '<' || data[length - 1] == ' ')
+    {
+        return true;
+    }
+    for (size_t i = 0; i < length; i++)
+    {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        if (c == 0 || c == '\n' || c == '\r' || c >= 0x80)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Function to write one "name: value" line, folding it if it is too long
+static void writeAttribute(ostream& out, string& line, const char* name, const char* data, size_t length)
+{
+    line.assign(name);
+    if (needsBase64(data, length))
+    {
+        line += ":: ";
+        encodeBase64(data, length, line);
+    }
+    else
+    {
+        line += ": ";
+        line.append(data, length);
+    }
+
+    if (line.size() <= foldColumn)
+    {
+        out << line << '\n';
+        return;
+    }
+
+    // Continuation lines start with a space that is not part of the value
+    out.write(line.data(), foldColumn);
+    for (size_t offset = foldColumn; offset < line.size(); offset += foldColumn - 1)
+    {
+        out << "\n ";
+        out.write(line.data() + offset, min(foldColumn - 1, line.size() - offset));
+    }
+    out << '\n';
+}
+
+// Function to write every entry of the ou=users subtree to a stream as LDIF (RFC 2849)
+int exportLdif(DirectoryBackend* ldap, const string& basePath, ostream& out, size_t& entryCount)
+{
+    entryCount = 0;
+    string line;
+
+    out << "version: 1\n";
+    int rc = pagedSearch(ldap, "ou=users," + basePath, LDAP_SCOPE_SUBTREE, "(objectClass=*)", vector<string>(), defaultSearchPageSize, [&](const DirectoryEntry& entry)
+    {
+        // Entries are separated by a blank line
+        out << '\n';
+        writeAttribute(out, line, "dn", entry.dn.data(), entry.dn.size());
+
+        for (const auto& attribute : entry.attributes)
+        {
+            for (const auto& value : attribute.values)
+            {
+                writeAttribute(out, line, attribute.name.c_str(), value.data(), value.size());
+            }
+        }
+
+        entryCount++;
+        return static_cast<bool>(out);
+    });
+
+    out.flush();
+    if (!out)
+    {
+        return LDAP_LOCAL_ERROR;
+    }
+    return rc;
+}
+
+// Function to split a line into an attribute name and its decoded value
+static LdifStatus parseLine(const string& line, string& name, string& value)
+{
+    size_t colon = line.find(':');
+    if (colon == string::npos || colon == 0)
+    {
+        return LdifStatus::Malformed;
+    }
+    name.assign(line, 0, colon);
+
+    size_t start = colon + 1;
+    if (start < line.size() && line[start] == ':')
+    {
+        return decodeBase64(line, start + 1, value) ? LdifStatus::Ok : LdifStatus::Malformed;
+    }
+    if (start < line.size() && line[start] == '<')
+    {
+        return LdifStatus::Unsupported;
+    }
+    while (start < line.size() && line[start] == ' ')
+    {
+        start++;
+    }
+    value.assign(line, start, string::npos);
+    return LdifStatus::Ok;
+}
+
+LdifReader::LdifReader()
+    : stream(nullptr), hasLookahead(false), lines(0), entryStart(0), versionChecked(false)
+{
+}
+
+// Function to open a file for reading, returns false if it can't be opened
+bool LdifReader::open(const string& filePath)
+{
+    close();
+
+    // The buffer has to be in place before the file is opened to take effect
+    buffer.resize(ldifBufferSize);
+    file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    file.open(filePath, ios::binary);
+    if (!file.is_open())
+    {
+        return false;
+    }
+    stream = &file;
+    return true;
+}
+
+// Function to read from a stream such as stdin instead of a file
+void LdifReader::open(istream& input)
+{
+    close();
+    stream = &input;
+}
+
+// Function to close the input
+void LdifReader::close()
+{
+    if (file.is_open())
+    {
+        file.close();
+    }
+    file.clear();
+    stream = nullptr;
+    hasLookahead = false;
+    lines = 0;
+    entryStart = 0;
+    versionChecked = false;
+}
+
+// Function to read the next physical line into the lookahead, unless one is already there
+bool LdifReader::fetchLine()
+{
+    if (hasLookahead)
+    {
+        return true;
+    }
+    if (stream == nullptr || !getline(*stream, lookahead))
+    {
+        return false;
+    }
+    if (!lookahead.empty() && lookahead.back() == '\r')
+    {
+        lookahead.pop_back();
+    }
+    hasLookahead = true;
+    return true;
+}
+
+// Function to read the next logical line, joining folded lines and skipping comments
+bool LdifReader::readLine(string& line)
+{
+    while (true)
+    {
+        if (!fetchLine())
+        {
+            return false;
+        }
+        line.swap(lookahead);
+        hasLookahead = false;
+        lines++;
+
+        // A line starting with a single space continues the previous one
+        while (fetchLine() && !lookahead.empty() && lookahead[0] == ' ')
+        {
+            line.append(lookahead, 1, string::npos);
+            hasLookahead = false;
+            lines++;
+        }
+
+        if (line.empty() || line[0] != '#')
+        {
+            return true;
+        }
+    }
+}
+
+// Function to skip the rest of an entry that could not be read
+void LdifReader::skipEntry()
+{
+    string line;
+    while (readLine(line) && !line.empty())
+    {
+    }
+}
+
+// Function to read the next entry
+LdifStatus LdifReader::next(ImportRow& row)
+{
+    row.id.clear();
+    row.dn.clear();
+    row.attributes.clear();
+
+    // Skip the blank lines between entries
+    string line;
+    do
+    {
+        if (!readLine(line))
+        {
+            return LdifStatus::EndOfFile;
+        }
+    } while (line.empty());
+    entryStart = lines;
+
+    // The file may start with a version line
+    if (!versionChecked)
+    {
+        versionChecked = true;
+        if (line.compare(0, 8, "version:") == 0)
+        {
+            do
+            {
+                if (!readLine(line))
+                {
+                    return LdifStatus::EndOfFile;
+                }
+            } while (line.empty());
+            entryStart = lines;
+        }
+    }
+
+    string name, value;
+    LdifStatus status = parseLine(line, name, value);
+    if (status == LdifStatus::Ok && !sameAttributeName(name, "dn"))
+    {
+        status = LdifStatus::Malformed;
+    }
+    if (status != LdifStatus::Ok)
+    {
+        skipEntry();
+        return status;
+    }
+    row.dn = value;
+
+    // The value of the first RDN identifies the entry in reports
+    size_t equals = row.dn.find('=');
+    size_t comma = row.dn.find(',');
+    row.id = equals == string::npos ? row.dn : row.dn.substr(equals + 1, comma == string::npos ? string::npos : comma - equals - 1);
+
+    while (readLine(line) && !line.empty())
+    {
+        status = parseLine(line, name, value);
+        if (status != LdifStatus::Ok)
+        {
+            skipEntry();
+            return status;
+        }
+
+        // Only plain entries and explicit adds can go through the add path
+        if (sameAttributeName(name, "changetype"))
+        {
+            if (value != "add")
+            {
+                skipEntry();
+                return LdifStatus::Unsupported;
+            }
+            continue;
+        }
+        if (sameAttributeName(name, "control"))
+        {
+            skipEntry();
+            return LdifStatus::Unsupported;
+        }
+
+        // Repeated attributes become one attribute with several values
+        EntryAttribute* attribute = nullptr;
+        for (auto& existing : row.attributes)
+        {
+            if (sameAttributeName(existing.name, name))
+            {
+                attribute = &existing;
+                break;
+            }
+        }
+        if (attribute == nullptr)
+        {
+            row.attributes.push_back({ name, {} });
+            attribute = &row.attributes.back();
+        }
+        attribute->values.push_back(value);
+    }
+
+    return row.attributes.empty() ? LdifStatus::Malformed : LdifStatus::Ok;
+}
+
+// Function to describe a status for error messages
+const char* LdifReader::describe(LdifStatus status)
+{
+    switch (status)
+    {
+    case LdifStatus::Ok:
+        return "OK";
+    case LdifStatus::EndOfFile:
+        return "End of file";
+    case LdifStatus::Malformed:
+        return "Malformed LDIF entry";
+    case LdifStatus::Unsupported:
+        return "Unsupported LDIF change or URL value";
+    }
+    return "Unknown error";
+}
@@ -0,0 +1,77 @@
+#ifndef LDIF_H
+#define LDIF_H
+
+#include <cstddef>          // For size_t
+#include <fstream>          // For reading files
+#include <istream>          // For streaming input
+#include <ostream>          // For streaming output
+#include <string>           // For string operations
+#include <vector>           // For the read buffer
+#include "ImportEngine.h"   // For ImportRow and the directory backend
+
+// Size of the buffers used to read and write LDIF files
+const size_t ldifBufferSize = 1 << 20;
+
+// Outcome of reading a single LDIF entry
+enum class LdifStatus
+{
+    Ok,                 // An entry was read
+    EndOfFile,          // No more entries
+    Malformed,          // A line is not a valid LDIF line or the entry has no DN
+    Unsupported         // The entry is a change other than an add, or a value is given by URL
+};
+
+// Function to write every entry of the ou=users subtree to a stream as LDIF (RFC 2849)
+// Entries are fetched one page at a time and written as they arrive, so memory use does not grow
+// with the size of the directory. Values that are not safe as plain text are written in base64.
+int exportLdif(DirectoryBackend* ldap, const std::string& basePath, std::ostream& out, size_t& entryCount);
+
+// Streaming LDIF reader
+// Each entry is returned as an ImportRow with dn and attributes set, ready for the import engine.
+// Folded lines, comments, base64 values and repeated attributes are handled; an entry that can't be
+// read is skipped so the caller can report it and carry on with the next one.
+class LdifReader
+{
+public:
+    LdifReader();
+
+    LdifReader(const LdifReader&) = delete;
+    LdifReader& operator=(const LdifReader&) = delete;
+
+    // Function to open a file for reading, returns false if it can't be opened
+    bool open(const std::string& filePath);
+
+    // Function to read from a stream such as stdin instead of a file
+    void open(std::istream& input);
+
+    // Function to close the input
+    void close();
+
+    // Function to read the next entry
+    LdifStatus next(ImportRow& row);
+
+    // Line number where the last entry read starts
+    size_t entryLine() const { return entryStart; }
+
+    // Function to describe a status for error messages
+    static const char* describe(LdifStatus status);
+
+private:
+    bool fetchLine();
+    bool readLine(std::string& line);
+    void skipEntry();
+
+    std::ifstream file;
+    std::vector<char> buffer;
+    std::istream* stream;
+
+    // Physical line read ahead to find out if the next one continues it
+    std::string lookahead;
+    bool hasLookahead;
+
+    size_t lines;
+    size_t entryStart;
+    bool versionChecked;
+};
+
+#endif // LDIF_H
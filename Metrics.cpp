@@ -0,0 +1,286 @@
+#include "Metrics.h"
+
+#include <cstdio>       // For renaming the snapshot into place
+#include <cstdlib>      // For reading the environment
+#include <fstream>      // For writing the snapshot
+
+using namespace std;
+
+// Percentiles exported for every operation
+static const double exportedPercentiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+const char* operationName(Operation operation)
+{
+    switch (operation)
+    {
+    case Operation::Bind:
+        return "bind";
+    case Operation::Search:
+        return "search";
+    case Operation::Add:
+        return "add";
+    case Operation::Modify:
+        return "modify";
+    case Operation::Delete:
+        return "delete";
+    default:
+        return "unknown";
+    }
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+// Function to find the bucket of a value, the index of its highest set bit picks the power of two
+size_t LatencyHistogram::bucketIndex(uint64_t value)
+{
+    if (value < static_cast<uint64_t>(subBucketCount))
+    {
+        return static_cast<size_t>(value);
+    }
+
+    int exponent = 0;
+    for (int step = 32; step > 0; step /= 2)
+    {
+        if (value >> (exponent + step))
+        {
+            exponent += step;
+        }
+    }
+    if (exponent > highestExponent)
+    {
+        return bucketCount - 1;
+    }
+
+    size_t subBucket = static_cast<size_t>(value >> (exponent - subBucketBits)) - subBucketCount;
+    return subBucketCount + (exponent - subBucketBits) * subBucketCount + subBucket;
+}
+
+// Function to find the largest value that falls into a bucket
+uint64_t LatencyHistogram::bucketUpperBound(size_t index)
+{
+    if (index < static_cast<size_t>(subBucketCount))
+    {
+        return index;
+    }
+
+    int shift = static_cast<int>((index - subBucketCount) / subBucketCount);
+    uint64_t subBucket = (index - subBucketCount) % subBucketCount;
+    return ((subBucketCount + subBucket + 1) << shift) - 1;
+}
+
+// Function to record one latency
+void LatencyHistogram::record(chrono::nanoseconds latency)
+{
+    uint64_t value = latency.count() > 0 ? static_cast<uint64_t>(latency.count()) : 0;
+    buckets[bucketIndex(value)].fetch_add(1, memory_order_relaxed);
+    total.fetch_add(1, memory_order_relaxed);
+    sumNs.fetch_add(value, memory_order_relaxed);
+
+    uint64_t currentMax = maxNs.load(memory_order_relaxed);
+    while (value > currentMax && !maxNs.compare_exchange_weak(currentMax, value, memory_order_relaxed))
+    {
+    }
+}
+
+// Function to forget every recorded latency
+void LatencyHistogram::reset()
+{
+    for (auto& bucket : buckets)
+    {
+        bucket.store(0, memory_order_relaxed);
+    }
+    total.store(0, memory_order_relaxed);
+    sumNs.store(0, memory_order_relaxed);
+    maxNs.store(0, memory_order_relaxed);
+}
+
+// Function to find the latency at or below which the given share (0 to 1) of recorded values fall
+chrono::nanoseconds LatencyHistogram::percentile(double share) const
+{
+    uint64_t recorded = count();
+    if (recorded == 0)
+    {
+        return chrono::nanoseconds(0);
+    }
+
+    // Rank of the value asked for, counting from 1
+    uint64_t rank = static_cast<uint64_t>(share * recorded + 0.5);
+    if (rank < 1)
+    {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    uint64_t largest = static_cast<uint64_t>(max().count());
+    for (size_t i = 0; i < bucketCount; i++)
+    {
+        seen += buckets[i].load(memory_order_relaxed);
+        if (seen >= rank)
+        {
+            uint64_t upperBound = bucketUpperBound(i);
+            return chrono::nanoseconds(upperBound < largest ? upperBound : largest);
+        }
+    }
+    return max();
+}
+
+Metrics::Metrics()
+{
+    reset();
+}
+
+// Function to record one finished operation
+void Metrics::recordOperation(Operation operation, chrono::nanoseconds elapsed, bool failed)
+{
+    size_t index = static_cast<size_t>(operation);
+    latency[index].record(elapsed);
+    if (failed)
+    {
+        errors[index].fetch_add(1, memory_order_relaxed);
+    }
+}
+
+// Function to forget everything recorded so far
+void Metrics::reset()
+{
+    for (size_t i = 0; i < static_cast<size_t>(Operation::Count); i++)
+    {
+        latency[i].reset();
+        errors[i].store(0, memory_order_relaxed);
+    }
+    roundTrips.store(0, memory_order_relaxed);
+    entriesReturned.store(0, memory_order_relaxed);
+    csvBytesRead.store(0, memory_order_relaxed);
+    writeRetries.store(0, memory_order_relaxed);
+    windowDecreases.store(0, memory_order_relaxed);
+    reconnects.store(0, memory_order_relaxed);
+    reconnectNanoseconds.store(0, memory_order_relaxed);
+    replayedRequests.store(0, memory_order_relaxed);
+}
+
+// Function to convert a latency to seconds for export
+static double toSeconds(chrono::nanoseconds latency)
+{
+    return chrono::duration<double>(latency).count();
+}
+
+// Function to write every metric in the Prometheus text exposition format
+void Metrics::writePrometheus(ostream& out) const
+{
+    out << "# HELP ldap_client_operation_duration_seconds Time from sending a request to reading its reply.\n";
+    out << "# TYPE ldap_client_operation_duration_seconds summary\n";
+    for (size_t i = 0; i < static_cast<size_t>(Operation::Count); i++)
+    {
+        const char* name = operationName(static_cast<Operation>(i));
+        for (double share : exportedPercentiles)
+        {
+            out << "ldap_client_operation_duration_seconds{operation=\"" << name << "\",quantile=\"" << share << "\"} " << toSeconds(latency[i].percentile(share)) << "\n";
+        }
+        out << "ldap_client_operation_duration_seconds_sum{operation=\"" << name << "\"} " << toSeconds(latency[i].sum()) << "\n";
+        out << "ldap_client_operation_duration_seconds_count{operation=\"" << name << "\"} " << latency[i].count() << "\n";
+    }
+
+    out << "# HELP ldap_client_operation_errors_total Requests that failed or were answered with an error.\n";
+    out << "# TYPE ldap_client_operation_errors_total counter\n";
+    for (size_t i = 0; i < static_cast<size_t>(Operation::Count); i++)
+    {
+        out << "ldap_client_operation_errors_total{operation=\"" << operationName(static_cast<Operation>(i)) << "\"} " << errors[i].load(memory_order_relaxed) << "\n";
+    }
+
+    out << "# HELP ldap_client_round_trips_total Requests sent to the server, one per page of a paged search.\n";
+    out << "# TYPE ldap_client_round_trips_total counter\n";
+    out << "ldap_client_round_trips_total " << roundTrips.load(memory_order_relaxed) << "\n";
+    out << "# HELP ldap_client_entries_returned_total Entries returned by searches.\n";
+    out << "# TYPE ldap_client_entries_returned_total counter\n";
+    out << "ldap_client_entries_returned_total " << entriesReturned.load(memory_order_relaxed) << "\n";
+    out << "# HELP ldap_client_csv_bytes_read_total Bytes of CSV input read by imports and syncs.\n";
+    out << "# TYPE ldap_client_csv_bytes_read_total counter\n";
+    out << "ldap_client_csv_bytes_read_total " << csvBytesRead.load(memory_order_relaxed) << "\n";
+    out << "# HELP ldap_client_write_retries_total Writes sent again after the server answered busy or unavailable.\n";
+    out << "# TYPE ldap_client_write_retries_total counter\n";
+    out << "ldap_client_write_retries_total " << writeRetries.load(memory_order_relaxed) << "\n";
+    out << "# HELP ldap_client_window_decreases_total Times a connection shrank its window of writes in flight.\n";
+    out << "# TYPE ldap_client_window_decreases_total counter\n";
+    out << "ldap_client_window_decreases_total " << windowDecreases.load(memory_order_relaxed) << "\n";
+    out << "# HELP ldap_client_reconnects_total Times a lost connection was opened and bound again.\n";
+    out << "# TYPE ldap_client_reconnects_total counter\n";
+    out << "ldap_client_reconnects_total " << reconnects.load(memory_order_relaxed) << "\n";
+    out << "# HELP ldap_client_reconnect_seconds_total Time spent reconnecting, including attempts that failed.\n";
+    out << "# TYPE ldap_client_reconnect_seconds_total counter\n";
+    out << "ldap_client_reconnect_seconds_total " << toSeconds(chrono::nanoseconds(reconnectNanoseconds.load(memory_order_relaxed))) << "\n";
+    out << "# HELP ldap_client_replayed_requests_total Requests sent again after their connection was restored.\n";
+    out << "# TYPE ldap_client_replayed_requests_total counter\n";
+    out << "ldap_client_replayed_requests_total " << replayedRequests.load(memory_order_relaxed) << "\n";
+}
+
+// Function to write every metric as a JSON object
+void Metrics::writeJson(ostream& out) const
+{
+    out << "{ \"operations\": {";
+    for (size_t i = 0; i < static_cast<size_t>(Operation::Count); i++)
+    {
+        out << (i > 0 ? ", " : " ") << "\"" << operationName(static_cast<Operation>(i)) << "\": { \"count\": " << latency[i].count()
+            << ", \"errors\": " << errors[i].load(memory_order_relaxed)
+            << ", \"p50Us\": " << latency[i].percentile(0.5).count() / 1000.0
+            << ", \"p99Us\": " << latency[i].percentile(0.99).count() / 1000.0
+            << ", \"p999Us\": " << latency[i].percentile(0.999).count() / 1000.0
+            << ", \"maxUs\": " << latency[i].max().count() / 1000.0 << " }";
+    }
+    out << " }, \"roundTrips\": " << roundTrips.load(memory_order_relaxed)
+        << ", \"entriesReturned\": " << entriesReturned.load(memory_order_relaxed)
+        << ", \"csvBytesRead\": " << csvBytesRead.load(memory_order_relaxed)
+        << ", \"writeRetries\": " << writeRetries.load(memory_order_relaxed)
+        << ", \"windowDecreases\": " << windowDecreases.load(memory_order_relaxed)
+        << ", \"reconnects\": " << reconnects.load(memory_order_relaxed)
+        << ", \"reconnectSeconds\": " << toSeconds(chrono::nanoseconds(reconnectNanoseconds.load(memory_order_relaxed)))
+        << ", \"replayedRequests\": " << replayedRequests.load(memory_order_relaxed) << " }";
+}
+
+// Function to get the metrics of this process
+Metrics& metrics()
+{
+    static Metrics processMetrics;
+    return processMetrics;
+}
+
+// Function to write the metrics to the file named by the LDAP_METRICS_FILE environment variable
+bool writeMetricsSnapshot()
+{
+    const char* path = getenv("LDAP_METRICS_FILE");
+    if (path == nullptr || *path == '\0')
+    {
+        return true;
+    }
+
+    string target = path;
+    string temporary = target + ".tmp";
+    {
+        ofstream out(temporary);
+        if (!out)
+        {
+            return false;
+        }
+        if (target.size() >= 5 && target.compare(target.size() - 5, 5, ".json") == 0)
+        {
+            metrics().writeJson(out);
+            out << "\n";
+        }
+        else
+        {
+            metrics().writePrometheus(out);
+        }
+        if (!out)
+        {
+            return false;
+        }
+    }
+
+#ifdef _WIN32
+    // Windows won't rename over an existing file
+    remove(target.c_str());
+#endif
+    return rename(temporary.c_str(), target.c_str()) == 0;
+}
@@ -0,0 +1,353 @@
+#include "OpenLdapBackend.h"
+
+using namespace std;
+
+// Null-terminated LDAPMod array pointing into the caller's strings
+// One is kept per connection and cleared between requests, so once it has grown to the largest entry
+// sent, building a request needs no memory allocation. Room is reserved up front so the pointers between
+// the vectors stay valid while it is built.
+struct OpenLdapBackend::ModList
+{
+    vector<berval> values;
+    vector<berval*> valuePointers;
+    vector<LDAPMod> modifications;
+    vector<LDAPMod*> mods;
+
+    // Function to empty the array and make room for the given number of attributes and values
+    void reset(size_t attributeCount, size_t valueCount)
+    {
+        values.clear();
+        valuePointers.clear();
+        modifications.clear();
+        mods.clear();
+        values.reserve(valueCount);
+        valuePointers.reserve(valueCount + attributeCount);
+        modifications.reserve(attributeCount);
+        mods.reserve(attributeCount + 1);
+    }
+
+    // Function to add one attribute, values are sent as binary so they may hold any bytes
+    template <typename Value>
+    void add(int operation, const char* name, const Value* attributeValues, size_t valueCount)
+    {
+        size_t firstValue = valuePointers.size();
+        for (size_t i = 0; i < valueCount; i++)
+        {
+            const Value& value = attributeValues[i];
+            berval bv;
+            bv.bv_len = value.size();
+            bv.bv_val = const_cast<char*>(value.data());
+            values.push_back(bv);
+            valuePointers.push_back(&values.back());
+        }
+        valuePointers.push_back(nullptr);
+
+        LDAPMod modification;
+        modification.mod_op = operation | LDAP_MOD_BVALUES;
+        modification.mod_type = const_cast<char*>(name);
+        modification.mod_bvalues = valueCount == 0 ? nullptr : &valuePointers[firstValue];
+        modifications.push_back(modification);
+        mods.push_back(&modifications.back());
+    }
+
+    // Function to end the array, returns it ready for the request
+    LDAPMod** finish()
+    {
+        mods.push_back(nullptr);
+        return mods.data();
+    }
+};
+
+// Function to build the null-terminated attribute list of a search
+static vector<char*> attributeList(const vector<string>& attributes)
+{
+    vector<char*> list;
+    list.reserve(attributes.size() + 1);
+    for (const auto& attribute : attributes)
+    {
+        list.push_back(const_cast<char*>(attribute.c_str()));
+    }
+    list.push_back(nullptr);
+    return list;
+}
+
+// Function to copy the entries of a search result
+static void readEntries(LDAP* ldap, LDAPMessage* result, vector<DirectoryEntry>& entries)
+{
+    for (LDAPMessage* entry = ldap_first_entry(ldap, result); entry != nullptr; entry = ldap_next_entry(ldap, entry))
+    {
+        DirectoryEntry directoryEntry;
+        char* dn = ldap_get_dn(ldap, entry);
+        if (dn)
+        {
+            directoryEntry.dn = dn;
+            ldap_memfree(dn);
+        }
+
+        BerElement* ber = nullptr;
+        for (char* attribute = ldap_first_attribute(ldap, entry, &ber); attribute != nullptr; attribute = ldap_next_attribute(ldap, entry, ber))
+        {
+            EntryAttribute entryAttribute;
+            entryAttribute.name = attribute;
+            berval** values = ldap_get_values_len(ldap, entry, attribute);
+            for (size_t i = 0; values != nullptr && values[i] != nullptr; i++)
+            {
+                entryAttribute.values.emplace_back(values[i]->bv_val, values[i]->bv_len);
+            }
+            if (values)
+            {
+                ldap_value_free_len(values);
+            }
+            ldap_memfree(attribute);
+            directoryEntry.attributes.push_back(move(entryAttribute));
+        }
+        if (ber)
+        {
+            ber_free(ber, 0);
+        }
+
+        entries.push_back(move(directoryEntry));
+    }
+}
+
+OpenLdapBackend::OpenLdapBackend()
+    : ldap(nullptr), mods(new ModList())
+{
+}
+
+OpenLdapBackend::~OpenLdapBackend()
+{
+    close();
+}
+
+// Function to open a connection using LDAP version 3
+int OpenLdapBackend::open(const string& host, int port)
+{
+    close();
+
+    // libldap connects lazily, so errors in reaching the server show up on the first request
+    string url = "ldap://" + host + ":" + to_string(port);
+    int rc = ldap_initialize(&ldap, url.c_str());
+    if (rc != LDAP_SUCCESS)
+    {
+        ldap = nullptr;
+        return rc;
+    }
+
+    int version = LDAP_VERSION3;
+    rc = ldap_set_option(ldap, LDAP_OPT_PROTOCOL_VERSION, &version);
+    if (rc != LDAP_SUCCESS)
+    {
+        close();
+    }
+    return rc;
+}
+
+// Function to bind with a simple username and password
+int OpenLdapBackend::bind(const string& username, const string& password)
+{
+    berval credentials;
+    credentials.bv_len = password.size();
+    credentials.bv_val = const_cast<char*>(password.data());
+    return ldap_sasl_bind_s(ldap, username.c_str(), LDAP_SASL_SIMPLE, &credentials, nullptr, nullptr, nullptr);
+}
+
+// Function to unbind and close the connection
+void OpenLdapBackend::close()
+{
+    if (ldap != nullptr)
+    {
+        ldap_unbind_ext_s(ldap, nullptr, nullptr);
+        ldap = nullptr;
+    }
+}
+
+// Function to create another, unopened backend of the same kind that talks to the same directory
+unique_ptr<DirectoryBackend> OpenLdapBackend::createConnection() const
+{
+    return unique_ptr<DirectoryBackend>(new OpenLdapBackend());
+}
+
+// Function to add an entry without copying it
+int OpenLdapBackend::addEntry(const EntryView& entry, int* messageId)
+{
+    size_t valueCount = 0;
+    for (size_t i = 0; i < entry.attributeCount; i++)
+    {
+        valueCount += entry.attributes[i].valueCount;
+    }
+    mods->reset(entry.attributeCount, valueCount);
+    for (size_t i = 0; i < entry.attributeCount; i++)
+    {
+        mods->add(LDAP_MOD_ADD, entry.attributes[i].name, entry.attributes[i].values, entry.attributes[i].valueCount);
+    }
+
+    if (messageId == nullptr)
+    {
+        return ldap_add_ext_s(ldap, entry.dn, mods->finish(), nullptr, nullptr);
+    }
+    return ldap_add_ext(ldap, entry.dn, mods->finish(), nullptr, nullptr, messageId);
+}
+
+// Function to modify an entry
+int OpenLdapBackend::modifyEntry(const string& dn, const vector<AttributeChange>& changes, int* messageId)
+{
+    size_t valueCount = 0;
+    for (const auto& change : changes)
+    {
+        valueCount += change.values.size();
+    }
+    mods->reset(changes.size(), valueCount);
+    for (const auto& change : changes)
+    {
+        mods->add(change.operation, change.name.c_str(), change.values.data(), change.values.size());
+    }
+
+    if (messageId == nullptr)
+    {
+        return ldap_modify_ext_s(ldap, dn.c_str(), mods->finish(), nullptr, nullptr);
+    }
+    return ldap_modify_ext(ldap, dn.c_str(), mods->finish(), nullptr, nullptr, messageId);
+}
+
+// Function to delete an entry, together with its children when treeDelete is set
+int OpenLdapBackend::deleteEntry(const string& dn, bool treeDelete, int* messageId)
+{
+    LDAPControl treeDeleteControl;
+    treeDeleteControl.ldctl_oid = const_cast<char*>(treeDeleteControlOid);
+    treeDeleteControl.ldctl_value.bv_len = 0;
+    treeDeleteControl.ldctl_value.bv_val = nullptr;
+    treeDeleteControl.ldctl_iscritical = 1;
+    LDAPControl* serverControls[] = { &treeDeleteControl, nullptr };
+    LDAPControl** controls = treeDelete ? serverControls : nullptr;
+
+    if (messageId == nullptr)
+    {
+        return ldap_delete_ext_s(ldap, dn.c_str(), controls, nullptr);
+    }
+    return ldap_delete_ext(ldap, dn.c_str(), controls, nullptr, messageId);
+}
+
+// Function to wait for the reply to any outstanding request
+int OpenLdapBackend::waitForResult(int& messageId, int& resultCode)
+{
+    LDAPMessage* message = nullptr;
+    int messageType = ldap_result(ldap, LDAP_RES_ANY, LDAP_MSG_ALL, nullptr, &message);
+    if (messageType <= 0 || message == nullptr)
+    {
+        ldap_msgfree(message);
+        int rc = LDAP_SUCCESS;
+        ldap_get_option(ldap, LDAP_OPT_RESULT_CODE, &rc);
+        return rc != LDAP_SUCCESS ? rc : LDAP_TIMEOUT;
+    }
+
+    messageId = ldap_msgid(message);
+    int rc = ldap_parse_result(ldap, message, &resultCode, nullptr, nullptr, nullptr, nullptr, 1);
+    if (rc != LDAP_SUCCESS)
+    {
+        resultCode = rc;
+    }
+    return LDAP_SUCCESS;
+}
+
+// Function to run a search and copy its entries, the result is kept for reading its controls
+int OpenLdapBackend::runSearch(const string& base, int scope, const string& filter, const vector<string>& attributes, size_t sizeLimit, LDAPControl** serverControls, vector<DirectoryEntry>& entries, LDAPMessage*& result)
+{
+    vector<char*> attrs = attributeList(attributes);
+    result = nullptr;
+    entries.clear();
+
+    int rc = ldap_search_ext_s(ldap, base.c_str(), scope, filter.c_str(), attributes.empty() ? nullptr : attrs.data(),
+                               0, serverControls, nullptr, nullptr, static_cast<int>(sizeLimit), &result);
+    if (result != nullptr)
+    {
+        readEntries(ldap, result, entries);
+    }
+    return rc;
+}
+
+// Function to search for matching entries, at most sizeLimit of them unless it is 0
+int OpenLdapBackend::search(const string& base, int scope, const string& filter, const vector<string>& attributes, size_t sizeLimit, vector<DirectoryEntry>& entries)
+{
+    LDAPMessage* result = nullptr;
+    int rc = runSearch(base, scope, filter, attributes, sizeLimit, nullptr, entries, result);
+    ldap_msgfree(result);
+    return rc;
+}
+
+// Function to read one page of a search with the Simple Paged Results control
+int OpenLdapBackend::searchPage(const string& base, int scope, const string& filter, const vector<string>& attributes, const string& sortAttribute, size_t pageSize, string& cookie, vector<DirectoryEntry>& entries)
+{
+    berval cookieValue;
+    cookieValue.bv_len = cookie.size();
+    cookieValue.bv_val = const_cast<char*>(cookie.data());
+    LDAPControl* pageControl = nullptr;
+    int rc = ldap_create_page_control(ldap, static_cast<ber_int_t>(pageSize), cookie.empty() ? nullptr : &cookieValue, 0, &pageControl);
+    if (rc != LDAP_SUCCESS)
+    {
+        return rc;
+    }
+
+    // The sort control goes with every page, the server keeps the sorted result set for the cookie
+    LDAPControl* sortControl = nullptr;
+    if (!sortAttribute.empty())
+    {
+        LDAPSortKey sortKey;
+        sortKey.attributeType = const_cast<char*>(sortAttribute.c_str());
+        sortKey.orderingRule = nullptr;
+        sortKey.reverseOrder = 0;
+        LDAPSortKey* sortKeys[] = { &sortKey, nullptr };
+        rc = ldap_create_sort_control(ldap, sortKeys, 1, &sortControl);
+        if (rc != LDAP_SUCCESS)
+        {
+            ldap_control_free(pageControl);
+            return rc;
+        }
+    }
+
+    LDAPControl* serverControls[] = { pageControl, sortControl, nullptr };
+    LDAPMessage* result = nullptr;
+    rc = runSearch(base, scope, filter, attributes, 0, serverControls, entries, result);
+    ldap_control_free(pageControl);
+    if (sortControl != nullptr)
+    {
+        ldap_control_free(sortControl);
+    }
+    cookie.clear();
+
+    // Read the cookie for the next page, servers without paging support simply don't return one
+    if (result != nullptr)
+    {
+        int resultCode = LDAP_SUCCESS;
+        LDAPControl** responseControls = nullptr;
+        if (ldap_parse_result(ldap, result, &resultCode, nullptr, nullptr, nullptr, &responseControls, 0) == LDAP_SUCCESS)
+        {
+            rc = resultCode;
+        }
+        LDAPControl* pageResponse = responseControls != nullptr ? ldap_control_find(LDAP_CONTROL_PAGEDRESULTS, responseControls, nullptr) : nullptr;
+        if (pageResponse != nullptr)
+        {
+            ber_int_t totalCount = 0;
+            berval nextCookie;
+            nextCookie.bv_len = 0;
+            nextCookie.bv_val = nullptr;
+            if (ldap_parse_pageresponse_control(ldap, pageResponse, &totalCount, &nextCookie) == LDAP_SUCCESS && nextCookie.bv_val != nullptr)
+            {
+                cookie.assign(nextCookie.bv_val, nextCookie.bv_len);
+                ber_memfree(nextCookie.bv_val);
+            }
+        }
+        if (responseControls != nullptr)
+        {
+            ldap_controls_free(responseControls);
+        }
+    }
+    ldap_msgfree(result);
+    return rc;
+}
+
+// Function to describe a result code for error messages
+string OpenLdapBackend::errorString(int rc) const
+{
+    return ldap_err2string(rc);
+}
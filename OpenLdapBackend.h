@@ -0,0 +1,43 @@
+#ifndef OPENLDAPBACKEND_H
+#define OPENLDAPBACKEND_H
+
+#include "DirectoryBackend.h"   // For the backend interface
+
+// Directory backend built on the OpenLDAP client library (libldap)
+class OpenLdapBackend : public DirectoryBackend
+{
+public:
+    OpenLdapBackend();
+    ~OpenLdapBackend();
+
+    OpenLdapBackend(const OpenLdapBackend&) = delete;
+    OpenLdapBackend& operator=(const OpenLdapBackend&) = delete;
+
+    int open(const std::string& host, int port) override;
+    int bind(const std::string& username, const std::string& password) override;
+    void close() override;
+    std::unique_ptr<DirectoryBackend> createConnection() const override;
+
+    using DirectoryBackend::addEntry;
+    int addEntry(const EntryView& entry, int* messageId = nullptr) override;
+    int modifyEntry(const std::string& dn, const std::vector<AttributeChange>& changes, int* messageId = nullptr) override;
+    int deleteEntry(const std::string& dn, bool treeDelete = false, int* messageId = nullptr) override;
+    int waitForResult(int& messageId, int& resultCode) override;
+
+    int search(const std::string& base, int scope, const std::string& filter, const std::vector<std::string>& attributes, size_t sizeLimit, std::vector<DirectoryEntry>& entries) override;
+    int searchPage(const std::string& base, int scope, const std::string& filter, const std::vector<std::string>& attributes, const std::string& sortAttribute, size_t pageSize, std::string& cookie, std::vector<DirectoryEntry>& entries) override;
+
+    std::string errorString(int rc) const override;
+
+private:
+    struct ModList;
+
+    int runSearch(const std::string& base, int scope, const std::string& filter, const std::vector<std::string>& attributes, size_t sizeLimit, LDAPControl** serverControls, std::vector<DirectoryEntry>& entries, LDAPMessage*& result);
+
+    LDAP* ldap;
+
+    // Reused for every add and modify sent on this connection
+    std::unique_ptr<ModList> mods;
+};
+
+#endif // OPENLDAPBACKEND_H
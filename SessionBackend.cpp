@@ -0,0 +1,524 @@
+#include "SessionBackend.h"
+
+#include <algorithm>    // For sorting requests to replay
+#include <cstring>      // For copying lengths and names
+#include <iostream>     // For reporting reconnects
+#include <string_view>  // For the values of a replayed entry
+
+using namespace std;
+
+// Function to append a length to a flattened entry
+static void appendLength(string& flat, size_t length)
+{
+    flat.append(reinterpret_cast<const char*>(&length), sizeof(length));
+}
+
+// Function to read a length from a flattened entry
+static size_t readLength(const string& flat, size_t& position)
+{
+    size_t length = 0;
+    memcpy(&length, flat.data() + position, sizeof(length));
+    position += sizeof(length);
+    return length;
+}
+
+// Function to copy the attributes of an entry into one string, reusing its memory
+// The attribute count comes first, then each name with its terminating null and each value, all after their lengths.
+static void flattenEntry(const EntryView& entry, string& flat)
+{
+    size_t size = sizeof(size_t);
+    for (size_t i = 0; i < entry.attributeCount; i++)
+    {
+        size += 2 * sizeof(size_t) + strlen(entry.attributes[i].name) + 1;
+        for (size_t j = 0; j < entry.attributes[i].valueCount; j++)
+        {
+            size += sizeof(size_t) + entry.attributes[i].values[j].size();
+        }
+    }
+
+    flat.clear();
+    flat.reserve(size);
+    appendLength(flat, entry.attributeCount);
+    for (size_t i = 0; i < entry.attributeCount; i++)
+    {
+        const AttributeView& attribute = entry.attributes[i];
+        size_t nameLength = strlen(attribute.name);
+        appendLength(flat, nameLength);
+        flat.append(attribute.name, nameLength + 1);
+        appendLength(flat, attribute.valueCount);
+        for (size_t j = 0; j < attribute.valueCount; j++)
+        {
+            appendLength(flat, attribute.values[j].size());
+            flat.append(attribute.values[j].data(), attribute.values[j].size());
+        }
+    }
+}
+
+// Function to add an entry that was flattened by flattenEntry()
+static int addFlattenedEntry(DirectoryBackend* backend, const string& dn, const string& flat, int* messageId)
+{
+    size_t position = 0;
+    size_t attributeCount = readLength(flat, position);
+    vector<AttributeView> attributes(attributeCount);
+    vector<size_t> firstValues(attributeCount);
+    vector<string_view> values;
+
+    for (size_t i = 0; i < attributeCount; i++)
+    {
+        size_t nameLength = readLength(flat, position);
+        attributes[i].name = flat.data() + position;
+        position += nameLength + 1;
+        attributes[i].valueCount = readLength(flat, position);
+        firstValues[i] = values.size();
+        for (size_t j = 0; j < attributes[i].valueCount; j++)
+        {
+            size_t valueLength = readLength(flat, position);
+            values.emplace_back(flat.data() + position, valueLength);
+            position += valueLength;
+        }
+    }
+
+    // The values have all been read, so they won't move any more
+    for (size_t i = 0; i < attributeCount; i++)
+    {
+        attributes[i].values = values.data() + firstValues[i];
+    }
+    return backend->addEntry(EntryView{ dn.c_str(), attributes.data(), attributes.size() }, messageId);
+}
+
+SessionBackend::SessionBackend(unique_ptr<DirectoryBackend> backend, chrono::seconds keepaliveInterval)
+    : backend(move(backend)), keepaliveInterval(keepaliveInterval), port(0), bound(false), slotsByBackendId(&slotPool), nextMessageId(1), failedWaits(0),
+      lastActivity(chrono::steady_clock::now()), stopping(false)
+{
+    if (keepaliveInterval.count() > 0)
+    {
+        keepaliveThread = thread(&SessionBackend::runKeepalive, this);
+    }
+}
+
+SessionBackend::~SessionBackend()
+{
+    {
+        lock_guard<mutex> lock(keepaliveMutex);
+        stopping = true;
+    }
+    keepaliveWake.notify_all();
+    if (keepaliveThread.joinable())
+    {
+        keepaliveThread.join();
+    }
+}
+
+int SessionBackend::open(const string& newHost, int newPort)
+{
+    lock_guard<mutex> lock(sessionMutex);
+    releaseAllRequests();
+    bound = false;
+    host = newHost;
+    port = newPort;
+    return backend->open(host, port);
+}
+
+int SessionBackend::bind(const string& newUsername, const string& newPassword)
+{
+    lock_guard<mutex> lock(sessionMutex);
+    lastActivity = chrono::steady_clock::now();
+    int rc = backend->bind(newUsername, newPassword);
+    if (rc == LDAP_SUCCESS)
+    {
+        username = newUsername;
+        password = newPassword;
+        bound = true;
+    }
+    return rc;
+}
+
+void SessionBackend::close()
+{
+    lock_guard<mutex> lock(sessionMutex);
+    bound = false;
+    releaseAllRequests();
+    backend->close();
+}
+
+unique_ptr<DirectoryBackend> SessionBackend::createConnection() const
+{
+    return unique_ptr<DirectoryBackend>(new SessionBackend(backend->createConnection(), keepaliveInterval));
+}
+
+// Function to open and bind the connection again and send every outstanding request again
+// Returns false once maxReconnectAttempts attempts have failed, the outstanding requests are then dropped.
+bool SessionBackend::reconnect()
+{
+    if (!bound)
+    {
+        return false;
+    }
+
+    auto startTime = chrono::steady_clock::now();
+    chrono::milliseconds delay = reconnectDelay;
+    int rc = LDAP_SUCCESS;
+    for (unsigned int attempt = 0; attempt < maxReconnectAttempts; attempt++)
+    {
+        if (attempt > 0)
+        {
+            this_thread::sleep_for(delay);
+            delay *= 2;
+        }
+
+        backend->close();
+        rc = backend->open(host, port);
+        if (rc == LDAP_SUCCESS)
+        {
+            rc = backend->bind(username, password);
+        }
+        if (rc != LDAP_SUCCESS)
+        {
+            continue;
+        }
+
+        // Requests the server never answered go out again in the order they were first sent
+        slotsByBackendId.clear();
+        failedReplays.clear();
+        vector<size_t> replayOrder;
+        for (size_t slot = 0; slot < requests.size(); slot++)
+        {
+            if (requests[slot].inUse)
+            {
+                replayOrder.push_back(slot);
+            }
+        }
+        sort(replayOrder.begin(), replayOrder.end(), [this](size_t a, size_t b) { return requests[a].callerId < requests[b].callerId; });
+        for (size_t slot : replayOrder)
+        {
+            requests[slot].replayed = true;
+            int backendId = 0;
+            rc = send(requests[slot], &backendId);
+            if (connectionLost(rc))
+            {
+                break;
+            }
+            if (rc != LDAP_SUCCESS)
+            {
+                failedReplays.emplace_back(slot, rc);
+            }
+            else
+            {
+                slotsByBackendId[backendId] = slot;
+            }
+        }
+        if (connectionLost(rc))
+        {
+            continue;
+        }
+
+        chrono::nanoseconds elapsed = chrono::steady_clock::now() - startTime;
+        metrics().reconnects.fetch_add(1, memory_order_relaxed);
+        metrics().reconnectNanoseconds.fetch_add(elapsed.count(), memory_order_relaxed);
+        metrics().replayedRequests.fetch_add(replayOrder.size(), memory_order_relaxed);
+        // Written in one piece, since the connections of an import may reconnect at the same time
+        cerr << ("Warning: The connection to the server was lost and has been restored in "
+                 + to_string(chrono::duration_cast<chrono::milliseconds>(elapsed).count()) + " ms, "
+                 + to_string(replayOrder.size()) + " requests were sent again.\n") << flush;
+        return true;
+    }
+
+    cerr << ("Warning: The connection to the server was lost and could not be restored: " + backend->errorString(rc) + "\n") << flush;
+    metrics().reconnectNanoseconds.fetch_add(chrono::nanoseconds(chrono::steady_clock::now() - startTime).count(), memory_order_relaxed);
+    releaseAllRequests();
+    bound = false;
+    return false;
+}
+
+// Function to send an outstanding request to the wrapped backend
+int SessionBackend::send(const OutstandingRequest& request, int* messageId)
+{
+    switch (request.operation)
+    {
+    case Operation::Add:
+        return addFlattenedEntry(backend.get(), request.dn, request.entry, messageId);
+    case Operation::Modify:
+        return backend->modifyEntry(request.dn, request.changes, messageId);
+    default:
+        return backend->deleteEntry(request.dn, request.treeDelete, messageId);
+    }
+}
+
+// Function to take a free slot for a request about to be sent, adding one while every slot is in use
+size_t SessionBackend::takeRequest(Operation operation)
+{
+    size_t slot = requests.size();
+    if (freeRequests.empty())
+    {
+        requests.emplace_back();
+    }
+    else
+    {
+        slot = freeRequests.back();
+        freeRequests.pop_back();
+    }
+
+    OutstandingRequest& request = requests[slot];
+    request.operation = operation;
+    request.treeDelete = false;
+    request.replayed = false;
+    request.inUse = true;
+    return slot;
+}
+
+// Function to give back the slot of a request that was answered or will never be
+void SessionBackend::releaseRequest(size_t slot)
+{
+    requests[slot].inUse = false;
+    freeRequests.push_back(slot);
+}
+
+// Function to forget every outstanding request, once none of their replies can arrive
+void SessionBackend::releaseAllRequests()
+{
+    slotsByBackendId.clear();
+    failedReplays.clear();
+    failedWaits = 0;
+    for (size_t slot = 0; slot < requests.size(); slot++)
+    {
+        if (requests[slot].inUse)
+        {
+            releaseRequest(slot);
+        }
+    }
+}
+
+// Function to count the requests sent and not yet answered
+size_t SessionBackend::outstandingCount() const
+{
+    return requests.size() - freeRequests.size();
+}
+
+// Function to remember a request that was only sent, reconnecting first if sending it found the connection gone
+int SessionBackend::track(int rc, int backendId, size_t slot, int* messageId)
+{
+    if (rc != LDAP_SUCCESS && !connectionLost(rc))
+    {
+        releaseRequest(slot);
+        return rc;
+    }
+
+    int callerId = nextMessageId++;
+    requests[slot].callerId = callerId;
+    if (rc == LDAP_SUCCESS)
+    {
+        slotsByBackendId[backendId] = slot;
+    }
+    else if (!reconnect())
+    {
+        releaseAllRequests();
+        return rc;
+    }
+    *messageId = callerId;
+    return LDAP_SUCCESS;
+}
+
+int SessionBackend::addEntry(const EntryView& entry, int* messageId)
+{
+    lock_guard<mutex> lock(sessionMutex);
+    lastActivity = chrono::steady_clock::now();
+
+    if (messageId == nullptr)
+    {
+        // A request that can't be sent is tried once more on a new connection
+        int rc = backend->addEntry(entry);
+        if (connectionLost(rc) && reconnect())
+        {
+            rc = backend->addEntry(entry);
+            rc = rc == LDAP_ALREADY_EXISTS ? LDAP_SUCCESS : rc;
+        }
+        return rc;
+    }
+
+    // The entry is only valid during this call, so it is copied into the slot in case it has to be sent again
+    size_t slot = takeRequest(Operation::Add);
+    requests[slot].dn.assign(entry.dn);
+    flattenEntry(entry, requests[slot].entry);
+    int backendId = 0;
+    int rc = backend->addEntry(entry, &backendId);
+    return track(rc, backendId, slot, messageId);
+}
+
+int SessionBackend::modifyEntry(const string& dn, const vector<AttributeChange>& changes, int* messageId)
+{
+    lock_guard<mutex> lock(sessionMutex);
+    lastActivity = chrono::steady_clock::now();
+
+    int backendId = 0;
+    int rc = backend->modifyEntry(dn, changes, messageId == nullptr ? nullptr : &backendId);
+    if (messageId == nullptr)
+    {
+        if (connectionLost(rc) && reconnect())
+        {
+            rc = backend->modifyEntry(dn, changes);
+        }
+        return rc;
+    }
+
+    size_t slot = takeRequest(Operation::Modify);
+    requests[slot].dn.assign(dn);
+    requests[slot].changes = changes;
+    return track(rc, backendId, slot, messageId);
+}
+
+int SessionBackend::deleteEntry(const string& dn, bool treeDelete, int* messageId)
+{
+    lock_guard<mutex> lock(sessionMutex);
+    lastActivity = chrono::steady_clock::now();
+
+    int backendId = 0;
+    int rc = backend->deleteEntry(dn, treeDelete, messageId == nullptr ? nullptr : &backendId);
+    if (messageId == nullptr)
+    {
+        if (connectionLost(rc) && reconnect())
+        {
+            rc = backend->deleteEntry(dn, treeDelete);
+            rc = rc == LDAP_NO_SUCH_OBJECT ? LDAP_SUCCESS : rc;
+        }
+        return rc;
+    }
+
+    size_t slot = takeRequest(Operation::Delete);
+    requests[slot].dn.assign(dn);
+    requests[slot].treeDelete = treeDelete;
+    return track(rc, backendId, slot, messageId);
+}
+
+int SessionBackend::waitForResult(int& messageId, int& resultCode)
+{
+    lock_guard<mutex> lock(sessionMutex);
+    lastActivity = chrono::steady_clock::now();
+
+    while (true)
+    {
+        // Requests that couldn't be sent again are answered with the error they got
+        if (!failedReplays.empty())
+        {
+            size_t slot = failedReplays.front().first;
+            messageId = requests[slot].callerId;
+            resultCode = failedReplays.front().second;
+            failedReplays.pop_front();
+            releaseRequest(slot);
+            return LDAP_SUCCESS;
+        }
+
+        int backendId = 0;
+        int rc = backend->waitForResult(backendId, resultCode);
+        if (rc != LDAP_SUCCESS)
+        {
+            // Replies may still come after an error that isn't a lost connection, unless the errors keep coming
+            bool lost = connectionLost(rc);
+            if (!lost && ++failedWaits % maxFailedWaits != 0)
+            {
+                return rc;
+            }
+
+            // A connection whose replies still can't be read after being restored several times is given up on
+            if (failedWaits < maxFailedWaits * maxReconnectAttempts && outstandingCount() > 0 && reconnect())
+            {
+                continue;
+            }
+
+            // Nothing will be answered any more, which the caller is told with an error that says so
+            releaseAllRequests();
+            return lost ? rc : LDAP_SERVER_DOWN;
+        }
+        failedWaits = 0;
+
+        auto found = slotsByBackendId.find(backendId);
+        if (found == slotsByBackendId.end())
+        {
+            continue;
+        }
+        size_t slot = found->second;
+        slotsByBackendId.erase(found);
+
+        // A replayed request may have been applied the first time it was sent
+        const OutstandingRequest& request = requests[slot];
+        if (request.replayed)
+        {
+            if ((request.operation == Operation::Add && resultCode == LDAP_ALREADY_EXISTS) ||
+                (request.operation == Operation::Delete && resultCode == LDAP_NO_SUCH_OBJECT))
+            {
+                resultCode = LDAP_SUCCESS;
+            }
+        }
+        messageId = request.callerId;
+        releaseRequest(slot);
+        return LDAP_SUCCESS;
+    }
+}
+
+int SessionBackend::search(const string& base, int scope, const string& filter, const vector<string>& attributes, size_t sizeLimit, vector<DirectoryEntry>& entries)
+{
+    lock_guard<mutex> lock(sessionMutex);
+    lastActivity = chrono::steady_clock::now();
+
+    int rc = backend->search(base, scope, filter, attributes, sizeLimit, entries);
+    if (connectionLost(rc) && reconnect())
+    {
+        rc = backend->search(base, scope, filter, attributes, sizeLimit, entries);
+    }
+    return rc;
+}
+
+int SessionBackend::searchPage(const string& base, int scope, const string& filter, const vector<string>& attributes, const string& sortAttribute, size_t pageSize, string& cookie, vector<DirectoryEntry>& entries)
+{
+    lock_guard<mutex> lock(sessionMutex);
+    lastActivity = chrono::steady_clock::now();
+
+    // Only the first page can be asked for again, a cookie means nothing to a new connection
+    int rc = backend->searchPage(base, scope, filter, attributes, sortAttribute, pageSize, cookie, entries);
+    if (connectionLost(rc))
+    {
+        bool firstPage = cookie.empty();
+        if (reconnect() && firstPage)
+        {
+            rc = backend->searchPage(base, scope, filter, attributes, sortAttribute, pageSize, cookie, entries);
+        }
+    }
+    return rc;
+}
+
+string SessionBackend::errorString(int rc) const
+{
+    return backend->errorString(rc);
+}
+
+// Function run by the keepalive thread, sending a cheap search whenever the connection has been idle too long
+void SessionBackend::runKeepalive()
+{
+    unique_lock<mutex> wakeLock(keepaliveMutex);
+    while (!stopping)
+    {
+        // Checking twice per interval keeps an idle connection from going much longer than it without a request
+        keepaliveWake.wait_for(wakeLock, chrono::duration_cast<chrono::milliseconds>(keepaliveInterval) / 2);
+        if (stopping)
+        {
+            break;
+        }
+        wakeLock.unlock();
+
+        // A connection in use doesn't need keeping alive, and mustn't be used by two threads
+        {
+            unique_lock<mutex> lock(sessionMutex, try_to_lock);
+            if (lock.owns_lock() && bound && outstandingCount() == 0 && chrono::steady_clock::now() - lastActivity >= keepaliveInterval)
+            {
+                vector<DirectoryEntry> entries;
+                int rc = backend->search("", LDAP_SCOPE_BASE, "(objectClass=*)", { "1.1" }, 0, entries);
+                if (connectionLost(rc))
+                {
+                    reconnect();
+                }
+                lastActivity = chrono::steady_clock::now();
+            }
+        }
+
+        wakeLock.lock();
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef SESSIONBACKEND_H
+#define SESSIONBACKEND_H
+
+#include <chrono>               // For the keepalive interval
+#include <condition_variable>   // For waking the keepalive thread
+#include <deque>                // For replies of requests that couldn't be sent again
+#include <memory_resource>      // For recycling the nodes of the message ID table
+#include <mutex>                // For sharing the connection with the keepalive thread
+#include <string>               // For the connection details
+#include <thread>               // For the keepalive thread
+#include <unordered_map>        // For translating message IDs
+#include <utility>              // For pairs of requests and results
+#include <vector>               // For outstanding requests and modify changes
+#include "DirectoryBackend.h"   // For the backend interface
+#include "Metrics.h"            // For the kind of each request
+
+// Time a connection may sit idle before a keepalive request is sent on it
+const std::chrono::seconds defaultKeepaliveInterval(60);
+
+// Number of times a lost connection is opened and bound again before giving up
+const unsigned int maxReconnectAttempts = 5;
+
+// Delay before the second attempt to reconnect, doubled for each further attempt
+const std::chrono::milliseconds reconnectDelay(200);
+
+// Number of waitForResult() errors in a row after which the connection is handled as lost
+const unsigned int maxFailedWaits = 3;
+
+// Directory backend that keeps the connection of the backend it wraps alive across failures
+// When a request fails because the connection was lost, the connection is opened and bound again
+// with the details of the last successful open and bind, and every request that was still waiting
+// for its reply is sent again. Callers keep the message IDs they were given. A replayed add that finds
+// its entry already there, or a replayed delete that finds it gone, is reported as a success, since
+// the first attempt was most likely applied before the connection went down. A paged search can't
+// carry on over a new connection, so a page lost with the connection fails after reconnecting.
+// waitForResult() only returns a connectionLost() error once the connection couldn't be restored, and
+// every outstanding request is then forgotten. Other errors leave them waiting for their replies, unless
+// maxFailedWaits of them come in a row, when the connection is reconnected as if it had been lost, up to
+// maxReconnectAttempts times before it is given up on.
+// While the connection is idle, a root DSE search is sent every keepaliveInterval so load balancers
+// and firewalls don't cut it; an interval of zero turns this off.
+// Like any backend, a SessionBackend is used by one thread at a time; its lock only keeps the keepalive
+// thread off the connection. Every request holds that lock while it runs, waitForResult() included, so a
+// search started from another thread waits until the next reply has been read.
+class SessionBackend : public DirectoryBackend
+{
+public:
+    explicit SessionBackend(std::unique_ptr<DirectoryBackend> backend, std::chrono::seconds keepaliveInterval = defaultKeepaliveInterval);
+    ~SessionBackend();
+
+    SessionBackend(const SessionBackend&) = delete;
+    SessionBackend& operator=(const SessionBackend&) = delete;
+
+    int open(const std::string& host, int port) override;
+    int bind(const std::string& username, const std::string& password) override;
+    void close() override;
+    std::unique_ptr<DirectoryBackend> createConnection() const override;
+
+    using DirectoryBackend::addEntry;
+    int addEntry(const EntryView& entry, int* messageId = nullptr) override;
+    int modifyEntry(const std::string& dn, const std::vector<AttributeChange>& changes, int* messageId = nullptr) override;
+    int deleteEntry(const std::string& dn, bool treeDelete = false, int* messageId = nullptr) override;
+    int waitForResult(int& messageId, int& resultCode) override;
+
+    int search(const std::string& base, int scope, const std::string& filter, const std::vector<std::string>& attributes, size_t sizeLimit, std::vector<DirectoryEntry>& entries) override;
+    int searchPage(const std::string& base, int scope, const std::string& filter, const std::vector<std::string>& attributes, const std::string& sortAttribute, size_t pageSize, std::string& cookie, std::vector<DirectoryEntry>& entries) override;
+
+    std::string errorString(int rc) const override;
+
+private:
+    // A request that was sent and not yet answered, kept so it can be sent again
+    // An add keeps its entry flattened into one string. Slots are reused once their reply has been read and
+    // keep the memory of their strings, so once the window has filled remembering an add allocates nothing.
+    struct OutstandingRequest
+    {
+        Operation operation = Operation::Add;
+        int callerId = 0;
+        std::string dn;
+        std::string entry;
+        std::vector<AttributeChange> changes;
+        bool treeDelete = false;
+        bool replayed = false;
+        bool inUse = false;
+    };
+
+    bool reconnect();
+    int send(const OutstandingRequest& request, int* messageId);
+    size_t takeRequest(Operation operation);
+    void releaseRequest(size_t slot);
+    void releaseAllRequests();
+    size_t outstandingCount() const;
+    int track(int rc, int backendId, size_t slot, int* messageId);
+    void runKeepalive();
+
+    std::unique_ptr<DirectoryBackend> backend;
+    std::chrono::seconds keepaliveInterval;
+
+    // Details of the last successful open and bind, used to reconnect
+    std::string host;
+    int port;
+    std::string username;
+    std::string password;
+    bool bound;
+
+    // Slots of outstanding requests, the free ones, and the slot of each request by the backend's message ID
+    // The table's nodes come from a pool that keeps them once freed, so it stops allocating as well.
+    std::vector<OutstandingRequest> requests;
+    std::vector<size_t> freeRequests;
+    std::pmr::unsynchronized_pool_resource slotPool;
+    std::pmr::unordered_map<int, size_t> slotsByBackendId;
+    std::deque<std::pair<size_t, int>> failedReplays;
+    int nextMessageId;
+    unsigned int failedWaits;
+
+    // Held by every request, so the keepalive thread never uses the connection at the same time
+    std::mutex sessionMutex;
+    std::chrono::steady_clock::time_point lastActivity;
+
+    std::mutex keepaliveMutex;
+    std::condition_variable keepaliveWake;
+    bool stopping;
+    std::thread keepaliveThread;
+};
+
+#endif // SESSIONBACKEND_H
@@ -0,0 +1,222 @@
+#include "TenantImport.h"
+
+#include <algorithm>            // For max
+#include <chrono>               // For timing each tenant
+#include <thread>               // For reading the files at the same time
+#include "CsvImport.h"          // For reading the rows of each file
+#include "CsvParser.h"          // For reading the manifest
+#include "CsvValidation.h"      // For checking each file before anything is sent
+
+using namespace std;
+
+// Function to check if a file path is absolute, on Unix or Windows
+static bool isAbsolutePath(const string& path)
+{
+    return (!path.empty() && (path[0] == '/' || path[0] == '\\')) || (path.size() > 1 && path[1] == ':');
+}
+
+// Function to read a manifest of import files
+bool loadImportManifest(const string& manifestPath, vector<TenantFeed>& feeds, string& error)
+{
+    CsvReader manifest;
+    if (!manifest.open(manifestPath))
+    {
+        error = "The manifest " + manifestPath + " can't be opened";
+        return false;
+    }
+
+    CsvRecord record;
+    CsvStatus status = manifest.next(record);
+    if (status != CsvStatus::Ok || record.fields.size() != 2 || record.fields[0] != "file" || record.fields[1] != "base_path")
+    {
+        error = "The manifest " + manifestPath + " doesn't start with the header file,base_path";
+        return false;
+    }
+
+    // Relative paths are found next to the manifest, wherever the program is run from
+    size_t slash = manifestPath.find_last_of("/\\");
+    string directory = slash == string::npos ? string() : manifestPath.substr(0, slash + 1);
+
+    feeds.clear();
+    while ((status = manifest.next(record)) != CsvStatus::EndOfFile)
+    {
+        string line = to_string(manifest.recordNumber());
+        if (status != CsvStatus::Ok)
+        {
+            error = "Line " + line + " of the manifest " + manifestPath + " can't be read: " + CsvReader::describe(status);
+            return false;
+        }
+        // A base path that wasn't quoted is split at its commas, so the columns after the file are joined again
+        TenantFeed feed;
+        feed.filePath.assign(record.fields[0]);
+        for (size_t i = 1; i < record.fields.size(); i++)
+        {
+            if (i > 1)
+            {
+                feed.basePath += ',';
+            }
+            feed.basePath.append(record.fields[i]);
+        }
+        if (feed.filePath.empty() || feed.basePath.empty())
+        {
+            error = "Line " + line + " of the manifest " + manifestPath + " needs both a file and a base path";
+            return false;
+        }
+        if (!isAbsolutePath(feed.filePath))
+        {
+            feed.filePath = directory + feed.filePath;
+        }
+        feeds.push_back(move(feed));
+    }
+    if (feeds.empty())
+    {
+        error = "The manifest " + manifestPath + " lists no import files";
+        return false;
+    }
+    return true;
+}
+
+// Function to get the path of the report of the tenant on the given line of the manifest
+string tenantReportPath(const string& reportPath, size_t tenant)
+{
+    size_t slash = reportPath.find_last_of("/\\");
+    size_t dot = reportPath.rfind('.');
+    if (dot == string::npos || (slash != string::npos && dot < slash))
+    {
+        dot = reportPath.size();
+    }
+    return reportPath.substr(0, dot) + "-" + to_string(tenant) + reportPath.substr(dot);
+}
+
+// Function to import the users of every tenant at once over one set of connections
+void importTenants(DirectoryBackend* ldap, const LDAPConnectionSettings& settings, const vector<TenantFeed>& feeds, const TenantImportOptions& options, vector<TenantImportResult>& results)
+{
+    results.clear();
+    results.resize(feeds.size());
+    vector<CsvValidationResult> validations(feeds.size());
+
+    // Every file is checked, on all cores, before the first row of any of them is sent
+    vector<size_t> importedFeeds;
+    for (size_t i = 0; i < feeds.size(); i++)
+    {
+        TenantImportResult& result = results[i];
+        result.report.reset(new ImportReport());
+        string reportPath = tenantReportPath(options.reportPath, i + 1);
+        if (!result.report->open(reportPath))
+        {
+            result.error = "the report file " + reportPath + " can't be created";
+            result.skipped = true;
+            continue;
+        }
+        if (!validateCsvFile(feeds[i].filePath, 0, validations[i]))
+        {
+            result.error = "the file " + feeds[i].filePath + " can't be opened";
+            result.skipped = true;
+        }
+        else if (!validations[i].headerValid)
+        {
+            result.error = "the file " + feeds[i].filePath + " is empty or its CSV header is incorrect";
+            result.skipped = true;
+        }
+        else
+        {
+            size_t rejectedRows = recordCsvIssues(validations[i], *result.report);
+            if (rejectedRows > 0 && !options.skipInvalid)
+            {
+                result.error = to_string(rejectedRows) + " of " + to_string(validations[i].rowCount) + " rows can't be added";
+                result.skipped = true;
+            }
+        }
+
+        if (result.skipped)
+        {
+            result.report->close();
+        }
+        else
+        {
+            importedFeeds.push_back(i);
+        }
+    }
+    if (importedFeeds.empty())
+    {
+        return;
+    }
+
+    ImportEngine engine(ldap, settings, options.connections, options.window);
+    vector<size_t> engineTenants(feeds.size());
+    for (size_t i : importedFeeds)
+    {
+        engineTenants[i] = engine.addTenant(feeds[i].basePath, *results[i].report);
+    }
+    engine.start();
+    auto startTime = chrono::steady_clock::now();
+
+    // Each file is read by its own thread, which waits only while its own tenant's queue is full
+    vector<thread> readers;
+    for (size_t i : importedFeeds)
+    {
+        readers.emplace_back([&, i]()
+        {
+            CsvReader file;
+            if (!file.open(feeds[i].filePath))
+            {
+                results[i].error = "the file " + feeds[i].filePath + " can't be opened";
+                return;
+            }
+            CsvImportOptions importOptions;
+            importOptions.tenant = engineTenants[i];
+            importOptions.validation = &validations[i];
+            CsvImportResult importResult = submitCsvRows(file, engine, importOptions);
+            if (importResult.status != CsvImportStatus::Complete)
+            {
+                results[i].error = describeCsvImport(importResult);
+            }
+        });
+    }
+    for (auto& reader : readers)
+    {
+        reader.join();
+    }
+    engine.finish();
+
+    for (size_t i : importedFeeds)
+    {
+        TenantImportResult& result = results[i];
+        result.report->close();
+        if (result.report->addedCount() > 0 || result.report->failedCount() > 0)
+        {
+            result.seconds = max(0.0, chrono::duration<double>(result.report->lastOutcomeTime() - startTime).count());
+        }
+    }
+}
+
+// Function to print the users added and failed, the time taken and the throughput of every tenant
+void printTenantResults(ostream& out, const vector<TenantFeed>& feeds, const vector<TenantImportResult>& results)
+{
+    for (size_t i = 0; i < feeds.size() && i < results.size(); i++)
+    {
+        const TenantImportResult& result = results[i];
+        out << "Tenant " << i + 1 << " (" << feeds[i].basePath << ", " << feeds[i].filePath << "): ";
+        if (result.skipped)
+        {
+            out << "not imported, " << result.error << "." << endl;
+        }
+        else
+        {
+            out << "imported " << result.report->addedCount() << " users in " << result.seconds << " seconds";
+            if (result.seconds > 0)
+            {
+                out << " (" << static_cast<size_t>(result.report->addedCount() / result.seconds) << " users/sec)";
+            }
+            out << ", " << result.report->failedCount() << " failed." << endl;
+            if (!result.error.empty())
+            {
+                out << "Error: " << result.error << "." << endl;
+            }
+        }
+        if (result.report)
+        {
+            result.report->printSummary(out);
+        }
+    }
+}
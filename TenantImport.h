@@ -0,0 +1,67 @@
+#ifndef TENANTIMPORT_H
+#define TENANTIMPORT_H
+
+#include <cstddef>              // For size_t
+#include <memory>               // For owning the report of each tenant
+#include <ostream>              // For printing the results
+#include <string>               // For string operations
+#include <vector>               // For the feeds and their results
+#include "DirectoryBackend.h"   // For directory operations
+#include "ImportEngine.h"       // For the default connections and window
+#include "ImportReport.h"       // For the outcome of each tenant
+
+// An import file whose users are added under ou=users of a base path
+struct TenantFeed
+{
+    std::string filePath;
+    std::string basePath;
+};
+
+// Options of importing several tenants at once
+struct TenantImportOptions
+{
+    // Connections and add requests in flight per connection, shared by every tenant
+    size_t connections = defaultImportConnections;
+    size_t window = defaultImportWindow;
+
+    // The report of each tenant is written next to this path, numbered after the tenant's line in the manifest
+    std::string reportPath = defaultReportPath;
+
+    // Whether the valid rows of a file with rows that can't be added are imported, otherwise none of its rows are
+    bool skipInvalid = false;
+};
+
+// Outcome of importing one tenant
+struct TenantImportResult
+{
+    // Why nothing of the tenant was imported, or why reading its file stopped, empty when it was read to the end
+    std::string error;
+    bool skipped = false;
+
+    // Seconds from the start of the import to the last user of the tenant being answered
+    double seconds = 0;
+
+    // Users added and failed, with the rows rejected before the import counted as failed
+    std::unique_ptr<ImportReport> report;
+};
+
+// Function to read a manifest of import files, returns false and sets error if it can't be read
+// The manifest is a CSV file with the columns file,base_path and one line per tenant. The base path may be
+// left unquoted, everything after the file is taken as the base path. File paths that are not absolute are
+// taken from the directory of the manifest.
+bool loadImportManifest(const std::string& manifestPath, std::vector<TenantFeed>& feeds, std::string& error);
+
+// Function to get the path of the report of the tenant on the given line of the manifest, such as ExitFile-3.csv
+std::string tenantReportPath(const std::string& reportPath, size_t tenant);
+
+// Function to import the users of every tenant at once over one set of connections, with a result per feed
+// Every file is checked before anything is sent, and a file that can't be read or, without skipInvalid,
+// has rows that can't be added is skipped with its rows listed in its report. The other files are read
+// at the same time, each by its own thread, into a queue per tenant that the connections take batches
+// from in turn, so a small tenant finishes in about the time its own rows take however large the others are.
+void importTenants(DirectoryBackend* ldap, const LDAPConnectionSettings& settings, const std::vector<TenantFeed>& feeds, const TenantImportOptions& options, std::vector<TenantImportResult>& results);
+
+// Function to print the users added and failed, the time taken and the throughput of every tenant
+void printTenantResults(std::ostream& out, const std::vector<TenantFeed>& feeds, const std::vector<TenantImportResult>& results);
+
+#endif // TENANTIMPORT_H
@@ -0,0 +1,281 @@
+#include "UserCache.h"
+
+#include <unordered_set>        // For the deleted-user sweep
+#include "DirectorySearch.h"    // For paged searches
+
+using namespace std;
+
+// How often the cache polls the server for changed users
+static const chrono::seconds refreshInterval(30);
+
+// How often the cache sweeps for users deleted by other clients
+static const chrono::minutes sweepInterval(5);
+
+// Filter matching the users managed by this application
+static const string userFilter = "(objectClass=inetOrgPerson)";
+
+// Attributes kept for every cached user, in display order
+static const char* const cachedAttributes[] = { "cn", "sn", "givenName", "mail", "ou", "telephoneNumber", "description" };
+
+// Function to check if a user ID is made of digits only
+static bool isNumericId(const string& id)
+{
+    if (id.empty())
+    {
+        return false;
+    }
+    for (char c : id)
+    {
+        if (c < '0' || c > '9')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool UserIdLess::operator()(const string& a, const string& b) const
+{
+    bool aNumeric = isNumericId(a);
+    bool bNumeric = isNumericId(b);
+    if (aNumeric != bNumeric)
+    {
+        return aNumeric;
+    }
+    if (aNumeric)
+    {
+        size_t aStart = a.find_first_not_of('0');
+        size_t bStart = b.find_first_not_of('0');
+        size_t aLength = aStart == string::npos ? 0 : a.size() - aStart;
+        size_t bLength = bStart == string::npos ? 0 : b.size() - bStart;
+        if (aLength != bLength)
+        {
+            return aLength < bLength;
+        }
+        int order = a.compare(a.size() - aLength, aLength, b, b.size() - bLength, bLength);
+        if (order != 0)
+        {
+            return order < 0;
+        }
+    }
+    return a < b;
+}
+
+// Function to take the user ID out of a DN of the form cn=<id>,ou=users,...
+static string idFromDN(const string& dn)
+{
+    if (dn.compare(0, 3, "cn=") != 0)
+    {
+        return string();
+    }
+    return dn.substr(3, dn.find(',') - 3);
+}
+
+// Attributes read for every cached user, the cached ones plus the change timestamp
+static const vector<string> searchedAttributes = { "cn", "sn", "givenName", "mail", "ou", "telephoneNumber", "description", "modifyTimestamp" };
+
+// Function to read a user from a search result entry
+static CachedUser readUser(const DirectoryEntry& entry, string& id)
+{
+    CachedUser user;
+    user.dn = entry.dn;
+
+    for (const char* attribute : cachedAttributes)
+    {
+        const string* value = entry.firstValue(attribute);
+        if (value)
+        {
+            user.attributes.emplace_back(attribute, *value);
+        }
+    }
+
+    const string* timestamp = entry.firstValue("modifyTimestamp");
+    if (timestamp)
+    {
+        user.modifyTimestamp = *timestamp;
+    }
+
+    id = !user.attributes.empty() && user.attributes[0].first == "cn" ? user.attributes[0].second : idFromDN(user.dn);
+    return user;
+}
+
+UserCache::UserCache(DirectoryBackend* ldap, const string& basePath)
+    : ldap(ldap), searchBase("ou=users," + basePath), loaded(false), hitCount(0), missCount(0)
+{
+}
+
+// Function to load every user and start tracking changes
+int UserCache::load()
+{
+    clear();
+
+    int rc = pagedSearch(ldap, searchBase, LDAP_SCOPE_ONELEVEL, userFilter, searchedAttributes, defaultSearchPageSize, [this](const DirectoryEntry& entry)
+    {
+        string id;
+        CachedUser user = readUser(entry, id);
+        store(move(user), id);
+        return true;
+    });
+
+    // A missing ou=users simply means there are no users yet
+    if (rc != LDAP_SUCCESS && rc != LDAP_NO_SUCH_OBJECT)
+    {
+        clear();
+        return rc;
+    }
+
+    loaded = true;
+    lastRefresh = chrono::steady_clock::now();
+    lastSweep = lastRefresh;
+    return LDAP_SUCCESS;
+}
+
+// Function to drop every cached user and stop using the cache
+void UserCache::clear()
+{
+    loaded = false;
+    byId.clear();
+    byCn.clear();
+    newestTimestamp.clear();
+}
+
+// Function to apply changes made on the server, at most once per refresh interval unless forced
+int UserCache::refresh(bool force)
+{
+    if (!loaded)
+    {
+        return LDAP_SUCCESS;
+    }
+
+    auto now = chrono::steady_clock::now();
+    if (!force && now - lastRefresh < refreshInterval)
+    {
+        return LDAP_SUCCESS;
+    }
+
+    // Without a timestamp to poll from, the only way to catch up is to load everything again
+    if (newestTimestamp.empty())
+    {
+        return load();
+    }
+
+    // The newest entry is returned again by >=, which keeps changes made within the same second
+    string filter = "(&" + userFilter + "(modifyTimestamp>=" + newestTimestamp + "))";
+    int rc = pagedSearch(ldap, searchBase, LDAP_SCOPE_ONELEVEL, filter, searchedAttributes, defaultSearchPageSize, [this](const DirectoryEntry& entry)
+    {
+        string id;
+        CachedUser user = readUser(entry, id);
+        store(move(user), id);
+        return true;
+    });
+    if (rc != LDAP_SUCCESS && rc != LDAP_NO_SUCH_OBJECT)
+    {
+        return rc;
+    }
+    lastRefresh = now;
+
+    if (force || now - lastSweep >= sweepInterval)
+    {
+        rc = sweepDeletedUsers();
+    }
+    return rc;
+}
+
+// Function to drop cached users that no longer exist on the server, listing DNs only
+int UserCache::sweepDeletedUsers()
+{
+    unordered_set<string> present;
+    present.reserve(byCn.size());
+
+    int rc = pagedSearch(ldap, searchBase, LDAP_SCOPE_ONELEVEL, userFilter, noAttributes, defaultSearchPageSize, [&present](const DirectoryEntry& entry)
+    {
+        present.insert(idFromDN(entry.dn));
+        return true;
+    });
+    if (rc != LDAP_SUCCESS && rc != LDAP_NO_SUCH_OBJECT)
+    {
+        return rc;
+    }
+
+    for (auto user = byCn.begin(); user != byCn.end();)
+    {
+        if (present.count(user->first) == 0)
+        {
+            byId.erase(user->first);
+            user = byCn.erase(user);
+        }
+        else
+        {
+            ++user;
+        }
+    }
+
+    lastSweep = chrono::steady_clock::now();
+    return LDAP_SUCCESS;
+}
+
+// Function to find a user by ID, counting a hit or a miss
+const CachedUser* UserCache::find(const string& id)
+{
+    refresh();
+
+    auto user = byCn.find(id);
+    if (user == byCn.end())
+    {
+        missCount++;
+        return nullptr;
+    }
+    hitCount++;
+    return &user->second;
+}
+
+// Function to record a user added by this application
+void UserCache::recordAdd(const ImportRow& row)
+{
+    if (!loaded)
+    {
+        return;
+    }
+
+    string firstName, lastName;
+    splitFullName(row.fullName, firstName, lastName);
+
+    CachedUser user;
+    user.dn = "cn=" + row.id + "," + searchBase;
+    user.attributes = { { "cn", row.id }, { "sn", lastName }, { "givenName", firstName }, { "mail", row.email },
+                        { "ou", row.department }, { "telephoneNumber", row.phoneNumber }, { "description", row.jobDescription } };
+    store(move(user), row.id);
+}
+
+// Function to record a user deleted by this application
+void UserCache::recordDelete(const string& id)
+{
+    erase(id);
+}
+
+// Function to record that every user was deleted by this application
+void UserCache::recordDeleteAll()
+{
+    byId.clear();
+    byCn.clear();
+}
+
+// Function to add or replace a user in both indexes
+void UserCache::store(CachedUser&& user, const string& id)
+{
+    if (user.modifyTimestamp > newestTimestamp)
+    {
+        newestTimestamp = user.modifyTimestamp;
+    }
+
+    CachedUser& stored = byCn[id];
+    stored = move(user);
+    byId[id] = &stored;
+}
+
+// Function to remove a user from both indexes
+void UserCache::erase(const string& id)
+{
+    byId.erase(id);
+    byCn.erase(id);
+}
@@ -0,0 +1,89 @@
+#ifndef USERCACHE_H
+#define USERCACHE_H
+
+#include <chrono>           // For refresh intervals
+#include <map>              // For the sorted index
+#include <string>           // For string operations
+#include <unordered_map>    // For the hash index
+#include <utility>          // For attribute/value pairs
+#include <vector>           // For storing attributes
+#include "ImportEngine.h"   // For ImportRow and the directory backend
+
+// Structure to store a user held in the local cache
+struct CachedUser
+{
+    std::string dn;
+    std::string modifyTimestamp;
+    std::vector<std::pair<std::string, std::string>> attributes;
+};
+
+// Orders user IDs numerically when both are numbers, so 2 sorts before 10
+struct UserIdLess
+{
+    bool operator()(const std::string& a, const std::string& b) const;
+};
+
+// Optional client-side copy of the ou=users subtree
+// Users are loaded once with a paged search and then kept fresh by polling for entries whose
+// modifyTimestamp is at or after the newest one seen, plus a periodic attribute-less sweep that
+// notices users deleted by other clients. Adds and deletes made by this application update the
+// cache in place.
+class UserCache
+{
+public:
+    UserCache(DirectoryBackend* ldap, const std::string& basePath);
+
+    // Function to load every user and start tracking changes
+    int load();
+
+    // Function to drop every cached user and stop using the cache
+    void clear();
+
+    // Function to check if the cache has been loaded
+    bool isLoaded() const { return loaded; }
+
+    // Function to apply changes made on the server, at most once per refresh interval unless forced
+    int refresh(bool force = false);
+
+    // Function to find a user by ID, counting a hit or a miss
+    const CachedUser* find(const std::string& id);
+
+    // Function to record a user added by this application
+    void recordAdd(const ImportRow& row);
+
+    // Function to record a user deleted by this application
+    void recordDelete(const std::string& id);
+
+    // Function to record that every user was deleted by this application
+    void recordDeleteAll();
+
+    // Users ordered by ID
+    const std::map<std::string, const CachedUser*, UserIdLess>& sortedById() const { return byId; }
+
+    size_t size() const { return byCn.size(); }
+    size_t hits() const { return hitCount; }
+    size_t misses() const { return missCount; }
+
+private:
+    void store(CachedUser&& user, const std::string& id);
+    void erase(const std::string& id);
+    int sweepDeletedUsers();
+
+    DirectoryBackend* ldap;
+    std::string searchBase;
+    bool loaded;
+
+    // Hash index by cn, and sorted index by ID pointing into it
+    std::unordered_map<std::string, CachedUser> byCn;
+    std::map<std::string, const CachedUser*, UserIdLess> byId;
+
+    // Newest modifyTimestamp seen, in the server's own clock
+    std::string newestTimestamp;
+    std::chrono::steady_clock::time_point lastRefresh;
+    std::chrono::steady_clock::time_point lastSweep;
+
+    size_t hitCount;
+    size_t missCount;
+};
+
+#endif // USERCACHE_H
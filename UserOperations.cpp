@@ -0,0 +1,393 @@
+#include "UserOperations.h"
+
+#include <algorithm>            // For min
+#include <cctype>               // For tolower
+#include <chrono>               // For timing bulk operations
+#include <iostream>             // For console output
+#include "DirectorySearch.h"    // For paged searches
+
+using namespace std;
+
+// Function to check if an LDAP user exists
+bool userExists(DirectoryBackend* ldap, const string& userDN)
+{
+    vector<DirectoryEntry> entries;
+
+    // Search for the user in the LDAP directory
+    int rc = ldap->search(userDN, LDAP_SCOPE_BASE, "(objectClass=inetOrgPerson)", noAttributes, 0, entries);
+
+    return rc == LDAP_SUCCESS && !entries.empty();
+}
+
+// Function to send one delete request, waiting for a slot when writes are rate limited
+// Entries the server can't take now are scheduled to be sent again, other failures are recorded
+static void sendLDAPDelete(DirectoryBackend* ldap, PendingDelete&& request, map<int, PendingDelete>& pendingDeletes, FlowController& flow, RetryQueue<PendingDelete>& retries, size_t& failedCount, int& lastError)
+{
+    writeRateLimiter().acquire();
+
+    int messageId = 0;
+    int rc = ldap->deleteEntry(request.dn, request.treeDelete, &messageId);
+    if (rc == LDAP_SUCCESS)
+    {
+        request.sentAt = chrono::steady_clock::now();
+        pendingDeletes[messageId] = move(request);
+        return;
+    }
+
+    if (isTransientResult(rc))
+    {
+        flow.recordBusy();
+        if (retries.retry(request, flow))
+        {
+            return;
+        }
+    }
+    cerr << "Failed to delete user with DN '" << request.dn << "': " << ldap->errorString(rc) << endl;
+    lastError = rc;
+    failedCount++;
+}
+
+// Function to wait for the reply to one outstanding delete request and record its outcome
+// Entries that still have children are sent again with the tree-delete control when the server supports it
+bool collectLDAPDeleteResult(DirectoryBackend* ldap, map<int, PendingDelete>& pendingDeletes, FlowController& flow, RetryQueue<PendingDelete>& retries, bool treeDeleteSupported, size_t& deletedCount, size_t& failedCount, int& lastError)
+{
+    int messageId = 0;
+    int rc = LDAP_SUCCESS;
+    int waitRc = ldap->waitForResult(messageId, rc);
+
+    // Only a lost connection takes the pending deletes with it, after any other error their replies may still come
+    if (waitRc != LDAP_SUCCESS)
+    {
+        if (!connectionLost(waitRc))
+        {
+            return false;
+        }
+        lastError = waitRc;
+        cerr << "Lost the replies to " << pendingDeletes.size() << " delete requests: " << ldap->errorString(lastError) << endl;
+        failedCount += pendingDeletes.size();
+        pendingDeletes.clear();
+        return false;
+    }
+
+    auto pending = pendingDeletes.find(messageId);
+    if (pending == pendingDeletes.end())
+    {
+        return true;
+    }
+
+    PendingDelete request = move(pending->second);
+    pendingDeletes.erase(pending);
+
+    // A busy server gets fewer requests in flight and the entry again later
+    if (isTransientResult(rc))
+    {
+        flow.recordBusy();
+        if (retries.retry(request, flow))
+        {
+            return true;
+        }
+    }
+    else
+    {
+        flow.recordReply(chrono::steady_clock::now() - request.sentAt);
+    }
+
+    if (rc == LDAP_NOT_ALLOWED_ON_NONLEAF && treeDeleteSupported && !request.treeDelete)
+    {
+        request.treeDelete = true;
+        sendLDAPDelete(ldap, move(request), pendingDeletes, flow, retries, failedCount, lastError);
+        return true;
+    }
+
+    if (rc != LDAP_SUCCESS)
+    {
+        cerr << "Failed to delete user with DN '" << request.dn << "': " << ldap->errorString(rc) << endl;
+        lastError = rc;
+        failedCount++;
+    }
+    else
+    {
+        deletedCount++;
+    }
+    return true;
+}
+
+// Function to delete all LDAP users under a specific path
+// Users are listed a page at a time and deleted with a window of asynchronous requests, so memory stays constant
+int deleteAllLDAPUsers(DirectoryBackend* ldap, const string& basePath)
+{
+    int rc = LDAP_SUCCESS;
+    int lastError = LDAP_SUCCESS;
+
+    string filter = "(objectClass=inetOrgPerson)";
+
+    // Construct the search base
+    string searchBase = "ou=users," + basePath;
+
+    bool treeDeleteSupported = serverSupportsControl(ldap, treeDeleteControlOid);
+    map<int, PendingDelete> pendingDeletes;
+    RetryQueue<PendingDelete> retries;
+    FlowController flow(defaultDeleteWindow);
+    size_t foundCount = 0;
+    size_t deletedCount = 0;
+    size_t failedCount = 0;
+    auto startTime = chrono::steady_clock::now();
+
+    // Function to send the entries whose retry is due, waiting for a reply whenever the window is full
+    auto sendDueRetries = [&]()
+    {
+        PendingDelete retry;
+        while (retries.takeDue(retry))
+        {
+            while (pendingDeletes.size() >= flow.window())
+            {
+                collectLDAPDeleteResult(ldap, pendingDeletes, flow, retries, treeDeleteSupported, deletedCount, failedCount, lastError);
+            }
+            sendLDAPDelete(ldap, move(retry), pendingDeletes, flow, retries, failedCount, lastError);
+        }
+    };
+
+    // Search for all users under the specified base path and delete each one as it is returned
+    rc = pagedSearch(ldap, searchBase, LDAP_SCOPE_ONELEVEL, filter, noAttributes, defaultSearchPageSize, [&](const DirectoryEntry& entry)
+    {
+        foundCount++;
+        sendDueRetries();
+
+        // Wait for a reply once the window of outstanding deletes is full
+        while (pendingDeletes.size() >= flow.window())
+        {
+            collectLDAPDeleteResult(ldap, pendingDeletes, flow, retries, treeDeleteSupported, deletedCount, failedCount, lastError);
+        }
+
+        PendingDelete request;
+        request.dn = entry.dn;
+        sendLDAPDelete(ldap, move(request), pendingDeletes, flow, retries, failedCount, lastError);
+        return true;
+    });
+
+    // Collect the replies to the deletes that are still outstanding, and send the ones still to be retried
+    while (!pendingDeletes.empty() || !retries.empty())
+    {
+        if (pendingDeletes.empty())
+        {
+            retries.waitForNext();
+        }
+        sendDueRetries();
+        if (!pendingDeletes.empty())
+        {
+            collectLDAPDeleteResult(ldap, pendingDeletes, flow, retries, treeDeleteSupported, deletedCount, failedCount, lastError);
+        }
+    }
+
+    if (rc != LDAP_SUCCESS)
+    {
+        cerr << "LDAP search failed: " << ldap->errorString(rc) << endl;
+        if (foundCount == 0)
+        {
+            return rc;
+        }
+    }
+
+    // Check if the user list is empty
+    if (foundCount == 0)
+    {
+        cout << "There are no users to delete. Try adding users to the directory first." << endl;
+        return rc;
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    cout << "Deleted " << deletedCount << " users";
+    if (failedCount > 0)
+    {
+        cout << " (" << failedCount << " failed)";
+    }
+    cout << " in " << seconds << " seconds";
+    if (seconds > 0)
+    {
+        cout << " (" << static_cast<size_t>(deletedCount / seconds) << " deletes/sec)";
+    }
+    cout << "." << endl;
+
+    if (rc == LDAP_SUCCESS && failedCount == 0)
+    {
+        cout << "All users have been deleted successfully." << endl;
+    }
+
+    return rc != LDAP_SUCCESS ? rc : lastError;
+}
+
+// Function to delete a single LDAP user by user ID
+// The existence check is skipped when the caller already knows the user exists
+int deleteSingleLDAPUser(DirectoryBackend* ldap, const string& userDN, bool knownToExist)
+{
+    int rc = LDAP_SUCCESS;
+
+    // Check if the user exists before attempting to delete
+    if (!knownToExist && !userExists(ldap, userDN))
+    {
+        cout << "User with DN '" << userDN << "' does not exist." << endl;
+        return LDAP_NO_SUCH_OBJECT;
+    }
+
+    rc = ldap->deleteEntry(userDN);
+    if (rc != LDAP_SUCCESS)
+    {
+        cerr << "Failed to delete user with DN '" << userDN << "': " << ldap->errorString(rc) << endl;
+    }
+    else
+    {
+        cout << "User with DN '" << userDN << "' has been deleted successfully." << endl;
+    }
+
+    return rc;
+}
+
+// Function to display detailed information of a single LDAP user
+void displaySingleLDAPUser(DirectoryBackend* ldap, const string& userDN)
+{
+    int rc = LDAP_SUCCESS;
+    vector<DirectoryEntry> entries;
+
+    // Search for the user in the LDAP directory
+    rc = ldap->search(userDN, LDAP_SCOPE_BASE, "(objectClass=inetOrgPerson)", displayedAttributes, 0, entries);
+
+    if (rc != LDAP_SUCCESS)
+    {
+        cerr << "LDAP search failed: " << ldap->errorString(rc) << endl;
+        return;
+    }
+
+    if (!entries.empty())
+    {
+        cout << "\nUser Details (DN: " << userDN << "):\n";
+        for (const auto& attr : displayedAttributes)
+        {
+            const string* value = entries[0].firstValue(attr);
+            if (value)
+            {
+                cout << attr << ": " << *value << '\n';
+            }
+        }
+        cout << flush;
+    }
+    else
+    {
+        cout << "No user found with DN: " << userDN << endl;
+    }
+}
+
+// Function to check if an ID is made of digits only
+static bool isNumericValue(const string& value)
+{
+    return !value.empty() && value.find_first_not_of("0123456789") == string::npos;
+}
+
+// Function to get the key a user sorts by in listings
+string userSortKey(const string& sortAttribute, const string* value)
+{
+    // The first byte puts numbers before other values and users without the attribute last
+    if (value == nullptr)
+    {
+        return "3";
+    }
+    string key;
+    bool byId = sameAttributeName(sortAttribute, "cn");
+    if (byId && isNumericValue(*value))
+    {
+        // Numbers without leading zeros order by length and then digit by digit, the whole ID breaks ties
+        size_t start = min(value->find_first_not_of('0'), value->size());
+        size_t length = value->size() - start;
+        key.reserve(value->size() * 2 + 10);
+        key += '1';
+        string lengthText = to_string(length);
+        key.append(8 - min<size_t>(lengthText.size(), 8), '0');
+        key += lengthText;
+        key.append(*value, start, string::npos);
+        key += '\0';
+        key += *value;
+    }
+    else if (byId)
+    {
+        // Other IDs order as they are, after the numbers, the same way the local cache orders them
+        key = '2' + *value;
+    }
+    else
+    {
+        // Values that only differ in case keep an order by the value itself
+        key.reserve(value->size() * 2 + 2);
+        key += '2';
+        for (char c : *value)
+        {
+            key += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        }
+        key += '\0';
+        key += *value;
+    }
+    return key;
+}
+
+// Function to write all LDAP users under a specific path, sorted by an attribute
+int displayAllLDAPUsers(DirectoryBackend* ldap, const string& basePath, const string& sortAttribute, UserWriter& writer, size_t memoryBudget)
+{
+    int rc = LDAP_SUCCESS;
+    string filter = "(objectClass=inetOrgPerson)";
+
+    // Construct the search base
+    string searchBase = "ou=users," + basePath;
+
+    // A server that can sort hands the users over in order, one page at a time
+    if (!sameAttributeName(sortAttribute, "cn") && serverSupportsControl(ldap, serverSortControlOid))
+    {
+        size_t usersBefore = writer.userCount();
+        rc = sortedPagedSearch(ldap, searchBase, LDAP_SCOPE_ONELEVEL, filter, displayedAttributes, sortAttribute, defaultSearchPageSize, [&](const DirectoryEntry& entry)
+        {
+            writer.writeUser(entry);
+            return true;
+        });
+        if (writer.userCount() > usersBefore)
+        {
+            if (rc != LDAP_SUCCESS)
+            {
+                cerr << "LDAP search failed: " << ldap->errorString(rc) << endl;
+            }
+            writer.finish();
+            return rc;
+        }
+
+        // The server couldn't sort by the attribute, or found no users to sort, so the users are sorted here
+    }
+
+    // Users are read a page at a time, formatted and sorted within the memory budget
+    ExternalSorter sorter(memoryBudget);
+    bool spillFailed = false;
+    rc = pagedSearch(ldap, searchBase, LDAP_SCOPE_ONELEVEL, filter, displayedAttributes, defaultSearchPageSize, [&](const DirectoryEntry& entry)
+    {
+        string record;
+        writer.formatUser(entry, record);
+        if (!sorter.add(userSortKey(sortAttribute, entry.firstValue(sortAttribute)), move(record)))
+        {
+            spillFailed = true;
+            return false;
+        }
+        return true;
+    });
+
+    if (rc != LDAP_SUCCESS)
+    {
+        // Without ou=users there are no users to list
+        if (rc != LDAP_NO_SUCH_OBJECT)
+        {
+            cerr << "LDAP search failed: " << ldap->errorString(rc) << endl;
+        }
+        writer.finish();
+        return rc;
+    }
+    if (spillFailed || !sorter.finish([&](const string& record) { writer.writeFormatted(record); }))
+    {
+        cerr << "Error: The users could not be sorted, a temporary file could not be written or read." << endl;
+        writer.finish();
+        return LDAP_OTHER;
+    }
+    writer.finish();
+    return LDAP_SUCCESS;
+}
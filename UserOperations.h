@@ -0,0 +1,66 @@
+#ifndef USEROPERATIONS_H
+#define USEROPERATIONS_H
+
+#include <chrono>               // For the time each delete request was sent
+#include <cstddef>              // For size_t
+#include <map>                  // For outstanding delete requests
+#include <string>               // For string operations
+#include <vector>               // For attribute lists
+#include "DirectoryBackend.h"   // For directory operations
+#include "ExternalSort.h"       // For the memory budget of sorted listings
+#include "FlowControl.h"        // For adapting to server load
+#include "UserSchema.h"         // For the columns of an import file
+#include "UserWriter.h"         // For writing listings
+
+// Number of delete requests kept in flight while deleting all users
+const size_t defaultDeleteWindow = 64;
+
+// Attributes shown for every user, in display order
+const std::vector<std::string> displayedAttributes = { "cn", "sn", "givenName", "mail", "ou", "telephoneNumber", "description" };
+
+// Attribute users are sorted by in listings unless another one is chosen
+const char* const defaultSortAttribute = "cn";
+
+// Function to get the key a user sorts by in listings, from its value of the sort attribute or nullptr if it has none
+// Keys compare as bytes. By the user ID (cn), users are in the order of the local cache, numeric IDs first
+// in numeric order; by any other attribute, values are ordered ignoring case, as a server's ordering rule does.
+// Users without the attribute come last either way.
+std::string userSortKey(const std::string& sortAttribute, const std::string* value);
+
+// Function to check if an LDAP user exists
+bool userExists(DirectoryBackend* ldap, const std::string& userDN);
+
+// Structure to store a delete request that was sent and not yet answered, or is waiting to be sent again
+struct PendingDelete
+{
+    std::string dn;
+    bool treeDelete = false;
+    unsigned int attempts = 0;
+    std::chrono::steady_clock::time_point sentAt;
+};
+
+// Function to wait for the reply to one outstanding delete request and record its outcome
+// Entries that still have children are sent again with the tree-delete control when the server supports it,
+// and entries answered busy or unavailable are scheduled in retries. Every reply is reported to flow.
+bool collectLDAPDeleteResult(DirectoryBackend* ldap, std::map<int, PendingDelete>& pendingDeletes, FlowController& flow, RetryQueue<PendingDelete>& retries, bool treeDeleteSupported, size_t& deletedCount, size_t& failedCount, int& lastError);
+
+// Function to delete all LDAP users under a specific path
+// Users are listed a page at a time and deleted with a window of asynchronous requests, so memory stays constant
+// The window shrinks while the server shows signs of load, and deletes it turned away are sent again later.
+int deleteAllLDAPUsers(DirectoryBackend* ldap, const std::string& basePath);
+
+// Function to delete a single LDAP user by user ID
+// The existence check is skipped when the caller already knows the user exists
+int deleteSingleLDAPUser(DirectoryBackend* ldap, const std::string& userDN, bool knownToExist = false);
+
+// Function to display detailed information of a single LDAP user
+void displaySingleLDAPUser(DirectoryBackend* ldap, const std::string& userDN);
+
+// Function to write all LDAP users under a specific path, sorted by an attribute, returns the result of the search
+// The server sorts them when it supports server side sorting, unless they are sorted by the user ID,
+// which needs a numeric order no matching rule gives. Otherwise users are read a page at a time and
+// sorted here, spilling to temporary files beyond memoryBudget, so listings of any size fit in memory.
+// The writer is flushed at the end, and writes nothing but a CSV header when there are no users.
+int displayAllLDAPUsers(DirectoryBackend* ldap, const std::string& basePath, const std::string& sortAttribute, UserWriter& writer, size_t memoryBudget = defaultSortMemoryBudget);
+
+#endif // USEROPERATIONS_H
@@ -0,0 +1,380 @@
+#include "UserQuery.h"
+
+#include <algorithm>            // For sorting prefixes and counts
+#include <cctype>               // For tolower
+#include <iostream>             // For error messages
+#include <unordered_map>        // For finding the count of a value
+#include "DirectorySearch.h"    // For paged searches
+#include "UserSchema.h"         // For the attribute naming a user
+
+using namespace std;
+
+// Most ID prefixes sent to the server for a range, wider ranges are only checked here
+static const size_t maxIdPrefixes = 64;
+
+// Function to escape a value for use in an LDAP filter (RFC 4515)
+static string escapeFilterValue(const string& value)
+{
+    static const char hex[] = "0123456789abcdef";
+    string escaped;
+    escaped.reserve(value.size());
+    for (char c : value)
+    {
+        if (c == '*' || c == '(' || c == ')' || c == '\\' || c == '\0')
+        {
+            escaped += '\\';
+            escaped += hex[(static_cast<unsigned char>(c) >> 4) & 0xF];
+            escaped += hex[c & 0xF];
+        }
+        else
+        {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+// Function to check if an ID is made of digits only
+static bool isNumericId(const string& id)
+{
+    return !id.empty() && id.find_first_not_of("0123456789") == string::npos;
+}
+
+// Function to strip the leading zeros of a number, keeping a single zero
+static string withoutLeadingZeros(const string& number)
+{
+    size_t start = number.find_first_not_of('0');
+    return start == string::npos ? "0" : number.substr(start);
+}
+
+// Function to compare two numbers without leading zeros
+static int compareNumbers(const string& a, const string& b)
+{
+    if (a.size() != b.size())
+    {
+        return a.size() < b.size() ? -1 : 1;
+    }
+    return a.compare(b);
+}
+
+// Function to add the prefixes that together start exactly the numbers from low to high, which have the same number of digits
+static void addRangePrefixes(const string& low, const string& high, vector<string>& prefixes)
+{
+    size_t common = 0;
+    while (common < low.size() && low[common] == high[common])
+    {
+        common++;
+    }
+    if (common == low.size())
+    {
+        prefixes.push_back(low);
+        return;
+    }
+
+    // Every number after the common prefix is in the range
+    if (low.find_first_not_of('0', common) == string::npos && high.find_first_not_of('9', common) == string::npos)
+    {
+        prefixes.push_back(low.substr(0, common));
+        return;
+    }
+
+    // The first and last digits after the common prefix are split further, the ones between are whole
+    size_t rest = low.size() - common - 1;
+    addRangePrefixes(low, low.substr(0, common + 1) + string(rest, '9'), prefixes);
+    for (char digit = low[common] + 1; digit < high[common]; digit++)
+    {
+        prefixes.push_back(low.substr(0, common) + digit);
+    }
+    addRangePrefixes(high.substr(0, common + 1) + string(rest, '0'), high, prefixes);
+}
+
+// Function to build the filter term selecting IDs that start like the numbers of a range, empty if it wouldn't narrow the search
+static string idRangeTerm(const UserQuery& query)
+{
+    // Without an upper bound every longer number is in the range, and every leading digit with it
+    if (query.idTo.empty())
+    {
+        return string();
+    }
+    string low = withoutLeadingZeros(query.idFrom.empty() ? "0" : query.idFrom);
+    string high = withoutLeadingZeros(query.idTo);
+
+    vector<string> prefixes;
+    for (size_t length = low.size(); length <= high.size(); length++)
+    {
+        string lengthLow = length == low.size() ? low : "1" + string(length - 1, '0');
+        string lengthHigh = length == high.size() ? high : string(length, '9');
+        if (compareNumbers(lengthLow, lengthHigh) <= 0)
+        {
+            addRangePrefixes(lengthLow, lengthHigh, prefixes);
+        }
+    }
+
+    // A prefix that starts another one already covers it
+    sort(prefixes.begin(), prefixes.end());
+    vector<string> covering;
+    for (const auto& prefix : prefixes)
+    {
+        if (covering.empty() || prefix.compare(0, covering.back().size(), covering.back()) != 0)
+        {
+            covering.push_back(prefix);
+        }
+    }
+    if (covering.empty() || covering[0].empty() || covering.size() > maxIdPrefixes)
+    {
+        return string();
+    }
+
+    string term = covering.size() > 1 ? "(|" : "";
+    for (const auto& prefix : covering)
+    {
+        term += string("(") + userRdnAttribute + "=" + prefix + "*)";
+    }
+    if (covering.size() > 1)
+    {
+        term += ")";
+    }
+    return term;
+}
+
+// Function to read the ID of a user from its DN, whose first part is the ID
+static string userIdFromDn(const string& dn)
+{
+    size_t equals = dn.find('=');
+    if (equals == string::npos)
+    {
+        return string();
+    }
+    return dn.substr(equals + 1, dn.find(',', equals) - equals - 1);
+}
+
+// Function to read an ID range such as 100-250, 100- or -250
+bool parseIdRange(const string& text, string& idFrom, string& idTo)
+{
+    size_t dash = text.find('-');
+    if (dash == string::npos)
+    {
+        return false;
+    }
+    string from = text.substr(0, dash);
+    string to = text.substr(dash + 1);
+    if ((from.empty() && to.empty()) || (!from.empty() && !isNumericId(from)) || (!to.empty() && !isNumericId(to)))
+    {
+        return false;
+    }
+    if (!from.empty() && !to.empty() && compareNumbers(withoutLeadingZeros(from), withoutLeadingZeros(to)) > 0)
+    {
+        return false;
+    }
+    idFrom = from;
+    idTo = to;
+    return true;
+}
+
+// Function to read a list of attribute names separated by commas
+vector<string> parseAttributeList(const string& text)
+{
+    vector<string> attributes;
+    size_t start = 0;
+    while (start <= text.size())
+    {
+        size_t comma = min(text.find(',', start), text.size());
+        size_t first = text.find_first_not_of(' ', start);
+        size_t last = text.find_last_not_of(' ', comma - 1);
+        if (first < comma && last != string::npos && last >= first)
+        {
+            attributes.push_back(text.substr(first, last - first + 1));
+        }
+        start = comma + 1;
+    }
+    return attributes;
+}
+
+// Function to build the LDAP filter that selects the users a query asks for
+string buildUserFilter(const UserQuery& query)
+{
+    string filter = "(&(objectClass=inetOrgPerson)";
+    if (!query.department.empty())
+    {
+        filter += "(ou=" + escapeFilterValue(query.department) + ")";
+    }
+    if (!query.emailDomain.empty())
+    {
+        string domain = query.emailDomain[0] == '@' ? query.emailDomain.substr(1) : query.emailDomain;
+        filter += "(mail=*@" + escapeFilterValue(domain) + ")";
+    }
+    if (!query.jobDescriptionPrefix.empty())
+    {
+        filter += "(description=" + escapeFilterValue(query.jobDescriptionPrefix) + "*)";
+    }
+    if (query.hasIdRange())
+    {
+        filter += idRangeTerm(query);
+    }
+    filter += ")";
+    return filter;
+}
+
+// Function to check the parts of a query the server filter can only narrow down
+bool matchesUserQuery(const UserQuery& query, const string& dn)
+{
+    if (!query.hasIdRange())
+    {
+        return true;
+    }
+    string id = userIdFromDn(dn);
+    if (!isNumericId(id))
+    {
+        return false;
+    }
+    id = withoutLeadingZeros(id);
+    return (query.idFrom.empty() || compareNumbers(id, withoutLeadingZeros(query.idFrom)) >= 0)
+        && (query.idTo.empty() || compareNumbers(id, withoutLeadingZeros(query.idTo)) <= 0);
+}
+
+// Function to write the users a query selects, with only the given attributes
+int queryUsers(DirectoryBackend* ldap, const string& basePath, const UserQuery& query, UserWriter& writer)
+{
+    string searchBase = "ou=users," + basePath;
+    int rc = pagedSearch(ldap, searchBase, LDAP_SCOPE_ONELEVEL, buildUserFilter(query), writer.writtenAttributes(), defaultSearchPageSize, [&](const DirectoryEntry& entry)
+    {
+        if (matchesUserQuery(query, entry.dn))
+        {
+            writer.writeUser(entry);
+        }
+        return true;
+    });
+
+    // Without ou=users there are no users to find
+    if (rc != LDAP_SUCCESS && rc != LDAP_NO_SUCH_OBJECT)
+    {
+        cerr << "LDAP search failed: " << ldap->errorString(rc) << endl;
+    }
+    writer.finish();
+    return rc;
+}
+
+// Function to count the users a query selects by their value of an attribute
+int countUsersBy(DirectoryBackend* ldap, const string& basePath, const UserQuery& query, const string& attribute, vector<UserGroupCount>& counts, size_t& missingCount)
+{
+    counts.clear();
+    missingCount = 0;
+
+    // Values are counted under their lower case form and shown as they were first seen
+    unordered_map<string, size_t> countIndex;
+    string key;
+    string searchBase = "ou=users," + basePath;
+    int rc = pagedSearch(ldap, searchBase, LDAP_SCOPE_ONELEVEL, buildUserFilter(query), attribute.empty() ? noAttributes : vector<string>{ attribute }, defaultSearchPageSize, [&](const DirectoryEntry& entry)
+    {
+        if (!matchesUserQuery(query, entry.dn))
+        {
+            return true;
+        }
+        const string* value = attribute.empty() ? nullptr : entry.firstValue(attribute);
+        if (value == nullptr)
+        {
+            missingCount++;
+            return true;
+        }
+
+        key.resize(value->size());
+        transform(value->begin(), value->end(), key.begin(), [](char c) { return static_cast<char>(tolower(static_cast<unsigned char>(c))); });
+        auto found = countIndex.emplace(key, counts.size());
+        if (found.second)
+        {
+            counts.push_back({ *value, 0 });
+        }
+        counts[found.first->second].count++;
+        return true;
+    });
+
+    if (rc != LDAP_SUCCESS && rc != LDAP_NO_SUCH_OBJECT)
+    {
+        cerr << "LDAP search failed: " << ldap->errorString(rc) << endl;
+    }
+    stable_sort(counts.begin(), counts.end(), [](const UserGroupCount& a, const UserGroupCount& b) { return a.count > b.count; });
+    return rc;
+}
+
+// Function to write counts made by countUsersBy
+void writeUserCounts(ostream& out, OutputFormat format, const string& attribute, const vector<UserGroupCount>& counts, size_t missingCount)
+{
+    string text;
+    if (attribute.empty())
+    {
+        // Only the number of users was counted
+        if (format == OutputFormat::Table)
+        {
+            text = to_string(missingCount) + " users\n";
+        }
+        else if (format == OutputFormat::Csv)
+        {
+            text = "count\n" + to_string(missingCount) + "\n";
+        }
+        else
+        {
+            text = "{\"count\":" + to_string(missingCount) + "}\n";
+        }
+        out << text << flush;
+        return;
+    }
+
+    string missingLabel = "(no " + attribute + ")";
+    if (format == OutputFormat::Table)
+    {
+        size_t width = max(attribute.size(), missingCount > 0 ? missingLabel.size() : 0);
+        for (const auto& group : counts)
+        {
+            width = max(width, group.value.size());
+        }
+        auto appendRow = [&](const string& value, const string& count)
+        {
+            text += value;
+            text.append(width - value.size() + 2, ' ');
+            text += count;
+            text += '\n';
+        };
+        appendRow(attribute, "users");
+        text += string(width, '-') + "  -----\n";
+        for (const auto& group : counts)
+        {
+            appendRow(group.value, to_string(group.count));
+        }
+        if (missingCount > 0)
+        {
+            appendRow(missingLabel, to_string(missingCount));
+        }
+    }
+    else if (format == OutputFormat::Csv)
+    {
+        appendCsvField(text, attribute);
+        text += ",count\n";
+        for (const auto& group : counts)
+        {
+            appendCsvField(text, group.value);
+            text += "," + to_string(group.count) + "\n";
+        }
+        if (missingCount > 0)
+        {
+            text += "," + to_string(missingCount) + "\n";
+        }
+    }
+    else
+    {
+        for (const auto& group : counts)
+        {
+            text += "{";
+            appendJsonString(text, attribute);
+            text += ":";
+            appendJsonString(text, group.value);
+            text += ",\"count\":" + to_string(group.count) + "}\n";
+        }
+        if (missingCount > 0)
+        {
+            text += "{";
+            appendJsonString(text, attribute);
+            text += ":null,\"count\":" + to_string(missingCount) + "}\n";
+        }
+    }
+    out << text << flush;
+}
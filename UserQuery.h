@@ -0,0 +1,62 @@
+#ifndef USERQUERY_H
+#define USERQUERY_H
+
+#include <cstddef>              // For size_t
+#include <ostream>              // For writing counts
+#include <string>               // For string operations
+#include <utility>              // For pairs of values and counts
+#include <vector>               // For attribute lists and counts
+#include "DirectoryBackend.h"   // For directory operations
+#include "UserWriter.h"         // For writing the users found
+
+// Criteria users are selected by, criteria left empty match every user
+struct UserQuery
+{
+    std::string department;             // Users whose ou is this department
+    std::string emailDomain;            // Users whose mail address is in this domain, with or without the @
+    std::string jobDescriptionPrefix;   // Users whose description starts with this text
+    std::string idFrom;                 // Users whose numeric ID is at least this, empty for no lower bound
+    std::string idTo;                   // Users whose numeric ID is at most this, empty for no upper bound
+
+    // Function to check if an ID range is set
+    bool hasIdRange() const { return !idFrom.empty() || !idTo.empty(); }
+};
+
+// Users that have one value of an attribute, and how many of them there are
+struct UserGroupCount
+{
+    std::string value;
+    size_t count = 0;
+};
+
+// Function to read an ID range such as 100-250, 100- or -250, returns false if it isn't one
+bool parseIdRange(const std::string& text, std::string& idFrom, std::string& idTo);
+
+// Function to read a list of attribute names separated by commas, empty when the text is
+std::vector<std::string> parseAttributeList(const std::string& text);
+
+// Function to build the LDAP filter (RFC 4515) that selects the users a query asks for
+// Every criterion is matched by the server. A numeric ID range can't be, because the user ID has no
+// numeric ordering rule, so it is sent as the ID prefixes that cover the range, and IDs that only share
+// a prefix with it, such as 1000 for 100-199, are dropped by matchesUserQuery(). IDs written with leading
+// zeros don't start like their number, so they are only found by a range without an upper bound.
+std::string buildUserFilter(const UserQuery& query);
+
+// Function to check the parts of a query the server filter can only narrow down, from the DN of a user
+bool matchesUserQuery(const UserQuery& query, const std::string& dn);
+
+// Function to write the users a query selects, with only the given attributes, returns the result of the search
+// Users are fetched a page at a time and written as they arrive, in the order the server returns them.
+int queryUsers(DirectoryBackend* ldap, const std::string& basePath, const UserQuery& query, UserWriter& writer);
+
+// Function to count the users a query selects by their value of an attribute, returns the result of the search
+// Only the attribute is fetched, and only the counts are kept, so memory grows with the number of values and
+// not with the number of users. Values that differ only in case are counted together. Users without the
+// attribute are counted in missingCount. Counts are sorted from the largest down. With an empty attribute
+// no attributes are fetched and only missingCount, the number of users, is set.
+int countUsersBy(DirectoryBackend* ldap, const std::string& basePath, const UserQuery& query, const std::string& attribute, std::vector<UserGroupCount>& counts, size_t& missingCount);
+
+// Function to write counts made by countUsersBy, as a table, a CSV file with attribute and count columns or JSON lines
+void writeUserCounts(std::ostream& out, OutputFormat format, const std::string& attribute, const std::vector<UserGroupCount>& counts, size_t missingCount);
+
+#endif // USERQUERY_H
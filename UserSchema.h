@@ -0,0 +1,88 @@
+#ifndef USERSCHEMA_H
+#define USERSCHEMA_H
+
+#include <cstddef>      // For size_t
+
+// Columns expected in the header of an import file
+const size_t csvColumnCount = 6;
+const char* const csvColumns[csvColumnCount] = { "id", "full_name", "phone_number", "email", "department", "job_description" };
+
+// Position of each column in an import file
+enum CsvColumn : size_t
+{
+    idColumn,
+    fullNameColumn,
+    phoneNumberColumn,
+    emailColumn,
+    departmentColumn,
+    jobDescriptionColumn
+};
+
+// Where the value of a user attribute comes from
+enum class ValueSource
+{
+    Column,         // A column of the import file, as it is
+    FirstName,      // The first word of the full name
+    LastName,       // The rest of the full name
+    Constant        // A fixed list of values
+};
+
+// Structure to map one LDAP attribute of a user to its value
+struct AttributeMapping
+{
+    const char* attribute;
+    ValueSource source;
+    size_t column;
+    const char* const* constants;
+    size_t constantCount;
+};
+
+// Object classes given to every user
+constexpr const char* userObjectClasses[] = { "inetOrgPerson", "organizationalPerson", "person", "top" };
+
+// Attribute naming a user in its DN, the id column
+constexpr const char* userRdnAttribute = "cn";
+
+// Attributes of a user added from an import file, in the order they are sent
+// Adding an attribute or object class here is all it takes for every import and sync to send it.
+constexpr AttributeMapping userSchema[] = {
+    { "cn", ValueSource::Column, idColumn, nullptr, 0 },
+    { "sn", ValueSource::LastName, fullNameColumn, nullptr, 0 },
+    { "givenName", ValueSource::FirstName, fullNameColumn, nullptr, 0 },
+    { "mail", ValueSource::Column, emailColumn, nullptr, 0 },
+    { "objectClass", ValueSource::Constant, 0, userObjectClasses, sizeof(userObjectClasses) / sizeof(userObjectClasses[0]) },
+    { "ou", ValueSource::Column, departmentColumn, nullptr, 0 },
+    { "telephoneNumber", ValueSource::Column, phoneNumberColumn, nullptr, 0 },
+    { "description", ValueSource::Column, jobDescriptionColumn, nullptr, 0 }
+};
+
+// Number of attributes of a user
+constexpr size_t userSchemaSize = sizeof(userSchema) / sizeof(userSchema[0]);
+
+// Function to count the values of a user, every mapping has one value except constant lists
+constexpr size_t userSchemaValueCount()
+{
+    size_t count = 0;
+    for (size_t i = 0; i < userSchemaSize; i++)
+    {
+        count += userSchema[i].source == ValueSource::Constant ? userSchema[i].constantCount : 1;
+    }
+    return count;
+}
+
+// Function to check that every mapping names a column of the import file or a constant list
+constexpr bool userSchemaIsValid()
+{
+    for (size_t i = 0; i < userSchemaSize; i++)
+    {
+        if (userSchema[i].source == ValueSource::Constant ? userSchema[i].constants == nullptr || userSchema[i].constantCount == 0 : userSchema[i].column >= csvColumnCount)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(userSchemaIsValid(), "every user attribute must name an import column or a list of constants");
+
+#endif // USERSCHEMA_H
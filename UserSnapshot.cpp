@@ -0,0 +1,472 @@
+#include "UserSnapshot.h"
+
+#include <algorithm>            // For sorting the users
+#include <cctype>               // For tolower
+#include <cstdio>               // For rename and remove
+#include <cstring>              // For memcmp and memcpy
+#include <fstream>              // For writing the snapshot file
+#include <iostream>             // For error messages
+#include "DirectorySearch.h"    // For paged searches
+#include "UserOperations.h"     // For the attributes shown for a user
+#include "UserSchema.h"         // For the attribute naming a user
+
+#ifdef _WIN32
+#include <Windows.h>            // For memory-mapped files
+#else
+#include <fcntl.h>              // For open
+#include <sys/mman.h>           // For mmap
+#include <sys/stat.h>           // For fstat
+#include <unistd.h>             // For close
+#endif
+
+using namespace std;
+
+static const char snapshotMagic[8] = { 'L', 'D', 'A', 'P', 'S', 'N', 'A', 'P' };
+static const uint32_t snapshotVersion = 1;
+
+// Written as it is in memory, so a file from a computer of the other byte order is recognised and refused
+static const uint32_t snapshotByteOrder = 0x01020304;
+
+// Length stored for a value the user doesn't have
+static const uint32_t missingValue = 0xFFFFFFFF;
+
+// Attribute that tells whether a user changed after the snapshot was taken
+static const char* const modifyTimestampAttribute = "modifyTimestamp";
+
+// Start of a snapshot file
+// Each string is stored as two numbers, its offset in the pool and its length. The attribute names follow
+// the header, then the records at recordsOffset, each the DN and one value per attribute, then the pool.
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t takenAt;           // Seconds since 1970
+    uint64_t userCount;
+    uint32_t attributeCount;
+    uint32_t basePath[2];
+    uint32_t reserved;
+    uint64_t recordsOffset;
+    uint64_t poolOffset;
+    uint64_t poolSize;
+};
+
+// Function to compare two IDs the way the server does, ignoring the case of ASCII letters
+static int compareIgnoringCase(string_view a, string_view b)
+{
+    size_t length = min(a.size(), b.size());
+    for (size_t i = 0; i < length; i++)
+    {
+        int ca = tolower(static_cast<unsigned char>(a[i]));
+        int cb = tolower(static_cast<unsigned char>(b[i]));
+        if (ca != cb)
+        {
+            return ca < cb ? -1 : 1;
+        }
+    }
+    return a.size() == b.size() ? 0 : (a.size() < b.size() ? -1 : 1);
+}
+
+// Attributes kept for each user, the ones shown for a user and the time it was last modified
+static vector<string> snapshotAttributeList()
+{
+    vector<string> attributes = displayedAttributes;
+    attributes.push_back(modifyTimestampAttribute);
+    return attributes;
+}
+
+UserSnapshot::UserSnapshot()
+    : mappedData(nullptr), mappedSize(0),
+#ifdef _WIN32
+      fileHandle(nullptr), mappingHandle(nullptr),
+#endif
+      userCount(0), refsPerUser(0), cnIndex(0), records(nullptr), pool(nullptr), poolSize(0)
+{
+}
+
+UserSnapshot::~UserSnapshot()
+{
+    close();
+}
+
+// Function to map a snapshot file
+bool UserSnapshot::open(const string& filePath, string& error)
+{
+    close();
+    error = "The snapshot " + filePath + " can't be opened";
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    fileHandle = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart < static_cast<LONGLONG>(sizeof(SnapshotHeader)))
+    {
+        close();
+        error = "The file " + filePath + " is not a user snapshot";
+        return false;
+    }
+    mappedSize = static_cast<size_t>(size.QuadPart);
+    mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle != nullptr)
+    {
+        mappedData = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (mappedData == nullptr)
+    {
+        close();
+        return false;
+    }
+#else
+    int fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || static_cast<size_t>(info.st_size) < sizeof(SnapshotHeader))
+    {
+        ::close(fd);
+        error = "The file " + filePath + " is not a user snapshot";
+        return false;
+    }
+
+    void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    // Lookups jump around the file, reading ahead would only load pages that aren't needed
+    madvise(data, static_cast<size_t>(info.st_size), MADV_RANDOM);
+    mappedData = static_cast<const char*>(data);
+    mappedSize = static_cast<size_t>(info.st_size);
+#endif
+
+    // Check that every part the header points to is inside the file before anything is read from it
+    SnapshotHeader header;
+    memcpy(&header, mappedData, sizeof(header));
+    uint64_t namesEnd = sizeof(header) + static_cast<uint64_t>(header.attributeCount) * 2 * sizeof(uint32_t);
+    uint64_t recordSize = (1 + static_cast<uint64_t>(header.attributeCount)) * 2 * sizeof(uint32_t);
+    bool valid = memcmp(header.magic, snapshotMagic, sizeof(snapshotMagic)) == 0
+        && header.version == snapshotVersion
+        && header.byteOrder == snapshotByteOrder
+        && header.attributeCount < 1024
+        && header.recordsOffset >= namesEnd
+        && header.recordsOffset % sizeof(uint32_t) == 0
+        && header.poolOffset >= header.recordsOffset
+        && header.userCount <= (header.poolOffset - header.recordsOffset) / recordSize
+        && header.poolOffset <= mappedSize
+        && header.poolSize <= mappedSize - header.poolOffset;
+    if (!valid)
+    {
+        close();
+        error = "The file " + filePath + " is not a user snapshot of this version";
+        return false;
+    }
+
+    userCount = static_cast<size_t>(header.userCount);
+    refsPerUser = 1 + header.attributeCount;
+    records = reinterpret_cast<const uint32_t*>(mappedData + header.recordsOffset);
+    pool = mappedData + header.poolOffset;
+    poolSize = header.poolSize;
+    takenTime = chrono::system_clock::time_point(chrono::seconds(header.takenAt));
+    base = poolString(header.basePath);
+
+    const uint32_t* names = reinterpret_cast<const uint32_t*>(mappedData + sizeof(header));
+    cnIndex = header.attributeCount;
+    for (size_t i = 0; i < header.attributeCount; i++)
+    {
+        attributeNames.emplace_back(poolString(names + 2 * i));
+        if (sameAttributeName(attributeNames.back(), userRdnAttribute))
+        {
+            cnIndex = i;
+        }
+    }
+    if (cnIndex == header.attributeCount)
+    {
+        close();
+        error = "The snapshot " + filePath + " has no " + userRdnAttribute + " of its users";
+        return false;
+    }
+    error.clear();
+    return true;
+}
+
+// Function to unmap the file
+void UserSnapshot::close()
+{
+#ifdef _WIN32
+    if (mappedData != nullptr)
+    {
+        UnmapViewOfFile(mappedData);
+    }
+    if (mappingHandle != nullptr)
+    {
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle != nullptr)
+    {
+        CloseHandle(fileHandle);
+    }
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    if (mappedData != nullptr)
+    {
+        munmap(const_cast<char*>(mappedData), mappedSize);
+    }
+#endif
+    mappedData = nullptr;
+    mappedSize = 0;
+    userCount = 0;
+    refsPerUser = 0;
+    records = nullptr;
+    pool = nullptr;
+    poolSize = 0;
+    attributeNames.clear();
+    base = string_view();
+}
+
+// Function to read a string from the pool, empty if it would run past the pool
+string_view UserSnapshot::poolString(const uint32_t* ref) const
+{
+    if (ref[1] == missingValue || static_cast<uint64_t>(ref[0]) + ref[1] > poolSize)
+    {
+        return string_view();
+    }
+    return string_view(pool + ref[0], ref[1]);
+}
+
+// Function to get the cn of the user at a position
+string_view UserSnapshot::cnOf(size_t user) const
+{
+    return poolString(records + (user * refsPerUser + 1 + cnIndex) * 2);
+}
+
+// Function to find a user by cn, ignoring case
+size_t UserSnapshot::find(string_view cn) const
+{
+    size_t low = 0;
+    size_t high = userCount;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        int order = compareIgnoringCase(cnOf(middle), cn);
+        if (order == 0)
+        {
+            return middle;
+        }
+        if (order < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return npos;
+}
+
+// Function to get the DN of the user at a position
+string_view UserSnapshot::dn(size_t user) const
+{
+    return poolString(records + user * refsPerUser * 2);
+}
+
+// Function to get the value of an attribute of the user at a position
+bool UserSnapshot::value(size_t user, const string& attribute, string_view& value) const
+{
+    for (size_t i = 0; i < attributeNames.size(); i++)
+    {
+        if (sameAttributeName(attributeNames[i], attribute))
+        {
+            const uint32_t* ref = records + (user * refsPerUser + 1 + i) * 2;
+            if (ref[1] == missingValue)
+            {
+                return false;
+            }
+            value = poolString(ref);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Function to write a snapshot of every user under ou=users of basePath
+int writeUserSnapshot(DirectoryBackend* ldap, const string& basePath, const string& filePath, size_t& userCount)
+{
+    userCount = 0;
+    vector<string> attributes = snapshotAttributeList();
+    size_t cnIndex = 0;
+    while (!sameAttributeName(attributes[cnIndex], userRdnAttribute))
+    {
+        cnIndex++;
+    }
+
+    // Every string goes into one pool, which offsets of 32 bits can address up to 4 GB of
+    string pool;
+    bool poolFull = false;
+    auto addString = [&](string_view text, uint32_t* ref)
+    {
+        if (pool.size() + text.size() >= missingValue)
+        {
+            poolFull = true;
+            return;
+        }
+        ref[0] = static_cast<uint32_t>(pool.size());
+        ref[1] = static_cast<uint32_t>(text.size());
+        pool.append(text.data(), text.size());
+    };
+
+    SnapshotHeader header = {};
+    memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+    header.version = snapshotVersion;
+    header.byteOrder = snapshotByteOrder;
+    header.takenAt = static_cast<uint64_t>(chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count());
+    header.attributeCount = static_cast<uint32_t>(attributes.size());
+    addString(basePath, header.basePath);
+    vector<uint32_t> names(attributes.size() * 2);
+    for (size_t i = 0; i < attributes.size(); i++)
+    {
+        addString(attributes[i], &names[2 * i]);
+    }
+
+    // Records are kept in the order the server returns them and sorted by cn once every user is in
+    size_t refsPerUser = 1 + attributes.size();
+    vector<uint32_t> refs;
+    string searchBase = "ou=users," + basePath;
+    int rc = pagedSearch(ldap, searchBase, LDAP_SCOPE_ONELEVEL, "(objectClass=inetOrgPerson)", attributes, defaultSearchPageSize, [&](const DirectoryEntry& entry)
+    {
+        if (entry.firstValue(attributes[cnIndex]) == nullptr)
+        {
+            return true;
+        }
+        size_t start = refs.size();
+        refs.resize(start + refsPerUser * 2);
+        addString(entry.dn, &refs[start]);
+        for (size_t i = 0; i < attributes.size(); i++)
+        {
+            const string* value = entry.firstValue(attributes[i]);
+            uint32_t* ref = &refs[start + (1 + i) * 2];
+            if (value != nullptr)
+            {
+                addString(*value, ref);
+            }
+            else
+            {
+                ref[0] = 0;
+                ref[1] = missingValue;
+            }
+        }
+        return !poolFull;
+    });
+
+    // Without ou=users there are no users, which is still a snapshot
+    if (rc != LDAP_SUCCESS && rc != LDAP_NO_SUCH_OBJECT)
+    {
+        cerr << "LDAP search failed: " << ldap->errorString(rc) << endl;
+        return rc;
+    }
+    if (poolFull)
+    {
+        cerr << "Error: The users take more than 4 GB, which a snapshot can't hold." << endl;
+        return LDAP_LOCAL_ERROR;
+    }
+
+    size_t users = refs.size() / (refsPerUser * 2);
+    vector<uint32_t> order(users);
+    for (size_t i = 0; i < users; i++)
+    {
+        order[i] = static_cast<uint32_t>(i);
+    }
+    auto cnOf = [&](uint32_t user)
+    {
+        const uint32_t* ref = &refs[(user * refsPerUser + 1 + cnIndex) * 2];
+        return string_view(pool.data() + ref[0], ref[1]);
+    };
+    sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return compareIgnoringCase(cnOf(a), cnOf(b)) < 0; });
+
+    header.userCount = users;
+    header.recordsOffset = sizeof(header) + names.size() * sizeof(uint32_t);
+    header.poolOffset = header.recordsOffset + refs.size() * sizeof(uint32_t);
+    header.poolSize = pool.size();
+
+    string temporary = filePath + ".tmp";
+    {
+        ofstream out(temporary, ios::binary | ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(names.data()), names.size() * sizeof(uint32_t));
+        for (uint32_t user : order)
+        {
+            out.write(reinterpret_cast<const char*>(&refs[user * refsPerUser * 2]), refsPerUser * 2 * sizeof(uint32_t));
+        }
+        out.write(pool.data(), pool.size());
+        if (!out)
+        {
+            out.close();
+            remove(temporary.c_str());
+            cerr << "Error: The snapshot file " << filePath << " can't be written." << endl;
+            return LDAP_LOCAL_ERROR;
+        }
+    }
+
+#ifdef _WIN32
+    // Windows won't rename over an existing file
+    remove(filePath.c_str());
+#endif
+    if (rename(temporary.c_str(), filePath.c_str()) != 0)
+    {
+        remove(temporary.c_str());
+        cerr << "Error: The snapshot file " << filePath << " can't be written." << endl;
+        return LDAP_LOCAL_ERROR;
+    }
+    userCount = users;
+    return LDAP_SUCCESS;
+}
+
+// Function to compare a snapshot with the server
+int verifyUserSnapshot(DirectoryBackend* ldap, const UserSnapshot& snapshot, SnapshotDrift& drift)
+{
+    drift = SnapshotDrift();
+    vector<bool> seen(snapshot.size(), false);
+    string searchBase = "ou=users," + string(snapshot.basePath());
+    int rc = pagedSearch(ldap, searchBase, LDAP_SCOPE_ONELEVEL, "(objectClass=inetOrgPerson)", { userRdnAttribute, modifyTimestampAttribute }, defaultSearchPageSize, [&](const DirectoryEntry& entry)
+    {
+        const string* cn = entry.firstValue(userRdnAttribute);
+        if (cn == nullptr)
+        {
+            return true;
+        }
+        size_t user = snapshot.find(*cn);
+        if (user == UserSnapshot::npos)
+        {
+            drift.added++;
+            return true;
+        }
+        seen[user] = true;
+
+        const string* timestamp = entry.firstValue(modifyTimestampAttribute);
+        string_view snapshotTimestamp;
+        bool hasTimestamp = snapshot.value(user, modifyTimestampAttribute, snapshotTimestamp);
+        if ((timestamp != nullptr) != hasTimestamp || (timestamp != nullptr && *timestamp != snapshotTimestamp))
+        {
+            drift.modified++;
+        }
+        return true;
+    });
+    if (rc != LDAP_SUCCESS && rc != LDAP_NO_SUCH_OBJECT)
+    {
+        cerr << "LDAP search failed: " << ldap->errorString(rc) << endl;
+        return rc;
+    }
+    drift.deleted = static_cast<size_t>(count(seen.begin(), seen.end(), false));
+    return LDAP_SUCCESS;
+}
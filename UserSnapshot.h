@@ -0,0 +1,103 @@
+#ifndef USERSNAPSHOT_H
+#define USERSNAPSHOT_H
+
+#include <chrono>               // For the time a snapshot was taken
+#include <cstddef>              // For size_t
+#include <cstdint>              // For the fixed-size fields of the file
+#include <string>               // For string operations
+#include <string_view>          // For values read in place from the file
+#include <vector>               // For the attribute names
+#include "DirectoryBackend.h"   // For directory operations
+
+// File a snapshot of the users is written to and read from unless another one is given
+const char* const defaultSnapshotPath = "Users.snapshot";
+
+// Users added, deleted and modified on the server since a snapshot was taken
+struct SnapshotDrift
+{
+    size_t added = 0;
+    size_t deleted = 0;
+    size_t modified = 0;
+
+    // Function to check if the snapshot still matches the server
+    bool isCurrent() const { return added == 0 && deleted == 0 && modified == 0; }
+};
+
+// Read-only copy of the ou=users subtree in a binary file, for looking up users without a connection
+// The file holds a header, the attribute names, one record per user and a pool of every string. A record
+// is the position and length in the pool of the user's DN and of its value of each attribute, and records
+// are in order of their cn with case ignored, as the server compares it, so a user is found by a binary
+// search. The file is mapped into memory instead of read, so opening it costs the same whatever its size
+// and a lookup only touches the pages it searches. Strings returned point into the mapping and stay valid
+// until the snapshot is closed.
+class UserSnapshot
+{
+public:
+    // Position find() returns for a user the snapshot doesn't have
+    static const size_t npos = static_cast<size_t>(-1);
+
+    UserSnapshot();
+    ~UserSnapshot();
+
+    UserSnapshot(const UserSnapshot&) = delete;
+    UserSnapshot& operator=(const UserSnapshot&) = delete;
+
+    // Function to map a snapshot file, returns false and sets error if it can't be opened or isn't a snapshot
+    bool open(const std::string& filePath, std::string& error);
+
+    // Function to unmap the file
+    void close();
+
+    // Function to find a user by cn, ignoring case, returns the user's position or npos
+    size_t find(std::string_view cn) const;
+
+    // Function to get the DN of the user at a position
+    std::string_view dn(size_t user) const;
+
+    // Function to get the value of an attribute of the user at a position, returns false if the user doesn't have it
+    bool value(size_t user, const std::string& attribute, std::string_view& value) const;
+
+    size_t size() const { return userCount; }
+    const std::vector<std::string>& attributes() const { return attributeNames; }
+
+    // Base path the users were read from, under ou=users
+    std::string_view basePath() const { return base; }
+
+    // Time the snapshot was taken, by the clock of this computer
+    std::chrono::system_clock::time_point takenAt() const { return takenTime; }
+
+private:
+    std::string_view poolString(const uint32_t* ref) const;
+    std::string_view cnOf(size_t user) const;
+
+    const char* mappedData;
+    size_t mappedSize;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+
+    size_t userCount;
+    size_t refsPerUser;
+    size_t cnIndex;
+    const uint32_t* records;
+    const char* pool;
+    uint64_t poolSize;
+    std::vector<std::string> attributeNames;
+    std::string_view base;
+    std::chrono::system_clock::time_point takenTime;
+};
+
+// Function to write a snapshot of every user under ou=users of basePath, returns the result of the search
+// Users are read with one paged search, sorted here and written to a temporary file that is renamed over
+// filePath, so a snapshot being read is never replaced by half of one. userCount is set to the users
+// written. Returns LDAP_LOCAL_ERROR if the file can't be written or the users don't fit in the format,
+// whose string pool holds up to 4 GB.
+int writeUserSnapshot(DirectoryBackend* ldap, const std::string& basePath, const std::string& filePath, size_t& userCount);
+
+// Function to compare a snapshot with the server, returns the result of the search
+// One paged search reads the cn and modifyTimestamp of every user, so the cost is that of listing the
+// IDs. Users with a modifyTimestamp other than the one in the snapshot count as modified.
+int verifyUserSnapshot(DirectoryBackend* ldap, const UserSnapshot& snapshot, SnapshotDrift& drift);
+
+#endif // USERSNAPSHOT_H
@@ -0,0 +1,334 @@
+#include "UserWriter.h"
+
+#include <algorithm>            // For max
+#include "UserSchema.h"         // For the columns of an import file
+
+using namespace std;
+
+// Width of a table column for attributes whose values have a usual length, wider values push the row along
+static size_t tableColumnWidth(const string& attribute)
+{
+    static const struct { const char* attribute; size_t width; } widths[] = {
+        { "cn", 8 }, { "sn", 14 }, { "givenName", 12 }, { "mail", 30 }, { "ou", 14 }, { "telephoneNumber", 15 }
+    };
+    size_t width = 16;
+    for (const auto& column : widths)
+    {
+        if (sameAttributeName(attribute, column.attribute))
+        {
+            width = column.width;
+            break;
+        }
+    }
+    return max(width, attribute.size());
+}
+
+// Function to find the position of an attribute in a list, or the size of the list if it isn't there
+static size_t attributeIndex(const vector<string>& attributes, const char* attribute)
+{
+    for (size_t i = 0; i < attributes.size(); i++)
+    {
+        if (sameAttributeName(attributes[i], attribute))
+        {
+            return i;
+        }
+    }
+    return attributes.size();
+}
+
+// Function to check if a value can be written as a CSV field as it is
+static bool isPlainCsvField(const string& value)
+{
+    return value.find_first_of(",\"\r\n") == string::npos;
+}
+
+// Function to append a value as a CSV field, quoted only when it has to be
+void appendCsvField(string& text, const string& value)
+{
+    if (isPlainCsvField(value))
+    {
+        text += value;
+        return;
+    }
+    text += '"';
+    for (char c : value)
+    {
+        if (c == '"')
+        {
+            text += '"';
+        }
+        text += c;
+    }
+    text += '"';
+}
+
+// Function to append a value as a JSON string literal
+void appendJsonString(string& text, const string& value)
+{
+    static const char hex[] = "0123456789abcdef";
+    text += '"';
+    size_t plainStart = 0;
+    for (size_t i = 0; i < value.size(); i++)
+    {
+        unsigned char c = static_cast<unsigned char>(value[i]);
+        if (c != '"' && c != '\\' && c >= 0x20)
+        {
+            continue;
+        }
+
+        // Characters that need no escaping are copied a run at a time
+        text.append(value, plainStart, i - plainStart);
+        plainStart = i + 1;
+        if (c == '"' || c == '\\')
+        {
+            text += '\\';
+            text += static_cast<char>(c);
+        }
+        else
+        {
+            text += "\\u00";
+            text += hex[c >> 4];
+            text += hex[c & 0xF];
+        }
+    }
+    text.append(value, plainStart, string::npos);
+    text += '"';
+}
+
+// Function to read an output format from its name
+bool parseOutputFormat(const string& name, OutputFormat& format)
+{
+    if (name == "table")
+    {
+        format = OutputFormat::Table;
+    }
+    else if (name == "csv")
+    {
+        format = OutputFormat::Csv;
+    }
+    else if (name == "jsonl")
+    {
+        format = OutputFormat::JsonLines;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+UserWriter::UserWriter(ostream& out, OutputFormat format, const vector<string>& attributes, size_t bufferSize)
+    : out(out), outputFormat(format), attributes(attributes), scratchValues(attributes.size()), bufferSize(bufferSize), users(0), headerWritten(false)
+{
+    for (const auto& attribute : attributes)
+    {
+        columnWidths.push_back(tableColumnWidth(attribute));
+    }
+
+    // Each CSV column comes from the attribute the import maps it to, and the full name from the first and last names
+    csvFirstSources.assign(csvColumnCount, attributes.size());
+    csvLastNameSources.assign(csvColumnCount, attributes.size());
+    for (const auto& mapping : userSchema)
+    {
+        if (mapping.source == ValueSource::LastName)
+        {
+            csvLastNameSources[mapping.column] = attributeIndex(attributes, mapping.attribute);
+        }
+        else if (mapping.source != ValueSource::Constant)
+        {
+            csvFirstSources[mapping.column] = attributeIndex(attributes, mapping.attribute);
+        }
+    }
+
+    // A user is formatted whole before the buffer is checked, so it may run past the size a little
+    buffer.reserve(bufferSize + 4096);
+}
+
+UserWriter::~UserWriter()
+{
+    flush();
+}
+
+// Function to write the table heading or CSV header
+void UserWriter::writeHeader()
+{
+    headerWritten = true;
+    if (outputFormat == OutputFormat::Table)
+    {
+        vector<const string*> names;
+        for (const auto& attribute : attributes)
+        {
+            names.push_back(&attribute);
+        }
+        formatTableRow(names.data(), buffer);
+        for (size_t i = 0; i < attributes.size(); i++)
+        {
+            buffer.append(i + 1 < attributes.size() ? columnWidths[i] : attributes[i].size(), '-');
+            buffer += i + 1 < attributes.size() ? "  " : "\n";
+        }
+    }
+    else if (outputFormat == OutputFormat::Csv)
+    {
+        for (size_t column = 0; column < csvColumnCount; column++)
+        {
+            buffer += csvColumns[column];
+            buffer += column + 1 < csvColumnCount ? ',' : '\n';
+        }
+    }
+}
+
+// Function to count a user about to be written, after the heading if it is the first
+void UserWriter::startUser()
+{
+    if (!headerWritten)
+    {
+        writeHeader();
+    }
+    users++;
+}
+
+// Function to format the values of a user as a row of aligned columns
+void UserWriter::formatTableRow(const string* const* values, string& text) const
+{
+    for (size_t i = 0; i < attributes.size(); i++)
+    {
+        size_t length = 0;
+        if (values[i] != nullptr)
+        {
+            text += *values[i];
+            length = values[i]->size();
+        }
+        if (i + 1 < attributes.size())
+        {
+            text.append(length < columnWidths[i] ? columnWidths[i] - length + 2 : 2, ' ');
+        }
+    }
+    text += '\n';
+}
+
+// Function to format the values of a user as the columns of an import file
+void UserWriter::formatCsvRow(const string* const* values, string& text) const
+{
+    for (size_t column = 0; column < csvColumnCount; column++)
+    {
+        const string* first = csvFirstSources[column] < attributes.size() ? values[csvFirstSources[column]] : nullptr;
+        const string* lastName = csvLastNameSources[column] < attributes.size() ? values[csvLastNameSources[column]] : nullptr;
+        if (first != nullptr && lastName != nullptr && !lastName->empty())
+        {
+            if (isPlainCsvField(*first) && isPlainCsvField(*lastName))
+            {
+                text += *first;
+                text += ' ';
+                text += *lastName;
+            }
+            else
+            {
+                appendCsvField(text, *first + ' ' + *lastName);
+            }
+        }
+        else if (first != nullptr || lastName != nullptr)
+        {
+            appendCsvField(text, first != nullptr ? *first : *lastName);
+        }
+        text += column + 1 < csvColumnCount ? ',' : '\n';
+    }
+}
+
+// Function to format the DN and values of a user as one JSON object on a line
+void UserWriter::formatJsonLine(const string& dn, const string* const* values, string& text) const
+{
+    text += "{\"dn\":";
+    appendJsonString(text, dn);
+    for (size_t i = 0; i < attributes.size(); i++)
+    {
+        if (values[i] != nullptr)
+        {
+            text += ',';
+            appendJsonString(text, attributes[i]);
+            text += ':';
+            appendJsonString(text, *values[i]);
+        }
+    }
+    text += "}\n";
+}
+
+// Function to format one user onto the end of a string without writing it
+void UserWriter::formatUser(const string& dn, const vector<const string*>& values, string& text) const
+{
+    if (outputFormat == OutputFormat::Table)
+    {
+        formatTableRow(values.data(), text);
+    }
+    else if (outputFormat == OutputFormat::Csv)
+    {
+        formatCsvRow(values.data(), text);
+    }
+    else
+    {
+        formatJsonLine(dn, values.data(), text);
+    }
+}
+
+void UserWriter::formatUser(const DirectoryEntry& entry, string& text)
+{
+    for (size_t i = 0; i < attributes.size(); i++)
+    {
+        scratchValues[i] = entry.firstValue(attributes[i]);
+    }
+    formatUser(entry.dn, scratchValues, text);
+}
+
+// Function to write one user from a search result
+void UserWriter::writeUser(const DirectoryEntry& entry)
+{
+    startUser();
+    formatUser(entry, buffer);
+    if (buffer.size() >= bufferSize)
+    {
+        flush();
+    }
+}
+
+// Function to write one user from its DN and values
+void UserWriter::writeUser(const string& dn, const vector<const string*>& values)
+{
+    startUser();
+    formatUser(dn, values, buffer);
+    if (buffer.size() >= bufferSize)
+    {
+        flush();
+    }
+}
+
+// Function to write a user formatted by formatUser
+void UserWriter::writeFormatted(const string& text)
+{
+    startUser();
+    buffer += text;
+    if (buffer.size() >= bufferSize)
+    {
+        flush();
+    }
+}
+
+// Function to write everything buffered to the stream
+bool UserWriter::flush()
+{
+    if (!buffer.empty())
+    {
+        out.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+    out.flush();
+    return static_cast<bool>(out);
+}
+
+// Function to write what an empty listing needs and flush
+bool UserWriter::finish()
+{
+    if (!headerWritten && outputFormat == OutputFormat::Csv)
+    {
+        writeHeader();
+    }
+    return flush();
+}
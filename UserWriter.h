@@ -0,0 +1,88 @@
+#ifndef USERWRITER_H
+#define USERWRITER_H
+
+#include <cstddef>              // For size_t
+#include <ostream>              // For the output stream
+#include <string>               // For string operations
+#include <vector>               // For the attributes and values of a user
+#include "DirectoryBackend.h"   // For DirectoryEntry
+
+// Bytes of formatted users held before they are written to the output
+const size_t userWriterBufferSize = 1 << 20;
+
+// How users are written in listings
+enum class OutputFormat
+{
+    Table,          // One aligned row per user under a heading, for reading on a console
+    Csv,            // The columns of an import file, so a listing can be imported again
+    JsonLines       // One JSON object per user and line, with the DN and every attribute the user has
+};
+
+// Function to read an output format from its name (table, csv or jsonl), returns false if it isn't one
+bool parseOutputFormat(const std::string& name, OutputFormat& format);
+
+// Function to append a value as a CSV field, quoted only when it has to be
+void appendCsvField(std::string& text, const std::string& value);
+
+// Function to append a value as a JSON string literal
+void appendJsonString(std::string& text, const std::string& value);
+
+// Buffered writer of user listings
+// Users are formatted straight into one large buffer that is written to the stream when it fills up or
+// when flush() is called, so a listing costs a write per megabyte instead of one per line. Values are
+// given in the order of the attributes the writer was made with, nullptr for ones a user doesn't have.
+// The table heading and CSV header are written before the first user, and finish() writes the CSV header
+// of an empty listing so tools reading it still see the columns.
+class UserWriter
+{
+public:
+    UserWriter(std::ostream& out, OutputFormat format, const std::vector<std::string>& attributes, size_t bufferSize = userWriterBufferSize);
+    ~UserWriter();
+
+    UserWriter(const UserWriter&) = delete;
+    UserWriter& operator=(const UserWriter&) = delete;
+
+    // Function to write one user from a search result
+    void writeUser(const DirectoryEntry& entry);
+
+    // Function to write one user from its DN and values
+    void writeUser(const std::string& dn, const std::vector<const std::string*>& values);
+
+    // Function to format one user onto the end of a string without writing it, for users that are sorted first
+    void formatUser(const std::string& dn, const std::vector<const std::string*>& values, std::string& text) const;
+    void formatUser(const DirectoryEntry& entry, std::string& text);
+
+    // Function to write a user formatted by formatUser
+    void writeFormatted(const std::string& text);
+
+    // Function to write everything buffered to the stream, returns false if the stream failed
+    bool flush();
+
+    // Function to write what an empty listing needs and flush, returns false if the stream failed
+    bool finish();
+
+    OutputFormat format() const { return outputFormat; }
+    const std::vector<std::string>& writtenAttributes() const { return attributes; }
+    size_t userCount() const { return users; }
+
+private:
+    void writeHeader();
+    void startUser();
+    void formatTableRow(const std::string* const* values, std::string& text) const;
+    void formatCsvRow(const std::string* const* values, std::string& text) const;
+    void formatJsonLine(const std::string& dn, const std::string* const* values, std::string& text) const;
+
+    std::ostream& out;
+    OutputFormat outputFormat;
+    std::vector<std::string> attributes;
+    std::vector<size_t> columnWidths;
+    std::vector<size_t> csvFirstSources;
+    std::vector<size_t> csvLastNameSources;
+    std::vector<const std::string*> scratchValues;
+    std::string buffer;
+    size_t bufferSize;
+    size_t users;
+    bool headerWritten;
+};
+
+#endif // USERWRITER_H
@@ -0,0 +1,339 @@
+#include "WinldapBackend.h"
+
+using namespace std;
+
+// Link the Wldap32 library for LDAP functions
+#pragma comment(lib, "Wldap32.lib")
+
+// Null-terminated LDAPMod array pointing into the caller's strings
+// One is kept per connection and cleared between requests, so once it has grown to the largest entry
+// sent, building a request needs no memory allocation. Room is reserved up front so the pointers between
+// the vectors stay valid while it is built.
+struct WinldapBackend::ModList
+{
+    vector<berval> values;
+    vector<berval*> valuePointers;
+    vector<LDAPModA> modifications;
+    vector<LDAPModA*> mods;
+
+    // Function to empty the array and make room for the given number of attributes and values
+    void reset(size_t attributeCount, size_t valueCount)
+    {
+        values.clear();
+        valuePointers.clear();
+        modifications.clear();
+        mods.clear();
+        values.reserve(valueCount);
+        valuePointers.reserve(valueCount + attributeCount);
+        modifications.reserve(attributeCount);
+        mods.reserve(attributeCount + 1);
+    }
+
+    // Function to add one attribute, values are sent as binary so they may hold any bytes
+    template <typename Value>
+    void add(ULONG operation, const char* name, const Value* attributeValues, size_t valueCount)
+    {
+        size_t firstValue = valuePointers.size();
+        for (size_t i = 0; i < valueCount; i++)
+        {
+            const Value& value = attributeValues[i];
+            values.push_back({ static_cast<ULONG>(value.size()), const_cast<char*>(value.data()) });
+            valuePointers.push_back(&values.back());
+        }
+        valuePointers.push_back(nullptr);
+
+        LDAPModA modification;
+        modification.mod_op = operation | LDAP_MOD_BVALUES;
+        modification.mod_type = const_cast<char*>(name);
+        modification.mod_bvalues = valueCount == 0 ? nullptr : &valuePointers[firstValue];
+        modifications.push_back(modification);
+        mods.push_back(&modifications.back());
+    }
+
+    // Function to end the array, returns it ready for the request
+    LDAPModA** finish()
+    {
+        mods.push_back(nullptr);
+        return mods.data();
+    }
+};
+
+// Function to build the null-terminated attribute list of a search
+static vector<char*> attributeList(const vector<string>& attributes)
+{
+    vector<char*> list;
+    list.reserve(attributes.size() + 1);
+    for (const auto& attribute : attributes)
+    {
+        list.push_back(const_cast<char*>(attribute.c_str()));
+    }
+    list.push_back(nullptr);
+    return list;
+}
+
+// Function to copy the entries of a search result
+static void readEntries(LDAP* ldap, LDAPMessage* result, vector<DirectoryEntry>& entries)
+{
+    for (LDAPMessage* entry = ldap_first_entry(ldap, result); entry != nullptr; entry = ldap_next_entry(ldap, entry))
+    {
+        DirectoryEntry directoryEntry;
+        char* dn = ldap_get_dnA(ldap, entry);
+        if (dn)
+        {
+            directoryEntry.dn = dn;
+            ldap_memfreeA(dn);
+        }
+
+        BerElement* ber = nullptr;
+        for (char* attribute = ldap_first_attributeA(ldap, entry, &ber); attribute != nullptr; attribute = ldap_next_attributeA(ldap, entry, ber))
+        {
+            EntryAttribute entryAttribute;
+            entryAttribute.name = attribute;
+            berval** values = ldap_get_values_lenA(ldap, entry, attribute);
+            for (ULONG i = 0; values != nullptr && values[i] != nullptr; i++)
+            {
+                entryAttribute.values.emplace_back(values[i]->bv_val, values[i]->bv_len);
+            }
+            if (values)
+            {
+                ldap_value_free_len(values);
+            }
+            ldap_memfreeA(attribute);
+            directoryEntry.attributes.push_back(move(entryAttribute));
+        }
+        if (ber)
+        {
+            ber_free(ber, 0);
+        }
+
+        entries.push_back(move(directoryEntry));
+    }
+}
+
+WinldapBackend::WinldapBackend()
+    : ldap(nullptr), mods(new ModList())
+{
+}
+
+WinldapBackend::~WinldapBackend()
+{
+    close();
+}
+
+// Function to open a connection using LDAP version 3
+int WinldapBackend::open(const string& host, int port)
+{
+    close();
+
+    ldap = ldap_initA(const_cast<char*>(host.c_str()), port);
+    if (ldap == nullptr)
+    {
+        return LdapGetLastError();
+    }
+
+    ULONG version = LDAP_VERSION3;
+    int rc = ldap_set_option(ldap, LDAP_OPT_PROTOCOL_VERSION, reinterpret_cast<void*>(&version));
+    if (rc != LDAP_SUCCESS)
+    {
+        close();
+    }
+    return rc;
+}
+
+// Function to bind with a simple username and password
+int WinldapBackend::bind(const string& username, const string& password)
+{
+    return ldap_simple_bind_sA(ldap, const_cast<char*>(username.c_str()), const_cast<char*>(password.c_str()));
+}
+
+// Function to unbind and close the connection
+void WinldapBackend::close()
+{
+    if (ldap != nullptr)
+    {
+        ldap_unbind_s(ldap);
+        ldap = nullptr;
+    }
+}
+
+// Function to create another, unopened backend of the same kind that talks to the same directory
+unique_ptr<DirectoryBackend> WinldapBackend::createConnection() const
+{
+    return unique_ptr<DirectoryBackend>(new WinldapBackend());
+}
+
+// Function to add an entry without copying it
+int WinldapBackend::addEntry(const EntryView& entry, int* messageId)
+{
+    size_t valueCount = 0;
+    for (size_t i = 0; i < entry.attributeCount; i++)
+    {
+        valueCount += entry.attributes[i].valueCount;
+    }
+    mods->reset(entry.attributeCount, valueCount);
+    for (size_t i = 0; i < entry.attributeCount; i++)
+    {
+        mods->add(LDAP_MOD_ADD, entry.attributes[i].name, entry.attributes[i].values, entry.attributes[i].valueCount);
+    }
+
+    if (messageId == nullptr)
+    {
+        return ldap_add_ext_sA(ldap, const_cast<char*>(entry.dn), mods->finish(), nullptr, nullptr);
+    }
+    ULONG id = 0;
+    int rc = ldap_add_extA(ldap, const_cast<char*>(entry.dn), mods->finish(), nullptr, nullptr, &id);
+    *messageId = static_cast<int>(id);
+    return rc;
+}
+
+// Function to modify an entry
+int WinldapBackend::modifyEntry(const string& dn, const vector<AttributeChange>& changes, int* messageId)
+{
+    size_t valueCount = 0;
+    for (const auto& change : changes)
+    {
+        valueCount += change.values.size();
+    }
+    mods->reset(changes.size(), valueCount);
+    for (const auto& change : changes)
+    {
+        mods->add(change.operation, change.name.c_str(), change.values.data(), change.values.size());
+    }
+
+    if (messageId == nullptr)
+    {
+        return ldap_modify_ext_sA(ldap, const_cast<char*>(dn.c_str()), mods->finish(), nullptr, nullptr);
+    }
+    ULONG id = 0;
+    int rc = ldap_modify_extA(ldap, const_cast<char*>(dn.c_str()), mods->finish(), nullptr, nullptr, &id);
+    *messageId = static_cast<int>(id);
+    return rc;
+}
+
+// Function to delete an entry, together with its children when treeDelete is set
+int WinldapBackend::deleteEntry(const string& dn, bool treeDelete, int* messageId)
+{
+    LDAPControlA treeDeleteControl = { const_cast<char*>(treeDeleteControlOid), { 0, nullptr }, TRUE };
+    PLDAPControlA serverControls[] = { &treeDeleteControl, nullptr };
+    PLDAPControlA* controls = treeDelete ? serverControls : nullptr;
+
+    if (messageId == nullptr)
+    {
+        return ldap_delete_ext_sA(ldap, const_cast<char*>(dn.c_str()), controls, nullptr);
+    }
+    ULONG id = 0;
+    int rc = ldap_delete_extA(ldap, const_cast<char*>(dn.c_str()), controls, nullptr, &id);
+    *messageId = static_cast<int>(id);
+    return rc;
+}
+
+// Function to wait for the reply to any outstanding request
+int WinldapBackend::waitForResult(int& messageId, int& resultCode)
+{
+    LDAPMessage* message = nullptr;
+    ULONG messageType = ldap_result(ldap, LDAP_RES_ANY, LDAP_MSG_ALL, nullptr, &message);
+    if (messageType == 0 || messageType == static_cast<ULONG>(-1) || message == nullptr)
+    {
+        ldap_msgfree(message);
+        ULONG rc = LdapGetLastError();
+        return rc != LDAP_SUCCESS ? rc : LDAP_TIMEOUT;
+    }
+
+    messageId = static_cast<int>(message->lm_msgid);
+    resultCode = ldap_result2error(ldap, message, TRUE);
+    return LDAP_SUCCESS;
+}
+
+// Function to run a search and copy its entries, the result is kept for reading its controls
+int WinldapBackend::runSearch(const string& base, int scope, const string& filter, const vector<string>& attributes, size_t sizeLimit, PLDAPControlA* serverControls, vector<DirectoryEntry>& entries, LDAPMessage*& result)
+{
+    vector<char*> attrs = attributeList(attributes);
+    result = nullptr;
+    entries.clear();
+
+    int rc = ldap_search_ext_sA(ldap, const_cast<char*>(base.c_str()), scope, const_cast<char*>(filter.c_str()), attributes.empty() ? nullptr : attrs.data(),
+                                0, serverControls, nullptr, nullptr, static_cast<ULONG>(sizeLimit), &result);
+    if (result != nullptr)
+    {
+        readEntries(ldap, result, entries);
+    }
+    return rc;
+}
+
+// Function to search for matching entries, at most sizeLimit of them unless it is 0
+int WinldapBackend::search(const string& base, int scope, const string& filter, const vector<string>& attributes, size_t sizeLimit, vector<DirectoryEntry>& entries)
+{
+    LDAPMessage* result = nullptr;
+    int rc = runSearch(base, scope, filter, attributes, sizeLimit, nullptr, entries, result);
+    ldap_msgfree(result);
+    return rc;
+}
+
+// Function to read one page of a search with the Simple Paged Results control
+int WinldapBackend::searchPage(const string& base, int scope, const string& filter, const vector<string>& attributes, const string& sortAttribute, size_t pageSize, string& cookie, vector<DirectoryEntry>& entries)
+{
+    berval cookieValue = { static_cast<ULONG>(cookie.size()), const_cast<char*>(cookie.data()) };
+    PLDAPControlA pageControl = nullptr;
+    int rc = ldap_create_page_controlA(ldap, static_cast<ULONG>(pageSize), cookie.empty() ? nullptr : &cookieValue, FALSE, &pageControl);
+    if (rc != LDAP_SUCCESS)
+    {
+        return rc;
+    }
+
+    // The sort control goes with every page, the server keeps the sorted result set for the cookie
+    PLDAPControlA sortControl = nullptr;
+    if (!sortAttribute.empty())
+    {
+        LDAPSortKeyA sortKey;
+        sortKey.sk_attrtype = const_cast<char*>(sortAttribute.c_str());
+        sortKey.sk_matchruleoid = nullptr;
+        sortKey.sk_reverseorder = FALSE;
+        PLDAPSortKeyA sortKeys[] = { &sortKey, nullptr };
+        rc = ldap_create_sort_controlA(ldap, sortKeys, TRUE, &sortControl);
+        if (rc != LDAP_SUCCESS)
+        {
+            ldap_control_freeA(pageControl);
+            return rc;
+        }
+    }
+
+    PLDAPControlA serverControls[] = { pageControl, sortControl, nullptr };
+    LDAPMessage* result = nullptr;
+    rc = runSearch(base, scope, filter, attributes, 0, serverControls, entries, result);
+    ldap_control_freeA(pageControl);
+    if (sortControl != nullptr)
+    {
+        ldap_control_freeA(sortControl);
+    }
+    cookie.clear();
+
+    // Read the cookie for the next page, servers without paging support simply don't return one
+    if (result != nullptr)
+    {
+        ULONG resultCode = LDAP_SUCCESS;
+        PLDAPControlA* responseControls = nullptr;
+        if (ldap_parse_resultA(ldap, result, &resultCode, nullptr, nullptr, nullptr, &responseControls, FALSE) == LDAP_SUCCESS)
+        {
+            rc = resultCode;
+        }
+        if (responseControls != nullptr)
+        {
+            ULONG totalCount = 0;
+            berval* nextCookie = nullptr;
+            if (ldap_parse_page_controlA(ldap, responseControls, &totalCount, &nextCookie) == LDAP_SUCCESS && nextCookie != nullptr)
+            {
+                cookie.assign(nextCookie->bv_val, nextCookie->bv_len);
+                ber_bvfree(nextCookie);
+            }
+            ldap_controls_freeA(responseControls);
+        }
+    }
+    ldap_msgfree(result);
+    return rc;
+}
+
+// Function to describe a result code for error messages
+string WinldapBackend::errorString(int rc) const
+{
+    return ldap_err2stringA(rc);
+}
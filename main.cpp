@@ -1,340 +1,212 @@
 #include <iostream>     // For input and output operations
 #include <fstream>      // For file handling
 #include <sstream>      // For string stream operations
-#include <Windows.h>    // For Windows-specific functions
-#include <Winldap.h>    // For LDAP functions
 #include <string>       // For string operations
 #include <vector>       // For storing user data
-#include <map>          // For clustering errors
 #include <algorithm>    // For sorting
+#include <chrono>       // For timing bulk operations
+#include <memory>       // For the background task
+#include <thread>       // For following a background task
+#include "CsvParser.h"  // For reading CSV files
+#include "DirectoryBackend.h" // For talking to the directory
+#include "ImportEngine.h" // For importing over several connections
+#include "CsvImport.h"  // For reading import files with checkpoints
+#include "CsvValidation.h" // For checking import files before anything is sent
+#include "DirectorySearch.h" // For paged searches
+#include "UserCache.h"  // For the local user cache
+#include "DeltaSync.h"  // For syncing users with a CSV file
+#include "Ldif.h"       // For LDIF export and import
+#include "UserOperations.h" // For viewing and deleting users
+#include "UserWriter.h" // For writing user listings
+#include "UserQuery.h"  // For filtered queries and counts
+#include "Metrics.h"    // For latency histograms and counters
+#include "AppConfig.h"  // For the server and credentials
+#include "BatchMode.h"  // For commands given on the command line
+#include "FlowControl.h" // For the write rate limit
+#include "AsyncRuntime.h" // For running tasks while the menus stay in use
+#include "BackgroundTasks.h" // For imports and deletes in the background
 
 using namespace std;
 
-// Link the Wldap32 library for LDAP functions
-#pragma comment(lib, "Wldap32.lib")
-
 // Function to print sensitive information safely
 void printSensitiveInfo(const string& info)
 {
     cout << "Binding with DN: " << info << endl;
 }
 
-// Function to add a single LDAP user
-int addLDAPUser(LDAP* ldap, const string& id, const string& fullName, const string& phoneNumber, const string& email, const string& department, const string& jobDescription)
-{
-    int rc = LDAP_SUCCESS;
-
-    // Split the full name into first name and last name
-    istringstream iss(fullName);
-    string firstName, lastName;
-    iss >> firstName;
-    getline(iss, lastName);
-
-    // Construct the Distinguished Name (DN) for the new user
-    string newUserDN = "cn=" + id + ",ou=users,o=c_plusplus_project";
-
-    // Prepare the attributes for the new user
-    LDAPMod mod_cn, mod_sn, mod_givenName, mod_mail, mod_objectClass, mod_department, mod_phoneNumber, mod_jobDescription;
-    LDAPMod* mods[9];
-
-    // Set values for each attribute
-    char* cn_values[] = { const_cast<char*>(id.c_str()), nullptr };
-    char* sn_values[] = { const_cast<char*>(lastName.c_str()), nullptr };
-    char* givenName_values[] = { const_cast<char*>(firstName.c_str()), nullptr };
-    char* mail_values[] = { const_cast<char*>(email.c_str()), nullptr };
-    char* objectClass_values[] = { const_cast<char*>("inetOrgPerson"), const_cast<char*>("organizationalPerson"), const_cast<char*>("person"), const_cast<char*>("top"), nullptr };
-    char* department_values[] = { const_cast<char*>(department.c_str()), nullptr };
-    char* phoneNumber_values[] = { const_cast<char*>(phoneNumber.c_str()), nullptr };
-    char* jobDescription_values[] = { const_cast<char*>(jobDescription.c_str()), nullptr };
-
-    // Fill in LDAPMod structures
-    mod_cn.mod_op = LDAP_MOD_ADD;
-    mod_cn.mod_type = const_cast<char*>("cn");
-    mod_cn.mod_values = cn_values;
-
-    mod_sn.mod_op = LDAP_MOD_ADD;
-    mod_sn.mod_type = const_cast<char*>("sn");
-    mod_sn.mod_values = sn_values;
-
-    mod_givenName.mod_op = LDAP_MOD_ADD;
-    mod_givenName.mod_type = const_cast<char*>("givenName");
-    mod_givenName.mod_values = givenName_values;
-
-    mod_mail.mod_op = LDAP_MOD_ADD;
-    mod_mail.mod_type = const_cast<char*>("mail");
-    mod_mail.mod_values = mail_values;
-
-    mod_objectClass.mod_op = LDAP_MOD_ADD;
-    mod_objectClass.mod_type = const_cast<char*>("objectClass");
-    mod_objectClass.mod_values = objectClass_values;
-
-    mod_department.mod_op = LDAP_MOD_ADD;
-    mod_department.mod_type = const_cast<char*>("ou");
-    mod_department.mod_values = department_values;
-
-    mod_phoneNumber.mod_op = LDAP_MOD_ADD;
-    mod_phoneNumber.mod_type = const_cast<char*>("telephoneNumber");
-    mod_phoneNumber.mod_values = phoneNumber_values;
-
-    mod_jobDescription.mod_op = LDAP_MOD_ADD;
-    mod_jobDescription.mod_type = const_cast<char*>("description");
-    mod_jobDescription.mod_values = jobDescription_values;
-
-    // Add all attributes to the mods array
-    mods[0] = &mod_cn;
-    mods[1] = &mod_sn;
-    mods[2] = &mod_givenName;
-    mods[3] = &mod_mail;
-    mods[4] = &mod_objectClass;
-    mods[5] = &mod_department;
-    mods[6] = &mod_phoneNumber;
-    mods[7] = &mod_jobDescription;
-    mods[8] = nullptr;
-
-    // Perform the add operation
-    rc = ldap_add_ext_sA(ldap, const_cast<char*>(newUserDN.c_str()), mods, nullptr, nullptr);
-    return rc;
-}
-
-// Function to check if an LDAP user exists
-bool userExists(LDAP* ldap, const string& userDN)
+// Function to display detailed information of a user held in the local cache
+void displayCachedUser(const CachedUser& user)
 {
-    int rc = LDAP_SUCCESS;
-    LDAPMessage* result = nullptr;
-
-    // Search for the user in the LDAP directory
-    rc = ldap_search_ext_sA(ldap, const_cast<char*>(userDN.c_str()), LDAP_SCOPE_BASE, const_cast<char*>("(objectClass=inetOrgPerson)"), nullptr, 0, nullptr, nullptr, nullptr, LDAP_NO_LIMIT, &result);
-
-    if (rc == LDAP_SUCCESS && ldap_count_entries(ldap, result) > 0)
+    cout << "\nUser Details (DN: " << user.dn << "):\n";
+    for (const auto& attribute : user.attributes)
     {
-        ldap_msgfree(result);
-        return true;
+        cout << attribute.first << ": " << attribute.second << '\n';
     }
-
-    ldap_msgfree(result);
-    return false;
+    cout << flush;
 }
 
-// Function to delete all LDAP users under a specific path
-int deleteAllLDAPUsers(LDAP* ldap, const string& basePath)
+// Function to find the value of an attribute of a cached user, returns nullptr if the user doesn't have it
+const string* cachedValue(const CachedUser& user, const string& attribute)
 {
-    int rc = LDAP_SUCCESS;
-
-    LDAPMessage* result = nullptr;
-    LDAPMessage* entry = nullptr;
-    string filter = "(objectClass=inetOrgPerson)";
-    char* attrs[] = { const_cast<char*>("cn"), nullptr };
-
-    // Construct the search base
-    string searchBase = "ou=users," + basePath;
-
-    // Search for all users under the specified base path
-    rc = ldap_search_ext_sA(ldap, const_cast<char*>(searchBase.c_str()), LDAP_SCOPE_ONELEVEL, const_cast<char*>(filter.c_str()), attrs, 0, nullptr, nullptr, nullptr, LDAP_NO_LIMIT, &result);
-
-    if (rc != LDAP_SUCCESS)
+    for (const auto& cached : user.attributes)
     {
-        cerr << "LDAP search failed: " << ldap_err2stringA(rc) << endl;
-        return rc;
-    }
-
-    // Check if the user list is empty
-    if (ldap_count_entries(ldap, result) == 0)
-    {
-        cout << "There are no users to delete. Try adding users to the directory first." << endl;
-        ldap_msgfree(result);
-        return rc;
-    }
-
-    // Iterate through the search results and delete each user
-    for (entry = ldap_first_entry(ldap, result); entry != nullptr; entry = ldap_next_entry(ldap, entry))
-    {
-        char* dn = ldap_get_dnA(ldap, entry);
-        cout << "Deleting user with DN: " << dn << endl;
-
-        rc = ldap_delete_ext_sA(ldap, dn, nullptr, nullptr);
-        if (rc != LDAP_SUCCESS)
+        if (sameAttributeName(cached.first, attribute))
         {
-            cerr << "Failed to delete user with DN '" << dn << "': " << ldap_err2stringA(rc) << endl;
-            ldap_memfreeA(dn);
-            continue;
+            return &cached.second;
         }
-
-        ldap_memfreeA(dn);
     }
-
-    ldap_msgfree(result);
-    cout << "All users have been deleted successfully." << endl;
-
-    return rc;
+    return nullptr;
 }
 
-// Function to delete a single LDAP user by user ID
-int deleteSingleLDAPUser(LDAP* ldap, const string& userDN)
+// Function to write a cached user to a listing
+void writeCachedUser(UserWriter& writer, const CachedUser& user, vector<const string*>& values)
 {
-    int rc = LDAP_SUCCESS;
-
-    // Check if the user exists before attempting to delete
-    if (!userExists(ldap, userDN))
+    values.resize(displayedAttributes.size());
+    for (size_t i = 0; i < displayedAttributes.size(); i++)
     {
-        cout << "User with DN '" << userDN << "' does not exist." << endl;
-        return LDAP_NO_SUCH_OBJECT;
+        values[i] = cachedValue(user, displayedAttributes[i]);
     }
+    writer.writeUser(user.dn, values);
+}
 
-    rc = ldap_delete_ext_sA(ldap, const_cast<char*>(userDN.c_str()), nullptr, nullptr);
-    if (rc != LDAP_SUCCESS)
-    {
-        cerr << "Failed to delete user with DN '" << userDN << "': " << ldap_err2stringA(rc) << endl;
-    }
-    else
+// Function to prompt for the format of a listing, falling back to a table on empty or invalid input
+OutputFormat promptForOutputFormat()
+{
+    string formatName;
+    OutputFormat format = OutputFormat::Table;
+    cout << "Show users as a table, csv or jsonl? (press Enter for table): ";
+    getline(cin, formatName);
+    if (!formatName.empty() && !parseOutputFormat(formatName, format))
     {
-        cout << "User with DN '" << userDN << "' has been deleted successfully." << endl;
+        cout << "Error: Invalid format. Showing users as a table instead." << endl;
     }
-
-    return rc;
+    return format;
 }
 
-// Function to check if a line is properly comma-delimited and matches the expected format
-bool isProperlyFormatted(const string& line)
+// Function to prompt for the criteria of a query, criteria left empty match every user
+UserQuery promptForUserQuery()
 {
-    istringstream iss(line);
-    string token;
-    int columnCount = 0;
-
-    while (getline(iss, token, ','))
+    UserQuery query;
+    cout << "Department (ou) to match (press Enter for any): ";
+    getline(cin, query.department);
+    cout << "Email domain to match, such as example.com (press Enter for any): ";
+    getline(cin, query.emailDomain);
+    cout << "Start of the job description to match (press Enter for any): ";
+    getline(cin, query.jobDescriptionPrefix);
+
+    string idRange;
+    cout << "Range of user IDs to match, such as 100-250, 100- or -250 (press Enter for any): ";
+    getline(cin, idRange);
+    if (!idRange.empty() && !parseIdRange(idRange, query.idFrom, query.idTo))
     {
-        columnCount++;
+        cout << "Error: Invalid ID range. Matching any ID instead." << endl;
     }
-
-    return columnCount == 6;
+    return query;
 }
 
-// Function to display detailed information of a single LDAP user
-void displaySingleLDAPUser(LDAP* ldap, const string& userDN)
+// Function to prompt for a positive number, falling back to a default on empty or invalid input
+size_t promptForCount(const string& prompt, const string& what, size_t defaultValue)
 {
-    int rc = LDAP_SUCCESS;
-
-    LDAPMessage* result = nullptr;
-    LDAPMessage* entry = nullptr;
-    char* attrs[] = { const_cast<char*>("cn"), const_cast<char*>("sn"), const_cast<char*>("givenName"), const_cast<char*>("mail"), const_cast<char*>("ou"), const_cast<char*>("telephoneNumber"), const_cast<char*>("description"), nullptr };
-
-    // Search for the user in the LDAP directory
-    rc = ldap_search_ext_sA(ldap, const_cast<char*>(userDN.c_str()), LDAP_SCOPE_BASE, const_cast<char*>("(objectClass=inetOrgPerson)"), attrs, 0, nullptr, nullptr, nullptr, LDAP_NO_LIMIT, &result);
-
-    if (rc != LDAP_SUCCESS)
+    string numberInput;
+    cout << prompt << " (press Enter for " << defaultValue << "): ";
+    getline(cin, numberInput);
+    if (numberInput.empty())
     {
-        cerr << "LDAP search failed: " << ldap_err2stringA(rc) << endl;
-        return;
+        return defaultValue;
     }
 
-    entry = ldap_first_entry(ldap, result);
-    if (entry != nullptr)
-    {
-        cout << "\nUser Details (DN: " << userDN << "):\n";
-        for (int i = 0; attrs[i] != nullptr; i++)
-        {
-            char* attr = attrs[i];
-            BerElement* ber = nullptr;
-            char** values = ldap_get_valuesA(ldap, entry, attr);
-            if (values)
-            {
-                cout << attr << ": " << values[0] << endl;
-                ldap_value_freeA(values);
-            }
-        }
-    }
-    else
+    size_t value = 0;
+    istringstream numberStream(numberInput);
+    if (!(numberStream >> value) || value == 0)
     {
-        cout << "No user found with DN: " << userDN << endl;
+        cerr << "Error: Invalid number of " << what << ". Using " << defaultValue << " instead." << endl;
+        return defaultValue;
     }
-
-    ldap_msgfree(result);
+    return value;
 }
 
-// Function to display all LDAP users under a specific path
-void displayAllLDAPUsers(LDAP* ldap, const string& basePath)
+// Function to check every row of an import file before anything is sent, recording the rejected rows in the report
+// A resumed import appends to a report that already lists them, so they are only skipped. validated is set when the
+// file could be checked. Returns false when rows were rejected and the user chose not to add the others.
+bool checkImportFile(const string& filePath, bool resumed, CsvValidationResult& validation, ImportReport& report, bool& validated)
 {
-    int rc = LDAP_SUCCESS;
-
-    LDAPMessage* result = nullptr;
-    LDAPMessage* entry = nullptr;
-    string filter = "(objectClass=inetOrgPerson)";
-    char* attrs[] = { const_cast<char*>("cn"), const_cast<char*>("sn"), const_cast<char*>("givenName"), const_cast<char*>("mail"), const_cast<char*>("ou"), const_cast<char*>("telephoneNumber"), const_cast<char*>("description"), nullptr };
-
-    // Construct the search base
-    string searchBase = "ou=users," + basePath;
+    // Every row is checked on all cores, so a bad file is caught in seconds
+    auto validationStart = chrono::steady_clock::now();
+    validated = validateCsvFile(filePath, 0, validation) && validation.headerValid;
+    size_t rejectedRows = validated && !resumed ? recordCsvIssues(validation, report) : 0;
+    if (rejectedRows == 0)
+    {
+        return true;
+    }
 
-    // Search for all users under the specified base path
-    rc = ldap_search_ext_sA(ldap, const_cast<char*>(searchBase.c_str()), LDAP_SCOPE_ONELEVEL, const_cast<char*>(filter.c_str()), attrs, 0, nullptr, nullptr, nullptr, LDAP_NO_LIMIT, &result);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - validationStart).count();
+    cout << "Checked " << validation.rowCount << " rows in " << seconds << " seconds, " << rejectedRows << " can't be added." << endl;
+    report.printSummary(cout);
 
-    if (rc != LDAP_SUCCESS)
+    string addChoice;
+    if (validation.issues.size() < validation.rowCount)
     {
-        cerr << "LDAP search failed: " << ldap_err2stringA(rc) << endl;
-        return;
+        cout << "Add the other users anyway? (y/n): ";
+        getline(cin, addChoice);
     }
-
-    // Check if the user list is empty
-    if (ldap_count_entries(ldap, result) == 0)
+    if (addChoice != "y" && addChoice != "yes")
     {
-        cout << "There are no users to display. Try adding users to the directory first." << endl;
-        ldap_msgfree(result);
-        return;
+        cout << "No users were added. Every row that can't be added is listed in " << defaultReportPath << ". Returning to menu." << endl;
+        return false;
     }
+    return true;
+}
 
-    // Store users in a vector to sort them by ID
-    vector<string> users;
-    for (entry = ldap_first_entry(ldap, result); entry != nullptr; entry = ldap_next_entry(ldap, entry))
+// Function to print the outcome of a background task that has finished and close its report
+void reportBackgroundTask(BackgroundTask& task)
+{
+    task.report.close();
+    cout << "\nFinished in the background: " << describeBackgroundTask(task) << "." << endl;
+    if (!task.error.empty())
     {
-        char* dn = ldap_get_dnA(ldap, entry);
-        users.push_back(dn);
-        ldap_memfreeA(dn);
+        cerr << "Error: " << task.error << "." << endl;
     }
-
-    // Sort users by their IDs
-    sort(users.begin(), users.end());
-
-    // Display sorted users
-    cout << "\nExisting LDAP users under " << searchBase << ":\n";
-    for (const auto& user : users)
+    else if (task.cancelRequested.load(memory_order_relaxed))
     {
-        cout << "\nUser Details (DN: " << user << "):\n";
-        rc = ldap_search_ext_sA(ldap, const_cast<char*>(user.c_str()), LDAP_SCOPE_BASE, const_cast<char*>("(objectClass=inetOrgPerson)"), attrs, 0, nullptr, nullptr, nullptr, LDAP_NO_LIMIT, &result);
-        if (rc == LDAP_SUCCESS)
-        {
-            entry = ldap_first_entry(ldap, result);
-            for (int i = 0; attrs[i] != nullptr; i++)
-            {
-                char* attr = attrs[i];
-                BerElement* ber = nullptr;
-                char** values = ldap_get_valuesA(ldap, entry, attr);
-                if (values)
-                {
-                    cout << attr << ": " << values[0] << endl;
-                    ldap_value_freeA(values);
-                }
-            }
-        }
-        ldap_msgfree(result);
+        cout << "The task was cancelled before every user was done." << endl;
     }
+    task.report.printSummary(cout);
 }
 
-int main()
+int main(int argc, char* argv[])
 {
+    // A command on the command line runs without the menus
+    if (argc > 1)
+    {
+        return runBatchCommand(argc, argv);
+    }
+
     // Display application purpose
     cout << "\n\nWelcome to the LDAP User Management Application.\n";
     cout << "This application allows you to manage LDAP users, including adding, viewing, and deleting users.\n";
     cout << "Please follow the prompts to perform the desired operations.\n" << endl;
 
-    LDAP* ldap = nullptr;
+    // LDAP server details, from the config file named by LDAP_CONFIG and the environment when set
+    AppConfig config;
+    string configError;
+    if (!loadAppConfig("", config, configError))
+    {
+        cerr << "Error: " << configError << "." << endl;
+        return 1;
+    }
+
+    // The directory backend is picked once, every connection of this run uses the same kind
+    // A connection lost while the menus are in use is restored without asking to connect again.
+    unique_ptr<DirectoryBackend> backend = createDirectoryBackend(config.keepaliveInterval);
+    DirectoryBackend* ldap = backend.get();
     int rc = 0;
     string connectChoice;
     bool firstAttempt = true;
+    const LDAPConnectionSettings& connectionSettings = config.connection;
+    const string& basePath = config.basePath;
 
-    // LDAP server details
-    const char* ldapHost = "xxx.xxx.x.x"; // hidden for security purposes
-    int ldapPort = 389;
-    const char* ldapUsername = "cn=idamadmin,ou=sa,o=pitg";
-    const char* ldapPassword = "xxxxxxxxxxx"; // hidden for security purposes
-    string basePath = "o=c_plusplus_project";
+    // Writes are paced over every connection when the server has to be shared
+    writeRateLimiter().setRate(config.maxOpsPerSecond);
 
     while (true)
     {
@@ -357,47 +229,69 @@ int main()
             firstAttempt = false;
             cout << "Attempting to initialize LDAP connection..." << endl;
 
-            // Initialize LDAP connection
-            ldap = ldap_initA(const_cast<char*>(ldapHost), ldapPort);
-            if (ldap == nullptr)
-            {
-                cerr << "Failed to initialize LDAP connection. Please try again later." << endl;
-                continue;
-            }
-            cout << "LDAP connection initialized successfully." << endl;
-
-            cout << "Setting LDAP protocol version..." << endl;
-
-            // Set LDAP options
-            ULONG version = LDAP_VERSION3;
-            cout << "Setting LDAP option: LDAP_OPT_PROTOCOL_VERSION = " << version << endl;
-            rc = ldap_set_option(ldap, LDAP_OPT_PROTOCOL_VERSION, reinterpret_cast<void*>(&version));
+            // Initialize LDAP connection using LDAP version 3
+            rc = ldap->open(connectionSettings.host, connectionSettings.port);
             if (rc != LDAP_SUCCESS)
             {
-                cerr << "Failed to set LDAP protocol version: " << ldap_err2stringA(rc) << endl;
-                ldap_unbind_s(ldap);
+                cerr << "Failed to initialize LDAP connection: " << ldap->errorString(rc) << endl;
+                cout << "Please try again later." << endl;
                 continue;
             }
-            cout << "LDAP protocol version set successfully." << endl;
+            cout << "LDAP connection initialized successfully." << endl;
 
             cout << "Attempting LDAP bind..." << endl;
 
             // Bind to LDAP server (authenticate)
-            printSensitiveInfo(ldapUsername);
-            rc = ldap_simple_bind_sA(ldap, const_cast<char*>(ldapUsername), const_cast<char*>(ldapPassword));
+            printSensitiveInfo(connectionSettings.username);
+            rc = ldap->bind(connectionSettings.username, connectionSettings.password);
             if (rc != LDAP_SUCCESS)
             {
-                cerr << "LDAP bind failed: " << ldap_err2stringA(rc) << endl;
-                ldap_unbind_s(ldap);
+                cerr << "LDAP bind failed: " << ldap->errorString(rc) << endl;
+                ldap->close();
                 cout << "Please try again later." << endl;
                 continue;
             }
             cout << "LDAP bind successful." << endl;
 
+            // Cached answers to "are there any users" for this session
+            UserCountProbe userCount(ldap, basePath);
+
+            // Optional local copy of the users, turned on from the menu
+            UserCache userCache(ldap, basePath);
+
+            // One import or delete at a time can run in the background on this connection
+            // While it runs, the menus only use the connection through runtime.call(), which runs a request
+            // on the event loop between replies. With none running the loop is idle and they use it directly.
+            unique_ptr<BackgroundTask> backgroundTask;
+            AsyncRuntime runtime(ldap);
+            runtime.start();
+
             // Menu-driven interface
             string choice;
             while (true)
             {
+                // Publish the metrics of the previous operation before showing the menu again
+                if (!writeMetricsSnapshot())
+                {
+                    cerr << "Warning: Failed to write the metrics snapshot." << endl;
+                }
+
+                // A background task is reported once it has finished, and its progress shown until then
+                if (backgroundTask && backgroundTask->finished.load(memory_order_acquire))
+                {
+                    reportBackgroundTask(*backgroundTask);
+                    backgroundTask.reset();
+                    userCount.invalidate();
+                    if (userCache.isLoaded())
+                    {
+                        userCache.refresh(true);
+                    }
+                }
+                else if (backgroundTask)
+                {
+                    cout << "\nIn the background: " << describeBackgroundTask(*backgroundTask) << endl;
+                }
+
                 // Display the main menu
                 cout << "\n+-------------------------------------+\n";
                 cout << "| LDAP User Management Menu           |\n";
@@ -406,11 +300,22 @@ int main()
                 cout << "| 1. Add users from a .csv file       |\n";
                 cout << "| 2. View single/all existing users   |\n";
                 cout << "| 3. Delete single/all existing users |\n";
-                cout << "| 4. Close connection and exit        |\n";
+                cout << "| 4. Turn local user cache on/off     |\n";
+                cout << "| 5. Sync users with a .csv file      |\n";
+                cout << "| 6. Export/import users as .ldif     |\n";
+                cout << "| 7. Show/cancel background task      |\n";
+                cout << "| 8. Close connection and exit        |\n";
                 cout << "+-------------------------------------+\n";
                 cout << "Enter your choice: ";
                 getline(cin, choice);
 
+                // Only viewing is allowed while a background task is changing the users
+                if (backgroundTask && (choice == "1" || choice == "3" || choice == "4" || choice == "5" || choice == "6"))
+                {
+                    cout << "A task is running in the background. Wait for it to finish or cancel it with option 7 first." << endl;
+                    continue;
+                }
+
                 if (choice == "1")
                 {
                     // Add users from a .csv file
@@ -430,8 +335,8 @@ int main()
                         }
 
                         // Check if the file exists
-                        ifstream file(filePath);
-                        if (!file)
+                        CsvReader file;
+                        if (!file.open(filePath))
                         {
                             cerr << "Error: The file does not exist. Please enter the correct file again." << endl;
                             continue;
@@ -444,134 +349,149 @@ int main()
                             continue;
                         }
 
-                        string line;
-                        bool headerChecked = false;
-                        bool properFormat = true;
-                        bool hasValidDataRow = false;
-
-                        // Structure to store user results
-                        struct UserResult
+                        // A background import uses this connection only, and the menus stay in use while it runs
+                        string backgroundChoice;
+                        cout << "Run the import in the background? (y/n): ";
+                        getline(cin, backgroundChoice);
+                        if (backgroundChoice == "y" || backgroundChoice == "yes")
                         {
-                            string id;
-                            string error;
-                        };
-                        vector<UserResult> results;
-                        vector<string> addedUsers;
+                            size_t importWindow = promptForCount("Enter the number of add requests to keep in flight", "requests", defaultImportWindow);
+                            file.close();
 
-                        // Read the CSV file line by line
-                        while (getline(file, line))
-                        {
-                            if (!headerChecked)
+                            unique_ptr<BackgroundTask> task(new BackgroundTask());
+                            task->description = "Adding users from " + filePath;
+                            if (!task->report.open(defaultReportPath))
                             {
-                                // Check if the header is correct
-                                if (line != "id,full_name,phone_number,email,department,job_description")
-                                {
-                                    cerr << "Error: CSV file header is incorrect. Returning to menu." << endl;
-                                    properFormat = false;
-                                    break;
-                                }
-                                headerChecked = true;
-                                continue;
+                                cerr << "Warning: The report file " << defaultReportPath << " can't be created, failures are only counted." << endl;
                             }
-
-                            // Check if the line is properly formatted
-                            if (!isProperlyFormatted(line))
+                            bool validated = false;
+                            if (!checkImportFile(filePath, false, task->validation, task->report, validated))
                             {
-                                cerr << "Error: File is not properly comma-delimited. Returning to menu." << endl;
-                                properFormat = false;
+                                task->report.close();
                                 break;
                             }
 
-                            // Extract user details from the line
-                            string id, fullName, phoneNumber, email, department, jobDescription;
-                            istringstream iss(line);
-                            if (getline(getline(iss, id, ','), fullName, ',') &&
-                                getline(getline(getline(getline(iss, phoneNumber, ','), email, ','), department, ','), jobDescription, ','))
+                            backgroundTask = move(task);
+                            backgroundTask->startTime = chrono::steady_clock::now();
+                            runtime.spawn(importCsvInBackground(runtime, basePath, filePath, importWindow, *backgroundTask));
+                            cout << "Adding users in the background. Choose 7 to follow or cancel the import." << endl;
+                            break;
+                        }
+
+                        // Prompt user for the number of connections and add requests to keep in flight
+                        size_t importConnections = promptForCount("Enter the number of connections to import with", "connections", defaultImportConnections);
+                        size_t importWindow = promptForCount("Enter the number of add requests to keep in flight per connection", "requests", defaultImportWindow);
+
+                        // An earlier import of this file that didn't finish can carry on where it stopped
+                        string journalPath = journalPathFor(filePath);
+                        ImportCheckpoint checkpoint;
+                        bool resume = false;
+                        if (loadImportCheckpoint(journalPath, checkpoint))
+                        {
+                            if (checkpoint.fileSize != file.fileSize())
                             {
-                                string userDN = "cn=" + id + ",ou=users," + basePath;
-                                if (userExists(ldap, userDN))
-                                {
-                                    results.push_back({ id, "User already exists" });
-                                }
-                                else
-                                {
-                                    rc = addLDAPUser(ldap, id, fullName, phoneNumber, email, department, jobDescription);
-                                    if (rc != LDAP_SUCCESS)
-                                    {
-                                        results.push_back({ id, ldap_err2stringA(rc) });
-                                    }
-                                    else
-                                    {
-                                        hasValidDataRow = true;
-                                        addedUsers.push_back(id);
-                                    }
-                                }
+                                cout << "The file has changed since an earlier import of it stopped, so the whole file will be imported." << endl;
+                            }
+                            else
+                            {
+                                string resumeChoice;
+                                cout << "An earlier import of this file stopped with every user up to line " << checkpoint.committedRecords << " done. Resume it? (y/n): ";
+                                getline(cin, resumeChoice);
+                                resume = resumeChoice == "y" || resumeChoice == "yes";
                             }
                         }
-                        file.close();
 
-                        // Display results of adding users
-                        if (properFormat && !hasValidDataRow)
+                        // Failures are written to the report file as they happen instead of being kept
+                        ImportReport report;
+                        if (!report.open(defaultReportPath, resume))
                         {
-                            cerr << "Error: CSV file does not contain any valid data rows. Returning to menu." << endl;
+                            cerr << "Warning: The report file " << defaultReportPath << " can't be created, failures are only counted." << endl;
                         }
-                        else if (results.empty())
+
+                        // Every row is checked before anything is sent
+                        CsvValidationResult validation;
+                        bool validated = false;
+                        if (!checkImportFile(filePath, resume, validation, report, validated))
                         {
-                            cout << "All users successfully added: ";
-                            for (const auto& user : addedUsers)
-                            {
-                                cout << user << " ";
-                            }
-                            cout << endl;
+                            report.close();
+                            break;
                         }
-                        else if (addedUsers.empty())
+
+                        // Rows are handed to the import engine in batches, one worker per connection
+                        ImportEngine engine(ldap, connectionSettings, basePath, importConnections, importWindow, report);
+                        vector<ImportRow> addedRows;
+                        if (userCache.isLoaded())
                         {
-                            bool sameError = true;
-                            string commonError = results[0].error;
-                            for (const auto& result : results)
-                            {
-                                if (result.error != commonError)
-                                {
-                                    sameError = false;
-                                    break;
-                                }
-                            }
-                            if (sameError)
-                            {
-                                cout << "All users can't be added due to the same reason: " << commonError << endl;
-                            }
-                            else
+                            engine.setAddedListener([&addedRows](const ImportRow& row) { addedRows.push_back(row); });
+                        }
+
+                        // Rows answered by the server are tracked so the journal can be checkpointed
+                        ImportProgress progress(file.fileSize());
+                        engine.setAnsweredListener([&progress](const ImportRow& row) { progress.finished(row); });
+                        importConnections = engine.start();
+
+                        CsvImportOptions importOptions;
+                        importOptions.progress = &progress;
+                        importOptions.journalPath = journalPath;
+                        importOptions.resumeFrom = resume ? &checkpoint : nullptr;
+                        importOptions.validation = validated ? &validation : nullptr;
+                        if (userCache.isLoaded())
+                        {
+                            // Users known to the local cache are reported without a round trip
+                            importOptions.skip = [&userCache, &report](const ImportRow& row)
                             {
-                                map<string, vector<string>> clusteredErrors;
-                                for (const auto& result : results)
+                                if (userCache.find(row.id) == nullptr)
                                 {
-                                    clusteredErrors[result.error].push_back(result.id);
+                                    return false;
                                 }
-                                cout << "All users can't be added due to the following reasons:" << endl;
-                                for (const auto& error : clusteredErrors)
-                                {
-                                    cout << "Reason: " << error.first << " - Users: ";
-                                    for (const auto& id : error.second)
-                                    {
-                                        cout << id << " ";
-                                    }
-                                    cout << endl;
-                                }
-                            }
+                                report.recordFailure(row.id, "User already exists");
+                                return true;
+                            };
+                        }
+
+                        // Read the CSV file record by record, validating columns and quoting in the same pass
+                        CsvImportResult importResult = submitCsvRows(file, engine, importOptions);
+                        file.close();
+                        bool properFormat = importResult.status == CsvImportStatus::Complete || importResult.status == CsvImportStatus::Empty;
+                        if (!properFormat)
+                        {
+                            cerr << "Error: " << describeCsvImport(importResult) << ". Returning to menu." << endl;
+                        }
+
+                        // Wait for every connection to finish its rows
+                        engine.finish();
+                        report.close();
+                        bool journalRemoved = finishCsvImportJournal(importOptions, importResult);
+                        for (const auto& row : addedRows)
+                        {
+                            userCache.recordAdd(row);
+                        }
+                        if (report.addedCount() > 0)
+                        {
+                            userCount.invalidate();
+                        }
+
+                        // Display results of adding users, only counts and a few IDs per reason are shown
+                        if (properFormat && report.addedCount() == 0 && report.failedCount() == 0)
+                        {
+                            cerr << "Error: CSV file does not contain any valid data rows. Returning to menu." << endl;
+                        }
+                        else if (report.failedCount() == 0)
+                        {
+                            cout << "All " << report.addedCount() << " users successfully added." << endl;
                         }
                         else
                         {
-                            cout << "Some users couldn't be added:" << endl;
-                            for (const auto& result : results)
-                            {
-                                cout << "User ID: " << result.id << " - Reason: " << result.error << endl;
-                            }
-                            cout << "Successfully added users: ";
-                            for (const auto& user : addedUsers)
-                            {
-                                cout << user << " ";
-                            }
-                            cout << endl;
+                            cout << "Successfully added " << report.addedCount() << " users." << endl;
+                            report.printSummary(cout);
+                        }
+                        if (importResult.resumedRows > 0)
+                        {
+                            cout << importResult.resumedRows << " users imported before the import was resumed were skipped." << endl;
+                        }
+                        if (!journalRemoved)
+                        {
+                            cout << progress.unfinishedCount() << " users were not answered by the server. Add users from the same file again to resume the import." << endl;
                         }
 
                         break;
@@ -579,19 +499,14 @@ int main()
                 }
                 else if (choice == "2")
                 {
-                    int userCount = 0;
-                    // Check if there are any users to display
-                    LDAPMessage* result = nullptr;
-                    string filter = "(objectClass=inetOrgPerson)";
-                    string searchBase = "ou=users," + basePath;
-                    rc = ldap_search_ext_sA(ldap, const_cast<char*>(searchBase.c_str()), LDAP_SCOPE_ONELEVEL, const_cast<char*>(filter.c_str()), nullptr, 0, nullptr, nullptr, nullptr, LDAP_NO_LIMIT, &result);
-                    if (rc == LDAP_SUCCESS)
+                    // Check if there are any users to display without listing them, counted again while a task changes them
+                    bool noUsers = false;
+                    if (backgroundTask)
                     {
-                        userCount = ldap_count_entries(ldap, result);
+                        userCount.invalidate();
                     }
-                    ldap_msgfree(result);
-
-                    if (userCount == 0)
+                    runtime.call([&]() { noUsers = userCount.isEmpty(); });
+                    if (noUsers)
                     {
                         cout << "There are no users to view. Try adding users to the directory first." << endl;
                     }
@@ -601,7 +516,7 @@ int main()
                         {
                             // View single/all existing users
                             string viewChoice;
-                            cout << "View a single user or all users? (single/all): ";
+                            cout << "View a single user, all users, the number of users or a query? (single/all/count/query): ";
                             getline(cin, viewChoice);
 
                             if (viewChoice == "single")
@@ -610,36 +525,148 @@ int main()
                                 cout << "Enter the user ID (cn): ";
                                 getline(cin, userId);
                                 string userDN = "cn=" + userId + ",ou=users," + basePath;
-                                displaySingleLDAPUser(ldap, userDN);
+                                const CachedUser* cachedUser = userCache.isLoaded() && !backgroundTask ? userCache.find(userId) : nullptr;
+                                if (cachedUser != nullptr)
+                                {
+                                    displayCachedUser(*cachedUser);
+                                }
+                                else
+                                {
+                                    runtime.call([&]() { displaySingleLDAPUser(ldap, userDN); });
+                                }
                                 break;
                             }
                             else if (viewChoice == "all")
                             {
-                                displayAllLDAPUsers(ldap, basePath);
+                                string sortAttribute;
+                                cout << "Sort users by which attribute? (press Enter for " << defaultSortAttribute << "): ";
+                                getline(cin, sortAttribute);
+                                if (sortAttribute.empty())
+                                {
+                                    sortAttribute = defaultSortAttribute;
+                                }
+
+                                OutputFormat format = promptForOutputFormat();
+                                UserWriter writer(cout, format, displayedAttributes);
+                                if (userCache.isLoaded() && !backgroundTask && userCache.refresh() == LDAP_SUCCESS)
+                                {
+                                    if (format == OutputFormat::Table)
+                                    {
+                                        cout << "\nExisting LDAP users under ou=users," << basePath << ", sorted by " << sortAttribute << " (from the local cache):\n";
+                                    }
+
+                                    vector<const string*> values;
+                                    if (sameAttributeName(sortAttribute, defaultSortAttribute))
+                                    {
+                                        for (const auto& user : userCache.sortedById())
+                                        {
+                                            writeCachedUser(writer, *user.second, values);
+                                        }
+                                    }
+                                    else
+                                    {
+                                        // The cache is kept in ID order, so users are put in order of the other attribute here
+                                        vector<pair<string, const CachedUser*>> users;
+                                        users.reserve(userCache.size());
+                                        for (const auto& user : userCache.sortedById())
+                                        {
+                                            users.emplace_back(userSortKey(sortAttribute, cachedValue(*user.second, sortAttribute)), user.second);
+                                        }
+                                        stable_sort(users.begin(), users.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+                                        for (const auto& user : users)
+                                        {
+                                            writeCachedUser(writer, *user.second, values);
+                                        }
+                                    }
+                                    writer.finish();
+                                }
+                                else
+                                {
+                                    if (format == OutputFormat::Table)
+                                    {
+                                        cout << "\nExisting LDAP users under ou=users," << basePath << ", sorted by " << sortAttribute << ":\n";
+                                    }
+                                    runtime.call([&]() { displayAllLDAPUsers(ldap, basePath, sortAttribute, writer); });
+                                }
+
+                                if (format == OutputFormat::Table && writer.userCount() == 0)
+                                {
+                                    cout << "There are no users to display. Try adding users to the directory first." << endl;
+                                }
+                                break;
+                            }
+                            else if (viewChoice == "count")
+                            {
+                                size_t users = 0;
+                                int countResult = LDAP_SUCCESS;
+                                string countError;
+                                runtime.call([&]()
+                                {
+                                    countResult = userCount.count(users);
+                                    if (countResult != LDAP_SUCCESS)
+                                    {
+                                        countError = ldap->errorString(countResult);
+                                    }
+                                });
+                                if (countResult != LDAP_SUCCESS)
+                                {
+                                    cerr << "Failed to count the users: " << countError << endl;
+                                }
+                                else
+                                {
+                                    cout << "There are " << users << " users under ou=users," << basePath << "." << endl;
+                                }
+                                break;
+                            }
+                            else if (viewChoice == "query")
+                            {
+                                UserQuery query = promptForUserQuery();
+
+                                string countAttribute;
+                                cout << "Count the users per value of an attribute, such as ou, instead of listing them? (attribute, or press Enter to list): ";
+                                getline(cin, countAttribute);
+                                if (!countAttribute.empty())
+                                {
+                                    vector<UserGroupCount> counts;
+                                    size_t missingCount = 0;
+                                    OutputFormat format = promptForOutputFormat();
+                                    int rc = LDAP_SUCCESS;
+                                    runtime.call([&]() { rc = countUsersBy(ldap, basePath, query, countAttribute, counts, missingCount); });
+                                    if (rc == LDAP_SUCCESS || rc == LDAP_NO_SUCH_OBJECT)
+                                    {
+                                        writeUserCounts(cout, format, countAttribute, counts, missingCount);
+                                    }
+                                    break;
+                                }
+
+                                string attributeList;
+                                cout << "Attributes to show, separated by commas (press Enter for all): ";
+                                getline(cin, attributeList);
+                                vector<string> attributes = parseAttributeList(attributeList);
+                                if (attributes.empty())
+                                {
+                                    attributes = displayedAttributes;
+                                }
+
+                                UserWriter writer(cout, promptForOutputFormat(), attributes);
+                                runtime.call([&]() { queryUsers(ldap, basePath, query, writer); });
+                                if (writer.format() == OutputFormat::Table)
+                                {
+                                    cout << writer.userCount() << " users matched." << endl;
+                                }
                                 break;
                             }
                             else
                             {
-                                cout << "Invalid choice. Please enter 'single' or 'all'." << endl;
+                                cout << "Invalid choice. Please enter 'single', 'all', 'count' or 'query'." << endl;
                             }
                         }
                     }
                 }
                 else if (choice == "3")
                 {
-                    int userCount = 0;
-                    // Check if there are any users to delete
-                    LDAPMessage* result = nullptr;
-                    string filter = "(objectClass=inetOrgPerson)";
-                    string searchBase = "ou=users," + basePath;
-                    rc = ldap_search_ext_sA(ldap, const_cast<char*>(searchBase.c_str()), LDAP_SCOPE_ONELEVEL, const_cast<char*>(filter.c_str()), nullptr, 0, nullptr, nullptr, nullptr, LDAP_NO_LIMIT, &result);
-                    if (rc == LDAP_SUCCESS)
-                    {
-                        userCount = ldap_count_entries(ldap, result);
-                    }
-                    ldap_msgfree(result);
-
-                    if (userCount == 0)
+                    // Check if there are any users to delete without listing them
+                    if (userCount.isEmpty())
                     {
                         cout << "There are no users to delete. Try adding users to the directory first." << endl;
                     }
@@ -658,18 +685,44 @@ int main()
                                 cout << "Enter the user ID (cn): ";
                                 getline(cin, userId);
                                 string userDN = "cn=" + userId + ",ou=users," + basePath;
-                                rc = deleteSingleLDAPUser(ldap, userDN);
+                                if (userCache.isLoaded() && userCache.find(userId) == nullptr)
+                                {
+                                    cout << "User with DN '" << userDN << "' does not exist." << endl;
+                                    break;
+                                }
+                                rc = deleteSingleLDAPUser(ldap, userDN, userCache.isLoaded());
+                                if (rc == LDAP_SUCCESS)
+                                {
+                                    userCount.invalidate();
+                                    userCache.recordDelete(userId);
+                                }
                                 break;
                             }
                             else if (deleteChoice == "all")
                             {
+                                string backgroundChoice;
+                                cout << "Delete the users in the background? (y/n): ";
+                                getline(cin, backgroundChoice);
+                                if (backgroundChoice == "y" || backgroundChoice == "yes")
+                                {
+                                    backgroundTask.reset(new BackgroundTask());
+                                    backgroundTask->description = "Deleting the users under ou=users," + basePath;
+                                    runtime.spawn(deleteAllUsersInBackground(runtime, basePath, defaultDeleteWindow, *backgroundTask));
+                                    cout << "Deleting users in the background. Choose 7 to follow or cancel the delete." << endl;
+                                    break;
+                                }
+
                                 rc = deleteAllLDAPUsers(ldap, basePath);
+                                userCount.invalidate();
                                 if (rc != LDAP_SUCCESS)
                                 {
+                                    userCache.refresh(true);
                                     cerr << "Error deleting LDAP users under base path '" << basePath << "'" << endl;
                                 }
                                 else
                                 {
+                                    userCount.setCount(0);
+                                    userCache.recordDeleteAll();
                                     cout << "Deleted all LDAP users under base path '" << basePath << "'" << endl;
                                 }
                                 break;
@@ -683,7 +736,293 @@ int main()
                 }
                 else if (choice == "4")
                 {
+                    // Turn the local user cache on or off
+                    if (userCache.isLoaded())
+                    {
+                        cout << "Local user cache turned off (" << userCache.hits() << " hits, " << userCache.misses() << " misses)." << endl;
+                        userCache.clear();
+                    }
+                    else
+                    {
+                        cout << "Loading users into the local cache..." << endl;
+                        rc = userCache.load();
+                        if (rc != LDAP_SUCCESS)
+                        {
+                            cerr << "Failed to load the local user cache: " << ldap->errorString(rc) << endl;
+                        }
+                        else
+                        {
+                            cout << "Local user cache turned on with " << userCache.size() << " users." << endl;
+                        }
+                    }
+                }
+                else if (choice == "5")
+                {
+                    // Sync users with a .csv file, applying only what changed
+                    string filePath;
+                    CsvReader file;
+
+                    while (true)
+                    {
+                        // Prompt user for the path to the CSV file
+                        cout << "Enter the full path to the CSV file (e.g., C:\\path\\to\\file\\company.csv): ";
+                        getline(cin, filePath);
+
+                        // Check if the file path is valid
+                        if (filePath.empty())
+                        {
+                            cerr << "Error: The file path is empty. Please enter the correct file again." << endl;
+                            continue;
+                        }
+
+                        // Check if the file exists
+                        if (!file.open(filePath))
+                        {
+                            cerr << "Error: The file does not exist. Please enter the correct file again." << endl;
+                            continue;
+                        }
+
+                        // Check if the file is a CSV file
+                        if (filePath.substr(filePath.find_last_of(".") + 1) != "csv")
+                        {
+                            cerr << "Error: The file is not a CSV file. Please enter the correct file again." << endl;
+                            file.close();
+                            continue;
+                        }
+                        break;
+                    }
+
+                    // Check if the header is correct
+                    CsvRecord record;
+                    file.setExpectedColumns(csvColumnCount);
+                    if (file.next(record) != CsvStatus::Ok || !equal(record.fields.begin(), record.fields.end(), csvColumns))
+                    {
+                        cerr << "Error: CSV file header is incorrect. Returning to menu." << endl;
+                        file.close();
+                        continue;
+                    }
+
+                    string deleteChoice;
+                    cout << "Delete users that are not in the file? (y/n): ";
+                    getline(cin, deleteChoice);
+                    bool deleteMissing = deleteChoice == "y" || deleteChoice == "yes";
+
+                    DeltaSyncSummary summary;
+                    if (!summary.failures.open(defaultReportPath))
+                    {
+                        cerr << "Warning: The report file " << defaultReportPath << " can't be created, failures are only counted." << endl;
+                    }
+                    auto syncStart = chrono::steady_clock::now();
+                    rc = deltaSyncUsers(ldap, basePath, file, deleteMissing, defaultImportWindow, summary);
+                    double seconds = chrono::duration<double>(chrono::steady_clock::now() - syncStart).count();
+                    metrics().csvBytesRead.fetch_add(file.byteOffset(), memory_order_relaxed);
+                    file.close();
+
+                    if (rc != LDAP_SUCCESS)
+                    {
+                        cerr << "Failed to read the current users: " << ldap->errorString(rc) << endl;
+                        continue;
+                    }
+
+                    if (summary.added > 0 || summary.deleted > 0)
+                    {
+                        userCount.invalidate();
+                    }
+                    userCache.refresh(true);
+
+                    // Display results of the sync
+                    if (!summary.properFormat && deleteMissing)
+                    {
+                        cout << "No users were deleted because the file could not be read to the end." << endl;
+                    }
+                    cout << "Sync finished in " << seconds << " seconds: " << summary.added << " added, " << summary.modified << " modified, "
+                         << summary.deleted << " deleted, " << summary.unchanged << " unchanged." << endl;
+                    if (summary.duplicates > 0)
+                    {
+                        cout << summary.duplicates << " repeated user IDs in the file were skipped." << endl;
+                    }
+                    summary.failures.close();
+                    summary.failures.printSummary(cout);
+                }
+                else if (choice == "6")
+                {
+                    // Export or import the ou=users subtree as LDIF
+                    string ldifChoice;
+                    cout << "Export users to a file or import users from a file? (export/import): ";
+                    getline(cin, ldifChoice);
+
+                    if (ldifChoice == "export")
+                    {
+                        string filePath;
+                        cout << "Enter the full path of the LDIF file to write (e.g., C:\\path\\to\\file\\users.ldif): ";
+                        getline(cin, filePath);
+                        if (filePath.empty())
+                        {
+                            cerr << "Error: The file path is empty. Returning to menu." << endl;
+                            continue;
+                        }
+
+                        // The buffer has to be in place before the file is opened to take effect
+                        vector<char> outputBuffer(ldifBufferSize);
+                        ofstream out;
+                        out.rdbuf()->pubsetbuf(outputBuffer.data(), outputBuffer.size());
+                        out.open(filePath, ios::binary);
+                        if (!out.is_open())
+                        {
+                            cerr << "Error: The file can't be created. Returning to menu." << endl;
+                            continue;
+                        }
+
+                        size_t entryCount = 0;
+                        auto exportStart = chrono::steady_clock::now();
+                        rc = exportLdif(ldap, basePath, out, entryCount);
+                        double seconds = chrono::duration<double>(chrono::steady_clock::now() - exportStart).count();
+                        out.close();
+
+                        if (rc != LDAP_SUCCESS)
+                        {
+                            cerr << "Export stopped after " << entryCount << " entries: " << ldap->errorString(rc) << endl;
+                            continue;
+                        }
+                        cout << "Exported " << entryCount << " entries in " << seconds << " seconds";
+                        if (seconds > 0)
+                        {
+                            cout << " (" << static_cast<size_t>(entryCount / seconds) << " entries/sec)";
+                        }
+                        cout << "." << endl;
+                    }
+                    else if (ldifChoice == "import")
+                    {
+                        string filePath;
+                        LdifReader reader;
+                        cout << "Enter the full path to the LDIF file (e.g., C:\\path\\to\\file\\users.ldif): ";
+                        getline(cin, filePath);
+                        if (filePath.empty() || !reader.open(filePath))
+                        {
+                            cerr << "Error: The file does not exist. Returning to menu." << endl;
+                            continue;
+                        }
+
+                        size_t importConnections = promptForCount("Enter the number of connections to import with", "connections", defaultImportConnections);
+                        size_t importWindow = promptForCount("Enter the number of add requests to keep in flight per connection", "requests", defaultImportWindow);
+
+                        // Entries go through the same engine as CSV rows
+                        ImportReport report;
+                        if (!report.open(defaultReportPath))
+                        {
+                            cerr << "Warning: The report file " << defaultReportPath << " can't be created, failures are only counted." << endl;
+                        }
+                        ImportEngine engine(ldap, connectionSettings, basePath, importConnections, importWindow, report);
+                        engine.start();
+
+                        auto importStart = chrono::steady_clock::now();
+                        vector<ImportRow> batch;
+                        batch.reserve(importBatchSize);
+                        ImportRow row;
+                        LdifStatus status;
+                        while ((status = reader.next(row)) != LdifStatus::EndOfFile)
+                        {
+                            if (status != LdifStatus::Ok)
+                            {
+                                report.recordFailure("line " + to_string(reader.entryLine()), LdifReader::describe(status));
+                                continue;
+                            }
+                            batch.push_back(move(row));
+
+                            if (batch.size() == importBatchSize)
+                            {
+                                engine.submit(move(batch));
+                                batch = vector<ImportRow>();
+                                batch.reserve(importBatchSize);
+                            }
+                        }
+                        reader.close();
+
+                        // Wait for every connection to finish its entries
+                        engine.submit(move(batch));
+                        engine.finish();
+                        report.close();
+                        double seconds = chrono::duration<double>(chrono::steady_clock::now() - importStart).count();
+
+                        if (report.addedCount() > 0)
+                        {
+                            userCount.invalidate();
+                            userCache.refresh(true);
+                        }
+
+                        // Display results of the import
+                        cout << "Imported " << report.addedCount() << " entries in " << seconds << " seconds";
+                        if (seconds > 0)
+                        {
+                            cout << " (" << static_cast<size_t>(report.addedCount() / seconds) << " entries/sec)";
+                        }
+                        cout << "." << endl;
+                        report.printSummary(cout, "entries");
+                    }
+                    else
+                    {
+                        cout << "Invalid choice. Please enter 'export' or 'import'." << endl;
+                    }
+                }
+                else if (choice == "7")
+                {
+                    // Show, follow or cancel the background task
+                    if (!backgroundTask)
+                    {
+                        cout << "No task is running in the background." << endl;
+                        continue;
+                    }
+
+                    string taskChoice;
+                    cout << describeBackgroundTask(*backgroundTask) << endl;
+                    cout << "Cancel the task or wait for it to finish? (cancel/wait, or press Enter to return to menu): ";
+                    getline(cin, taskChoice);
+                    if (taskChoice == "cancel")
+                    {
+                        backgroundTask->cancelRequested.store(true, memory_order_relaxed);
+                        cout << "Cancelling, the requests already sent are still answered." << endl;
+                    }
+                    else if (taskChoice == "wait")
+                    {
+                        // The progress line is redrawn in place until the task finishes
+                        while (!backgroundTask->finished.load(memory_order_acquire))
+                        {
+                            cout << "\r" << describeBackgroundTask(*backgroundTask) << "    " << flush;
+                            this_thread::sleep_for(chrono::milliseconds(500));
+                        }
+                        cout << endl;
+                    }
+                }
+                else if (choice == "8")
+                {
+                    // A task still running is cancelled and waited for, the connection is closed after it
+                    if (backgroundTask && !backgroundTask->finished.load(memory_order_acquire))
+                    {
+                        string cancelChoice;
+                        cout << "A task is running in the background. Cancel it and exit? (y/n): ";
+                        getline(cin, cancelChoice);
+                        if (cancelChoice != "y" && cancelChoice != "yes")
+                        {
+                            continue;
+                        }
+                        backgroundTask->cancelRequested.store(true, memory_order_relaxed);
+                        cout << "Waiting for the requests already sent to be answered..." << endl;
+                        while (!backgroundTask->finished.load(memory_order_acquire))
+                        {
+                            this_thread::sleep_for(chrono::milliseconds(50));
+                        }
+                    }
+                    if (backgroundTask)
+                    {
+                        reportBackgroundTask(*backgroundTask);
+                        backgroundTask.reset();
+                    }
+
                     // Exit
+                    if (userCache.isLoaded())
+                    {
+                        cout << "Local user cache: " << userCache.hits() << " hits, " << userCache.misses() << " misses." << endl;
+                    }
                     break;
                 }
                 else
@@ -693,9 +1032,15 @@ int main()
             }
 
             // Clean up
+            runtime.stop();
             cout << "Unbinding from LDAP server..." << endl;
-            ldap_unbind_s(ldap);
+            ldap->close();
             cout << "LDAP unbind successful. Connection closed." << endl;
+
+            if (!writeMetricsSnapshot())
+            {
+                cerr << "Warning: Failed to write the metrics snapshot." << endl;
+            }
         }
         else if (connectChoice == "n" || connectChoice == "no")
         {